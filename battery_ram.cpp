@@ -0,0 +1,117 @@
+#include "battery_ram.hpp"
+
+#include <stdexcept>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+BatteryRAM::BatteryRAM(const std::string& path, std::chrono::milliseconds flush_interval)
+	: flush_interval{ flush_interval }
+{
+#if defined(_WIN32)
+	file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		throw std::runtime_error("BatteryRAM: could not open " + path);
+	}
+
+	// A mapping larger than the file extends it with zeros.
+	mapping = CreateFileMappingA(file, nullptr, PAGE_READWRITE, 0, static_cast<DWORD>(size), nullptr);
+	data = (mapping != nullptr) ? static_cast<byte*>(MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, size)) : nullptr;
+
+	if (data == nullptr)
+	{
+		if (mapping != nullptr)
+		{
+			CloseHandle(mapping);
+		}
+		CloseHandle(file);
+		throw std::runtime_error("BatteryRAM: could not map " + path);
+	}
+#else
+	int file{ open(path.c_str(), O_RDWR | O_CREAT, 0644) };
+	if (file < 0)
+	{
+		throw std::runtime_error("BatteryRAM: could not open " + path);
+	}
+
+	// Longer files (some dumps pad their saves) keep their tail; only the first 8 KiB is mapped.
+	struct stat status;
+	bool sized{ fstat(file, &status) == 0 && (status.st_size >= static_cast<off_t>(size) || ftruncate(file, size) == 0) };
+
+	void* view{ sized ? mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0) : MAP_FAILED };
+	close(file);
+
+	if (view == MAP_FAILED)
+	{
+		throw std::runtime_error("BatteryRAM: could not map " + path);
+	}
+
+	data = static_cast<byte*>(view);
+#endif
+
+	flusher = std::thread{ &BatteryRAM::flushLoop, this };
+}
+
+
+BatteryRAM::~BatteryRAM()
+{
+	{
+		std::lock_guard<std::mutex> lock{ mutex };
+		stopping = true;
+	}
+	wake.notify_one();
+	flusher.join();
+
+	flush();
+
+#if defined(_WIN32)
+	UnmapViewOfFile(data);
+	CloseHandle(mapping);
+	CloseHandle(file);
+#else
+	munmap(data, size);
+#endif
+}
+
+
+byte* BatteryRAM::getData()
+{
+	return data;
+}
+
+
+void BatteryRAM::flush()
+{
+#if defined(_WIN32)
+	FlushViewOfFile(data, size);
+	FlushFileBuffers(file);
+#else
+	msync(data, size, MS_SYNC);
+#endif
+}
+
+
+/*
+	Flushing pages that were not written since the last flush costs a system call and
+	no I/O, so the loop does not track whether the game saved.
+*/
+void BatteryRAM::flushLoop()
+{
+	std::unique_lock<std::mutex> lock{ mutex };
+
+	while (!wake.wait_for(lock, flush_interval, [this] { return stopping; }))
+	{
+		lock.unlock();
+		flush();
+		lock.lock();
+	}
+}
\ No newline at end of file
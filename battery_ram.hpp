@@ -0,0 +1,62 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "types.hpp"
+
+
+/// <summary>
+/// Battery-backed PRG RAM ($6000-$7FFF) kept in a save file that is memory-mapped shared.
+/// The bus maps its pages straight onto the file (see NES::setBatteryRAM()), so a game's
+/// writes cost what RAM writes cost and the emulation loop does no save-related I/O.
+///
+/// The operating system owns the written pages as soon as they are written, so they survive
+/// the emulator crashing. A background thread flushes them to disk periodically (and the
+/// destructor once more), which bounds what a system crash or power loss can lose.
+/// </summary>
+class BatteryRAM
+{
+public:
+	static constexpr size_t size{ 0x2000 };
+
+	/// <summary>
+	/// Opens the save file, creating it if needed. Files shorter than 8 KiB are extended with
+	/// zeros (the RAM of a new cartridge). Throws std::runtime_error if it cannot be mapped.
+	/// </summary>
+	/// <param name="flush_interval">Time between flushes to disk.</param>
+	explicit BatteryRAM(const std::string& path, std::chrono::milliseconds flush_interval = std::chrono::seconds{ 1 });
+	~BatteryRAM();
+
+	BatteryRAM(const BatteryRAM&) = delete;
+	BatteryRAM& operator=(const BatteryRAM&) = delete;
+
+	/// <summary>
+	/// The mapped 8 KiB.
+	/// </summary>
+	byte* getData();
+
+	/// <summary>
+	/// Writes the RAM to disk now and waits for it.
+	/// </summary>
+	void flush();
+
+private:
+	void flushLoop();
+
+	byte* data{ nullptr };
+
+#if defined(_WIN32)
+	void* file{ nullptr };
+	void* mapping{ nullptr };
+#endif
+
+	std::chrono::milliseconds flush_interval;
+	std::thread flusher;
+	std::mutex mutex;
+	std::condition_variable wake;
+	bool stopping{ false };
+};
\ No newline at end of file
@@ -0,0 +1,725 @@
+#include "benchmark.hpp"
+#include "nes.hpp"
+#include "opcodes.hpp"
+#include "perf_counters.hpp"
+#include "recompiler.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+
+namespace
+{
+	// Memory layout of the generated loops. Code runs from ROM; operands point into RAM.
+	constexpr word code_start{ 0x8000 };
+	constexpr word data_address{ 0x0280 };
+	constexpr word crossing_data_address{ 0x02F8 };		// + index_value lands on the next page
+	constexpr word jump_table{ 0x0300 };				// pointers for JMP ($nnnn), one per copy
+	constexpr byte zero_page_operand{ 0x40 };			// (zero_page_operand,X) points at the data
+	constexpr byte indirect_pointer{ 0x60 };			// (indirect_pointer),Y points at the data
+	constexpr byte index_value{ 0x10 };
+
+	// Instructions per generated loop; enough to make the closing JMP negligible.
+	constexpr size_t unroll{ 256 };
+
+	// Length of the official nestest log, in CPU cycles from $C000.
+	constexpr uint64_t nestest_cycles{ 26554 };
+
+
+	/// <summary>
+	/// Runs a prepared case for a number of passes and returns the operations executed.
+	/// </summary>
+	using Runner = std::function<uint64_t(uint64_t passes)>;
+
+	struct Case
+	{
+		std::string name;
+		const char* unit;
+		std::function<Runner()> prepare;
+	};
+
+	struct Result
+	{
+		std::string name;
+		const char* unit;
+		double ns_per_op;				// median of the samples
+		double ns_min;
+		uint64_t ops;
+		double counters[PerfCounters::counter_count];
+	};
+
+	struct Options
+	{
+		std::string filter;
+		int repetitions{ 5 };
+		double min_time_ms{ 10.0 };
+		std::string json_path;
+		std::string baseline_path;
+		double threshold_percent{ 10.0 };
+		std::string nestest_path;
+		std::string rom_path;
+		bool list{ false };
+	};
+
+
+	const char* getModeName(AddressingMode mode)
+	{
+		static constexpr const char* names[]{
+			"Implied", "Accumulator", "Immediate", "ZeroPage", "ZeroPageX", "ZeroPageY", "Relative",
+			"Absolute", "AbsoluteX", "AbsoluteY", "Indirect", "IndirectX", "IndirectY",
+		};
+		return names[static_cast<size_t>(mode)];
+	}
+
+
+	// Where the loop for the opcode starts (see loadOpcodeLoop()).
+	word getLoopStart(byte opcode)
+	{
+		switch (opcode)
+		{
+			case 0x40:	return 0x8080;
+			case 0x60:	return 0x8081;
+			default:	return code_start;
+		}
+	}
+
+
+	/*
+		Repeats one opcode, then jumps back. Operands point at data, through pointers where the
+		mode needs them, so indexed modes cross a page exactly when data does. Branches go to
+		the next instruction whether taken or not, and JMP and JSR go to the next copy.
+
+		The instructions that cannot fall through are loops of their own: BRK through the IRQ
+		vector, and RTS and RTI through a stack page filled with $80, which makes every return
+		go to $8081 and $8080 respectively (see getLoopStart()).
+	*/
+	void loadOpcodeLoop(Bus& bus, byte opcode, word data)
+	{
+		const OpcodeInfo& info{ opcode_table[opcode] };
+		bool is_jump{ std::strcmp(info.mnemonic, "JMP") == 0 || std::strcmp(info.mnemonic, "JSR") == 0 };
+		bool is_loop{ opcode == 0x00 || opcode == 0x40 || opcode == 0x60 };
+		size_t copies{ is_loop ? 1 : (info.mode == AddressingMode::Indirect) ? unroll / 2 : unroll };
+		word start{ getLoopStart(opcode) };
+
+		std::vector<byte> code;
+		for (size_t i{ 0 }; i < copies; ++i)
+		{
+			word next{ static_cast<word>(start + code.size() + getInstructionLength(info.mode)) };
+			code.push_back(opcode);
+
+			switch (info.mode)
+			{
+				case AddressingMode::Immediate:
+					code.push_back(0x01);
+					break;
+
+				case AddressingMode::Relative:
+					code.push_back(0x00);
+					break;
+
+				case AddressingMode::ZeroPage:
+				case AddressingMode::ZeroPageX:
+				case AddressingMode::ZeroPageY:
+				case AddressingMode::IndirectX:
+					code.push_back(zero_page_operand);
+					break;
+
+				case AddressingMode::IndirectY:
+					code.push_back(indirect_pointer);
+					break;
+
+				case AddressingMode::Absolute:
+				case AddressingMode::AbsoluteX:
+				case AddressingMode::AbsoluteY:
+					code.push_back(static_cast<byte>((is_jump ? next : data) & 0xFF));
+					code.push_back(static_cast<byte>((is_jump ? next : data) >> 8));
+					break;
+
+				case AddressingMode::Indirect:
+				{
+					word pointer{ static_cast<word>(jump_table + 2 * i) };
+					code.push_back(static_cast<byte>(pointer & 0xFF));
+					code.push_back(static_cast<byte>(pointer >> 8));
+
+					byte target[2]{ static_cast<byte>(next & 0xFF), static_cast<byte>(next >> 8) };
+					bus.load(pointer, target, sizeof(target));
+					break;
+				}
+
+				default:
+					break;
+			}
+		}
+
+		if (!is_loop)
+		{
+			code.insert(code.end(), { 0x4C, static_cast<byte>(start & 0xFF), static_cast<byte>(start >> 8) });
+		}
+		bus.load(start, code);
+
+		std::vector<byte> stack(0x100, 0x80);
+		bus.load(Bus::stack_page, stack);
+
+		byte pointer[2]{ static_cast<byte>(data & 0xFF), static_cast<byte>(data >> 8) };
+		bus.load(zero_page_operand + index_value, pointer, sizeof(pointer));
+		bus.load(indirect_pointer, pointer, sizeof(pointer));
+
+		byte vector[2]{ static_cast<byte>(code_start & 0xFF), static_cast<byte>(code_start >> 8) };
+		bus.load(0xFFFE, vector, sizeof(vector));
+	}
+
+
+	/*
+		A checksum over two pages of RAM: the kind of tight load/compute/store loop games spend
+		their frames in.
+	*/
+	void loadCPULoop(Bus& bus)
+	{
+		const std::vector<byte> code{
+			0xA2, 0x00,					// start:	LDX #$00
+			0xBD, 0x00, 0x03,			// inner:	LDA $0300,X
+			0x65, 0x10,					//			ADC $10
+			0x85, 0x10,					//			STA $10
+			0x5D, 0x00, 0x04,			//			EOR $0400,X
+			0x9D, 0x00, 0x04,			//			STA $0400,X
+			0x2A,						//			ROL A
+			0xCA,						//			DEX
+			0xD0, 0xF0,					//			BNE inner
+			0xE6, 0x11,					//			INC $11
+			0x4C, 0x00, 0x80,			//			JMP start
+		};
+		bus.load(code_start, code);
+	}
+
+
+	/*
+		NROM image that turns rendering on and then runs a store loop forever, so a frame
+		costs a full picture plus a frame's worth of CPU work. The CHR is an arbitrary pattern.
+	*/
+	std::vector<byte> makeFrameImage()
+	{
+		std::vector<byte> image{ 'N', 'E', 'S', 0x1A, 0x01, 0x01, 0x00, 0x00 };
+		image.resize(16 + 0x4000 + 0x2000, 0x00);
+
+		const std::vector<byte> code{
+			0xA9, 0x1E,					//			LDA #$1E
+			0x8D, 0x01, 0x20,			//			STA $2001
+			0xE6, 0x10,					// loop:	INC $10
+			0xA5, 0x10,					//			LDA $10
+			0x69, 0x03,					//			ADC #$03
+			0x9D, 0x00, 0x03,			//			STA $0300,X
+			0xE8,						//			INX
+			0xD0, 0xF5,					//			BNE loop
+			0x4C, 0x05, 0x80,			//			JMP loop
+		};
+		std::copy(code.begin(), code.end(), image.begin() + 16);
+
+		// NMI (never enabled), reset and IRQ vectors.
+		const byte vectors[6]{ 0x05, 0x80, 0x00, 0x80, 0x05, 0x80 };
+		std::copy(std::begin(vectors), std::end(vectors), image.begin() + 16 + 0x3FFA);
+
+		for (size_t i{ 0 }; i < 0x2000; ++i)
+		{
+			image[16 + 0x4000 + i] = static_cast<byte>(i * 37 + (i >> 8));
+		}
+
+		return image;
+	}
+
+
+	/*
+		A CPU looping over a program from start. One pass is once around the loop; it is stepped
+		through once to count its instructions and cycles. After that runUntil() (the dispatch
+		loop the emulator runs) executes whole passes.
+	*/
+	Runner makeLoopRunner(const std::function<void(Bus&)>& load, word start, CPUAccuracy accuracy)
+	{
+		auto cpu{ std::make_shared<CPU>() };
+		cpu->setAccuracy(accuracy);
+		cpu->setIdleLoopSkipping(false);
+		load(cpu->getBus());
+		cpu->setRegisters({ start, 0xFF, 0x01, index_value, index_value, 0x24 });
+
+		uint64_t first_cycle{ cpu->getCycles() };
+		uint64_t instructions{ 0 };
+		do
+		{
+			cpu->step();
+			++instructions;
+		} while (cpu->getRegisters().program_counter != start && instructions < 0x10000);
+
+		if (cpu->getRegisters().program_counter != start)
+		{
+			throw std::runtime_error("Benchmark: generated program does not loop");
+		}
+
+		uint64_t cycles_per_pass{ cpu->getCycles() - first_cycle };
+
+		return [cpu, instructions, cycles_per_pass](uint64_t passes) {
+			cpu->runUntil(cpu->getCycles() + passes * cycles_per_pass);
+			return passes * instructions;
+		};
+	}
+
+
+	Runner makeNestestRunner(const std::string& path, CPUAccuracy accuracy)
+	{
+		auto nes{ std::make_shared<NES>() };
+		nes->getCPU().setAccuracy(accuracy);
+		nes->loadCartridge(Cartridge::load(path));
+		nes->power();
+
+		// Automation mode: start at $C000 instead of the reset vector.
+		CPU::Registers registers{ nes->getCPU().getRegisters() };
+		registers.program_counter = 0xC000;
+		registers.stack_pointer = 0xFD;
+		registers.processor_status = 0x24;
+		nes->getCPU().setRegisters(registers);
+
+		auto start{ std::make_shared<NES::Fork>() };
+		nes->fork(*start);
+
+		return [nes, start](uint64_t passes) {
+			uint64_t ops{ 0 };
+			for (uint64_t pass{ 0 }; pass < passes; ++pass)
+			{
+				nes->loadFork(*start);
+
+				CPU& cpu{ nes->getCPU() };
+				uint64_t first_cycle{ cpu.getCycles() };
+				cpu.runUntil(first_cycle + nestest_cycles);
+				ops += cpu.getCycles() - first_cycle;
+			}
+			return ops;
+		};
+	}
+
+
+	Runner makeFrameRunner(const std::vector<byte>& image, bool render, CPUAccuracy accuracy)
+	{
+		auto nes{ std::make_shared<NES>() };
+		nes->getCPU().setAccuracy(accuracy);
+		nes->loadCartridge(Cartridge{ image });
+		nes->power();
+
+		return [nes, render](uint64_t passes) {
+			for (uint64_t pass{ 0 }; pass < passes; ++pass)
+			{
+				nes->runFrame(render);
+			}
+			return passes;
+		};
+	}
+
+
+	/*
+		Every case runs once per accuracy tier, named after the tier as --accuracy spells it, so
+		the regression gate covers the bus-exact dispatch loops as well.
+	*/
+	void addCases(std::vector<Case>& cases, const Options& options, CPUAccuracy accuracy, const std::string& tier)
+	{
+		for (int opcode{ 0 }; opcode < 0x100; ++opcode)
+		{
+			if (!Recompiler::isCompiled(static_cast<byte>(opcode)))
+			{
+				continue;
+			}
+
+			const OpcodeInfo& info{ opcode_table[opcode] };
+			char name[64];
+			std::snprintf(name, sizeof(name), "/opcode/%02X %s %s", opcode, info.mnemonic, getModeName(info.mode));
+
+			cases.push_back({ tier + name, "instruction", [opcode, accuracy]() {
+				return makeLoopRunner([opcode](Bus& bus) { loadOpcodeLoop(bus, static_cast<byte>(opcode), data_address); },
+					getLoopStart(static_cast<byte>(opcode)), accuracy);
+			} });
+		}
+
+		struct ModeCase
+		{
+			const char* name;
+			byte opcode;
+			word data;
+		};
+
+		// Loads (LDX for zero page,Y; JMP for indirect) so only the addressing differs.
+		static constexpr ModeCase modes[]{
+			{ "/mode/Immediate", 0xA9, data_address },
+			{ "/mode/ZeroPage", 0xA5, data_address },
+			{ "/mode/ZeroPageX", 0xB5, data_address },
+			{ "/mode/ZeroPageY", 0xB6, data_address },
+			{ "/mode/Absolute", 0xAD, data_address },
+			{ "/mode/AbsoluteX", 0xBD, data_address },
+			{ "/mode/AbsoluteX crossing", 0xBD, crossing_data_address },
+			{ "/mode/AbsoluteY", 0xB9, data_address },
+			{ "/mode/AbsoluteY crossing", 0xB9, crossing_data_address },
+			{ "/mode/IndirectX", 0xA1, data_address },
+			{ "/mode/IndirectY", 0xB1, data_address },
+			{ "/mode/IndirectY crossing", 0xB1, crossing_data_address },
+			{ "/mode/Indirect", 0x6C, data_address },
+		};
+
+		for (const ModeCase& mode : modes)
+		{
+			cases.push_back({ tier + mode.name, "instruction", [mode, accuracy]() {
+				return makeLoopRunner([mode](Bus& bus) { loadOpcodeLoop(bus, mode.opcode, mode.data); }, code_start, accuracy);
+			} });
+		}
+
+		cases.push_back({ tier + "/macro/cpu loop", "instruction", [accuracy]() { return makeLoopRunner(loadCPULoop, code_start, accuracy); } });
+
+		if (!options.nestest_path.empty())
+		{
+			std::string path{ options.nestest_path };
+			cases.push_back({ tier + "/macro/nestest", "cycle", [path, accuracy]() { return makeNestestRunner(path, accuracy); } });
+		}
+
+		cases.push_back({ tier + "/macro/frame", "frame", [accuracy]() { return makeFrameRunner(makeFrameImage(), true, accuracy); } });
+		cases.push_back({ tier + "/macro/frame skip", "frame", [accuracy]() { return makeFrameRunner(makeFrameImage(), false, accuracy); } });
+
+		if (!options.rom_path.empty())
+		{
+			std::string path{ options.rom_path };
+			cases.push_back({ tier + "/macro/rom frame", "frame", [path, accuracy]() { return makeFrameRunner(Cartridge::readImage(path), true, accuracy); } });
+			cases.push_back({ tier + "/macro/rom frame skip", "frame", [path, accuracy]() { return makeFrameRunner(Cartridge::readImage(path), false, accuracy); } });
+		}
+	}
+
+
+	std::vector<Case> makeCases(const Options& options)
+	{
+		std::vector<Case> cases;
+		addCases(cases, options, CPUAccuracy::Instruction, "instruction");
+		addCases(cases, options, CPUAccuracy::BusExact, "bus");
+		return cases;
+	}
+
+
+	double getSeconds(std::chrono::steady_clock::duration duration)
+	{
+		return std::chrono::duration<double>(duration).count();
+	}
+
+
+	/*
+		Sizing the sample doubles as the warm-up: passes grow until one sample takes the minimum
+		time, by which point code, data and branch predictors have settled.
+	*/
+	Result measure(const Case& test, PerfCounters& counters, const Options& options)
+	{
+		Runner runner{ test.prepare() };
+
+		double min_time{ options.min_time_ms / 1000.0 };
+		uint64_t passes{ 1 };
+		for (;;)
+		{
+			auto start{ std::chrono::steady_clock::now() };
+			runner(passes);
+			double elapsed{ getSeconds(std::chrono::steady_clock::now() - start) };
+
+			if (elapsed >= min_time || passes >= (uint64_t{ 1 } << 40))
+			{
+				break;
+			}
+
+			double scale{ (elapsed > 0.0) ? std::min(min_time * 1.2 / elapsed, 16.0) : 16.0 };
+			passes = std::max(passes * 2, static_cast<uint64_t>(static_cast<double>(passes) * scale));
+		}
+
+		Result result{ test.name, test.unit, 0.0, 0.0, 0, {} };
+		std::vector<double> samples;
+		PerfCounters::Values totals{};
+
+		for (int repetition{ 0 }; repetition < options.repetitions; ++repetition)
+		{
+			counters.start();
+			auto start{ std::chrono::steady_clock::now() };
+			uint64_t ops{ runner(passes) };
+			double elapsed{ getSeconds(std::chrono::steady_clock::now() - start) };
+			PerfCounters::Values values{ counters.stop() };
+
+			samples.push_back(elapsed * 1e9 / static_cast<double>(ops));
+			result.ops += ops;
+			for (size_t counter{ 0 }; counter < PerfCounters::counter_count; ++counter)
+			{
+				totals.counts[counter] += values.counts[counter];
+			}
+		}
+
+		std::sort(samples.begin(), samples.end());
+		result.ns_per_op = samples[samples.size() / 2];
+		result.ns_min = samples.front();
+		for (size_t counter{ 0 }; counter < PerfCounters::counter_count; ++counter)
+		{
+			result.counters[counter] = static_cast<double>(totals.counts[counter]) / static_cast<double>(result.ops);
+		}
+
+		return result;
+	}
+
+
+	bool writeJSON(const std::string& path, const std::vector<Result>& results, const PerfCounters& counters, const Options& options)
+	{
+		std::unique_ptr<std::FILE, int(*)(std::FILE*)> file{ std::fopen(path.c_str(), "w"), &std::fclose };
+		if (file == nullptr)
+		{
+			return false;
+		}
+
+		std::fprintf(file.get(), "{\n\t\"version\": 1,\n\t\"repetitions\": %d,\n\t\"min_time_ms\": %g,\n\t\"results\": [\n",
+			options.repetitions, options.min_time_ms);
+
+		// One result per line: the baseline reader relies on it.
+		for (size_t i{ 0 }; i < results.size(); ++i)
+		{
+			const Result& result{ results[i] };
+			std::fprintf(file.get(), "\t\t{ \"name\": \"%s\", \"unit\": \"%s\", \"ns_per_op\": %.4f, \"ns_min\": %.4f, \"ops\": %llu",
+				result.name.c_str(), result.unit, result.ns_per_op, result.ns_min, static_cast<unsigned long long>(result.ops));
+
+			for (size_t counter{ 0 }; counter < PerfCounters::counter_count; ++counter)
+			{
+				PerfCounters::Counter id{ static_cast<PerfCounters::Counter>(counter) };
+				if (counters.isAvailable(id))
+				{
+					std::fprintf(file.get(), ", \"%s_per_op\": %.4f", PerfCounters::getName(id), result.counters[counter]);
+				}
+			}
+
+			std::fprintf(file.get(), " }%s\n", (i + 1 < results.size()) ? "," : "");
+		}
+
+		std::fprintf(file.get(), "\t]\n}\n");
+		return std::ferror(file.get()) == 0;
+	}
+
+
+	/*
+		Reads name and ns_min of every result in a file written by writeJSON().
+	*/
+	std::map<std::string, double> readBaseline(const std::string& path)
+	{
+		std::unique_ptr<std::FILE, int(*)(std::FILE*)> file{ std::fopen(path.c_str(), "r"), &std::fclose };
+		if (file == nullptr)
+		{
+			throw std::runtime_error("Benchmark: could not open baseline " + path);
+		}
+
+		std::map<std::string, double> baseline;
+		char line[1024];
+		while (std::fgets(line, sizeof(line), file.get()) != nullptr)
+		{
+			const char* name{ std::strstr(line, "\"name\": \"") };
+			const char* time{ std::strstr(line, "\"ns_min\": ") };
+			if (name == nullptr || time == nullptr)
+			{
+				continue;
+			}
+
+			name += std::strlen("\"name\": \"");
+			const char* name_end{ std::strchr(name, '"') };
+			if (name_end != nullptr)
+			{
+				baseline[std::string(name, name_end)] = std::strtod(time + std::strlen("\"ns_min\": "), nullptr);
+			}
+		}
+
+		if (baseline.empty())
+		{
+			throw std::runtime_error("Benchmark: no results in baseline " + path);
+		}
+
+		return baseline;
+	}
+
+
+	void printResult(const Result& result, const PerfCounters& counters)
+	{
+		std::printf("%-40s %10.2f ns/%-11s (min %.2f)", result.name.c_str(), result.ns_per_op, result.unit, result.ns_min);
+
+		for (size_t counter{ 0 }; counter < PerfCounters::counter_count; ++counter)
+		{
+			PerfCounters::Counter id{ static_cast<PerfCounters::Counter>(counter) };
+			if (counters.isAvailable(id))
+			{
+				std::printf("  %s %.2f", PerfCounters::getName(id), result.counters[counter]);
+			}
+		}
+
+		std::printf("\n");
+	}
+
+
+	/*
+		A case regresses if its fastest sample is more than the threshold slower than the baseline's.
+		The fastest sample is the one least disturbed by the rest of the system (which only ever
+		adds time), so it varies far less between runs than the median. Cases missing from either
+		side are listed but do not fail the gate.
+	*/
+	int compare(const std::vector<Result>& results, const std::map<std::string, double>& baseline, double threshold_percent, bool filtered)
+	{
+		size_t regressions{ 0 };
+		std::printf("\ncompared with baseline (threshold %.1f%%):\n", threshold_percent);
+
+		for (const Result& result : results)
+		{
+			auto entry{ baseline.find(result.name) };
+			if (entry == baseline.end())
+			{
+				std::printf("  %-40s new\n", result.name.c_str());
+				continue;
+			}
+
+			double change{ (entry->second > 0.0) ? (result.ns_min / entry->second - 1.0) * 100.0 : 0.0 };
+			bool regressed{ change > threshold_percent };
+			regressions += regressed ? 1 : 0;
+
+			if (regressed || std::fabs(change) > threshold_percent / 2.0)
+			{
+				std::printf("  %-40s %10.2f -> %10.2f  %+6.1f%%%s\n", result.name.c_str(), entry->second, result.ns_min, change,
+					regressed ? "  REGRESSION" : "");
+			}
+		}
+
+		for (const auto& [name, time] : baseline)
+		{
+			bool measured{ std::any_of(results.begin(), results.end(), [&name](const Result& result) { return result.name == name; }) };
+			if (!measured && !filtered)
+			{
+				std::printf("  %-40s not measured\n", name.c_str());
+			}
+		}
+
+		if (regressions > 0)
+		{
+			std::printf("%zu case(s) regressed by more than %.1f%%\n", regressions, threshold_percent);
+			return 1;
+		}
+
+		std::printf("no regressions\n");
+		return EXIT_SUCCESS;
+	}
+}
+
+
+int Benchmark::run(int argc, char* argv[])
+{
+	Options options;
+	bool valid{ true };
+
+	for (int i{ 0 }; i < argc; ++i)
+	{
+		std::string argument{ argv[i] };
+		bool has_value{ i + 1 < argc };
+
+		if (argument == "--filter" && has_value)
+		{
+			options.filter = argv[++i];
+		}
+		else if (argument == "--list")
+		{
+			options.list = true;
+		}
+		else if (argument == "--repetitions" && has_value)
+		{
+			options.repetitions = std::max(1, std::atoi(argv[++i]));
+		}
+		else if (argument == "--min-time" && has_value)
+		{
+			options.min_time_ms = std::max(0.1, std::atof(argv[++i]));
+		}
+		else if (argument == "--json" && has_value)
+		{
+			options.json_path = argv[++i];
+		}
+		else if (argument == "--baseline" && has_value)
+		{
+			options.baseline_path = argv[++i];
+		}
+		else if (argument == "--threshold" && has_value)
+		{
+			options.threshold_percent = std::atof(argv[++i]);
+		}
+		else if (argument == "--nestest" && has_value)
+		{
+			options.nestest_path = argv[++i];
+		}
+		else if (argument == "--rom" && has_value)
+		{
+			options.rom_path = argv[++i];
+		}
+		else
+		{
+			valid = false;
+		}
+	}
+
+	if (!valid)
+	{
+		std::fprintf(stderr, "usage: bench [--filter text] [--list] [--repetitions n] [--min-time ms] [--json file]\n"
+			"             [--baseline file] [--threshold percent] [--nestest nestest.nes] [--rom rom.nes]\n");
+		return EXIT_FAILURE;
+	}
+
+	try
+	{
+		std::map<std::string, double> baseline;
+		if (!options.baseline_path.empty())
+		{
+			baseline = readBaseline(options.baseline_path);
+		}
+
+		std::vector<Case> cases{ makeCases(options) };
+		cases.erase(std::remove_if(cases.begin(), cases.end(), [&options](const Case& test) {
+			return test.name.find(options.filter) == std::string::npos;
+		}), cases.end());
+
+		if (options.list)
+		{
+			for (const Case& test : cases)
+			{
+				std::printf("%s\n", test.name.c_str());
+			}
+			return EXIT_SUCCESS;
+		}
+
+		PerfCounters counters;
+		std::printf("hardware counters:");
+		for (size_t counter{ 0 }; counter < PerfCounters::counter_count; ++counter)
+		{
+			PerfCounters::Counter id{ static_cast<PerfCounters::Counter>(counter) };
+			std::printf(" %s%s", PerfCounters::getName(id), counters.isAvailable(id) ? "" : " (unavailable)");
+		}
+		std::printf("\n\n");
+
+		std::vector<Result> results;
+		for (const Case& test : cases)
+		{
+			results.push_back(measure(test, counters, options));
+			printResult(results.back(), counters);
+			std::fflush(stdout);
+		}
+
+		if (!options.json_path.empty() && !writeJSON(options.json_path, results, counters, options))
+		{
+			throw std::runtime_error("Benchmark: could not write " + options.json_path);
+		}
+
+		return options.baseline_path.empty() ? EXIT_SUCCESS : compare(results, baseline, options.threshold_percent, !options.filter.empty());
+	}
+	catch (const std::exception& e)
+	{
+		std::fprintf(stderr, "%s\n", e.what());
+		return EXIT_FAILURE;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,40 @@
+#pragma once
+
+/// <summary>
+/// Microbenchmarks of the interpreter, with a regression gate.
+///
+///		opcode/...	every opcode the dispatch loop implements, alone in an unrolled loop (ns per instruction)
+///		mode/...	one load per addressing mode, with and without a page crossing; the
+///					differences between them are the cost of the getAddr_* helpers
+///		macro/...	a CPU-only loop (ns per instruction), nestest from $C000 (ns per CPU cycle),
+///					and whole frames with and without rendering (ns per frame)
+///
+/// Each case runs under both accuracy tiers, named instruction/... and bus/... (see CPUAccuracy).
+///
+/// Every case is run until it is in a steady state, then timed over a number of samples of
+/// at least the minimum time each. The median is reported, along with the user-mode hardware
+/// counters per operation (PerfCounters) where the system provides them.
+/// The regression gate compares the fastest sample of each case with the baseline's.
+///
+///		emuNES bench [options]
+///			--filter <text>			only cases whose name contains text
+///			--list					print the case names and exit
+///			--repetitions <n>		samples per case (default 5)
+///			--min-time <ms>			minimum duration of a sample (default 10)
+///			--json <file>			write the results as JSON
+///			--baseline <file>		compare with the JSON of an earlier run
+///			--threshold <percent>	allowed slowdown against the baseline (default 10)
+///			--nestest <nestest.nes>	add macro/nestest
+///			--rom <rom.nes>			add whole frames of a real game
+/// </summary>
+class Benchmark
+{
+public:
+	/// <param name="argc">Number of arguments following the tool name.</param>
+	/// <param name="argv">Arguments following the tool name.</param>
+	/// <returns>Process exit code: 1 if a case regressed past the threshold.</returns>
+	static int run(int argc, char* argv[]);
+
+private:
+	Benchmark() = delete;
+};
\ No newline at end of file
@@ -0,0 +1,459 @@
+#include "binary_trace.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+
+namespace
+{
+	constexpr char header_magic[8]{ 'N', 'E', 'S', 'T', 'R', 'A', 'C', 'E' };
+	constexpr char footer_magic[8]{ 'N', 'E', 'S', 'T', 'I', 'D', 'X', '!' };
+	constexpr uint32_t format_version{ 1 };
+
+	constexpr size_t header_size{ 8 + 4 + 4 + 4 };
+	constexpr size_t index_entry_size{ 8 + 4 + 4 + 8 + 8 };
+	constexpr size_t footer_size{ 8 + 8 + 8 };
+
+
+	// Traces grow past 2 GiB, so use 64-bit file offsets everywhere.
+	int seekFile(std::FILE* file, int64_t offset, int origin)
+	{
+#ifdef _WIN32
+		return _fseeki64(file, offset, origin);
+#else
+		return fseeko(file, static_cast<off_t>(offset), origin);
+#endif
+	}
+
+
+	uint64_t tellFile(std::FILE* file)
+	{
+#ifdef _WIN32
+		return static_cast<uint64_t>(_ftelli64(file));
+#else
+		return static_cast<uint64_t>(ftello(file));
+#endif
+	}
+
+
+	void putLE(byte* out, uint64_t value, size_t size)
+	{
+		for (size_t i{ 0 }; i < size; ++i)
+		{
+			out[i] = static_cast<byte>(value >> (8 * i));
+		}
+	}
+
+
+	uint64_t getLE(const byte* in, size_t size)
+	{
+		uint64_t value{ 0 };
+		for (size_t i{ 0 }; i < size; ++i)
+		{
+			value |= static_cast<uint64_t>(in[i]) << (8 * i);
+		}
+
+		return value;
+	}
+
+
+	void serialize(const TraceRecord& record, byte* out)
+	{
+		putLE(out, record.program_counter, 2);
+		out[2] = record.opcode;
+		out[3] = record.reg_accumulator;
+		out[4] = record.reg_x;
+		out[5] = record.reg_y;
+		out[6] = record.processor_status;
+		out[7] = record.stack_pointer;
+		putLE(out + 8, record.cycle_delta, 4);
+	}
+
+
+	TraceRecord deserialize(const byte* in)
+	{
+		TraceRecord record;
+		record.program_counter = static_cast<word>(getLE(in, 2));
+		record.opcode = in[2];
+		record.reg_accumulator = in[3];
+		record.reg_x = in[4];
+		record.reg_y = in[5];
+		record.processor_status = in[6];
+		record.stack_pointer = in[7];
+		record.cycle_delta = static_cast<uint32_t>(getLE(in + 8, 4));
+
+		return record;
+	}
+
+
+	/*
+		Chunk codec.
+
+		Records are transposed into byte planes (all first bytes, then all second bytes, ...)
+		and every byte is replaced by its difference to the same byte of the previous record.
+		Registers that did not change turn into zeros, which the run-length coder collapses:
+
+			0x00-0x7F	literal run: the next (n + 1) bytes are copied as-is
+			0x80-0xFF	zero run: (n - 0x80 + 1) zero bytes
+	*/
+	void compressChunk(const std::vector<TraceRecord>& records, std::vector<byte>& out)
+	{
+		const size_t count{ records.size() };
+
+		std::vector<byte> raw(count * TraceRecord::record_size);
+		for (size_t i{ 0 }; i < count; ++i)
+		{
+			serialize(records[i], raw.data() + i * TraceRecord::record_size);
+		}
+
+		std::vector<byte> planes(raw.size());
+		for (size_t b{ 0 }; b < TraceRecord::record_size; ++b)
+		{
+			byte previous{ 0 };
+			byte* plane{ planes.data() + b * count };
+
+			for (size_t i{ 0 }; i < count; ++i)
+			{
+				byte value{ raw[i * TraceRecord::record_size + b] };
+				plane[i] = static_cast<byte>(value - previous);
+				previous = value;
+			}
+		}
+
+		out.clear();
+		size_t position{ 0 };
+		while (position < planes.size())
+		{
+			size_t run{ 0 };
+			while (position + run < planes.size() && planes[position + run] == 0 && run < 128)
+			{
+				++run;
+			}
+
+			if (run > 0)
+			{
+				out.push_back(static_cast<byte>(0x80 + run - 1));
+				position += run;
+				continue;
+			}
+
+			// Literal run: stop at the first pair of zeros, which is better stored as a zero run.
+			size_t start{ position };
+			while (position < planes.size() && position - start < 128)
+			{
+				if (planes[position] == 0 && position + 1 < planes.size() && planes[position + 1] == 0)
+				{
+					break;
+				}
+				++position;
+			}
+
+			out.push_back(static_cast<byte>(position - start - 1));
+			out.insert(out.end(), planes.begin() + start, planes.begin() + position);
+		}
+	}
+
+
+	void decompressChunk(const std::vector<byte>& in, size_t count, std::vector<TraceRecord>& records)
+	{
+		std::vector<byte> planes(count * TraceRecord::record_size);
+
+		size_t position{ 0 };
+		size_t written{ 0 };
+		while (position < in.size() && written < planes.size())
+		{
+			byte control{ in[position++] };
+
+			if (control >= 0x80)
+			{
+				size_t run{ static_cast<size_t>(control - 0x80 + 1) };
+				run = std::min(run, planes.size() - written);
+				std::fill_n(planes.begin() + written, run, byte{ 0 });
+				written += run;
+			}
+			else
+			{
+				size_t run{ static_cast<size_t>(control + 1) };
+				if (position + run > in.size() || written + run > planes.size())
+				{
+					throw std::runtime_error("BinaryTraceReader: corrupt chunk");
+				}
+
+				std::copy_n(in.begin() + position, run, planes.begin() + written);
+				position += run;
+				written += run;
+			}
+		}
+
+		if (written != planes.size())
+		{
+			throw std::runtime_error("BinaryTraceReader: truncated chunk");
+		}
+
+		std::vector<byte> raw(planes.size());
+		for (size_t b{ 0 }; b < TraceRecord::record_size; ++b)
+		{
+			byte previous{ 0 };
+			const byte* plane{ planes.data() + b * count };
+
+			for (size_t i{ 0 }; i < count; ++i)
+			{
+				previous = static_cast<byte>(previous + plane[i]);
+				raw[i * TraceRecord::record_size + b] = previous;
+			}
+		}
+
+		records.resize(count);
+		for (size_t i{ 0 }; i < count; ++i)
+		{
+			records[i] = deserialize(raw.data() + i * TraceRecord::record_size);
+		}
+	}
+}
+
+
+bool TraceRecord::operator==(const TraceRecord& other) const
+{
+	return program_counter == other.program_counter
+		&& opcode == other.opcode
+		&& reg_accumulator == other.reg_accumulator
+		&& reg_x == other.reg_x
+		&& reg_y == other.reg_y
+		&& processor_status == other.processor_status
+		&& stack_pointer == other.stack_pointer
+		&& cycle_delta == other.cycle_delta;
+}
+
+
+/*
+
+	WRITER
+
+*/
+#pragma region WRITER
+
+
+BinaryTraceWriter::BinaryTraceWriter(const std::string& path, uint32_t records_per_chunk)
+	: records_per_chunk{ std::max<uint32_t>(records_per_chunk, 1) }
+{
+	file = std::fopen(path.c_str(), "wb");
+	if (file == nullptr)
+	{
+		throw std::runtime_error("BinaryTraceWriter: could not open " + path);
+	}
+
+	byte header[header_size];
+	std::memcpy(header, header_magic, 8);
+	putLE(header + 8, format_version, 4);
+	putLE(header + 12, TraceRecord::record_size, 4);
+	putLE(header + 16, this->records_per_chunk, 4);
+	std::fwrite(header, 1, header_size, file);
+
+	records.reserve(this->records_per_chunk);
+}
+
+
+BinaryTraceWriter::~BinaryTraceWriter()
+{
+	writeChunk();
+
+	uint64_t index_offset{ tellFile(file) };
+
+	for (const TraceChunkInfo& chunk : index)
+	{
+		byte entry[index_entry_size];
+		putLE(entry, chunk.file_offset, 8);
+		putLE(entry + 8, chunk.compressed_size, 4);
+		putLE(entry + 12, chunk.record_count, 4);
+		putLE(entry + 16, chunk.first_cycle, 8);
+		putLE(entry + 24, chunk.first_record, 8);
+		std::fwrite(entry, 1, index_entry_size, file);
+	}
+
+	byte footer[footer_size];
+	putLE(footer, index_offset, 8);
+	putLE(footer + 8, index.size(), 8);
+	std::memcpy(footer + 16, footer_magic, 8);
+	std::fwrite(footer, 1, footer_size, file);
+
+	std::fclose(file);
+}
+
+
+void BinaryTraceWriter::onInstruction(const CPU::Registers& registers, const byte* instruction, uint64_t cycles)
+{
+	TraceRecord record;
+	record.program_counter = registers.program_counter;
+	record.opcode = instruction[0];
+	record.reg_accumulator = registers.reg_accumulator;
+	record.reg_x = registers.reg_x;
+	record.reg_y = registers.reg_y;
+	record.processor_status = registers.processor_status;
+	record.stack_pointer = registers.stack_pointer;
+
+	if (records.empty())
+	{
+		// First record of a chunk: its absolute cycle goes in the index so the chunk decodes on its own.
+		chunk_first_cycle = cycles;
+	}
+	else
+	{
+		record.cycle_delta = static_cast<uint32_t>(cycles - previous_cycles);
+	}
+
+	previous_cycles = cycles;
+	records.push_back(record);
+
+	if (records.size() == records_per_chunk)
+	{
+		writeChunk();
+	}
+}
+
+
+void BinaryTraceWriter::writeChunk()
+{
+	if (records.empty())
+	{
+		return;
+	}
+
+	compressChunk(records, compressed);
+
+	TraceChunkInfo chunk;
+	chunk.file_offset = tellFile(file);
+	chunk.compressed_size = static_cast<uint32_t>(compressed.size());
+	chunk.record_count = static_cast<uint32_t>(records.size());
+	chunk.first_cycle = chunk_first_cycle;
+	chunk.first_record = record_count;
+	index.push_back(chunk);
+
+	std::fwrite(compressed.data(), 1, compressed.size(), file);
+
+	record_count += records.size();
+	records.clear();
+}
+#pragma endregion
+
+
+/*
+
+	READER
+
+*/
+#pragma region READER
+
+
+BinaryTraceReader::BinaryTraceReader(const std::string& path)
+{
+	file = std::fopen(path.c_str(), "rb");
+	if (file == nullptr)
+	{
+		throw std::runtime_error("BinaryTraceReader: could not open " + path);
+	}
+
+	byte header[header_size];
+	if (std::fread(header, 1, header_size, file) != header_size
+		|| std::memcmp(header, header_magic, 8) != 0
+		|| getLE(header + 8, 4) != format_version
+		|| getLE(header + 12, 4) != TraceRecord::record_size)
+	{
+		std::fclose(file);
+		throw std::runtime_error("BinaryTraceReader: " + path + " is not a binary trace");
+	}
+	records_per_chunk = static_cast<uint32_t>(getLE(header + 16, 4));
+
+	byte footer[footer_size];
+	if (seekFile(file, -static_cast<int64_t>(footer_size), SEEK_END) != 0
+		|| std::fread(footer, 1, footer_size, file) != footer_size
+		|| std::memcmp(footer + 16, footer_magic, 8) != 0)
+	{
+		std::fclose(file);
+		throw std::runtime_error("BinaryTraceReader: " + path + " has no chunk index (was the writer destroyed?)");
+	}
+
+	uint64_t file_size{ tellFile(file) };
+	uint64_t index_offset{ getLE(footer, 8) };
+	uint64_t chunk_count{ getLE(footer + 8, 8) };
+
+	// The index fills the space up to the footer exactly. Checked before sizing anything
+	// from the footer, whose counts are arbitrary in a corrupt file.
+	uint64_t index_end{ file_size - footer_size };
+	if (chunk_count > UINT64_MAX / index_entry_size
+		|| index_offset > index_end
+		|| chunk_count * index_entry_size != index_end - index_offset)
+	{
+		std::fclose(file);
+		throw std::runtime_error("BinaryTraceReader: " + path + " has a corrupt chunk index");
+	}
+
+	std::vector<byte> entries(chunk_count * index_entry_size);
+	seekFile(file, static_cast<int64_t>(index_offset), SEEK_SET);
+	if (std::fread(entries.data(), 1, entries.size(), file) != entries.size())
+	{
+		std::fclose(file);
+		throw std::runtime_error("BinaryTraceReader: " + path + " has a truncated chunk index");
+	}
+
+	chunks.resize(chunk_count);
+	for (size_t i{ 0 }; i < chunk_count; ++i)
+	{
+		const byte* entry{ entries.data() + i * index_entry_size };
+		chunks[i].file_offset = getLE(entry, 8);
+		chunks[i].compressed_size = static_cast<uint32_t>(getLE(entry + 8, 4));
+		chunks[i].record_count = static_cast<uint32_t>(getLE(entry + 12, 4));
+		chunks[i].first_cycle = getLE(entry + 16, 8);
+		chunks[i].first_record = getLE(entry + 24, 8);
+	}
+}
+
+
+BinaryTraceReader::~BinaryTraceReader()
+{
+	std::fclose(file);
+}
+
+
+const std::vector<TraceChunkInfo>& BinaryTraceReader::getChunks() const
+{
+	return chunks;
+}
+
+
+uint32_t BinaryTraceReader::getRecordsPerChunk() const
+{
+	return records_per_chunk;
+}
+
+
+uint64_t BinaryTraceReader::getRecordCount() const
+{
+	return chunks.empty() ? 0 : chunks.back().first_record + chunks.back().record_count;
+}
+
+
+void BinaryTraceReader::readChunk(size_t chunk, std::vector<TraceRecord>& out)
+{
+	const TraceChunkInfo& info{ chunks.at(chunk) };
+
+	compressed.resize(info.compressed_size);
+	seekFile(file, static_cast<int64_t>(info.file_offset), SEEK_SET);
+	if (std::fread(compressed.data(), 1, compressed.size(), file) != compressed.size())
+	{
+		throw std::runtime_error("BinaryTraceReader: could not read chunk");
+	}
+
+	decompressChunk(compressed, info.record_count, out);
+}
+
+
+size_t BinaryTraceReader::findChunk(uint64_t cycle) const
+{
+	// Last chunk starting at or before the cycle.
+	auto it = std::upper_bound(chunks.begin(), chunks.end(), cycle,
+		[](uint64_t value, const TraceChunkInfo& chunk) { return value < chunk.first_cycle; });
+
+	return (it == chunks.begin()) ? 0 : static_cast<size_t>(it - chunks.begin() - 1);
+}
+#pragma endregion
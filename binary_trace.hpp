@@ -0,0 +1,142 @@
+#pragma once
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "cpu.hpp"
+
+
+/// <summary>
+/// One executed instruction in a binary trace.
+/// Stored on disk as a fixed-size, little-endian record of record_size bytes.
+/// </summary>
+struct TraceRecord
+{
+	static constexpr size_t record_size{ 12 };
+
+	word program_counter{ 0 };
+	byte opcode{ 0 };
+	byte reg_accumulator{ 0 };
+	byte reg_x{ 0 };
+	byte reg_y{ 0 };
+	byte processor_status{ 0 };
+	byte stack_pointer{ 0 };
+
+	// Cycles elapsed since the previous record of the same chunk (0 for the first record).
+	uint32_t cycle_delta{ 0 };
+
+	bool operator==(const TraceRecord& other) const;
+	bool operator!=(const TraceRecord& other) const { return !(*this == other); }
+};
+
+
+/// <summary>
+/// Index entry describing one chunk of a binary trace.
+/// Every chunk can be decoded on its own.
+/// </summary>
+struct TraceChunkInfo
+{
+	uint64_t file_offset{ 0 };
+	uint32_t compressed_size{ 0 };
+	uint32_t record_count{ 0 };
+
+	// Absolute cycle count and instruction number of the chunk's first record.
+	uint64_t first_cycle{ 0 };
+	uint64_t first_record{ 0 };
+};
+
+
+/*
+	Binary trace file layout (all integers little-endian):
+
+		header		"NESTRACE", u32 version, u32 record_size, u32 records_per_chunk
+		chunks		compressed chunk data, back to back
+		index		one entry per chunk: u64 file_offset, u32 compressed_size, u32 record_count,
+					u64 first_cycle, u64 first_record
+		footer		u64 index_offset, u64 chunk_count, "NESTIDX!"
+
+	Chunks are compressed by splitting the records into byte planes, delta coding each
+	plane against the previous record and run-length encoding the (mostly zero) result.
+*/
+
+
+/// <summary>
+/// Trace hook writing a compressed binary trace. Attach with CPU::setTraceHook().
+/// </summary>
+class BinaryTraceWriter : public TraceHook
+{
+public:
+	/// <summary>
+	/// Creates the trace file. Throws std::runtime_error if it cannot be opened.
+	/// </summary>
+	/// <param name="path">File to write.</param>
+	/// <param name="records_per_chunk">Number of instructions per independently decodable chunk.</param>
+	explicit BinaryTraceWriter(const std::string& path, uint32_t records_per_chunk = 64 * 1024);
+
+	/// <summary>
+	/// Writes the last chunk and the chunk index.
+	/// </summary>
+	~BinaryTraceWriter();
+
+	BinaryTraceWriter(const BinaryTraceWriter&) = delete;
+	BinaryTraceWriter& operator=(const BinaryTraceWriter&) = delete;
+
+	void onInstruction(const CPU::Registers& registers, const byte* instruction, uint64_t cycles) override;
+
+private:
+	void writeChunk();
+
+	std::FILE* file{ nullptr };
+	uint32_t records_per_chunk;
+
+	std::vector<TraceRecord> records;
+	std::vector<byte> compressed;
+	std::vector<TraceChunkInfo> index;
+
+	uint64_t chunk_first_cycle{ 0 };
+	uint64_t previous_cycles{ 0 };
+	uint64_t record_count{ 0 };
+};
+
+
+/// <summary>
+/// Random access to a binary trace through its chunk index.
+/// A reader is not thread safe; use one reader per thread.
+/// </summary>
+class BinaryTraceReader
+{
+public:
+	/// <summary>
+	/// Opens a trace and loads its index. Throws std::runtime_error if the file is not a valid trace.
+	/// </summary>
+	explicit BinaryTraceReader(const std::string& path);
+	~BinaryTraceReader();
+
+	BinaryTraceReader(const BinaryTraceReader&) = delete;
+	BinaryTraceReader& operator=(const BinaryTraceReader&) = delete;
+
+	const std::vector<TraceChunkInfo>& getChunks() const;
+	uint32_t getRecordsPerChunk() const;
+	uint64_t getRecordCount() const;
+
+	/// <summary>
+	/// Decodes a single chunk.
+	/// </summary>
+	/// <param name="chunk">Index of the chunk.</param>
+	/// <param name="out">Receives the chunk's records (previous contents are replaced).</param>
+	void readChunk(size_t chunk, std::vector<TraceRecord>& out);
+
+	/// <summary>
+	/// Finds the chunk holding the instruction that is executing at the given cycle.
+	/// </summary>
+	/// <returns>Chunk index (0 if the cycle is before the start of the trace).</returns>
+	size_t findChunk(uint64_t cycle) const;
+
+private:
+	std::FILE* file{ nullptr };
+	uint32_t records_per_chunk{ 0 };
+
+	std::vector<TraceChunkInfo> chunks;
+	std::vector<byte> compressed;
+};
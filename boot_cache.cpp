@@ -0,0 +1,233 @@
+#include "boot_cache.hpp"
+#include "hash.hpp"
+
+#include <array>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <type_traits>
+
+
+static_assert(std::is_trivially_copyable_v<NES::Snapshot>, "boot snapshots are stored as plain bytes");
+
+
+namespace
+{
+	/*
+		File layout (native byte order): "EMUNESBC", u32 state version, u32 snapshot size,
+		u64 key, then the snapshot. The header is checked again on load, so a file left by
+		another build or a hash collision is treated as a miss.
+	*/
+	struct FileHeader
+	{
+		char magic[8];
+		uint32_t state_version;
+		uint32_t snapshot_size;
+		uint64_t key;
+	};
+
+	constexpr char boot_magic[8]{ 'E', 'M', 'U', 'N', 'E', 'S', 'B', 'C' };
+
+
+	FileHeader makeHeader(uint64_t key)
+	{
+		FileHeader header{};
+		std::memcpy(header.magic, boot_magic, sizeof(boot_magic));
+		header.state_version = NES::state_version;
+		header.snapshot_size = static_cast<uint32_t>(sizeof(NES::Snapshot));
+		header.key = key;
+		return header;
+	}
+
+
+	/*
+		Notes whether an instruction at the given address has executed.
+	*/
+	class ProgramCounterWatch : public TraceHook
+	{
+	public:
+		explicit ProgramCounterWatch(word program_counter)
+			: program_counter{ program_counter }
+		{	}
+
+		void onInstruction(const CPU::Registers& registers, const byte*, uint64_t) override
+		{
+			reached |= (registers.program_counter == program_counter);
+		}
+
+		word program_counter;
+		bool reached{ false };
+	};
+}
+
+
+BootCache::BootCache(const std::string& directory, Trigger trigger)
+	: directory{ directory }
+	, trigger{ trigger }
+{	}
+
+
+bool BootCache::boot(NES& nes, const Cartridge& cartridge)
+{
+	nes.loadCartridge(cartridge);
+	nes.setInput(0, 0);
+	nes.power();
+
+	uint64_t key{ getKey(nes, cartridge) };
+	auto snapshot{ std::make_unique<NES::Snapshot>() };
+
+	if (load(key, *snapshot))
+	{
+		nes.restore(*snapshot);
+
+		++stats.hits;
+		stats.frames_skipped += nes.getFrame();
+		return true;
+	}
+
+	++stats.misses;
+
+	if (runBoot(nes))
+	{
+		nes.save(*snapshot);
+		store(key, *snapshot);
+	}
+
+	return false;
+}
+
+
+BootCache::Stats BootCache::getStats() const
+{
+	return stats;
+}
+
+
+/*
+	Everything that decides the state at the trigger: the ROM (PRG and CHR; mirroring is
+	wired on the board), PRG RAM as power-up leaves it, how the console emulates it, and the
+	trigger itself.
+
+	PRG RAM matters because a battery save survives power-up and is part of what the game
+	boots from. Restoring a snapshot writes its PRG RAM through to an attached save file, so
+	a snapshot may only be restored onto the save it was booted from; keyed by the contents,
+	a changed save is a miss and boots from the save as it is now.
+*/
+uint64_t BootCache::getKey(const NES& nes, const Cartridge& cartridge) const
+{
+	const std::vector<byte>& prg{ cartridge.getPRG() };
+	const std::vector<byte>& chr{ cartridge.getCHR() };
+
+	const Bus& bus{ nes.getCPU().getBus() };
+	std::array<byte, Bus::prg_ram_size> prg_ram;
+	for (word offset{ 0 }; offset < Bus::prg_ram_size; ++offset)
+	{
+		prg_ram[offset] = bus.peek(Bus::prg_ram_start + offset);
+	}
+
+	uint64_t fields[]{
+		xxHash64(prg.data(), prg.size()),
+		xxHash64(chr.data(), chr.size()),
+		xxHash64(prg_ram.data(), prg_ram.size()),
+		static_cast<uint64_t>(cartridge.getMirroring()),
+		NES::state_version,
+		sizeof(NES::Snapshot),
+		static_cast<uint64_t>(nes.getCPU().getVariant()),
+		static_cast<uint64_t>(nes.getCPU().getAccuracy()),
+		trigger.frames,
+		trigger.use_program_counter ? (0x10000u | trigger.program_counter) : 0u,
+	};
+
+	return xxHash64(fields, sizeof(fields));
+}
+
+
+std::string BootCache::getPath(uint64_t key) const
+{
+	char name[32];
+	std::snprintf(name, sizeof(name), "%016" PRIx64 ".boot", key);
+	return (std::filesystem::path{ directory } / name).string();
+}
+
+
+bool BootCache::load(uint64_t key, NES::Snapshot& snapshot) const
+{
+	std::unique_ptr<std::FILE, int(*)(std::FILE*)> file{ std::fopen(getPath(key).c_str(), "rb"), &std::fclose };
+	if (file == nullptr)
+	{
+		return false;
+	}
+
+	FileHeader header;
+	FileHeader expected{ makeHeader(key) };
+
+	return std::fread(&header, sizeof(header), 1, file.get()) == 1
+		&& std::memcmp(&header, &expected, sizeof(header)) == 0
+		&& std::fread(&snapshot, sizeof(snapshot), 1, file.get()) == 1;
+}
+
+
+/*
+	Written to a temporary file and renamed, so batch jobs booting the same ROM at once
+	never read a partial snapshot; the last rename wins with identical contents.
+*/
+void BootCache::store(uint64_t key, const NES::Snapshot& snapshot) const
+{
+	std::error_code error;
+	std::filesystem::create_directories(directory, error);
+
+	std::string path{ getPath(key) };
+	std::string temporary_path{ path + "." + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count()) + ".tmp" };
+
+	bool written;
+	{
+		std::unique_ptr<std::FILE, int(*)(std::FILE*)> file{ std::fopen(temporary_path.c_str(), "wb"), &std::fclose };
+		FileHeader header{ makeHeader(key) };
+
+		written = file != nullptr
+			&& std::fwrite(&header, sizeof(header), 1, file.get()) == 1
+			&& std::fwrite(&snapshot, sizeof(snapshot), 1, file.get()) == 1
+			&& std::fflush(file.get()) == 0;
+	}
+
+	if (written)
+	{
+		std::filesystem::rename(temporary_path, path, error);
+	}
+
+	if (!written || error)
+	{
+		std::filesystem::remove(temporary_path, error);
+	}
+}
+
+
+bool BootCache::runBoot(NES& nes) const
+{
+	if (!trigger.use_program_counter)
+	{
+		for (uint64_t frame{ 0 }; frame < trigger.frames; ++frame)
+		{
+			nes.runFrame(false);
+		}
+
+		return true;
+	}
+
+	// The watch replaces any trace hook for the boot.
+	CPU& cpu{ nes.getCPU() };
+	TraceHook* trace_hook{ cpu.getTraceHook() };
+	ProgramCounterWatch watch{ trigger.program_counter };
+	cpu.setTraceHook(&watch);
+
+	for (uint64_t frame{ 0 }; frame < trigger.frames && !watch.reached; ++frame)
+	{
+		nes.runFrame(false);
+	}
+
+	cpu.setTraceHook(trace_hook);
+	return watch.reached;
+}
\ No newline at end of file
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <string>
+
+#include "types.hpp"
+#include "nes.hpp"
+
+
+/// <summary>
+/// On-disk cache of post-boot console states. Many games spend hundreds of frames in logos
+/// and attract screens before they take input; a warm start restores the state at the end of
+/// that sequence instead of emulating it again.
+///
+/// The first boot of a ROM runs from power-up (without input) to the trigger and stores a
+/// snapshot; later boots load it. Files are keyed by a hash of the ROM, PRG RAM after power-up
+/// (the battery save, which restoring writes back to), NES::state_version,
+/// the CPU variant and accuracy tier and the trigger, so a change to any of them makes a new
+/// entry rather than restoring a state the emulator would not have reached.
+/// </summary>
+class BootCache
+{
+public:
+	/// <summary>
+	/// Where the boot sequence ends. Snapshots are taken at frame boundaries.
+	/// </summary>
+	struct Trigger
+	{
+		// Frames emulated after power-up. With a program counter: the most frames to wait for it.
+		uint64_t frames{ 0 };
+
+		// If set, boot ends with the first frame that executes an instruction at this address,
+		// and nothing is cached if that does not happen within the frame limit.
+		bool use_program_counter{ false };
+		word program_counter{ 0 };
+	};
+
+	/// <summary>
+	/// Statistics, for reports.
+	/// </summary>
+	struct Stats
+	{
+		uint64_t hits{ 0 };
+		uint64_t misses{ 0 };
+		uint64_t frames_skipped{ 0 };		// boot frames not emulated thanks to hits
+	};
+
+	/// <param name="directory">Cache directory; created when the first snapshot is stored.</param>
+	BootCache(const std::string& directory, Trigger trigger);
+
+	/// <summary>
+	/// Loads the cartridge and powers the console up, then restores the cached post-boot
+	/// state or, on a miss, boots it to the trigger and stores the state. Either way the
+	/// console ends up in the same state. Boot frames are not rendered, and with a program
+	/// counter trigger not traced either.
+	/// Storing is best effort: a cache that cannot be written only costs the next boot time.
+	/// </summary>
+	/// <returns>Whether the state came from the cache.</returns>
+	bool boot(NES& nes, const Cartridge& cartridge);
+
+	Stats getStats() const;
+
+private:
+	/// <summary>
+	/// Identifies the boot of this cartridge on this console configuration.
+	/// </summary>
+	uint64_t getKey(const NES& nes, const Cartridge& cartridge) const;
+
+	std::string getPath(uint64_t key) const;
+
+	bool load(uint64_t key, NES::Snapshot& snapshot) const;
+	void store(uint64_t key, const NES::Snapshot& snapshot) const;
+
+	/// <summary>
+	/// Boots from power-up. Returns false if the trigger was not reached.
+	/// </summary>
+	bool runBoot(NES& nes) const;
+
+	std::string directory;
+	Trigger trigger;
+	Stats stats;
+};
\ No newline at end of file
@@ -0,0 +1,309 @@
+#include "bus.hpp"
+#include "hash.hpp"
+
+#include <algorithm>
+
+
+Bus::Bus()
+{
+	rehashMemory();
+}
+
+
+byte Bus::read(word address)
+{
+	if (address >= ppu_start && address < ppu_end)
+	{
+		return ppu.read(address);
+	}
+
+	switch (address)
+	{
+		case controller_port_1:	++change_count;	return controllers[0].read();
+		case controller_port_2:	++change_count;	return controllers[1].read();
+		default:								return memory.read(mirror(address));
+	}
+}
+
+
+void Bus::write(word address, byte data)
+{
+	++change_count;
+
+	if (address >= ppu_start && address < ppu_end)
+	{
+		ppu.write(address, data);
+		return;
+	}
+
+	if (address == oam_dma)
+	{
+		byte page[0x100];
+		transfer(data << 8, page, sizeof(page));
+		ppu.writeOAM(page);
+	}
+
+	// A single strobe line is shared by both controllers.
+	// ($4017 writes go to the APU frame counter, not the controllers.)
+	if (address == controller_port_1)
+	{
+		controllers[0].write(data);
+		controllers[1].write(data);
+	}
+
+	// Registers, not memory: reads must not return the last value written.
+	if (address >= io_start && address < io_end)
+	{
+		return;
+	}
+
+	// ROM is read-only.
+	if (address < rom_start)
+	{
+		address = mirror(address);
+		memory_hash ^= zobristKey(address, memory.read(address)) ^ zobristKey(address, data);
+		memory.write(address, data);
+	}
+}
+
+
+byte Bus::peek(word address) const
+{
+	if (address >= ppu_start && address < ppu_end)
+	{
+		return ppu.peek(address);
+	}
+
+	switch (address)
+	{
+		case controller_port_1:	return controllers[0].peek();
+		case controller_port_2:	return controllers[1].peek();
+		default:				return memory.read(mirror(address));
+	}
+}
+
+
+void Bus::transfer(word address, byte* destination, size_t length)
+{
+	while (length > 0)
+	{
+		// One page at a time; a page is either all plain memory or all I/O.
+		size_t count{ std::min<size_t>(length, 0x100 - (address & 0xFF)) };
+
+		if (isIOPage(address >> 8))
+		{
+			for (size_t i{ 0 }; i < count; ++i)
+			{
+				destination[i] = read(static_cast<word>(address + i));
+			}
+		}
+		else
+		{
+			std::copy_n(memory.getPage(mirror(address) >> 8) + (address & 0xFF), count, destination);
+		}
+
+		address = static_cast<word>(address + count);
+		destination += count;
+		length -= count;
+	}
+}
+
+
+bool Bus::isIOPage(byte page)
+{
+	return (page >= (ppu_start >> 8) && page < (ppu_end >> 8)) || page == (io_start >> 8);
+}
+
+
+void Bus::load(word address, const std::vector<byte>& data)
+{
+	load(address, data.data(), data.size());
+}
+
+
+void Bus::load(word address, const byte* data, size_t length)
+{
+	++change_count;
+	length = std::min(length, size() - address);
+
+	while (length > 0)
+	{
+		size_t offset{ address % PagedMemory::page_size };
+		size_t count{ std::min(length, PagedMemory::page_size - offset) };
+
+		std::copy_n(data, count, memory.getWritablePage(address / PagedMemory::page_size) + offset);
+
+		address = static_cast<word>(address + count);
+		data += count;
+		length -= count;
+	}
+
+	rehashMemory();
+}
+
+
+size_t Bus::size() const
+{
+	return PagedMemory::page_size * PagedMemory::page_count;
+}
+
+
+void Bus::copyRAM(byte* out) const
+{
+	for (size_t page{ 0 }; page < ram_size / PagedMemory::page_size; ++page)
+	{
+		std::copy_n(memory.getPage(page), PagedMemory::page_size, out + page * PagedMemory::page_size);
+	}
+}
+
+
+void Bus::clearRAM()
+{
+	++change_count;
+	for (size_t page{ 0 }; page < ram_size / PagedMemory::page_size; ++page)
+	{
+		std::fill_n(memory.getWritablePage(page), PagedMemory::page_size, byte{ 0x00 });
+	}
+
+	rehashMemory();
+}
+
+
+void Bus::clear()
+{
+	++change_count;
+	for (size_t page{ 0 }; page < PagedMemory::page_count; ++page)
+	{
+		if (!memory.isAttached(page))
+		{
+			std::fill_n(memory.getWritablePage(page), PagedMemory::page_size, byte{ 0x00 });
+		}
+	}
+	controllers = {};
+	ppu.power();
+	rehashMemory();
+}
+
+
+void Bus::attachPRGRAM(byte* external)
+{
+	++change_count;
+	memory.attach(prg_ram_start / PagedMemory::page_size, prg_ram_size / PagedMemory::page_size, external);
+	rehashMemory();
+}
+
+
+void Bus::detachPRGRAM()
+{
+	++change_count;
+	memory.detach(prg_ram_start / PagedMemory::page_size, prg_ram_size / PagedMemory::page_size);
+}
+
+
+Controller& Bus::getController(size_t port)
+{
+	// The caller may change the buttons.
+	++change_count;
+	return controllers[port];
+}
+
+
+void Bus::saveState(State& state) const
+{
+	for (size_t page{ 0 }; page < rom_start / PagedMemory::page_size; ++page)
+	{
+		std::copy_n(memory.getPage(page), PagedMemory::page_size, &state.memory[page * PagedMemory::page_size]);
+	}
+	state.controllers = controllers;
+	ppu.saveState(state.ppu);
+}
+
+
+void Bus::loadState(const State& state)
+{
+	++change_count;
+	// Pages that did not change stay shared with forks.
+	for (size_t page{ 0 }; page < rom_start / PagedMemory::page_size; ++page)
+	{
+		const byte* source{ &state.memory[page * PagedMemory::page_size] };
+
+		if (!std::equal(source, source + PagedMemory::page_size, memory.getPage(page)))
+		{
+			byte* destination{ memory.getWritablePage(page) };
+
+			for (size_t i{ 0 }; i < PagedMemory::page_size; ++i)
+			{
+				uint32_t address{ static_cast<uint32_t>(page * PagedMemory::page_size + i) };
+				memory_hash ^= zobristKey(address, destination[i]) ^ zobristKey(address, source[i]);
+				destination[i] = source[i];
+			}
+		}
+	}
+	controllers = state.controllers;
+	ppu.loadState(state.ppu);
+}
+
+
+void Bus::fork(Fork& child) const
+{
+	child.memory = memory;
+	child.memory_hash = memory_hash;
+	child.controllers = controllers;
+	ppu.saveState(child.ppu);
+}
+
+
+void Bus::loadFork(const Fork& fork)
+{
+	++change_count;
+	memory = fork.memory;
+	memory_hash = fork.memory_hash;
+	controllers = fork.controllers;
+	ppu.loadState(fork.ppu);
+}
+
+
+size_t Bus::getUnsharedPageCount() const
+{
+	return memory.getUnsharedPageCount();
+}
+
+
+uint64_t Bus::getMemoryHash() const
+{
+	return memory_hash;
+}
+
+
+void Bus::rehashMemory()
+{
+	memory_hash = 0;
+
+	for (size_t page{ 0 }; page < rom_start / PagedMemory::page_size; ++page)
+	{
+		const byte* data{ memory.getPage(page) };
+
+		for (size_t i{ 0 }; i < PagedMemory::page_size; ++i)
+		{
+			memory_hash ^= zobristKey(static_cast<uint32_t>(page * PagedMemory::page_size + i), data[i]);
+		}
+	}
+}
+
+
+PPU& Bus::getPPU()
+{
+	return ppu;
+}
+
+
+const PPU& Bus::getPPU() const
+{
+	return ppu;
+}
+
+
+uint64_t Bus::getChangeCount() const
+{
+	return change_count + ppu.getChangeCount();
+}
\ No newline at end of file
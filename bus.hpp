@@ -0,0 +1,227 @@
+#pragma once
+
+#include <array>
+#include <vector>
+
+#include "types.hpp"
+#include "hash.hpp"
+#include "controller.hpp"
+#include "ppu.hpp"
+#include "paged_memory.hpp"
+
+
+/// <summary>
+/// CPU address space. Plain memory, plus the memory-mapped I/O registers 
+/// (PPU, controllers) which have side effects when read or written.
+/// </summary>
+class Bus
+{
+public:
+	Bus();
+
+	/// <summary>
+	/// CPU read. May have side effects (e.g. shifting a controller).
+	/// </summary>
+	byte read(word address);
+
+	/// <summary>
+	/// CPU write. May have side effects (e.g. strobing the controllers).
+	/// </summary>
+	void write(word address, byte data);
+
+	static constexpr word stack_page{ 0x0100 };
+
+	/// <summary>
+	/// Stack access. The stack is always plain RAM in page $01, so these go straight to the
+	/// page, without the address decoding of read() and write(). writeStack() keeps the memory
+	/// hash and change count up to date like write() does.
+	/// </summary>
+	/// <param name="offset">Address within page $01 (the stack pointer).</param>
+	byte readStack(byte offset) const;
+	void writeStack(byte offset, byte data);
+
+	/// <summary>
+	/// Read without side effects, for tracing and debugging.
+	/// </summary>
+	byte peek(word address) const;
+
+	/// <summary>
+	/// Bulk read for DMA: reads length bytes starting at address (wrapping at $FFFF).
+	/// Spans of plain memory are copied directly; I/O pages go through read() one byte
+	/// at a time, with the same side effects.
+	/// </summary>
+	void transfer(word address, byte* destination, size_t length);
+
+	/// <summary>
+	/// Writing a page number here copies that page to the PPU's OAM. The CPU is halted
+	/// for oam_dma_cycles, plus one if the DMA starts on an odd cycle (see CPU::write()).
+	/// </summary>
+	static constexpr word oam_dma{ 0x4014 };
+	static constexpr uint64_t oam_dma_cycles{ 513 };
+
+	/// <summary>
+	/// Copies a block into memory without side effects (e.g. loading a ROM image).
+	/// Data past the end of the address space is ignored.
+	/// </summary>
+	void load(word address, const std::vector<byte>& data);
+	void load(word address, const byte* data, size_t length);
+
+	/// <summary>
+	/// Number of addresses backed by memory (the whole 64 KiB address space).
+	/// </summary>
+	size_t size() const;
+
+	/// <summary>
+	/// The 2 KiB of internal work RAM ($0000-$07FF), mirrored up to $1FFF.
+	/// </summary>
+	static constexpr word ram_size{ 0x0800 };
+	static constexpr word ram_mirrors_end{ 0x2000 };
+
+	/// <summary>
+	/// The address backing a CPU address: work RAM mirrors fold onto $0000-$07FF.
+	/// </summary>
+	static word mirror(word address);
+
+	void copyRAM(byte* out) const;
+
+	/// <summary>
+	/// Clears work RAM, as on power-up.
+	/// </summary>
+	void clearRAM();
+
+	/// <summary>
+	/// Clears all memory (ROM included), the controllers and the PPU.
+	/// Attached battery RAM keeps its contents.
+	/// </summary>
+	void clear();
+
+	/// <summary>
+	/// Cartridge PRG RAM ($6000-$7FFF).
+	/// </summary>
+	static constexpr word prg_ram_start{ 0x6000 };
+	static constexpr word prg_ram_size{ 0x2000 };
+
+	/// <summary>
+	/// Maps PRG RAM onto external memory of prg_ram_size bytes (see BatteryRAM), which must
+	/// outlive the attachment. Reads and writes then go straight to it; the RAM shows its
+	/// contents. Save states and forks still copy PRG RAM like any other memory.
+	/// </summary>
+	void attachPRGRAM(byte* external);
+
+	/// <summary>
+	/// Back to memory of the bus's own, with the contents PRG RAM has now.
+	/// </summary>
+	void detachPRGRAM();
+
+	/// <param name="port">0 for $4016, 1 for $4017.</param>
+	Controller& getController(size_t port);
+
+	PPU& getPPU();
+	const PPU& getPPU() const;
+
+	/// <summary>
+	/// Everything the CPU can change: the writable lower half of the address space
+	/// ($0000-$7FFF; the ROM half ignores writes), the controllers and the PPU.
+	/// Fixed size, so saving and restoring is a plain copy.
+	/// </summary>
+	static constexpr word rom_start{ 0x8000 };
+
+	struct State
+	{
+		std::array<byte, rom_start> memory;
+		std::array<Controller, 2> controllers;
+		PPU::State ppu;
+	};
+
+	void saveState(State& state) const;
+	void loadState(const State& state);
+
+	/// <summary>
+	/// Copy-on-write copy of the whole bus state, for tree search over game states.
+	/// The memory pages are shared with the bus (and with other forks) until either side 
+	/// writes to them, so a fork costs the PPU state plus the pages written since.
+	/// </summary>
+	struct Fork
+	{
+		PagedMemory memory;
+		uint64_t memory_hash;
+		std::array<Controller, 2> controllers;
+		PPU::State ppu;
+	};
+
+	void fork(Fork& child) const;
+	void loadFork(const Fork& fork);
+
+	/// <summary>
+	/// Number of memory pages not shared with any fork.
+	/// </summary>
+	size_t getUnsharedPageCount() const;
+
+	/// <summary>
+	/// Zobrist hash of the writable memory ($0000-$7FFF): the XOR of zobristKey(address, value)
+	/// over all addresses. Kept up to date by every write, at O(1) per write.
+	/// </summary>
+	uint64_t getMemoryHash() const;
+
+	/// <summary>
+	/// Counts everything that can change what the CPU sees: writes, reads with side effects,
+	/// loads, state restores and controller access. If the count has not moved between two
+	/// points in time, every read in between returned the same data it would return now.
+	/// </summary>
+	uint64_t getChangeCount() const;
+
+private:
+	// PPU registers, mirrored every 8 bytes.
+	static constexpr word ppu_start{ 0x2000 };
+	static constexpr word ppu_end{ 0x4000 };
+
+	// APU and I/O registers ($4000-$401F).
+	static constexpr word io_start{ 0x4000 };
+	static constexpr word io_end{ 0x4020 };
+
+	/// <summary>
+	/// Whether reads from the page can have side effects (PPU and I/O registers).
+	/// </summary>
+	static bool isIOPage(byte page);
+
+	/// <summary>
+	/// Recomputes memory_hash from scratch, after memory changed other than through write().
+	/// </summary>
+	void rehashMemory();
+
+	// Memory-mapped controller ports.
+	static constexpr word controller_port_1{ 0x4016 };
+	static constexpr word controller_port_2{ 0x4017 };
+
+	PagedMemory memory;
+	uint64_t memory_hash{ 0 };
+	std::array<Controller, 2> controllers;
+	PPU ppu;
+
+	uint64_t change_count{ 0 };
+};
+
+
+inline word Bus::mirror(word address)
+{
+	return (address < ram_mirrors_end) ? static_cast<word>(address & (ram_size - 1)) : address;
+}
+
+
+// The CPU pushes and pulls through these on every call, return and interrupt, so they are inline.
+// The stack page lies in work RAM proper, so it needs no mirroring.
+
+inline byte Bus::readStack(byte offset) const
+{
+	return memory.read(stack_page | offset);
+}
+
+
+inline void Bus::writeStack(byte offset, byte data)
+{
+	word address{ static_cast<word>(stack_page | offset) };
+
+	++change_count;
+	memory_hash ^= zobristKey(address, memory.read(address)) ^ zobristKey(address, data);
+	memory.write(address, data);
+}
\ No newline at end of file
@@ -0,0 +1,159 @@
+#include "cartridge.hpp"
+#include "rom_index.hpp"
+
+#include <cstdio>
+#include <memory>
+#include <stdexcept>
+
+
+INESHeader INESHeader::parse(const std::vector<byte>& image)
+{
+	constexpr size_t header_size{ 16 };
+	constexpr size_t trainer_size{ 512 };
+	constexpr size_t prg_bank_size{ 0x4000 };
+	constexpr size_t chr_bank_size{ 0x2000 };
+
+	if (image.size() < header_size || image[0] != 'N' || image[1] != 'E' || image[2] != 'S' || image[3] != 0x1A)
+	{
+		throw std::runtime_error("Cartridge: not an iNES image");
+	}
+
+	INESHeader header;
+	byte flags_6{ image[6] };
+	byte flags_7{ image[7] };
+
+	header.prg_size = image[4] * prg_bank_size;
+	header.chr_size = image[5] * chr_bank_size;
+	header.mirroring = (flags_6 & 0x01) ? Mirroring::Vertical : Mirroring::Horizontal;
+	header.battery = (flags_6 & 0x02) != 0;
+	header.mapper = (flags_7 & 0xF0) | (flags_6 >> 4);
+
+	// An optional 512-byte trainer sits between the header and PRG ROM.
+	header.prg_offset = header_size + ((flags_6 & 0x04) ? trainer_size : 0);
+	if (image.size() < header.prg_offset + header.prg_size + header.chr_size)
+	{
+		throw std::runtime_error("Cartridge: image is truncated");
+	}
+
+	return header;
+}
+
+
+Cartridge::Cartridge(const std::vector<byte>& image)
+	: Cartridge{ image, INESHeader::parse(image) }
+{	}
+
+
+Cartridge::Cartridge(const std::vector<byte>& image, const INESHeader& header)
+	: mirroring{ header.mirroring }
+	, mapper{ header.mapper }
+	, battery{ header.battery }
+{
+	if (mapper != 0)
+	{
+		throw std::runtime_error("Cartridge: unsupported mapper " + std::to_string(mapper));
+	}
+
+	if (header.prg_size != prg_bank_size && header.prg_size != 2 * prg_bank_size)
+	{
+		throw std::runtime_error("Cartridge: NROM needs 16 or 32 KiB of PRG ROM");
+	}
+
+	if (header.chr_size > chr_bank_size)
+	{
+		throw std::runtime_error("Cartridge: NROM has at most 8 KiB of CHR ROM");
+	}
+
+	if (image.size() < header.prg_offset + header.prg_size + header.chr_size)
+	{
+		throw std::runtime_error("Cartridge: image is truncated");
+	}
+
+	size_t offset{ header.prg_offset };
+	prg.assign(image.begin() + offset, image.begin() + offset + header.prg_size);
+	offset += header.prg_size;
+	chr.assign(image.begin() + offset, image.begin() + offset + header.chr_size);
+}
+
+
+Cartridge Cartridge::load(const std::string& path)
+{
+	return Cartridge{ readImage(path) };
+}
+
+
+/*
+	The entry is only trusted if the file still has the size and modification time it had when
+	it was indexed; otherwise the file's own header is used.
+*/
+Cartridge Cartridge::load(const std::string& path, const RomIndex& index)
+{
+	std::vector<byte> image{ readImage(path) };
+	INESHeader header{ INESHeader::parse(image) };
+
+	const RomIndex::Entry* entry{ index.find(path) };
+	if (entry != nullptr && (entry->flags & RomIndex::valid) && RomIndex::isCurrent(*entry, path))
+	{
+		header.mapper = entry->mapper;
+		header.mirroring = static_cast<Mirroring>(entry->mirroring);
+		header.battery = entry->battery != 0;
+	}
+
+	return Cartridge{ image, header };
+}
+
+
+std::vector<byte> Cartridge::readImage(const std::string& path)
+{
+	std::unique_ptr<std::FILE, int(*)(std::FILE*)> file{ std::fopen(path.c_str(), "rb"), &std::fclose };
+	if (file == nullptr)
+	{
+		throw std::runtime_error("Cartridge: could not open " + path);
+	}
+
+	std::vector<byte> image;
+	byte buffer[4096];
+	size_t count;
+	while ((count = std::fread(buffer, 1, sizeof(buffer), file.get())) > 0)
+	{
+		image.insert(image.end(), buffer, buffer + count);
+	}
+
+	return image;
+}
+
+
+const std::vector<byte>& Cartridge::getPRG() const
+{
+	return prg;
+}
+
+
+const std::vector<byte>& Cartridge::getCHR() const
+{
+	return chr;
+}
+
+
+bool Cartridge::hasCHRRAM() const
+{
+	return chr.empty();
+}
+
+
+Mirroring Cartridge::getMirroring() const
+{
+	return mirroring;
+}
+
+
+byte Cartridge::getMapper() const
+{
+	return mapper;
+}
+
+
+bool Cartridge::hasBattery() const
+{
+	return battery;
+}
\ No newline at end of file
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "types.hpp"
+
+class RomIndex;
+
+
+/// <summary>
+/// Nametable layout, chosen by the cartridge wiring.
+/// </summary>
+enum class Mirroring : byte
+{
+	Horizontal,		// $2000 = $2400, $2800 = $2C00 (vertical scrolling)
+	Vertical,		// $2000 = $2800, $2400 = $2C00 (horizontal scrolling)
+};
+
+
+/// <summary>
+/// Board description from the 16-byte iNES header.
+/// </summary>
+struct INESHeader
+{
+	/// <summary>
+	/// Reads the header of an iNES image. Throws std::runtime_error if the image is not iNES or is truncated.
+	/// </summary>
+	static INESHeader parse(const std::vector<byte>& image);
+
+	size_t prg_offset{ 0 };		// past the header and the optional trainer
+	size_t prg_size{ 0 };
+	size_t chr_size{ 0 };
+
+	byte mapper{ 0 };
+	Mirroring mirroring{ Mirroring::Horizontal };
+	bool battery{ false };
+};
+
+
+/// <summary>
+/// A game cartridge loaded from an iNES (.nes) image.
+/// Only NROM (mapper 0) boards are supported so far.
+/// </summary>
+class Cartridge
+{
+public:
+	/// <summary>
+	/// Parses an iNES image. Throws std::runtime_error if it is invalid or uses an unsupported mapper.
+	/// </summary>
+	explicit Cartridge(const std::vector<byte>& image);
+
+	/// <summary>
+	/// Loads an iNES image with the board description given, e.g. a corrected header.
+	/// </summary>
+	Cartridge(const std::vector<byte>& image, const INESHeader& header);
+
+	/// <summary>
+	/// Reads and parses an iNES file. Throws std::runtime_error on I/O errors.
+	/// </summary>
+	static Cartridge load(const std::string& path);
+
+	/// <summary>
+	/// Like load(), but takes mapper, mirroring and battery from the ROM library index when it
+	/// has an up-to-date entry for the file (one lookup, no hashing), so images with a bad
+	/// header load with the corrected one.
+	/// </summary>
+	static Cartridge load(const std::string& path, const RomIndex& index);
+
+	/// <summary>
+	/// Reads a whole file. Throws std::runtime_error on I/O errors.
+	/// </summary>
+	static std::vector<byte> readImage(const std::string& path);
+
+	/// <summary>
+	/// PRG ROM: 16 KiB (mirrored at $C000) or 32 KiB.
+	/// </summary>
+	const std::vector<byte>& getPRG() const;
+
+	/// <summary>
+	/// CHR ROM, 8 KiB. Empty if the board has 8 KiB of CHR RAM instead.
+	/// </summary>
+	const std::vector<byte>& getCHR() const;
+	bool hasCHRRAM() const;
+
+	Mirroring getMirroring() const;
+	byte getMapper() const;
+
+	/// <summary>
+	/// Whether PRG RAM at $6000-$7FFF is battery backed.
+	/// </summary>
+	bool hasBattery() const;
+
+private:
+	static constexpr size_t prg_bank_size{ 0x4000 };
+	static constexpr size_t chr_bank_size{ 0x2000 };
+
+	std::vector<byte> prg;
+	std::vector<byte> chr;
+
+	Mirroring mirroring{ Mirroring::Horizontal };
+	byte mapper{ 0 };
+	bool battery{ false };
+};
\ No newline at end of file
@@ -0,0 +1,52 @@
+#include "controller.hpp"
+
+
+void Controller::setButtons(byte buttons)
+{
+	this->buttons = buttons;
+
+	if (strobe)
+	{
+		shift_register = buttons;
+	}
+}
+
+
+byte Controller::getButtons() const
+{
+	return buttons;
+}
+
+
+void Controller::write(byte data)
+{
+	strobe = (data & 0b1) != 0;
+
+	if (strobe)
+	{
+		shift_register = buttons;
+	}
+}
+
+
+byte Controller::read()
+{
+	// While strobing, the register is continuously reloaded so A is always reported.
+	if (strobe)
+	{
+		return buttons & A;
+	}
+
+	byte bit{ static_cast<byte>(shift_register & 0b1) };
+
+	// Official controllers shift in 1s, so reads past the 8th return 1.
+	shift_register = static_cast<byte>((shift_register >> 1) | 0b1000'0000);
+
+	return bit;
+}
+
+
+byte Controller::peek() const
+{
+	return strobe ? (buttons & A) : (shift_register & 0b1);
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "types.hpp"
+
+
+/// <summary>
+/// Standard NES controller: an 8-bit shift register read serially through $4016/$4017.
+/// </summary>
+class Controller
+{
+public:
+	// Button bits, in the order the shift register reports them.
+	enum : byte {
+		A		= 1 << 0,
+		B		= 1 << 1,
+		SELECT	= 1 << 2,
+		START	= 1 << 3,
+		UP		= 1 << 4,
+		DOWN	= 1 << 5,
+		LEFT	= 1 << 6,
+		RIGHT	= 1 << 7,
+	};
+
+	/// <summary>
+	/// Sets the buttons currently held down. Takes effect on the next strobe.
+	/// </summary>
+	/// <param name="buttons">Bitwise OR of the button bits.</param>
+	void setButtons(byte buttons);
+	byte getButtons() const;
+
+	/// <summary>
+	/// CPU write to $4016. While bit 0 is set the shift register keeps reloading.
+	/// </summary>
+	void write(byte data);
+
+	/// <summary>
+	/// CPU read from $4016/$4017. Returns the next button in bit 0.
+	/// Once all 8 buttons have been read, 1 is returned.
+	/// </summary>
+	byte read();
+
+	/// <summary>
+	/// Value the next read() would return, without shifting.
+	/// </summary>
+	byte peek() const;
+
+private:
+	byte buttons{ 0x00 };
+	byte shift_register{ 0x00 };
+	bool strobe{ false };
+};
@@ -1,9 +1,17 @@
 #include "cpu.hpp"
+#include "opcodes.hpp"
+#include "recompiled_module.hpp"
+
+
+namespace
+{
+	using Handlers = InstructionHandlers<CPU>;
+}
 
 
 CPU::CPU()
 {
-	memory.resize(0xFFFF);
+	setVariant(CPUVariant::Ricoh2A03);
 }
 
 
@@ -15,206 +23,600 @@ void CPU::reset()
 	reg_x  = 0x00;
 	reg_y  = 0x00;
 	processor_status = 0b0000'0000;
+	cycles = 0;
+	idle_loop.valid = false;
+	return_stack.clear();
 }
 
 
 void CPU::loadROM(std::vector<byte>& rom)
 {
-	std::copy(rom.begin(), rom.end(), memory.begin() + 0x8000);
+	bus.load(0x8000, rom);
 }
 
 
 void CPU::run()
 {
-	while (program_counter < memory.size())
+	// Run until the program counter reaches the top of memory ($FFFF), or the program
+	// hits a BRK with no IRQ/BRK vector to go to (it would only loop through $0000 forever).
+	while (program_counter < bus.size() - 1)
+	{
+		if (bus.peek(program_counter) == 0x00 && bus.peek(0xFFFE) == 0x00 && bus.peek(0xFFFF) == 0x00)
+		{
+			break;
+		}
+
+		step();
+	}
+}
+
+
+void CPU::runUntil(uint64_t cycle)
+{
+	(this->*run_until_function)(cycle);
+}
+
+
+void CPU::step()
+{
+	(this->*step_function)();
+}
+
+
+void CPU::setVariant(CPUVariant variant)
+{
+	this->variant = variant;
+
+	bind();
+}
+
+
+CPUVariant CPU::getVariant() const
+{
+	return variant;
+}
+
+
+void CPU::setAccuracy(CPUAccuracy accuracy)
+{
+	this->accuracy = accuracy;
+	bind();
+}
+
+
+CPUAccuracy CPU::getAccuracy() const
+{
+	return accuracy;
+}
+
+
+void CPU::bind()
+{
+	if (accuracy == CPUAccuracy::BusExact)
+	{
+		switch (variant)
+		{
+			case CPUVariant::Ricoh2A03:	bindVariant<Ricoh2A03, BusExact>();	break;
+			case CPUVariant::NMOS6502:	bindVariant<NMOS6502, BusExact>();	break;
+			case CPUVariant::WDC65C02:	bindVariant<WDC65C02, BusExact>();	break;
+		}
+	}
+	else
+	{
+		switch (variant)
+		{
+			case CPUVariant::Ricoh2A03:	bindVariant<Ricoh2A03, InstructionAccurate>();	break;
+			case CPUVariant::NMOS6502:	bindVariant<NMOS6502, InstructionAccurate>();	break;
+			case CPUVariant::WDC65C02:	bindVariant<WDC65C02, InstructionAccurate>();	break;
+		}
+	}
+}
+
+
+template <typename Variant, typename Accuracy>
+void CPU::bindVariant()
+{
+	step_function = &CPU::stepVariant<Variant, Accuracy>;
+	run_until_function = &CPU::runUntilVariant<Variant, Accuracy>;
+}
+
+
+template <typename Variant, typename Accuracy>
+void CPU::runUntilVariant(uint64_t cycle)
+{
+	while (cycles < cycle)
 	{
-		// fetch();
-		byte opcode = memory[program_counter++];
+		bool recompiled{ false };
+
+		if constexpr (Variant::variant == CPUVariant::Ricoh2A03 && !Accuracy::dummy_accesses)
+		{
+			recompiled = (recompiled_module != nullptr && trace_hook == nullptr && runRecompiled(cycle));
+		}
+
+		if (!recompiled)
+		{
+			stepVariant<Variant, Accuracy>();
+		}
 
-		// decode();
-		switch (opcode)
+		if (backward_jump)
 		{
-			// ADC - Add with Carry
-			case 0x69: doADC(get_Immediate());		break;
-			case 0x65: doADC(get_ZeroPage());		break;
-			case 0x75: doADC(get_ZeroPageX());		break;
-			case 0x6d: doADC(get_Absolute());		break;
-			case 0x7d: doADC(get_AbsoluteX());		break;
-			case 0x79: doADC(get_AbsoluteY());		break;
-			case 0x61: doADC(get_IndirectX());		break;
-			case 0x71: doADC(get_IndirectY());		break;
-
-			// AAND - Logical AND
-			case 0x29: doAND(get_Immediate());		break;
-			case 0x25: doAND(get_ZeroPage());		break;
-			case 0x35: doAND(get_ZeroPageX());		break;
-			case 0x2d: doAND(get_Absolute());		break;
-			case 0x3d: doAND(get_AbsoluteX());		break;
-			case 0x39: doAND(get_AbsoluteY());		break;
-			case 0x21: doAND(get_IndirectX());		break;
-			case 0x31: doAND(get_IndirectY());		break;
-
-			// ASL - Arithmetic Shift Left
-			case 0x0a: doAND(get_Accumulator());	break;
-			case 0x06: doAND(get_ZeroPage());		break;
-			case 0x16: doAND(get_ZeroPageX());		break;
-			case 0x0e: doAND(get_Absolute());		break;
-			case 0x1e: doAND(get_AbsoluteX());		break;
-
-			// (Branches) BCC, BCS, BEQ, BMI, BNE, BVC, BVS
-			case 0x90: doBCC(get_Immediate());		break;
-			case 0xb0: doBCS(get_Immediate());		break;
-			case 0xf0: doBEQ(get_Immediate());		break;
-			case 0x30: doBMI(get_Immediate());		break;
-			case 0xd0: doBNE(get_Immediate());		break;
-			case 0x10: doBPL(get_Immediate());		break;
-			case 0x50: doBVC(get_Immediate());		break;
-			case 0x70: doBVS(get_Immediate());		break;
-
-			// BIT - Bit Test
-			case 0x24: doBIT(get_ZeroPage());		break;
-			case 0x2c: doBIT(get_Absolute());		break;
-
-			// BRK - Force Interrupt
-			case 0x00: doBRK();						break;
-
-			// (Clears) CLC, CLD, CLI, CLV 
-			case 0x18: doCLC();						break;
-			case 0xd8: doCLD();						break;
-			case 0x58: doCLI();						break;
-			case 0xb8: doCLV();						break;			
-
-			// CMP - Compare
-			case 0xc9: doCMP(get_Immediate());		break;
-			case 0xc5: doCMP(get_ZeroPage());		break;
-			case 0xd5: doCMP(get_ZeroPageX());		break;
-			case 0xcd: doCMP(get_Absolute());		break;
-			case 0xdd: doCMP(get_AbsoluteX());		break;
-			case 0xd9: doCMP(get_AbsoluteY());		break;
-			case 0xc1: doCMP(get_IndirectX());		break;
-			case 0xd1: doCMP(get_IndirectY());		break;
-
-			// CPX - Compare X Register
-			case 0xe0: doCMX(get_Immediate());		break;
-			case 0xe4: doCMX(get_ZeroPage());		break;
-			case 0xec: doCMX(get_Absolute());		break;
-
-			// CPY - Compare Y Register
-			case 0xc0: doCMY(get_Immediate());		break;
-			case 0xc4: doCMY(get_ZeroPage());		break;
-			case 0xcc: doCMY(get_Absolute());		break;
-
-			// (Decrements) DEC, DEX, DEY
-			case 0xc6: doDEC(get_ZeroPage());		break;
-			case 0xd6: doDEC(get_ZeroPageX());		break;
-			case 0xce: doDEC(get_Absolute());		break;
-			case 0xde: doDEC(get_AbsoluteX());		break;
-			case 0xca: doDEX();						break;
-			case 0x88: doDEY();						break;
-
-			// EOR - Exclusive OR
-			case 0x49: doEOR(get_Immediate());		break;
-			case 0x45: doEOR(get_ZeroPage());		break;
-			case 0x55: doEOR(get_ZeroPageX());		break;
-			case 0x4d: doEOR(get_Absolute());		break;
-			case 0x5d: doEOR(get_AbsoluteX());		break;
-			case 0x59: doEOR(get_AbsoluteY());		break;
-			case 0x41: doEOR(get_IndirectX());		break;
-			case 0x51: doEOR(get_IndirectY());		break;
-
-			// (Increments) INC, INX, INY
-			case 0xe6: doINC(get_ZeroPage());		break;
-			case 0xf6: doINC(get_ZeroPageX());		break;
-			case 0xee: doINC(get_Absolute());		break;
-			case 0xfe: doINC(get_AbsoluteX());		break;
-			case 0xe8: doINX();						break;
-			case 0xc8: doINY();						break;
-			
-			// JMP - Jump
-			case 0x4c: doJMP(getAddr_Absolute());	break;
-			case 0x6c: doJMP(getAddr_Indirect());	break;
-
-			// TODO: JSR
-
-			// LDA - Load Accumulator
-			case 0xa9: doLDA(get_Immediate());		break;
-			case 0xa5: doLDA(get_ZeroPage());		break;
-			case 0xb5: doLDA(get_ZeroPageX());		break;
-			case 0xad: doLDA(get_Absolute());		break;
-			case 0xbd: doLDA(get_AbsoluteX());		break;
-			case 0xb9: doLDA(get_AbsoluteY());		break;
-			case 0xa1: doLDA(get_IndirectX());		break;
-			case 0xb1: doLDA(get_IndirectY());		break;
-
-			// LDX - Load X Register
-			case 0xa2: doLDX(get_Immediate());		break;
-			case 0xa6: doLDX(get_ZeroPage());		break;
-			case 0xb6: doLDX(get_ZeroPageY());		break;
-			case 0xae: doLDX(get_Absolute());		break;			
-			case 0xbe: doLDX(get_AbsoluteY());		break;
-
-			// LDY - Load Y Register
-			case 0xa0: doLDY(get_Immediate());		break;
-			case 0xa4: doLDY(get_ZeroPage());		break;
-			case 0xb4: doLDY(get_ZeroPageX());		break;
-			case 0xac: doLDY(get_Absolute());		break;
-			case 0xbc: doLDY(get_AbsoluteX());		break;
-
-			// LSR - Logical Shift Right
-			case 0x4a: doLDY(get_Accumulator());	break;
-			case 0x46: doLDY(get_ZeroPage());		break;
-			case 0x56: doLDY(get_ZeroPageX());		break;
-			case 0x4e: doLDY(get_Absolute());		break;
-			case 0x5e: doLDY(get_AbsoluteX());		break;
-			
-			// ORA - Logical Inclusive OR			
-			case 0x09: doORA(get_Immediate());		break;
-			case 0x05: doORA(get_ZeroPage());		break;
-			case 0x15: doORA(get_ZeroPageX());		break;
-			case 0x0d: doORA(get_Absolute());		break;
-			case 0x1d: doORA(get_AbsoluteX());		break;
-			case 0x19: doORA(get_AbsoluteY());		break;
-			case 0x01: doORA(get_IndirectX());		break;
-			case 0x11: doORA(get_IndirectY());		break;
-
-			// TODO: PHA
-			// TODO: PHP
-			// TODO: PLA
-			// TODO: PLP
-
-			// ROL - Rotate Left
-			case 0x2a: doROL(get_Accumulator());	break;
-			case 0x26: doROL(get_ZeroPage());		break;
-			case 0x36: doROL(get_ZeroPageX());		break;
-			case 0x2e: doROL(get_Absolute());		break;
-			case 0x3e: doROL(get_AbsoluteX());		break;
-
-			// ROR - Rotate Right
-			case 0x6a: doROR(get_Accumulator());	break;
-			case 0x66: doROR(get_ZeroPage());		break;
-			case 0x76: doROR(get_ZeroPageX());		break;
-			case 0x6e: doROR(get_Absolute());		break;
-			case 0x7e: doROR(get_AbsoluteX());		break;
-
-			// TODO: RTI
-			// TODO: RTS
-
-			// SBC - Subtract with Carry
-			case 0xe9: doSBC(get_Immediate());		break;
-			case 0xe5: doSBC(get_ZeroPage());		break;
-			case 0xf5: doSBC(get_ZeroPageX());		break;
-			case 0xed: doSBC(get_Absolute());		break;
-			case 0xfd: doSBC(get_AbsoluteX());		break;
-			case 0xf9: doSBC(get_AbsoluteY());		break;
-			case 0xe1: doSBC(get_IndirectX());		break;
-			case 0xf1: doSBC(get_IndirectY());		break;
+			backward_jump = false;
+			skipIdleLoop(cycle);
 		}
+	}
+}
+
+
+template <typename Variant, typename Accuracy>
+void CPU::stepVariant()
+{
+	if (trace_hook != nullptr)
+	{
+		traceInstruction();
+	}
+
+	// fetch();
+	byte opcode = bus.read(program_counter++);
+	page_crossed = false;
+
+	// decode();
+	switch (opcode)
+	{
+		// ADC - Add with Carry
+		case 0x69: doADC<Variant>(get_Immediate());		break;
+		case 0x65: doADC<Variant>(get_ZeroPage());		break;
+		case 0x75: doADC<Variant>(get_ZeroPageX<Variant, Accuracy>());		break;
+		case 0x6d: doADC<Variant>(get_Absolute());		break;
+		case 0x7d: doADC<Variant>(get_AbsoluteX<Variant, Accuracy>());		break;
+		case 0x79: doADC<Variant>(get_AbsoluteY<Variant, Accuracy>());		break;
+		case 0x61: doADC<Variant>(get_IndirectX<Variant, Accuracy>());		break;
+		case 0x71: doADC<Variant>(get_IndirectY<Variant, Accuracy>());		break;
+
+		// AAND - Logical AND
+		case 0x29: doAND(get_Immediate());		break;
+		case 0x25: doAND(get_ZeroPage());		break;
+		case 0x35: doAND(get_ZeroPageX<Variant, Accuracy>());		break;
+		case 0x2d: doAND(get_Absolute());		break;
+		case 0x3d: doAND(get_AbsoluteX<Variant, Accuracy>());		break;
+		case 0x39: doAND(get_AbsoluteY<Variant, Accuracy>());		break;
+		case 0x21: doAND(get_IndirectX<Variant, Accuracy>());		break;
+		case 0x31: doAND(get_IndirectY<Variant, Accuracy>());		break;
+
+		// ASL - Arithmetic Shift Left
+		case 0x0a: doASL(get_Accumulator());	break;
+		case 0x06: modify<Variant, Accuracy>(getAddr_ZeroPage(), &CPU::doASL);	break;
+		case 0x16: modify<Variant, Accuracy>(getAddr_ZeroPageX<Variant, Accuracy>(), &CPU::doASL);	break;
+		case 0x0e: modify<Variant, Accuracy>(getAddr_Absolute(), &CPU::doASL);	break;
+		case 0x1e: modify<Variant, Accuracy>(getAddr_AbsoluteX<Variant, Accuracy>(), &CPU::doASL);	break;
+
+		// (Branches) BCC, BCS, BEQ, BMI, BNE, BVC, BVS
+		case 0x90: doBCC(get_Immediate());		break;
+		case 0xb0: doBCS(get_Immediate());		break;
+		case 0xf0: doBEQ(get_Immediate());		break;
+		case 0x30: doBMI(get_Immediate());		break;
+		case 0xd0: doBNE(get_Immediate());		break;
+		case 0x10: doBPL(get_Immediate());		break;
+		case 0x50: doBVC(get_Immediate());		break;
+		case 0x70: doBVS(get_Immediate());		break;
+
+		// BIT - Bit Test
+		case 0x24: doBIT(get_ZeroPage());		break;
+		case 0x2c: doBIT(get_Absolute());		break;
+
+		// BRK - Force Interrupt
+		case 0x00: doBRK();						break;
+
+		// (Clears) CLC, CLD, CLI, CLV 
+		case 0x18: doCLC();						break;
+		case 0xd8: doCLD();						break;
+		case 0x58: doCLI();						break;
+		case 0xb8: doCLV();						break;			
+
+		// CMP - Compare
+		case 0xc9: doCMP(get_Immediate());		break;
+		case 0xc5: doCMP(get_ZeroPage());		break;
+		case 0xd5: doCMP(get_ZeroPageX<Variant, Accuracy>());		break;
+		case 0xcd: doCMP(get_Absolute());		break;
+		case 0xdd: doCMP(get_AbsoluteX<Variant, Accuracy>());		break;
+		case 0xd9: doCMP(get_AbsoluteY<Variant, Accuracy>());		break;
+		case 0xc1: doCMP(get_IndirectX<Variant, Accuracy>());		break;
+		case 0xd1: doCMP(get_IndirectY<Variant, Accuracy>());		break;
+
+		// CPX - Compare X Register
+		case 0xe0: doCMX(get_Immediate());		break;
+		case 0xe4: doCMX(get_ZeroPage());		break;
+		case 0xec: doCMX(get_Absolute());		break;
+
+		// CPY - Compare Y Register
+		case 0xc0: doCMY(get_Immediate());		break;
+		case 0xc4: doCMY(get_ZeroPage());		break;
+		case 0xcc: doCMY(get_Absolute());		break;
+
+		// (Decrements) DEC, DEX, DEY
+		case 0xc6: modify<Variant, Accuracy>(getAddr_ZeroPage(), &CPU::doDEC);	break;
+		case 0xd6: modify<Variant, Accuracy>(getAddr_ZeroPageX<Variant, Accuracy>(), &CPU::doDEC);	break;
+		case 0xce: modify<Variant, Accuracy>(getAddr_Absolute(), &CPU::doDEC);	break;
+		case 0xde: modify<Variant, Accuracy>(getAddr_AbsoluteX<Variant, Accuracy>(), &CPU::doDEC);	break;
+		case 0xca: doDEX();						break;
+		case 0x88: doDEY();						break;
+
+		// EOR - Exclusive OR
+		case 0x49: doEOR(get_Immediate());		break;
+		case 0x45: doEOR(get_ZeroPage());		break;
+		case 0x55: doEOR(get_ZeroPageX<Variant, Accuracy>());		break;
+		case 0x4d: doEOR(get_Absolute());		break;
+		case 0x5d: doEOR(get_AbsoluteX<Variant, Accuracy>());		break;
+		case 0x59: doEOR(get_AbsoluteY<Variant, Accuracy>());		break;
+		case 0x41: doEOR(get_IndirectX<Variant, Accuracy>());		break;
+		case 0x51: doEOR(get_IndirectY<Variant, Accuracy>());		break;
+
+		// (Increments) INC, INX, INY
+		case 0xe6: modify<Variant, Accuracy>(getAddr_ZeroPage(), &CPU::doINC);	break;
+		case 0xf6: modify<Variant, Accuracy>(getAddr_ZeroPageX<Variant, Accuracy>(), &CPU::doINC);	break;
+		case 0xee: modify<Variant, Accuracy>(getAddr_Absolute(), &CPU::doINC);	break;
+		case 0xfe: modify<Variant, Accuracy>(getAddr_AbsoluteX<Variant, Accuracy>(), &CPU::doINC);	break;
+		case 0xe8: doINX();						break;
+		case 0xc8: doINY();						break;
+		
+		// JMP - Jump
+		case 0x4c: doJMP(getAddr_Absolute());	break;
+		case 0x6c: doJMP(getAddr_Indirect<Variant>());	break;
+
+		// JSR - Jump to Subroutine
+		case 0x20: doJSR(getAddr_Absolute());	break;
+
+		// LDA - Load Accumulator
+		case 0xa9: doLDA(get_Immediate());		break;
+		case 0xa5: doLDA(get_ZeroPage());		break;
+		case 0xb5: doLDA(get_ZeroPageX<Variant, Accuracy>());		break;
+		case 0xad: doLDA(get_Absolute());		break;
+		case 0xbd: doLDA(get_AbsoluteX<Variant, Accuracy>());		break;
+		case 0xb9: doLDA(get_AbsoluteY<Variant, Accuracy>());		break;
+		case 0xa1: doLDA(get_IndirectX<Variant, Accuracy>());		break;
+		case 0xb1: doLDA(get_IndirectY<Variant, Accuracy>());		break;
+
+		// LDX - Load X Register
+		case 0xa2: doLDX(get_Immediate());		break;
+		case 0xa6: doLDX(get_ZeroPage());		break;
+		case 0xb6: doLDX(get_ZeroPageY<Variant, Accuracy>());		break;
+		case 0xae: doLDX(get_Absolute());		break;			
+		case 0xbe: doLDX(get_AbsoluteY<Variant, Accuracy>());		break;
+
+		// LDY - Load Y Register
+		case 0xa0: doLDY(get_Immediate());		break;
+		case 0xa4: doLDY(get_ZeroPage());		break;
+		case 0xb4: doLDY(get_ZeroPageX<Variant, Accuracy>());		break;
+		case 0xac: doLDY(get_Absolute());		break;
+		case 0xbc: doLDY(get_AbsoluteX<Variant, Accuracy>());		break;
+
+		// LSR - Logical Shift Right
+		case 0x4a: doLSR(get_Accumulator());	break;
+		case 0x46: modify<Variant, Accuracy>(getAddr_ZeroPage(), &CPU::doLSR);	break;
+		case 0x56: modify<Variant, Accuracy>(getAddr_ZeroPageX<Variant, Accuracy>(), &CPU::doLSR);	break;
+		case 0x4e: modify<Variant, Accuracy>(getAddr_Absolute(), &CPU::doLSR);	break;
+		case 0x5e: modify<Variant, Accuracy>(getAddr_AbsoluteX<Variant, Accuracy>(), &CPU::doLSR);	break;
+		
+		// ORA - Logical Inclusive OR			
+		case 0x09: doORA(get_Immediate());		break;
+		case 0x05: doORA(get_ZeroPage());		break;
+		case 0x15: doORA(get_ZeroPageX<Variant, Accuracy>());		break;
+		case 0x0d: doORA(get_Absolute());		break;
+		case 0x1d: doORA(get_AbsoluteX<Variant, Accuracy>());		break;
+		case 0x19: doORA(get_AbsoluteY<Variant, Accuracy>());		break;
+		case 0x01: doORA(get_IndirectX<Variant, Accuracy>());		break;
+		case 0x11: doORA(get_IndirectY<Variant, Accuracy>());		break;
+
+		// (Stack) PHA, PHP, PLA, PLP
+		case 0x48: doPHA();						break;
+		case 0x08: doPHP();						break;
+		case 0x68: doPLA();						break;
+		case 0x28: doPLP();						break;
+
+		// ROL - Rotate Left
+		case 0x2a: doROL(get_Accumulator());	break;
+		case 0x26: modify<Variant, Accuracy>(getAddr_ZeroPage(), &CPU::doROL);	break;
+		case 0x36: modify<Variant, Accuracy>(getAddr_ZeroPageX<Variant, Accuracy>(), &CPU::doROL);	break;
+		case 0x2e: modify<Variant, Accuracy>(getAddr_Absolute(), &CPU::doROL);	break;
+		case 0x3e: modify<Variant, Accuracy>(getAddr_AbsoluteX<Variant, Accuracy>(), &CPU::doROL);	break;
+
+		// ROR - Rotate Right
+		case 0x6a: doROR(get_Accumulator());	break;
+		case 0x66: modify<Variant, Accuracy>(getAddr_ZeroPage(), &CPU::doROR);	break;
+		case 0x76: modify<Variant, Accuracy>(getAddr_ZeroPageX<Variant, Accuracy>(), &CPU::doROR);	break;
+		case 0x6e: modify<Variant, Accuracy>(getAddr_Absolute(), &CPU::doROR);	break;
+		case 0x7e: modify<Variant, Accuracy>(getAddr_AbsoluteX<Variant, Accuracy>(), &CPU::doROR);	break;
+
+		// (Returns) RTI, RTS
+		case 0x40: doRTI();						break;
+		case 0x60: doRTS();						break;
+
+		// SBC - Subtract with Carry
+		case 0xe9: doSBC<Variant>(get_Immediate());		break;
+		case 0xe5: doSBC<Variant>(get_ZeroPage());		break;
+		case 0xf5: doSBC<Variant>(get_ZeroPageX<Variant, Accuracy>());		break;
+		case 0xed: doSBC<Variant>(get_Absolute());		break;
+		case 0xfd: doSBC<Variant>(get_AbsoluteX<Variant, Accuracy>());		break;
+		case 0xf9: doSBC<Variant>(get_AbsoluteY<Variant, Accuracy>());		break;
+		case 0xe1: doSBC<Variant>(get_IndirectX<Variant, Accuracy>());		break;
+		case 0xf1: doSBC<Variant>(get_IndirectY<Variant, Accuracy>());		break;
+
+		// STA - Store Accumulator
+		case 0x85: doSTA(getAddr_ZeroPage());	break;
+		case 0x95: doSTA(getAddr_ZeroPageX<Variant, Accuracy>());	break;
+		case 0x8d: doSTA(getAddr_Absolute());	break;
+		case 0x9d: doSTA(getAddr_AbsoluteX<Variant, Accuracy>());	break;
+		case 0x99: doSTA(getAddr_AbsoluteY<Variant, Accuracy>());	break;
+		case 0x81: doSTA(getAddr_IndirectX<Variant, Accuracy>());	break;
+		case 0x91: doSTA(getAddr_IndirectY<Variant, Accuracy>());	break;
+
+		// STX - Store X Register
+		case 0x86: doSTX(getAddr_ZeroPage());	break;
+		case 0x96: doSTX(getAddr_ZeroPageY<Variant, Accuracy>());	break;
+		case 0x8e: doSTX(getAddr_Absolute());	break;
+
+		// STY - Store Y Register
+		case 0x84: doSTY(getAddr_ZeroPage());	break;
+		case 0x94: doSTY(getAddr_ZeroPageX<Variant, Accuracy>());	break;
+		case 0x8c: doSTY(getAddr_Absolute());	break;
+	}
+
+	// execute();
+	const OpcodeInfo& info{ opcode_table[opcode] };
+	cycles += info.cycles;
+
+	if (info.page_cross_penalty && page_crossed)
+	{
+		++cycles;
+	}
 
-		// execute();
+	// OAM DMA halts the CPU for 513 cycles, plus one to align on an even cycle.
+	if (oam_dma_started)
+	{
+		oam_dma_started = false;
+		cycles += Bus::oam_dma_cycles + (cycles & 1);
 	}
 }
 
 
+CPU::Registers CPU::getRegisters() const
+{
+	return { program_counter, stack_pointer, reg_accumulator, reg_x, reg_y, processor_status };
+}
+
+
+void CPU::setRegisters(const Registers& registers)
+{
+	program_counter = registers.program_counter;
+	stack_pointer = registers.stack_pointer;
+	reg_accumulator = registers.reg_accumulator;
+	reg_x = registers.reg_x;
+	reg_y = registers.reg_y;
+	processor_status = registers.processor_status;
+	idle_loop.valid = false;
+
+	// The frames describe a stack that is no longer there.
+	return_stack.clear();
+}
+
+
+word CPU::getStackAddress() const
+{
+	return 0x0100 | stack_pointer;
+}
+
+
+void CPU::nmi()
+{
+	// Bit 5 is always pushed set; B is only set by BRK/PHP.
+	interrupt(program_counter, (processor_status & ~(1 << B)) | 0x20, 0xFFFA);
+	cycles += 7;
+}
+
+
+const ReturnStack& CPU::getReturnStack() const
+{
+	return return_stack;
+}
+
+
+void CPU::saveState(State& state) const
+{
+	state.registers = getRegisters();
+	state.cycles = cycles;
+	bus.saveState(state.bus);
+}
+
+
+void CPU::loadState(const State& state)
+{
+	setRegisters(state.registers);
+	cycles = state.cycles;
+	bus.loadState(state.bus);
+	idle_loop.valid = false;
+}
+
+
+void CPU::fork(Fork& child) const
+{
+	child.registers = getRegisters();
+	child.cycles = cycles;
+	bus.fork(child.bus);
+}
+
+
+void CPU::loadFork(const Fork& fork)
+{
+	setRegisters(fork.registers);
+	cycles = fork.cycles;
+	bus.loadFork(fork.bus);
+}
+
+
+uint64_t CPU::getCycles() const
+{
+	return cycles;
+}
+
+
+Bus& CPU::getBus()
+{
+	return bus;
+}
+
+
+const Bus& CPU::getBus() const
+{
+	return bus;
+}
+
+
+void CPU::setTraceHook(TraceHook* hook)
+{
+	trace_hook = hook;
+}
+
+
+TraceHook* CPU::getTraceHook() const
+{
+	return trace_hook;
+}
+
+
+bool CPU::setRecompiledModule(const RecompiledModule* module)
+{
+	recompiled_module = (module != nullptr && module->matches(bus)) ? module : nullptr;
+
+	// Frames may point at blocks of the previous module.
+	return_stack.clear();
+	return recompiled_module == module;
+}
+
+
+namespace
+{
+	// Bus access for recompiled code.
+	byte readBus(void* bus, word address)
+	{
+		return static_cast<Bus*>(bus)->read(address);
+	}
+
+
+	void writeBus(void* bus, word address, byte data)
+	{
+		static_cast<Bus*>(bus)->write(address, data);
+	}
+
+
+	byte readStack(void* bus, byte offset)
+	{
+		return static_cast<Bus*>(bus)->readStack(offset);
+	}
+
+
+	void writeStack(void* bus, byte offset, byte data)
+	{
+		static_cast<Bus*>(bus)->writeStack(offset, data);
+	}
+}
+
+
+bool CPU::runRecompiled(uint64_t cycle)
+{
+	RecompiledBlock block{ recompiled_module->getBlock(program_counter) };
+
+	if (block == nullptr)
+	{
+		return false;
+	}
+
+	RecompiledState state{ program_counter, stack_pointer, reg_accumulator, reg_x, reg_y, processor_status, false, cycles,
+		&bus, &readBus, &writeBus, &readStack, &writeStack, &return_stack, nullptr };
+
+	// A block ending in a call, or in a return the shadow stack predicted, names the block to
+	// continue with, which runs without coming back here to look it up. runUntil() still sees
+	// the state at the cycle target and after every backward jump (idle-loop detection).
+	while (block != nullptr)
+	{
+		state.next_block = nullptr;
+		block(state, cycle);
+		block = (state.cycles < cycle && !state.backward_jump) ? state.next_block : nullptr;
+	}
+
+	program_counter = state.program_counter;
+	stack_pointer = state.stack_pointer;
+	reg_accumulator = state.reg_accumulator;
+	reg_x = state.reg_x;
+	reg_y = state.reg_y;
+	processor_status = state.processor_status;
+	cycles = state.cycles;
+	backward_jump = state.backward_jump;
+	return true;
+}
+
+
+void CPU::setIdleLoopSkipping(bool enabled)
+{
+	idle_loop_skipping = enabled;
+	idle_loop.valid = false;
+}
+
+
+uint64_t CPU::getIdleCyclesSkipped() const
+{
+	return idle_cycles_skipped;
+}
+
+
+void CPU::traceInstruction()
+{
+	// Peek at the operand bytes so tracing has no effect on emulation.
+	byte instruction[3]{};
+	for (word i{ 0 }; i < 3; ++i)
+	{
+		instruction[i] = bus.peek(program_counter + i);
+	}
+
+	trace_hook->onInstruction(getRegisters(), instruction, cycles);
+}
+
+
+void CPU::skipIdleLoop(uint64_t next_event)
+{
+	// A trace must see every instruction.
+	if (!idle_loop_skipping || trace_hook != nullptr)
+	{
+		return;
+	}
+
+	Registers current{ getRegisters() };
+	uint64_t bus_changes{ bus.getChangeCount() };
+
+	const Registers& previous{ idle_loop.registers };
+	bool same_registers{
+		current.program_counter == previous.program_counter
+		&& current.stack_pointer == previous.stack_pointer
+		&& current.reg_accumulator == previous.reg_accumulator
+		&& current.reg_x == previous.reg_x
+		&& current.reg_y == previous.reg_y
+		&& current.processor_status == previous.processor_status
+	};
+
+	// Same registers and memory as one iteration ago: the execution is deterministic, 
+	// so each further iteration takes the same number of cycles and ends in this same state
+	// until the next event. Skip all iterations that end before it; stepping resumes from there.
+	if (idle_loop.valid && same_registers && bus_changes == idle_loop.bus_changes && cycles < next_event)
+	{
+		uint64_t period{ cycles - idle_loop.cycles };
+		uint64_t skipped{ ((next_event - 1 - cycles) / period) * period };
+
+		cycles += skipped;
+		idle_cycles_skipped += skipped;
+	}
+
+	idle_loop = { current, cycles, bus_changes, true };
+}
+
+
 /*
 
 	INSTRUCTIONS
@@ -241,10 +643,20 @@ void CPU::run()
 	This instruction adds the contents of a memory location to the accumulator together with the carry bit. 
 	If overflow occurs the carry bit is set, this enables multiple byte addition to be performed.
 */
-void CPU::doADC(byte& data)
+template <typename Variant>
+void CPU::doADC(byte data)
 {
-	reg_accumulator = addBytes(data, reg_accumulator, true);
-	setZeroAndNegativeFlags(reg_accumulator);	
+	// Drops out entirely for variants without decimal mode (the 2A03).
+	if constexpr (Variant::has_decimal_mode)
+	{
+		if (isFlagSet(D))
+		{
+			reg_accumulator = addDecimal<Variant>(reg_accumulator, data);
+			return;
+		}
+	}
+
+	Handlers::doADC(*this, data);
 }
 
 
@@ -253,10 +665,9 @@ void CPU::doADC(byte& data)
  
 	A logical AND is performed, bit by bit, on the accumulator contents using the contents of a byte of memory.
 */
-void CPU::doAND(byte& data)
+void CPU::doAND(byte data)
 {
-	reg_accumulator &= data;
-	setZeroAndNegativeFlags(reg_accumulator);
+	Handlers::doAND(*this, data);
 }
 
 
@@ -270,9 +681,57 @@ void CPU::doAND(byte& data)
 */
 void CPU::doASL(byte& data)
 {
-	setFlag(C, (data & 0b1000'0000) != 0);
-	data <<= 1;
-	setZeroAndNegativeFlags(data);
+	Handlers::doASL(*this, data);
+}
+
+
+/*
+	(Branch helper)
+
+	Branch offsets are signed, relative to the instruction following the branch.
+	A taken branch costs one extra cycle, or two if the destination is on another page.
+	Backward branches may close an idle loop (see skipIdleLoop()).
+*/
+void CPU::branch(byte offset)
+{
+	word destination = addWords(program_counter, static_cast<word>(static_cast<int8_t>(offset)));
+
+	cycles += ((destination & 0xFF00) != (program_counter & 0xFF00)) ? 2 : 1;
+	backward_jump = destination < program_counter;
+	program_counter = destination;
+}
+
+
+/*
+	(Stack helper)
+
+	The stack pointer points at the next free byte of page $01 and grows down.
+*/
+void CPU::push(byte data)
+{
+	bus.writeStack(stack_pointer--, data);
+}
+
+
+byte CPU::pull()
+{
+	return bus.readStack(++stack_pointer);
+}
+
+
+/*
+	(Interrupt helper)
+
+	Pushes the return address (high byte first) and the status, sets the interrupt disable
+	flag and loads the vector into the program counter. The handler's frame goes on the
+	shadow return stack for RTI to match.
+*/
+void CPU::interrupt(word return_address, byte status, word vector)
+{
+	Handlers::pushInterrupt(*this, return_address, status);
+
+	program_counter = bus.read(vector) | (bus.read(vector + 1) << 8);
+	return_stack.call({ program_counter, return_address, stack_pointer, true, cycles, nullptr });
 }
 
 
@@ -282,11 +741,11 @@ void CPU::doASL(byte& data)
 	If the carry flag is clear then add the relative displacement to the program counter 
 	to cause a branch to a new location.
 */
-void CPU::doBCC(byte& data)
+void CPU::doBCC(byte data)
 {
 	if (!isFlagSet(C))
 	{
-		program_counter = addWords(program_counter, data);
+		branch(data);
 	}
 }
 
@@ -297,11 +756,11 @@ void CPU::doBCC(byte& data)
 	If the carry flag is set then add the relative displacement to the program counter
 	to cause a branch to a new location.
 */
-void CPU::doBCS(byte& data)
+void CPU::doBCS(byte data)
 {
 	if (isFlagSet(C))
 	{
-		program_counter = addWords(program_counter, data);
+		branch(data);
 	}
 }
 
@@ -312,11 +771,11 @@ void CPU::doBCS(byte& data)
 	If the zero flag is set then add the relative displacement to the program counter
 	to cause a branch to a new location.
 */
-void CPU::doBEQ(byte& data)
+void CPU::doBEQ(byte data)
 {
 	if (isFlagSet(Z))
 	{
-		program_counter = addWords(program_counter, data);
+		branch(data);
 	}
 }
 
@@ -328,17 +787,9 @@ void CPU::doBEQ(byte& data)
 	The mask pattern in A is ANDed with the value in memory to set or clear the zero flag, 
 	but the result is not kept. Bits 7 and 6 of the value from memory are copied into the N and V flags.
 */
-void CPU::doBIT(byte& data)
+void CPU::doBIT(byte data)
 {
-	byte result{ reg_accumulator & data };
-
-	if (result == 0)
-	{
-		setFlag(Z, true);
-	}
-	
-	setFlag(N, (data & 0b1000'0000) != 0);
-	setFlag(V, (data & 0b0100'0000) != 0);
+	Handlers::doBIT(*this, data);
 }
 
 
@@ -348,11 +799,11 @@ void CPU::doBIT(byte& data)
 	If the negative flag is set then add the relative displacement to the program counter 
 	to cause a branch to a new location.
 */
-void CPU::doBMI(byte& data)
+void CPU::doBMI(byte data)
 {
 	if (isFlagSet(N))
 	{
-		program_counter = addWords(program_counter, data);
+		branch(data);
 	}
 }
 
@@ -363,11 +814,11 @@ void CPU::doBMI(byte& data)
 	If the zero flag is clear then add the relative displacement to the program counter 
 	to cause a branch to a new location.
 */
-void CPU::doBNE(byte& data)
+void CPU::doBNE(byte data)
 {
 	if (!isFlagSet(Z))
 	{
-		program_counter = addWords(program_counter, data);
+		branch(data);
 	}
 }
 
@@ -378,11 +829,11 @@ void CPU::doBNE(byte& data)
 	If the negative flag is clear then add the relative displacement to the program counter
 	to cause a branch to a new location.
 */
-void CPU::doBPL(byte& data)
+void CPU::doBPL(byte data)
 {
 	if (!isFlagSet(N))
 	{
-		program_counter = addWords(program_counter, data);
+		branch(data);
 	}
 }
 
@@ -393,13 +844,13 @@ void CPU::doBPL(byte& data)
 	The BRK instruction forces the generation of an interrupt request. 
 	The program counter and processor status are pushed on the stack 
 	then the IRQ interrupt vector at $FFFE/F is loaded into the PC and the break flag in the status set to one.
+
+	The break flag only exists in the pushed copy of the status. The return address skips
+	the byte after BRK, which the handler can use as a signature.
 */
 void CPU::doBRK()
 {
-	// Push program_counter and processor_status onto stack.
-	// Load word at $FFFE/F into program_counter.
-
-	setFlag(B, true);
+	interrupt(program_counter + 1, processor_status | Handlers::pushed_bits, 0xFFFE);
 }
 
 
@@ -409,11 +860,11 @@ void CPU::doBRK()
 	If the overflow flag is clear then add the relative displacement to the program counter
 	to cause a branch to a new location.
 */
-void CPU::doBVC(byte& data)
+void CPU::doBVC(byte data)
 {
 	if (!isFlagSet(V))
 	{
-		program_counter = addWords(program_counter, data);
+		branch(data);
 	}
 }
 
@@ -424,11 +875,11 @@ void CPU::doBVC(byte& data)
 	If the overflow flag is set then add the relative displacement to the program counter
 	to cause a branch to a new location.
 */
-void CPU::doBVS(byte& data)
+void CPU::doBVS(byte data)
 {
 	if (isFlagSet(V))
 	{
-		program_counter = addWords(program_counter, data);
+		branch(data);
 	}
 }
 
@@ -440,7 +891,7 @@ void CPU::doBVS(byte& data)
 */
 void CPU::doCLC()
 {
-	setFlag(C, false);
+	Handlers::doCLC(*this);
 }
 
 
@@ -455,7 +906,7 @@ void CPU::doCLC()
 */
 void CPU::doCLD()
 {
-	setFlag(D, false);
+	Handlers::doCLD(*this);
 }
 
 
@@ -466,7 +917,7 @@ void CPU::doCLD()
 */
 void CPU::doCLI()
 {
-	setFlag(I, false);
+	Handlers::doCLI(*this);
 }
 
 
@@ -477,7 +928,7 @@ void CPU::doCLI()
 */
 void CPU::doCLV()
 {
-	setFlag(V, false);
+	Handlers::doCLV(*this);
 }
 
 
@@ -487,23 +938,9 @@ void CPU::doCLV()
 	This instruction compares the contents of the accumulator with another 
 	memory held value and sets the zero and carry flags as appropriate.
 */
-void CPU::doCMP(byte& data)
+void CPU::doCMP(byte data)
 {
-	if (reg_accumulator >= data)
-	{
-		setFlag(C, true);
-	}
-
-	if (reg_accumulator == data)
-	{
-		setFlag(Z, true);
-	}
-	
-	byte result = subtractBytes(reg_accumulator, data, false);
-	if ((result & 0b1000'0000) != 0)
-	{
-		setFlag(N, true);
-	}
+	Handlers::doCMP(*this, data);
 }
 
 
@@ -513,23 +950,9 @@ void CPU::doCMP(byte& data)
 	This instruction compares the contents of the X register with another
 	memory held value and sets the zero and carry flags as appropriate.
 */
-void CPU::doCMX(byte& data)
+void CPU::doCMX(byte data)
 {
-	if (reg_x >= data)
-	{
-		setFlag(C, true);
-	}
-
-	if (reg_x == data)
-	{
-		setFlag(Z, true);
-	}
-
-	byte result = subtractBytes(reg_x, data, false);
-	if ((result & 0b1000'0000) != 0)
-	{
-		setFlag(N, true);
-	}
+	Handlers::doCMX(*this, data);
 }
 
 
@@ -539,23 +962,9 @@ void CPU::doCMX(byte& data)
 	This instruction compares the contents of the Y register with another
 	memory held value and sets the zero and carry flags as appropriate.
 */
-void CPU::doCMY(byte& data)
+void CPU::doCMY(byte data)
 {
-	if (reg_y >= data)
-	{
-		setFlag(C, true);
-	}
-
-	if (reg_y == data)
-	{
-		setFlag(Z, true);
-	}
-
-	byte result = subtractBytes(reg_y, data, false);
-	if ((result & 0b1000'0000) != 0)
-	{
-		setFlag(N, true);
-	}
+	Handlers::doCMY(*this, data);
 }
 
 
@@ -567,8 +976,7 @@ void CPU::doCMY(byte& data)
 */
 void CPU::doDEC(byte& data)
 {
-	data = subtractBytes(data, 0b0000'0001, false);
-	setZeroAndNegativeFlags(data);
+	Handlers::doDEC(*this, data);
 }
 
 
@@ -580,8 +988,7 @@ void CPU::doDEC(byte& data)
 */
 void CPU::doDEX()
 {
-	reg_x = subtractBytes(reg_x, 0b0000'0001, false);
-	setZeroAndNegativeFlags(reg_x);
+	Handlers::doDEX(*this);
 }
 
 
@@ -593,8 +1000,7 @@ void CPU::doDEX()
 */
 void CPU::doDEY()
 {
-	reg_y = subtractBytes(reg_y, 0b0000'0001, false);
-	setZeroAndNegativeFlags(reg_y);
+	Handlers::doDEY(*this);
 }
 
 
@@ -604,10 +1010,9 @@ void CPU::doDEY()
 	An exclusive OR is performed, bit by bit, on the 
 	accumulator contents using the contents of a byte of memory.
 */
-void CPU::doEOR(byte& data)
+void CPU::doEOR(byte data)
 {
-	reg_accumulator = reg_accumulator ^ data;
-	setZeroAndNegativeFlags(reg_accumulator);
+	Handlers::doEOR(*this, data);
 }
 
 
@@ -619,9 +1024,7 @@ void CPU::doEOR(byte& data)
 */
 void CPU::doINC(byte& data)
 {
-	//data = addBytes(data, 0b0000'0001, false);
-	++data; // TODO: Is this ok???
-	setZeroAndNegativeFlags(data);
+	Handlers::doINC(*this, data);
 }
 
 
@@ -633,8 +1036,7 @@ void CPU::doINC(byte& data)
 */
 void CPU::doINX()
 {
-	reg_x = addBytes(reg_x, 0b0000'0001, false);
-	setZeroAndNegativeFlags(reg_x);
+	Handlers::doINX(*this);
 }
 
 
@@ -646,8 +1048,7 @@ void CPU::doINX()
 */
 void CPU::doINY()
 {
-	reg_y = addBytes(reg_y, 0b0000'0001, false);
-	setZeroAndNegativeFlags(reg_y);
+	Handlers::doINY(*this);
 }
 
 
@@ -655,9 +1056,30 @@ void CPU::doINY()
 	JMP - Jump
 
 	Sets the program counter to the address specified by the operand.
+	Backward jumps may close an idle loop (see skipIdleLoop()).
 */
 void CPU::doJMP(word address)
 {
+	backward_jump = address < program_counter;
+	program_counter = address;
+}
+
+
+/*
+	JSR - Jump to Subroutine
+
+	The JSR instruction pushes the address (minus one) of the return point on to the stack
+	and then sets the program counter to the target memory address.
+
+	The call goes on the shadow return stack, with the recompiled block at the return point
+	if there is one, so the matching RTS can continue there directly.
+*/
+void CPU::doJSR(word address)
+{
+	Handlers::pushWord(*this, static_cast<word>(program_counter - 1));
+
+	RecompiledBlock return_block{ (recompiled_module != nullptr) ? recompiled_module->getBlock(program_counter) : nullptr };
+	return_stack.call({ address, program_counter, stack_pointer, false, cycles, return_block });
 	program_counter = address;
 }
 
@@ -668,10 +1090,9 @@ void CPU::doJMP(word address)
 	Loads a byte of memory into the accumulator,
 	setting the zero and negative flags as appropriate.
 */
-void CPU::doLDA(byte& data)
+void CPU::doLDA(byte data)
 {
-	reg_accumulator = data;
-	setZeroAndNegativeFlags(data);
+	Handlers::doLDA(*this, data);
 }
 
 
@@ -681,10 +1102,9 @@ void CPU::doLDA(byte& data)
 	Loads a byte of memory into the X register,
 	setting the zero and negative flags as appropriate.
 */
-void CPU::doLDX(byte& data)
+void CPU::doLDX(byte data)
 {
-	reg_x = data;
-	setZeroAndNegativeFlags(data);
+	Handlers::doLDX(*this, data);
 }
 
 
@@ -694,10 +1114,9 @@ void CPU::doLDX(byte& data)
 	Loads a byte of memory into the Y register,
 	setting the zero and negative flags as appropriate.
 */
-void CPU::doLDY(byte& data)
+void CPU::doLDY(byte data)
 {
-	reg_y = data;
-	setZeroAndNegativeFlags(data);
+	Handlers::doLDY(*this, data);
 }
 
 
@@ -709,42 +1128,71 @@ void CPU::doLDY(byte& data)
 */
 void CPU::doLSR(byte& data)
 {
-	setFlag(C, (data & 0b0000'0001) != 0);
-	data >>= 1;
-	setZeroAndNegativeFlags(data);
+	Handlers::doLSR(*this, data);
 }
 
 
 /*
-	LSR - Logical Shift Right
+	ORA - Logical Inclusive OR
 
-	Each of the bits in A or M is shift one place to the right.
-	The bit that was in bit 0 is shifted into the carry flag. Bit 7 is set to zero.
+	An inclusive OR is performed, bit by bit, 
+	on the accumulator contents using the contents of a byte of memory.
 */
-void CPU::doLSR(byte& data)
+void CPU::doORA(byte data)
 {
-	setFlag(C, (data & 0b0000'0001) != 0);
-	data >>= 1;
-	setZeroAndNegativeFlags(data);
+	Handlers::doORA(*this, data);
 }
 
 
 /*
-	ORA - Logical Inclusive OR
+	PHA - Push Accumulator
 
-	An inclusive OR is performed, bit by bit, 
-	on the accumulator contents using the contents of a byte of memory.
+	Pushes a copy of the accumulator on to the stack.
+
+	The stack instructions, returns and BRK make their dummy reads from the instruction
+	stream and the stack page, which have no side effects, so the bus-exact tier has
+	nothing to add to them.
+*/
+void CPU::doPHA()
+{
+	Handlers::doPHA(*this);
+}
+
+
+/*
+	PHP - Push Processor Status
+
+	Pushes a copy of the status flags on to the stack, with the break flag and bit 5 set.
+*/
+void CPU::doPHP()
+{
+	Handlers::doPHP(*this);
+}
+
+
+/*
+	PLA - Pull Accumulator
+
+	Pulls an 8 bit value from the stack and into the accumulator.
+	The zero and negative flags are set as appropriate.
 */
-void CPU::doORA(byte& data)
+void CPU::doPLA()
 {
-	reg_accumulator = reg_accumulator | data;
-	setZeroAndNegativeFlags(data);
+	Handlers::doPLA(*this);
+}
+
+
+/*
+	PLP - Pull Processor Status
+
+	Pulls an 8 bit value from the stack and into the processor flags. 
+	The break flag and bit 5 are not real flags and keep their values.
+*/
+void CPU::doPLP()
+{
+	Handlers::doPLP(*this);
 }
 
-// TODO: PHA
-// TODO: PHP
-// TODO: PLA
-// TODO: PLP
 
 /*
 	ROL - Rotate Left
@@ -754,12 +1202,7 @@ void CPU::doORA(byte& data)
 */
 void CPU::doROL(byte& data)
 {
-	byte temp{ data & 0b1000'0000 };
-	data = (data << 1) | (isFlagSet(C) ? 0b0 : 0b1);
-
-	setFlag(C, temp != 0);
-
-	setZeroAndNegativeFlags(data);
+	Handlers::doROL(*this, data);
 }
 
 
@@ -769,19 +1212,41 @@ void CPU::doROL(byte& data)
 	Move each of the bits in either A or M one place to the right. 
 	Bit 7 is filled with the current value of the carry flag whilst the old bit 0 becomes the new carry flag value.
 */
-void CPU::doROR(byte & data)
+void CPU::doROR(byte& data)
 {
-	byte temp{ data & 0b1 };
-	data = (data >> 1) | (isFlagSet(C) ? 0b0 : 0b1000'0000);
+	Handlers::doROR(*this, data);
+}
+
 
-	setFlag(C, temp != 0);
+/*
+	RTI - Return from Interrupt
 
-	setZeroAndNegativeFlags(data);
+	The RTI instruction is used at the end of an interrupt processing routine. 
+	It pulls the processor flags from the stack followed by the program counter.
+*/
+void CPU::doRTI()
+{
+	byte stack_before{ stack_pointer };
+	Handlers::doRTI(*this);
+	return_stack.ret(stack_before, program_counter);
 }
 
 
-// TODO: RTI
-// TODO: RTS
+/*
+	RTS - Return from Subroutine
+
+	The RTS instruction is used at the end of a subroutine to return to the calling routine. 
+	It pulls the program counter (minus one) from the stack.
+
+	Whatever was pushed is returned to, matching call or not: jump tables push an entry
+	and RTS to it. The shadow return stack only records whether it saw this coming.
+*/
+void CPU::doRTS()
+{
+	byte stack_before{ stack_pointer };
+	Handlers::doRTS(*this);
+	return_stack.ret(stack_before, program_counter);
+}
 
 
 /*
@@ -791,10 +1256,53 @@ void CPU::doROR(byte & data)
 	together with the not of the carry bit. If overflow occurs the carry bit is clear, 
 	this enables multiple byte subtraction to be performed.
 */
-void CPU::doSBC(byte& data)
+template <typename Variant>
+void CPU::doSBC(byte data)
+{
+	// Drops out entirely for variants without decimal mode (the 2A03).
+	if constexpr (Variant::has_decimal_mode)
+	{
+		if (isFlagSet(D))
+		{
+			reg_accumulator = subtractDecimal<Variant>(reg_accumulator, data);
+			return;
+		}
+	}
+
+	Handlers::doSBC(*this, data);
+}
+
+
+/*
+	STA - Store Accumulator
+
+	Stores the contents of the accumulator into memory.
+*/
+void CPU::doSTA(word address)
+{
+	write(address, reg_accumulator);
+}
+
+
+/*
+	STX - Store X Register
+
+	Stores the contents of the X register into memory.
+*/
+void CPU::doSTX(word address)
 {
-	reg_accumulator = subtractBytes(reg_accumulator, data, true);
-	setZeroAndNegativeFlags(reg_accumulator);
+	write(address, reg_x);
+}
+
+
+/*
+	STY - Store Y Register
+
+	Stores the contents of the Y register into memory.
+*/
+void CPU::doSTY(word address)
+{
+	write(address, reg_y);
 }
 
 
@@ -823,69 +1331,131 @@ void CPU::doSBC(byte& data)
 #pragma region GET_DATA
 
 
-byte& CPU::get_Immediate()
+byte CPU::get_Immediate()
 {
-	return memory[getAddr_Immediate()];
+	return bus.read(getAddr_Immediate());
 }
 
 
-byte& CPU::get_ZeroPage()
+byte CPU::get_ZeroPage()
 {
-	return memory[getAddr_ZeroPage()];
+	return bus.read(getAddr_ZeroPage());
 }
 
 
-byte& CPU::get_ZeroPageX()
+template <typename Variant, typename Accuracy>
+byte CPU::get_ZeroPageX()
 {
-	return memory[getAddr_ZeroPageX()];
+	return bus.read(getAddr_ZeroPageX<Variant, Accuracy>());
 }
 
 
-byte& CPU::get_ZeroPageY()
+template <typename Variant, typename Accuracy>
+byte CPU::get_ZeroPageY()
 {
-	return memory[getAddr_ZeroPageY()];
+	return bus.read(getAddr_ZeroPageY<Variant, Accuracy>());
 }
 
 
-byte& CPU::get_Absolute()
+byte CPU::get_Absolute()
 {
-	return memory[getAddr_Absolute()];
+	return bus.read(getAddr_Absolute());
 }
 
 
-byte& CPU::get_AbsoluteX()
+/*
+	Loads through the indexed modes only make the fix-up read when the index crossed a page.
+	Otherwise the read at the uncorrected address already is the load.
+*/
+template <typename Variant, typename Accuracy>
+byte CPU::get_AbsoluteX()
 {
-	return memory[getAddr_AbsoluteX()];
+	word address{ indexAddress(getAddr_Absolute(), reg_x) };
+
+	if (page_crossed)
+	{
+		dummyRead<Variant, Accuracy>(uncorrected_address);
+	}
+
+	return bus.read(address);
 }
 
 
-byte& CPU::get_AbsoluteY()
+template <typename Variant, typename Accuracy>
+byte CPU::get_AbsoluteY()
 {
-	return memory[getAddr_AbsoluteY()];
+	word address{ indexAddress(getAddr_Absolute(), reg_y) };
+
+	if (page_crossed)
+	{
+		dummyRead<Variant, Accuracy>(uncorrected_address);
+	}
+
+	return bus.read(address);
 }
 
 
-byte& CPU::get_IndirectX()
+template <typename Variant, typename Accuracy>
+byte CPU::get_IndirectX()
 {
-	return memory[getAddr_IndirectX()];
+	return bus.read(getAddr_IndirectX<Variant, Accuracy>());
 }
 
 
-byte& CPU::get_IndirectY()
+template <typename Variant, typename Accuracy>
+byte CPU::get_IndirectY()
 {
-	return memory[getAddr_IndirectY()];
+	word address{ indexAddress(readPointer(bus.read(program_counter++)), reg_y) };
+
+	if (page_crossed)
+	{
+		dummyRead<Variant, Accuracy>(uncorrected_address);
+	}
+
+	return bus.read(address);
 }
 
 
-byte& CPU::get_Indirect()
+template <typename Variant>
+byte CPU::get_Indirect()
 {
-	return memory[getAddr_Indirect()];
+	return bus.read(getAddr_Indirect<Variant>());
 }
 
 byte& CPU::get_Accumulator()
 {
 	return reg_accumulator;
 }
+
+
+template <typename Variant, typename Accuracy>
+void CPU::modify(word address, void (CPU::*instruction)(byte&))
+{
+	byte data{ bus.read(address) };
+
+	// The chip spends a cycle modifying the data, with the bus still on the address.
+	if constexpr (Accuracy::dummy_accesses)
+	{
+		if constexpr (Variant::nmos_dummy_accesses)
+		{
+			write(address, data);
+		}
+		else
+		{
+			bus.read(address);
+		}
+	}
+
+	(this->*instruction)(data);
+	write(address, data);
+}
+
+
+void CPU::write(word address, byte data)
+{
+	bus.write(address, data);
+	oam_dma_started |= (address == Bus::oam_dma);
+}
 #pragma endregion
 
 
@@ -918,76 +1488,126 @@ word CPU::getAddr_Immediate()
 
 word CPU::getAddr_ZeroPage()
 {
-	return memory[program_counter++];
+	return bus.read(program_counter++);
 }
 
 
+/*
+	Zero page indexing always reads the base address while it adds the index.
+*/
+template <typename Variant, typename Accuracy>
 word CPU::getAddr_ZeroPageX()
 {
-	return addBytes(memory[program_counter++], reg_x, false);
+	byte base{ bus.read(program_counter++) };
+	dummyRead<Variant, Accuracy>(base);
+
+	return addBytes(base, reg_x);
 }
 
 
+template <typename Variant, typename Accuracy>
 word CPU::getAddr_ZeroPageY()
 {
-	// TODO: return addWords(memory[program_counter++], reg_y); not sure if the NB applies to this as well.
-	return addBytes(memory[program_counter++], reg_y, false);
+	byte base{ bus.read(program_counter++) };
+	dummyRead<Variant, Accuracy>(base);
+
+	// TODO: return addWords(base, reg_y); not sure if the NB applies to this as well.
+	return addBytes(base, reg_y);
 }
 
 
 word CPU::getAddr_Absolute()
 {
-	byte lo = memory[program_counter++];
-	byte hi = memory[program_counter++];
+	byte lo = bus.read(program_counter++);
+	byte hi = bus.read(program_counter++);
 
 	return (hi << 8) | lo;
 }
 
 
+/*
+	Used directly by stores and read-modify-writes, which always make the fix-up read
+	(the chip cannot know yet whether the read hit the right page).
+*/
+template <typename Variant, typename Accuracy>
 word CPU::getAddr_AbsoluteX()
 {
-	byte lo = memory[program_counter++];
-	byte hi = memory[program_counter++];
+	word address{ indexAddress(getAddr_Absolute(), reg_x) };
+	dummyRead<Variant, Accuracy>(uncorrected_address);
 
-	word address_before_offset = (hi << 8) | lo;
-	return addWords(address_before_offset, reg_x);
+	return address;
 }
 
 
+template <typename Variant, typename Accuracy>
 word CPU::getAddr_AbsoluteY()
 {
-	byte lo = memory[program_counter++];
-	byte hi = memory[program_counter++];
+	word address{ indexAddress(getAddr_Absolute(), reg_y) };
+	dummyRead<Variant, Accuracy>(uncorrected_address);
 
-	word address_before_offset = (hi << 8) | lo;
-	return addWords(address_before_offset, reg_y);
+	return address;
 }
 
 
+template <typename Variant, typename Accuracy>
 word CPU::getAddr_IndirectX()
 {
-	byte table_address{ memory[program_counter++] };
-	return addBytes(table_address, reg_x, false);
+	// The pointer lives in the zero page; indexing wraps within it.
+	byte base{ bus.read(program_counter++) };
+	dummyRead<Variant, Accuracy>(base);
+
+	return readPointer(addBytes(base, reg_x));
 }
 
 
+template <typename Variant, typename Accuracy>
 word CPU::getAddr_IndirectY()
 {
-	byte lo_idx{ memory[program_counter++] };
-	byte lo{ memory[lo_idx] };
+	word address{ indexAddress(readPointer(bus.read(program_counter++)), reg_y) };
+	dummyRead<Variant, Accuracy>(uncorrected_address);
+
+	return address;
+}
+
+
+word CPU::indexAddress(word base, byte index)
+{
+	word address = addWords(base, index);
 
-	return addWords(reg_y, lo);
+	page_crossed = (address & 0xFF00) != (base & 0xFF00);
+	uncorrected_address = (base & 0xFF00) | static_cast<byte>(base + index);
+	return address;
+}
+
+
+word CPU::readPointer(byte address)
+{
+	byte lo{ bus.read(address) };
+	byte hi{ bus.read(static_cast<byte>(address + 1)) };
+
+	return (hi << 8) | lo;
+}
+
+
+template <typename Variant, typename Accuracy>
+void CPU::dummyRead(word address)
+{
+	if constexpr (Accuracy::dummy_accesses)
+	{
+		bus.read(Variant::nmos_dummy_accesses ? address : static_cast<word>(program_counter - 1));
+	}
 }
 
 
+template <typename Variant>
 word CPU::getAddr_Indirect()
 {
-	byte lo = memory[program_counter++];
-	byte hi = memory[program_counter++];
+	byte lo = bus.read(program_counter++);
+	byte hi = bus.read(program_counter++);
 
 	word indirect_address = (hi << 8) | lo;
 
-	byte i_lo = memory[indirect_address++];
+	byte i_lo = bus.read(indirect_address++);
 
 	// Per nesdev.org (https://www.nesdev.org/obelisk-6502-guide/reference.html#JMP):
 	/*
@@ -998,16 +1618,21 @@ word CPU::getAddr_Indirect()
 		chips like the 65SC02 so for compatibility always ensure the indirect 
 		vector is not at the end of the page.
 	*/
-#ifdef 65SC02
-	// Correctly fetches MSB.
-	byte i_hi = memory[indirect_address]; 
-#else
-	// Increments only the lo without regard to the whole indirect address value.
-	// Thus an overflow does not carry to the hi.
-	// (e.g., hi = 0x32, lo = 0xFF; lo + 1 = 0x00; (hi << 8) | lo = 0x3200 (!0x3300))
-	word incorrect_indirect_address = (hi << 8) | addBytes(lo, 0b1, false);
-	byte i_hi = memory[incorrect_indirect_address];
-#endif
+	byte i_hi;
+	if constexpr (Variant::indirect_jump_wraps_page)
+	{
+		// Increments only the lo without regard to the whole indirect address value.
+		// Thus an overflow does not carry to the hi.
+		// (e.g., hi = 0x32, lo = 0xFF; lo + 1 = 0x00; (hi << 8) | lo = 0x3200 (!0x3300))
+		word incorrect_indirect_address = (hi << 8) | addBytes(lo, 0b1);
+		i_hi = bus.read(incorrect_indirect_address);
+	}
+	else
+	{
+		// Correctly fetches MSB. The fix costs the 65C02 an extra cycle.
+		i_hi = bus.read(indirect_address);
+		++cycles;
+	}
 
 	return (i_hi << 8) | i_lo;
 }
@@ -1035,9 +1660,9 @@ word CPU::getAddr_Indirect()
 #pragma region BINARY_MATH
 
 
-byte CPU::addBytes(byte a, byte b, bool use_flags)
+byte CPU::addBytes(byte a, byte b)
 {
-	byte carry{ (use_flags ? static_cast<byte>(processor_status & (1 << C)) : static_cast<byte>(0)) };
+	byte carry{ 0x00 };
 	byte result{ 0x00 };
 
 	for (size_t i{ 0 }; i < 8; ++i)
@@ -1051,28 +1676,6 @@ byte CPU::addBytes(byte a, byte b, bool use_flags)
 		result |= (sum << i);
 	}
 
-	std::cout << "\n\nAdd bytes:\n";
-	std::cout << std::bitset<8>(a) << '\n';
-	std::cout << std::bitset<8>(b) << '\n';
-	std::cout << std::bitset<8>(result) << '\n';
-
-	// Set flags.
-	if (use_flags)
-	{
-		// Overflow check: if MSB of starting values is different from result.
-		bool had_overflow{ (a ^ result) & (b ^ result) & 0b1000'000 };
-		if (had_overflow)
-		{
-			// Overflow flag - set if there was overflow.
-			setFlag(V, true);
-
-			// Carry flag - set if there was overflow.
-			setFlag(C, true);
-		}
-		
-		std::cout << "Carry: " << carry << " | Overflow? " << had_overflow << std::endl;
-	}
-
 	return result;
 }
 
@@ -1093,8 +1696,6 @@ word CPU::addWords(word a, word b)
 		result |= (sum << i);
 	}
 
-	std::cout << "Add word/word: (bits) " << std::bitset<16>(result) << " | (hex) " << std::hex << (int)result << std::endl;
-
 	return result;
 }
 
@@ -1104,89 +1705,138 @@ word CPU::addWords(byte a, word b) { return addWords(static_cast<word>(a), b); }
 word CPU::addWords(byte a, byte b) { return addWords(static_cast<word>(a), static_cast<word>(b)); }
 
 
-byte CPU::subtractBytes(byte minuend, byte subtrahend, bool use_flags)
+word CPU::subtractWords(word minuend, word subtrahend)
 {
-	byte initial_subtrahend{ subtrahend };
-
 	// Flip subtrahend with 2's complement so that:
 	//	(minuend -  subtrahend) => (minuend + -subtrahend)
 	//  (minuend - -subtrahend) => (minuend +  subtrahend)
 	//subtrahend = ~(subtrahend - 0b1);
-	// TODO: Can carry bit be subtracted here?
-	byte carry_bit{ ~(use_flags ? (isFlagSet(C) ? 0b1 : 0b0) : 0b0) };
-	subtrahend = ~(subtrahend - 0b1) - carry_bit;
-	carry_bit = 0b0;
+	// TODO: 
 
-	byte result{ 0x0000 };
+	byte carry{ 0x00 };
+	word result{ 0x0000 };
 
-	for (size_t i{ 0 }; i < 8; ++i)
+	for (size_t i{ 0 }; i < 16; ++i)
 	{
 		byte x{ static_cast<byte>((minuend & (0b01 << i)) >> i) };
 		byte y{ static_cast<byte>((subtrahend & (0b01 << i)) >> i) };
 
 		// Full Adder.
-		byte sum = carry_bit ^ (x ^ y);
-		carry_bit = (x & y) | (y & carry_bit) | (x & carry_bit);
+		byte sum = carry ^ (x ^ y);
+		carry = (x & y) | (y & carry) | (x & carry);
 		result |= (sum << i);
 	}
 
-	std::cout << "\n\nSubtract bytes:\n";
-	std::cout << std::bitset<8>(minuend) << '\n';
-	std::cout << std::bitset<8>(initial_subtrahend) << " => " << std::bitset<8>(subtrahend) << '\n';
-	std::cout << std::bitset<8>(result) << '\n';
+	return result;
+}
+
 
-	// Set flags.
-	if (use_flags)
+word CPU::subtractWords(word a, byte b) { return subtractWords(a, static_cast<word>(b)); }
+word CPU::subtractWords(byte a, word b) { return subtractWords(static_cast<word>(a), b); }
+word CPU::subtractWords(byte a, byte b) { return subtractWords(static_cast<word>(a), static_cast<word>(b)); }
+
+
+/*
+	Decimal mode addition. Each nibble is a decimal digit (0-9).
+
+	On NMOS chips N, V and Z come from intermediate (partly binary) results and are 
+	not meaningful; the 65C02 sets N and Z from the final BCD result and takes an extra cycle.
+	See http://www.6502.org/tutorials/decimal_mode.html
+*/
+template <typename Variant>
+byte CPU::addDecimal(byte a, byte b)
+{
+	int carry_in{ isFlagSet(C) ? 1 : 0 };
+
+	int lo{ (a & 0x0F) + (b & 0x0F) + carry_in };
+	if (lo > 0x09)
 	{
-		// Overflow check: if MSB of starting values is different from result.
-		bool had_overflow{ (minuend ^ result) & (subtrahend ^ result) & 0b1000'000 };		
-		if (had_overflow)
-		{
-			// Overflow flag - set if there was overflow.
-			setFlag(V, true);			
-			
-			// Carry flag - clear if there was overflow.
-			setFlag(C, false);
-		}
+		lo += 0x06;
+	}
+
+	int hi{ (a >> 4) + (b >> 4) + (lo > 0x0F ? 1 : 0) };
+
+	// NMOS: Z from the binary sum; N and V from the high digit before its decimal adjust.
+	byte binary{ static_cast<byte>(a + b + carry_in) };
+	byte unadjusted{ static_cast<byte>((hi << 4) | (lo & 0x0F)) };
+	setFlag(Z, binary == 0);
+	setFlag(N, (unadjusted & 0b1000'0000) != 0);
+	setFlag(V, ((a ^ unadjusted) & ~(a ^ b) & 0b1000'0000) != 0);
+
+	if (hi > 0x09)
+	{
+		hi += 0x06;
+	}
+	setFlag(C, hi > 0x0F);
 
-		std::cout << "Carry: " << carry_bit << " | Overflow? " << had_overflow << std::endl;
+	byte result{ static_cast<byte>((hi << 4) | (lo & 0x0F)) };
+
+	if constexpr (Variant::decimal_flags_valid)
+	{
+		setFlag(Z, result == 0);
+		setFlag(N, (result & 0b1000'0000) != 0);
+		++cycles;
 	}
 
 	return result;
 }
 
 
-word CPU::subtractWords(word minuend, word subtrahend)
+/*
+	Decimal mode subtraction. The borrow is the inverted carry flag, as in binary mode.
+	C and V are the same as for a binary subtraction.
+*/
+template <typename Variant>
+byte CPU::subtractDecimal(byte minuend, byte subtrahend)
 {
-	// Flip subtrahend with 2's complement so that:
-	//	(minuend -  subtrahend) => (minuend + -subtrahend)
-	//  (minuend - -subtrahend) => (minuend +  subtrahend)
-	//subtrahend = ~(subtrahend - 0b1);
-	// TODO: 
+	int borrow{ isFlagSet(C) ? 0 : 1 };
+	int binary{ minuend - subtrahend - borrow };
 
-	byte carry{ 0x00 };
-	word result{ 0x0000 };
+	setFlag(C, binary >= 0);
+	setFlag(V, ((minuend ^ subtrahend) & (minuend ^ binary) & 0b1000'0000) != 0);
 
-	for (size_t i{ 0 }; i < 16; ++i)
+	byte result;
+	if constexpr (Variant::decimal_flags_valid)
 	{
-		byte x{ static_cast<byte>((minuend & (0b01 << i)) >> i) };
-		byte y{ static_cast<byte>((subtrahend & (0b01 << i)) >> i) };
+		// 65C02: adjust the full result, flags from the BCD result.
+		int lo{ (minuend & 0x0F) - (subtrahend & 0x0F) - borrow };
+		int adjusted{ binary };
+		if (adjusted < 0)
+		{
+			adjusted -= 0x60;
+		}
+		if (lo < 0)
+		{
+			adjusted -= 0x06;
+		}
 
-		// Full Adder.
-		byte sum = carry ^ (x ^ y);
-		carry = (x & y) | (y & carry) | (x & carry);
-		result |= (sum << i);
+		result = static_cast<byte>(adjusted);
+		setFlag(Z, result == 0);
+		setFlag(N, (result & 0b1000'0000) != 0);
+		++cycles;
 	}
+	else
+	{
+		// NMOS: adjust each digit, flags from the binary result.
+		int lo{ (minuend & 0x0F) - (subtrahend & 0x0F) - borrow };
+		int hi{ (minuend >> 4) - (subtrahend >> 4) };
+		if (lo < 0)
+		{
+			lo -= 0x06;
+			--hi;
+		}
+		if (hi < 0)
+		{
+			hi -= 0x06;
+		}
 
-	std::cout << "Subtract word/word: (bits) " << std::bitset<16>(result) << " | (hex) " << std::hex << (int)result << std::endl;
+		result = static_cast<byte>((hi << 4) | (lo & 0x0F));
+		setFlag(Z, static_cast<byte>(binary) == 0);
+		setFlag(N, (binary & 0b1000'0000) != 0);
+	}
 
 	return result;
 }
-
-
-word CPU::subtractWords(word a, byte b) { return subtractWords(a, static_cast<word>(b)); }
-word CPU::subtractWords(byte a, word b) { return subtractWords(static_cast<word>(a), b); }
-word CPU::subtractWords(byte a, byte b) { return subtractWords(static_cast<word>(a), static_cast<word>(b)); }
 #pragma endregion
 
 
@@ -1211,23 +1861,6 @@ word CPU::subtractWords(byte a, byte b) { return subtractWords(static_cast<word>
 #pragma region PROCESSOR_FLAGS
 
 
-void CPU::setZeroAndNegativeFlags(byte data)
-{
-	//setFlag(Z, data == 0);
-	//setFlag(N, data & 0b1000'0000);
-
-	if (data == 0) 
-	{
-		setFlag(Z, true);
-	}
-
-	if ((data & 0b1000'0000) != 0) 
-	{
-		setFlag(N, true);
-	}
-}
-
-
 void CPU::setFlag(byte flag_idx, bool value)
 {
 	processor_status = (value ? processor_status | (1 << flag_idx) : processor_status & ~(1 << flag_idx));
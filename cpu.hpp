@@ -1,13 +1,16 @@
 #pragma once
 
-#include <iostream>
-
 #include <vector>
 #include <array>
-#include <bitset>
 
-using byte = uint8_t;
-using word = uint16_t;
+#include "types.hpp"
+#include "bus.hpp"
+#include "cpu_variants.hpp"
+#include "return_stack.hpp"
+#include "instruction_handlers.hpp"
+
+class TraceHook;
+class RecompiledModule;
 
 
 class CPU
@@ -19,22 +22,209 @@ public:
 
 	void loadROM(std::vector<byte>& rom);	
 
+	/// <summary>
+	/// Executes instructions until the program counter reaches $FFFF, or until the next
+	/// instruction is a BRK and the IRQ/BRK vector ($FFFE) is not set.
+	/// </summary>
 	void run();
 
+	/// <summary>
+	/// Executes a single instruction.
+	/// </summary>
+	void step();
+
+	/// <summary>
+	/// Executes instructions until the cycle counter reaches the given cycle.
+	/// The last instruction may overshoot it by a few cycles.
+	/// The given cycle is the next event: idle loops are fast-forwarded up to it (see setIdleLoopSkipping()).
+	/// </summary>
+	void runUntil(uint64_t cycle);
+
+	/// <summary>
+	/// Idle-loop skipping (on by default). When a backward branch or jump returns to the
+	/// same registers without anything having changed on the bus, every further iteration
+	/// of the loop is identical, so runUntil() adds whole iterations to the cycle counter
+	/// instead of executing them. The result is the same as stepping through the loop.
+	/// Disabled while a trace hook is attached.
+	/// </summary>
+	void setIdleLoopSkipping(bool enabled);
+
+	/// <summary>
+	/// Total cycles skipped by idle-loop skipping since construction.
+	/// </summary>
+	uint64_t getIdleCyclesSkipped() const;
+
+	/// <summary>
+	/// Selects which chip is emulated (Ricoh 2A03 by default). 
+	/// Each variant has its own instantiation of the dispatch loop.
+	/// </summary>
+	void setVariant(CPUVariant variant);
+	CPUVariant getVariant() const;
+
+	/// <summary>
+	/// Selects the accuracy tier (instruction-level by default, see cpu_variants.hpp).
+	/// Each tier has its own instantiation of the dispatch loop. Recompiled code
+	/// (see setRecompiledModule()) only runs in the instruction-level tier.
+	/// </summary>
+	void setAccuracy(CPUAccuracy accuracy);
+	CPUAccuracy getAccuracy() const;
+
+	Bus& getBus();
+	const Bus& getBus() const;
+
+	/// <summary>
+	/// Snapshot of the programmer-visible registers.
+	/// </summary>
+	struct Registers
+	{
+		word program_counter;
+		byte stack_pointer;
+		byte reg_accumulator;
+		byte reg_x;
+		byte reg_y;
+		byte processor_status;
+	};
+
+	Registers getRegisters() const;
+	void setRegisters(const Registers& registers);
+
+	/// <summary>
+	/// Address the next push would write to. The stack always lives in page $01.
+	/// </summary>
+	word getStackAddress() const;
+
+	/// <summary>
+	/// Non-maskable interrupt (the PPU's vblank signal): pushes the program counter and
+	/// the status, and continues at the address stored at $FFFA/$FFFB. Takes 7 cycles.
+	/// </summary>
+	void nmi();
+
+	/// <summary>
+	/// Shadow return stack: the calls and interrupts not yet returned from, innermost first,
+	/// and how well they predicted the returns (see return_stack.hpp). A profiler can sample
+	/// it for the current call path. Cleared whenever the registers are replaced.
+	/// </summary>
+	const ReturnStack& getReturnStack() const;
+
+	/// <summary>
+	/// Complete machine state as seen from the CPU. Plain data with a fixed size.
+	/// </summary>
+	struct State
+	{
+		Registers registers;
+		uint64_t cycles;
+		Bus::State bus;
+	};
+
+	void saveState(State& state) const;
+	void loadState(const State& state);
+
+	/// <summary>
+	/// Copy-on-write copy of the complete state (see Bus::Fork).
+	/// </summary>
+	struct Fork
+	{
+		Registers registers;
+		uint64_t cycles;
+		Bus::Fork bus;
+	};
+
+	void fork(Fork& child) const;
+	void loadFork(const Fork& fork);
+
+	/// <summary>
+	/// Number of CPU cycles executed since reset.
+	/// </summary>
+	uint64_t getCycles() const;
+
+	/// <summary>
+	/// Reports every instruction to the hook before it executes. Pass nullptr to stop tracing.
+	/// The hook is not owned by the CPU.
+	/// </summary>
+	void setTraceHook(TraceHook* hook);
+	TraceHook* getTraceHook() const;
+
+	/// <summary>
+	/// Runs statically recompiled code (see recompiler.hpp) in runUntil() wherever the module
+	/// has a block for the program counter, and interprets the rest. Only used by the 2A03 variant
+	/// and while no trace hook is attached. Pass nullptr to detach; the module is not owned by the CPU.
+	/// </summary>
+	/// <returns>False (and detached) if the module was not compiled from the ROM on the bus.</returns>
+	bool setRecompiledModule(const RecompiledModule* module);
+
 private:
 	/// <summary>
-	/// Bitwise addition returning a byte. Overflow does not create a word!
+	/// Dispatch loop, instantiated per variant and accuracy policy (see cpu_variants.hpp).
+	/// </summary>
+	template <typename Variant, typename Accuracy> void stepVariant();
+	template <typename Variant, typename Accuracy> void runUntilVariant(uint64_t cycle);
+	template <typename Variant, typename Accuracy> void bindVariant();
+
+	/// <summary>
+	/// Binds the dispatch loop of the selected variant and accuracy tier.
+	/// </summary>
+	void bind();
+
+	/// <summary>
+	/// Runs the recompiled block at program_counter, if there is one.
+	/// </summary>
+	/// <returns>False if the instruction has to be interpreted.</returns>
+	bool runRecompiled(uint64_t cycle);
+
+	/// <summary>
+	/// Passes the instruction at program_counter to the trace hook.
+	/// </summary>
+	void traceInstruction();
+
+	/// <summary>
+	/// Called by runUntil() after a backward branch or jump. If the machine is back in the
+	/// state of the previous backward jump (same registers, no bus changes), skips as many
+	/// whole loop iterations as fit before the next event.
+	/// </summary>
+	/// <param name="next_event">Cycle at which something outside the loop can happen.</param>
+	void skipIdleLoop(uint64_t next_event);
+
+	/// <summary>
+	/// Takes a branch: adds the signed displacement to the program counter
+	/// and charges the extra cycle(s) for a taken branch.
+	/// </summary>
+	/// <param name="offset">Relative displacement (two's complement).</param>
+	void branch(byte offset);
+
+	/// <summary>
+	/// Writes a byte to the stack and decrements the stack pointer.
+	/// </summary>
+	void push(byte data);
+
+	/// <summary>
+	/// Increments the stack pointer and reads the byte there.
+	/// </summary>
+	byte pull();
+
+	/// <summary>
+	/// Interrupt sequence shared by BRK and NMI: pushes the return address and the status,
+	/// sets I and continues at the address stored at the vector.
+	/// </summary>
+	/// <param name="return_address">Where RTI continues.</param>
+	/// <param name="status">Status as pushed (B set by BRK only).</param>
+	/// <param name="vector">Address of the handler's address.</param>
+	void interrupt(word return_address, byte status, word vector);
+
+	/// <summary>
+	/// Store through the bus. A store to $4014 starts OAM DMA; the CPU is halted for it
+	/// once the instruction completes.
+	/// </summary>
+	void write(word address, byte data);
+
+	/// <summary>
+	/// Bitwise addition returning a byte, for address arithmetic. Overflow does not create a word!
 	/// (i.e., 0xFF + 0x02 = 0x01)
+	/// ADC and SBC add with flags in InstructionHandlers.
 	/// </summary>
 	/// <param name="a">First addend.</param>
 	/// <param name="b">Second addend.</param>
-	/// <param name="use_carry">
-	/// Should method use flags? 
-	/// If true, the carry flag will be used to get and store the C-IN and C-OUT values; 
-	/// and the overflow flag will be set at the end of calculation if overflow occurred.
-	/// </param>
 	/// <returns>Sum of binary addition.</returns>
-	byte addBytes(byte a, byte b, bool use_carry_flag);
+	byte addBytes(byte a, byte b);
 
 	/// <summary>
 	/// Bitwise addtion returning a word.
@@ -47,17 +237,6 @@ private:
 	word addWords(byte a, word b);
 	word addWords(byte a, byte b);
 
-	/// <summary>
-	/// Bitwise subtraction returning a byte.
-	/// </summary>
-	/// <param name="a">Minuend.</param>
-	/// <param name="b">Subtrahend.</param>
-	/// <param name="use_carry">
-	/// Should method use flags?
-	/// </param>
-	/// <returns>Difference of binary subtraction.</returns>
-	byte subtractBytes(byte a, byte b, bool use_carry_flag);
-
 	/// <summary>
 	/// Bitwise subtraction returning a word.
 	/// </summary>
@@ -69,6 +248,14 @@ private:
 	word subtractWords(byte a, word b);
 	word subtractWords(byte a, byte b);
 
+	/// <summary>
+	/// Decimal mode (BCD) addition and subtraction for ADC/SBC when the D flag is set.
+	/// Use and update the carry flag, and set N, V and Z like the given variant.
+	/// </summary>
+	/// <returns>BCD result.</returns>
+	template <typename Variant> byte addDecimal(byte a, byte b);
+	template <typename Variant> byte subtractDecimal(byte minuend, byte subtrahend);
+
 	// Processor status bit indices.
 	enum : byte {
 		C = 0,
@@ -87,9 +274,11 @@ private:
 	/// <param name="flag">Bitflag index to toggle.</param>
 	/// <param name="value">Should flag be turned on or off?</param>
 	void setFlag(byte flag_idx, bool value);
-	void setZeroAndNegativeFlags(byte data);
 	bool isFlagSet(byte flag_idx) const;
 
+	// The handlers' bodies, shared with recompiled code (see instruction_handlers.hpp).
+	friend class InstructionHandlers<CPU>;
+
 
 	/// <summary>
 	/// All instructions.
@@ -97,49 +286,55 @@ private:
 	/// <param name="data">
 	/// The data from memory to act upon.
 	/// Parameter is omitted if instruction is implied.
+	/// Read-modify-write instructions take a reference (see modify()); 
+	/// stores take the address to write to.
 	/// </param>
-	void doADC(byte& data);
-	void doAND(byte& data);
+	template <typename Variant> void doADC(byte data);
+	void doAND(byte data);
 	void doASL(byte& data);
-	void doBCC(byte& data);
-	void doBCS(byte& data);
-	void doBEQ(byte& data);
-	void doBIT(byte& data);
-	void doBMI(byte& data);
-	void doBNE(byte& data);
-	void doBPL(byte& data);
+	void doBCC(byte data);
+	void doBCS(byte data);
+	void doBEQ(byte data);
+	void doBIT(byte data);
+	void doBMI(byte data);
+	void doBNE(byte data);
+	void doBPL(byte data);
 	void doBRK();
-	void doBVC(byte& data);
-	void doBVS(byte& data);
+	void doBVC(byte data);
+	void doBVS(byte data);
 	void doCLC();
 	void doCLD();
 	void doCLI();
 	void doCLV();
-	void doCMP(byte& data);
-	void doCMX(byte& data);
-	void doCMY(byte& data);
+	void doCMP(byte data);
+	void doCMX(byte data);
+	void doCMY(byte data);
 	void doDEC(byte& data);
 	void doDEX();
 	void doDEY();
-	void doEOR(byte& data);
+	void doEOR(byte data);
 	void doINC(byte& data);
 	void doINX();
 	void doINY();
 	void doJMP(word address);
-	void doLDA(byte& data);
-	void doLDX(byte& data);
-	void doLDY(byte& data);
+	void doJSR(word address);
+	void doLDA(byte data);
+	void doLDX(byte data);
+	void doLDY(byte data);
 	void doLSR(byte& data);
-	void doORA(byte& data);
-	// TODO: PHA
-	// TODO: PHP
-	// TODO: PLA
-	// TODO: PLP	
+	void doORA(byte data);
+	void doPHA();
+	void doPHP();
+	void doPLA();
+	void doPLP();
 	void doROL(byte& data);
 	void doROR(byte& data);
-	// TODO: RTI
-	// TODO: RTS
-	void doSBC(byte& data);
+	void doRTI();
+	void doRTS();
+	template <typename Variant> void doSBC(byte data);
+	void doSTA(word address);
+	void doSTX(word address);
+	void doSTY(word address);
 
 
 
@@ -151,33 +346,58 @@ private:
 	/// <returns>Address of data in memory.</returns>
 	word getAddr_Immediate();
 	word getAddr_ZeroPage();
-	word getAddr_ZeroPageX();
-	word getAddr_ZeroPageY();
+	template <typename Variant, typename Accuracy> word getAddr_ZeroPageX();
+	template <typename Variant, typename Accuracy> word getAddr_ZeroPageY();
 	word getAddr_Absolute();
-	word getAddr_AbsoluteX();
-	word getAddr_AbsoluteY();
-	word getAddr_IndirectX();
-	word getAddr_IndirectY();
-	word getAddr_Indirect();
+	template <typename Variant, typename Accuracy> word getAddr_AbsoluteX();
+	template <typename Variant, typename Accuracy> word getAddr_AbsoluteY();
+	template <typename Variant, typename Accuracy> word getAddr_IndirectX();
+	template <typename Variant, typename Accuracy> word getAddr_IndirectY();
+	template <typename Variant> word getAddr_Indirect();
+
+	/// <summary>
+	/// Indexed addressing helpers.
+	/// indexAddress() adds the index and sets page_crossed and uncorrected_address;
+	/// readPointer() fetches a pointer from the zero page (wrapping within it).
+	/// </summary>
+	word indexAddress(word base, byte index);
+	word readPointer(byte address);
+
+	/// <summary>
+	/// The read an indexed addressing mode makes while it fixes up the address (bus-exact tier only).
+	/// NMOS chips read the given address; the 65C02 rereads the last operand byte.
+	/// </summary>
+	template <typename Variant, typename Accuracy> void dummyRead(word address);
 
 
 	/// <summary>
 	/// Addressing Mode helpers. 
 	/// Fetches the data from memory to simplify instuction code.
 	/// </summary>
-	/// <returns>Reference to the data in memory.</returns>
-	byte& get_Immediate();
-	byte& get_ZeroPage();
-	byte& get_ZeroPageX();
-	byte& get_ZeroPageY();
-	byte& get_Absolute();
-	byte& get_AbsoluteX();
-	byte& get_AbsoluteY();
-	byte& get_IndirectX();
-	byte& get_IndirectY();
-	byte& get_Indirect();
+	/// <returns>The data read through the bus.</returns>
+	byte get_Immediate();
+	byte get_ZeroPage();
+	template <typename Variant, typename Accuracy> byte get_ZeroPageX();
+	template <typename Variant, typename Accuracy> byte get_ZeroPageY();
+	byte get_Absolute();
+	template <typename Variant, typename Accuracy> byte get_AbsoluteX();
+	template <typename Variant, typename Accuracy> byte get_AbsoluteY();
+	template <typename Variant, typename Accuracy> byte get_IndirectX();
+	template <typename Variant, typename Accuracy> byte get_IndirectY();
+	template <typename Variant> byte get_Indirect();
+
+	/// <returns>Reference to the accumulator, for read-modify-write instructions.</returns>
 	byte& get_Accumulator();
 
+	/// <summary>
+	/// Read-modify-write helper: reads the data at address through the bus,
+	/// applies the instruction to it and writes the result back through the bus.
+	/// The bus-exact tier adds the chip's dummy access in between.
+	/// </summary>
+	/// <param name="address">Effective address of the operand.</param>
+	/// <param name="instruction">One of the read-modify-write instructions (e.g. &CPU::doASL).</param>
+	template <typename Variant, typename Accuracy> void modify(word address, void (CPU::*instruction)(byte&));
+
 
 	// Properties.
 	word program_counter{ 0x00 };
@@ -187,5 +407,54 @@ private:
 	byte reg_y{ 0x00 };
 	byte processor_status{ 0b0000'0000 };
 
-	std::vector<byte> memory;
+	uint64_t cycles{ 0 };
+
+	// Set by the indexed addressing modes when the effective address lands on another page,
+	// and the address before the carry into the high byte.
+	bool page_crossed{ false };
+	word uncorrected_address{ 0x00 };
+
+	// Set by write() when the instruction started OAM DMA.
+	bool oam_dma_started{ false };
+
+	TraceHook* trace_hook{ nullptr };
+	const RecompiledModule* recompiled_module{ nullptr };
+
+	// Idle-loop detection. backward_jump is set by branches/JMP to a lower address.
+	struct IdleLoop
+	{
+		Registers registers;
+		uint64_t cycles;
+		uint64_t bus_changes;
+		bool valid;
+	};
+
+	bool idle_loop_skipping{ true };
+	bool backward_jump{ false };
+	IdleLoop idle_loop{};
+	uint64_t idle_cycles_skipped{ 0 };
+
+	ReturnStack return_stack;
+
+	CPUVariant variant{ CPUVariant::Ricoh2A03 };
+	CPUAccuracy accuracy{ CPUAccuracy::Instruction };
+	void (CPU::*step_function)(){ nullptr };
+	void (CPU::*run_until_function)(uint64_t){ nullptr };
+
+	Bus bus;
+};
+
+
+/// <summary>
+/// Receives every instruction before it executes. See CPU::setTraceHook().
+/// </summary>
+class TraceHook
+{
+public:
+	virtual ~TraceHook() = default;
+
+	/// <param name="registers">Register state before the instruction executes.</param>
+	/// <param name="instruction">Opcode followed by its operand bytes (always 3 bytes).</param>
+	/// <param name="cycles">CPU cycle count before the instruction executes.</param>
+	virtual void onInstruction(const CPU::Registers& registers, const byte* instruction, uint64_t cycles) = 0;
 };
\ No newline at end of file
@@ -0,0 +1,116 @@
+#pragma once
+
+#include "types.hpp"
+
+
+/*
+	CPU variant policies.
+
+	The dispatch loop is instantiated once per policy (see CPU::setVariant), so every 
+	difference between the chips is resolved at compile time with 'if constexpr'.
+*/
+
+
+/// <summary>
+/// Variants selectable at load time.
+/// </summary>
+enum class CPUVariant : byte
+{
+	Ricoh2A03,
+	NMOS6502,
+	WDC65C02,
+};
+
+
+/// <summary>
+/// The NES CPU: an NMOS 6502 core with the decimal mode circuitry removed.
+/// The D flag can be set and cleared but ADC/SBC always work in binary.
+/// </summary>
+struct Ricoh2A03
+{
+	static constexpr CPUVariant variant{ CPUVariant::Ricoh2A03 };
+	static constexpr bool has_decimal_mode{ false };
+
+	// Decimal ADC/SBC set N and Z from the BCD result (and take an extra cycle).
+	static constexpr bool decimal_flags_valid{ false };
+
+	// JMP ($xxFF) reads the high byte from $xx00.
+	static constexpr bool indirect_jump_wraps_page{ true };
+
+	// Dummy accesses (bus-exact tier): indexing reads the address before the page carry is
+	// fixed, and read-modify-write instructions write the unmodified value back first.
+	static constexpr bool nmos_dummy_accesses{ true };
+};
+
+
+/// <summary>
+/// Original NMOS 6502, with decimal mode.
+/// </summary>
+struct NMOS6502
+{
+	static constexpr CPUVariant variant{ CPUVariant::NMOS6502 };
+	static constexpr bool has_decimal_mode{ true };
+	static constexpr bool decimal_flags_valid{ false };
+	static constexpr bool indirect_jump_wraps_page{ true };
+	static constexpr bool nmos_dummy_accesses{ true };
+};
+
+
+/// <summary>
+/// CMOS 65C02. Fixes the JMP ($xxFF) bug (at the cost of an extra cycle)
+/// and sets valid N and Z flags in decimal mode.
+/// </summary>
+struct WDC65C02
+{
+	static constexpr CPUVariant variant{ CPUVariant::WDC65C02 };
+	static constexpr bool has_decimal_mode{ true };
+	static constexpr bool decimal_flags_valid{ true };
+	static constexpr bool indirect_jump_wraps_page{ false };
+
+	// Rereads the last operand byte while indexing, and reads twice instead of writing twice.
+	static constexpr bool nmos_dummy_accesses{ false };
+};
+
+
+
+/*
+	CPU accuracy policies.
+
+	Orthogonal to the variant: the dispatch loop is instantiated for every variant and tier.
+*/
+
+
+/// <summary>
+/// Tiers selectable at load time (see CPU::setAccuracy).
+/// </summary>
+enum class CPUAccuracy : byte
+{
+	Instruction,
+	BusExact,
+};
+
+
+/// <summary>
+/// Registers, memory and cycle counts are exact after every instruction, but only the bus
+/// accesses that carry data are made. The fastest core.
+/// </summary>
+struct InstructionAccurate
+{
+	static constexpr CPUAccuracy accuracy{ CPUAccuracy::Instruction };
+	static constexpr bool dummy_accesses{ false };
+};
+
+
+/// <summary>
+/// Also makes the chip's dummy data accesses, in bus order: the read while an indexed address
+/// is fixed up (on a page cross for loads, always for stores and read-modify-writes, always
+/// for zero page indexing) and the extra access of read-modify-write instructions. These are
+/// visible to registers with read or write side effects ($2002, $2007, $4016...).
+/// Dummy reads of the instruction stream (implied operands, taken branches) are not made:
+/// they read program memory, which has no side effects.
+/// </summary>
+struct BusExact
+{
+	static constexpr CPUAccuracy accuracy{ CPUAccuracy::BusExact };
+	static constexpr bool dummy_accesses{ true };
+};
@@ -0,0 +1,134 @@
+#include "disassembler.hpp"
+#include "opcodes.hpp"
+
+
+namespace
+{
+	constexpr char hex_digits[]{ "0123456789ABCDEF" };
+
+
+	char* writeText(char* out, const char* text)
+	{
+		while (*text != '\0')
+		{
+			*out++ = *text++;
+		}
+
+		return out;
+	}
+}
+
+
+size_t Disassembler::format(char* out, word address, const byte* instruction)
+{
+	const OpcodeInfo& info{ opcode_table[instruction[0]] };
+
+	char* cursor{ out };
+	cursor = writeText(cursor, info.mnemonic);
+
+	byte lo{ instruction[1] };
+	word absolute{ static_cast<word>((instruction[2] << 8) | lo) };
+
+	switch (info.mode)
+	{
+		case AddressingMode::Implied:
+			break;
+
+		case AddressingMode::Accumulator:
+			cursor = writeText(cursor, " A");
+			break;
+
+		case AddressingMode::Immediate:
+			cursor = writeText(cursor, " #$");
+			cursor = writeHex8(cursor, lo);
+			break;
+
+		case AddressingMode::ZeroPage:
+			cursor = writeText(cursor, " $");
+			cursor = writeHex8(cursor, lo);
+			break;
+
+		case AddressingMode::ZeroPageX:
+			cursor = writeText(cursor, " $");
+			cursor = writeHex8(cursor, lo);
+			cursor = writeText(cursor, ",X");
+			break;
+
+		case AddressingMode::ZeroPageY:
+			cursor = writeText(cursor, " $");
+			cursor = writeHex8(cursor, lo);
+			cursor = writeText(cursor, ",Y");
+			break;
+
+		case AddressingMode::Relative:
+		{
+			// Offset is signed and relative to the instruction that follows the branch.
+			word destination{ static_cast<word>(address + 2 + static_cast<int8_t>(lo)) };
+			cursor = writeText(cursor, " $");
+			cursor = writeHex16(cursor, destination);
+			break;
+		}
+
+		case AddressingMode::Absolute:
+			cursor = writeText(cursor, " $");
+			cursor = writeHex16(cursor, absolute);
+			break;
+
+		case AddressingMode::AbsoluteX:
+			cursor = writeText(cursor, " $");
+			cursor = writeHex16(cursor, absolute);
+			cursor = writeText(cursor, ",X");
+			break;
+
+		case AddressingMode::AbsoluteY:
+			cursor = writeText(cursor, " $");
+			cursor = writeHex16(cursor, absolute);
+			cursor = writeText(cursor, ",Y");
+			break;
+
+		case AddressingMode::Indirect:
+			cursor = writeText(cursor, " ($");
+			cursor = writeHex16(cursor, absolute);
+			cursor = writeText(cursor, ")");
+			break;
+
+		case AddressingMode::IndirectX:
+			cursor = writeText(cursor, " ($");
+			cursor = writeHex8(cursor, lo);
+			cursor = writeText(cursor, ",X)");
+			break;
+
+		case AddressingMode::IndirectY:
+			cursor = writeText(cursor, " ($");
+			cursor = writeHex8(cursor, lo);
+			cursor = writeText(cursor, "),Y");
+			break;
+	}
+
+	return static_cast<size_t>(cursor - out);
+}
+
+
+std::string Disassembler::disassemble(word address, const byte* instruction)
+{
+	char buffer[max_length];
+	size_t length{ format(buffer, address, instruction) };
+
+	return std::string(buffer, length);
+}
+
+
+char* Disassembler::writeHex8(char* out, byte value)
+{
+	out[0] = hex_digits[value >> 4];
+	out[1] = hex_digits[value & 0x0F];
+
+	return out + 2;
+}
+
+
+char* Disassembler::writeHex16(char* out, word value)
+{
+	out = writeHex8(out, static_cast<byte>(value >> 8));
+	return writeHex8(out, static_cast<byte>(value & 0xFF));
+}
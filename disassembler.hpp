@@ -0,0 +1,40 @@
+#pragma once
+
+#include <string>
+
+#include "types.hpp"
+
+
+class Disassembler
+{
+public:
+	/// <summary>
+	/// Longest text format() can produce (e.g., "JMP ($ABCD)").
+	/// </summary>
+	static constexpr size_t max_length{ 16 };
+
+	/// <summary>
+	/// Writes the mnemonic and operand of an instruction into a buffer.
+	/// Uses the same opcode table as the dispatch loop.
+	/// No terminating null is written.
+	/// </summary>
+	/// <param name="out">Buffer with room for at least max_length characters.</param>
+	/// <param name="address">Address of the opcode (needed to resolve branch targets).</param>
+	/// <param name="instruction">Opcode followed by its operand bytes.</param>
+	/// <returns>Number of characters written.</returns>
+	static size_t format(char* out, word address, const byte* instruction);
+
+	/// <summary>
+	/// Convenience wrapper around format() for tools and debugging.
+	/// </summary>
+	static std::string disassemble(word address, const byte* instruction);
+
+	/// <summary>
+	/// Hex formatting helpers. Write uppercase digits and return the new end of the buffer.
+	/// </summary>
+	static char* writeHex8(char* out, byte value);
+	static char* writeHex16(char* out, word value);
+
+private:
+	Disassembler() = delete;
+};
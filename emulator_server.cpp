@@ -0,0 +1,684 @@
+#include "emulator_server.hpp"
+#include "cartridge.hpp"
+
+#include <algorithm>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <stdexcept>
+
+#if defined(__linux__)
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+
+using namespace ServerProtocol;
+
+
+namespace
+{
+	// epoll user data of the two descriptors that are not connections.
+	constexpr uint64_t listener_id{ 0 };
+	constexpr uint64_t event_id{ ~uint64_t{ 0 } };
+
+	constexpr size_t read_chunk_size{ 64 * 1024 };
+
+
+	template <typename T>
+	T readValue(const std::vector<byte>& payload, size_t offset)
+	{
+		T value;
+		std::memcpy(&value, payload.data() + offset, sizeof(T));
+		return value;
+	}
+
+
+	template <typename T>
+	void appendValue(std::vector<byte>& out, T value)
+	{
+		const byte* bytes{ reinterpret_cast<const byte*>(&value) };
+		out.insert(out.end(), bytes, bytes + sizeof(T));
+	}
+
+
+	std::vector<byte> makeResponse(const RequestHeader& request, Status status, const std::vector<byte>& payload = {})
+	{
+		ResponseHeader header{};
+		header.size = static_cast<uint32_t>(payload.size());
+		header.tag = request.tag;
+		header.session = request.session;
+		header.status = status;
+
+		std::vector<byte> response(sizeof(header) + payload.size());
+		std::memcpy(response.data(), &header, sizeof(header));
+		std::copy(payload.begin(), payload.end(), response.begin() + sizeof(header));
+		return response;
+	}
+
+
+	EmulatorServer* signal_server{ nullptr };
+
+	void stopOnSignal(int)
+	{
+		if (signal_server != nullptr)
+		{
+			signal_server->stop();
+		}
+	}
+}
+
+
+EmulatorServer::EmulatorServer(const std::string& socket_path, unsigned workers)
+	: socket_path{ socket_path }
+{
+	for (unsigned i{ 0 }; i < std::max(workers, 1u); ++i)
+	{
+		this->workers.push_back(std::make_unique<Worker>());
+	}
+
+	// Created first thing, so stop() works before run() has set up the rest.
+#if defined(__linux__)
+	event = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+#endif
+
+	for (std::unique_ptr<Worker>& worker : this->workers)
+	{
+		worker->thread = std::thread{ &EmulatorServer::workerLoop, this, std::ref(*worker) };
+	}
+}
+
+
+EmulatorServer::~EmulatorServer()
+{
+	stopping.store(true);
+
+	for (std::unique_ptr<Worker>& worker : workers)
+	{
+		{
+			std::lock_guard<std::mutex> lock{ worker->mutex };
+		}
+		worker->wake.notify_one();
+		worker->thread.join();
+	}
+
+#if defined(__linux__)
+	for (auto& [id, connection] : connections)
+	{
+		close(connection.socket);
+	}
+
+	for (int descriptor : { listener, epoll, event })
+	{
+		if (descriptor >= 0)
+		{
+			close(descriptor);
+		}
+	}
+
+	if (listener >= 0)
+	{
+		unlink(socket_path.c_str());
+	}
+#endif
+}
+
+
+#pragma region Workers
+void EmulatorServer::workerLoop(Worker& worker)
+{
+	for (;;)
+	{
+		std::deque<Job> jobs;
+		{
+			std::unique_lock<std::mutex> lock{ worker.mutex };
+			worker.wake.wait(lock, [&] { return !worker.jobs.empty() || stopping.load(); });
+
+			if (worker.jobs.empty())
+			{
+				return;
+			}
+
+			jobs.swap(worker.jobs);
+		}
+
+		// A batch of requests is answered in one hand-over, and one wake-up of the loop.
+		std::vector<Completion> done;
+		for (const Job& job : jobs)
+		{
+			done.push_back(Completion{ job.connection, execute(worker, job) });
+		}
+
+		{
+			std::lock_guard<std::mutex> lock{ completion_mutex };
+			for (Completion& completion : done)
+			{
+				completions.push_back(std::move(completion));
+			}
+		}
+
+#if defined(__linux__)
+		uint64_t one{ 1 };
+		(void)!write(event, &one, sizeof(one));
+#endif
+	}
+}
+
+
+std::vector<byte> EmulatorServer::execute(Worker& worker, const Job& job)
+{
+	const RequestHeader& request{ job.header };
+	const std::vector<byte>& payload{ job.payload };
+
+	if (request.command == Command::Create)
+	{
+		// Allocated by the worker's thread, so the console's memory is local to it.
+		worker.sessions[request.session] = std::make_unique<Session>();
+
+		std::vector<byte> out;
+		appendValue<uint32_t>(out, request.session);
+		return makeResponse(request, Status::Ok, out);
+	}
+
+	auto found{ worker.sessions.find(request.session) };
+	if (found == worker.sessions.end())
+	{
+		return makeResponse(request, Status::UnknownSession);
+	}
+
+	Session& session{ *found->second };
+	NES& nes{ session.nes };
+
+	// Everything but loading needs a cartridge.
+	bool needs_rom{ request.command != Command::Destroy && request.command != Command::LoadROM };
+	if (needs_rom && !session.loaded)
+	{
+		return makeResponse(request, Status::BadRequest);
+	}
+
+	try
+	{
+		std::vector<byte> out;
+
+		switch (request.command)
+		{
+			case Command::Destroy:
+				worker.sessions.erase(found);
+				break;
+
+			case Command::LoadROM:
+				nes.loadCartridge(Cartridge{ payload });
+				nes.power();
+				session.saves.clear();
+				session.loaded = true;
+				break;
+
+			case Command::Power:
+				nes.power();
+				break;
+
+			case Command::Reset:
+				nes.reset();
+				break;
+
+			case Command::SetInput:
+				if (payload.size() < 2)
+				{
+					return makeResponse(request, Status::BadRequest);
+				}
+				nes.setInput(payload[0], payload[1]);
+				break;
+
+			case Command::StepFrames:
+			{
+				if (payload.size() < 5)
+				{
+					return makeResponse(request, Status::BadRequest);
+				}
+
+				uint32_t frames{ readValue<uint32_t>(payload, 0) };
+				bool render{ payload[4] != 0 };
+				for (uint32_t frame{ 0 }; frame < frames; ++frame)
+				{
+					// Only the last frame can be looked at.
+					nes.runFrame(render && frame + 1 == frames);
+				}
+
+				appendValue<uint64_t>(out, nes.getFrame());
+				appendValue<uint64_t>(out, nes.getStateHash());
+				break;
+			}
+
+			case Command::ReadMemory:
+			{
+				if (payload.size() < 4)
+				{
+					return makeResponse(request, Status::BadRequest);
+				}
+
+				word address{ readValue<word>(payload, 0) };
+				word length{ readValue<word>(payload, 2) };
+				const Bus& bus{ nes.getCPU().getBus() };
+				for (uint32_t i{ 0 }; i < length; ++i)
+				{
+					out.push_back(bus.peek(static_cast<word>(address + i)));
+				}
+				break;
+			}
+
+			case Command::Save:
+			case Command::Restore:
+			{
+				if (payload.size() < 4)
+				{
+					return makeResponse(request, Status::BadRequest);
+				}
+
+				uint32_t slot{ readValue<uint32_t>(payload, 0) };
+				if (request.command == Command::Save)
+				{
+					std::unique_ptr<NES::Fork>& save{ session.saves[slot] };
+					if (save == nullptr)
+					{
+						save = std::make_unique<NES::Fork>();
+					}
+					nes.fork(*save);
+				}
+				else
+				{
+					auto save{ session.saves.find(slot) };
+					if (save == session.saves.end())
+					{
+						return makeResponse(request, Status::BadRequest);
+					}
+					nes.loadFork(*save->second);
+				}
+				break;
+			}
+
+			case Command::GetInfo:
+				appendValue<uint64_t>(out, nes.getFrame());
+				appendValue<uint64_t>(out, nes.getStateHash());
+				appendValue<uint64_t>(out, nes.getCPU().getCycles());
+				break;
+
+			default:
+				return makeResponse(request, Status::UnknownCommand);
+		}
+
+		return makeResponse(request, Status::Ok, out);
+	}
+	catch (const std::exception& e)
+	{
+		std::string message{ e.what() };
+		return makeResponse(request, Status::Failed, std::vector<byte>(message.begin(), message.end()));
+	}
+}
+#pragma endregion
+
+
+#if defined(__linux__)
+#pragma region Event loop
+void EmulatorServer::run()
+{
+	sockaddr_un address{};
+	address.sun_family = AF_UNIX;
+	if (socket_path.size() >= sizeof(address.sun_path))
+	{
+		throw std::runtime_error("EmulatorServer: socket path too long: " + socket_path);
+	}
+	std::memcpy(address.sun_path, socket_path.c_str(), socket_path.size() + 1);
+
+	listener = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	unlink(socket_path.c_str());
+
+	if (listener < 0 || bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(listener, SOMAXCONN) != 0)
+	{
+		throw std::runtime_error("EmulatorServer: could not listen on " + socket_path);
+	}
+
+	epoll = epoll_create1(EPOLL_CLOEXEC);
+
+	epoll_event listener_event{ EPOLLIN, { .u64 = listener_id } };
+	epoll_event wake_event{ EPOLLIN, { .u64 = event_id } };
+	if (epoll < 0 || event < 0 || epoll_ctl(epoll, EPOLL_CTL_ADD, listener, &listener_event) != 0
+		|| epoll_ctl(epoll, EPOLL_CTL_ADD, event, &wake_event) != 0)
+	{
+		throw std::runtime_error("EmulatorServer: could not set up epoll");
+	}
+
+	epoll_event events[64];
+	while (!stopping.load())
+	{
+		int count{ epoll_wait(epoll, events, 64, -1) };
+
+		for (int i{ 0 }; i < count; ++i)
+		{
+			uint64_t id{ events[i].data.u64 };
+
+			if (id == listener_id)
+			{
+				acceptConnections();
+			}
+			else if (id == event_id)
+			{
+				uint64_t value;
+				(void)!read(event, &value, sizeof(value));
+				collectCompletions();
+			}
+			else if (connections.count(id) != 0)
+			{
+				if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+				{
+					readConnection(id);
+				}
+
+				if (connections.count(id) != 0 && (events[i].events & EPOLLOUT))
+				{
+					flushConnection(id);
+				}
+			}
+		}
+	}
+}
+
+
+void EmulatorServer::stop()
+{
+	stopping.store(true);
+
+	// The loop may be waiting in epoll_wait().
+	uint64_t one{ 1 };
+	if (event >= 0)
+	{
+		(void)!write(event, &one, sizeof(one));
+	}
+}
+
+
+void EmulatorServer::acceptConnections()
+{
+	for (;;)
+	{
+		int socket{ accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC) };
+		if (socket < 0)
+		{
+			return;
+		}
+
+		uint64_t id{ next_connection++ };
+		connections[id] = Connection{ .socket = socket };
+
+		epoll_event connection_event{ EPOLLIN, { .u64 = id } };
+		epoll_ctl(epoll, EPOLL_CTL_ADD, socket, &connection_event);
+	}
+}
+
+
+/*
+	End of input is only the client shutting down its side (a batch followed by shutdown()
+	is a complete conversation): the requests read with it are still dispatched, and the
+	connection closes once they are answered (see flushConnection()). Events after that
+	mean the client has gone away altogether.
+*/
+void EmulatorServer::readConnection(uint64_t id)
+{
+	Connection& connection{ connections.at(id) };
+
+	if (connection.input_closed)
+	{
+		closeConnection(id);
+		return;
+	}
+
+	for (;;)
+	{
+		size_t used{ connection.input.size() };
+		connection.input.resize(used + read_chunk_size);
+
+		ssize_t received{ recv(connection.socket, connection.input.data() + used, read_chunk_size, 0) };
+		connection.input.resize(used + std::max<ssize_t>(received, 0));
+
+		if (received < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+		{
+			closeConnection(id);
+			return;
+		}
+
+		if (received == 0)
+		{
+			connection.input_closed = true;
+			break;
+		}
+
+		if (received < 0)
+		{
+			break;
+		}
+	}
+
+	if (!dispatch(id, connection))
+	{
+		closeConnection(id);
+		return;
+	}
+
+	if (connection.input_closed)
+	{
+		flushConnection(id);
+	}
+}
+
+
+/*
+	Creates are numbered here, so the session id (and with it the worker) is known before
+	the worker runs the request.
+*/
+bool EmulatorServer::dispatch(uint64_t id, Connection& connection)
+{
+	size_t offset{ 0 };
+	std::vector<std::vector<Job>> batches(workers.size());
+
+	while (connection.input.size() - offset >= sizeof(RequestHeader))
+	{
+		RequestHeader header;
+		std::memcpy(&header, connection.input.data() + offset, sizeof(header));
+
+		if (header.size > max_payload_size)
+		{
+			return false;
+		}
+
+		if (connection.input.size() - offset - sizeof(header) < header.size)
+		{
+			break;
+		}
+
+		const byte* payload{ connection.input.data() + offset + sizeof(header) };
+		offset += sizeof(header) + header.size;
+
+		if (header.command == Command::Create)
+		{
+			header.session = next_session.fetch_add(1);
+		}
+
+		size_t worker{ (header.session - 1) % workers.size() };
+		batches[worker].push_back(Job{ id, header, std::vector<byte>(payload, payload + header.size) });
+		++connection.pending;
+	}
+
+	connection.input.erase(connection.input.begin(), connection.input.begin() + offset);
+
+	for (size_t i{ 0 }; i < workers.size(); ++i)
+	{
+		if (batches[i].empty())
+		{
+			continue;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock{ workers[i]->mutex };
+			for (Job& job : batches[i])
+			{
+				workers[i]->jobs.push_back(std::move(job));
+			}
+		}
+		workers[i]->wake.notify_one();
+	}
+
+	return true;
+}
+
+
+void EmulatorServer::collectCompletions()
+{
+	std::vector<Completion> done;
+	{
+		std::lock_guard<std::mutex> lock{ completion_mutex };
+		done.swap(completions);
+	}
+
+	std::vector<uint64_t> touched;
+	for (Completion& completion : done)
+	{
+		// The client may have gone away meanwhile.
+		auto connection{ connections.find(completion.connection) };
+		if (connection != connections.end())
+		{
+			std::vector<byte>& output{ connection->second.output };
+			output.insert(output.end(), completion.response.begin(), completion.response.end());
+			--connection->second.pending;
+			touched.push_back(completion.connection);
+		}
+	}
+
+	std::sort(touched.begin(), touched.end());
+	touched.erase(std::unique(touched.begin(), touched.end()), touched.end());
+
+	for (uint64_t id : touched)
+	{
+		flushConnection(id);
+	}
+}
+
+
+/*
+	Writes as much as the socket takes; the rest waits for EPOLLOUT. A connection whose
+	client has shut down its side closes once everything it asked for has been sent.
+*/
+void EmulatorServer::flushConnection(uint64_t id)
+{
+	Connection& connection{ connections.at(id) };
+
+	while (connection.output_sent < connection.output.size())
+	{
+		ssize_t sent{ send(connection.socket, connection.output.data() + connection.output_sent,
+			connection.output.size() - connection.output_sent, MSG_NOSIGNAL) };
+
+		if (sent < 0)
+		{
+			if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+			{
+				break;
+			}
+
+			closeConnection(id);
+			return;
+		}
+
+		connection.output_sent += static_cast<size_t>(sent);
+	}
+
+	if (connection.output_sent == connection.output.size())
+	{
+		connection.output.clear();
+		connection.output_sent = 0;
+	}
+
+	if (connection.input_closed && connection.pending == 0 && connection.output.empty())
+	{
+		closeConnection(id);
+		return;
+	}
+
+	// Without input there is nothing to read: end of input would be reported again and again.
+	bool writable_wanted{ !connection.output.empty() };
+	if (writable_wanted != connection.writable_wanted || connection.input_closed)
+	{
+		epoll_event connection_event{ (connection.input_closed ? 0u : EPOLLIN) | (writable_wanted ? EPOLLOUT : 0u), { .u64 = id } };
+		epoll_ctl(epoll, EPOLL_CTL_MOD, connection.socket, &connection_event);
+		connection.writable_wanted = writable_wanted;
+	}
+}
+
+
+void EmulatorServer::closeConnection(uint64_t id)
+{
+	auto connection{ connections.find(id) };
+	if (connection != connections.end())
+	{
+		epoll_ctl(epoll, EPOLL_CTL_DEL, connection->second.socket, nullptr);
+		close(connection->second.socket);
+		connections.erase(connection);
+	}
+}
+#pragma endregion
+#else
+void EmulatorServer::run()
+{
+	throw std::runtime_error("EmulatorServer: only available on Linux");
+}
+
+
+void EmulatorServer::stop()
+{
+	stopping.store(true);
+}
+#endif
+
+
+int EmulatorServer::run(int argc, char* argv[])
+{
+	if (argc < 1)
+	{
+		std::fprintf(stderr, "usage: serve <socket> [--workers n]\n");
+		return EXIT_FAILURE;
+	}
+
+	unsigned worker_count{ std::max(std::thread::hardware_concurrency(), 1u) };
+	for (int i{ 1 }; i + 1 < argc; ++i)
+	{
+		if (std::string{ argv[i] } == "--workers")
+		{
+			worker_count = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+		}
+	}
+
+	try
+	{
+		EmulatorServer server{ argv[0], worker_count };
+
+		signal_server = &server;
+		std::signal(SIGINT, stopOnSignal);
+		std::signal(SIGTERM, stopOnSignal);
+
+		std::printf("serving on %s with %u workers\n", argv[0], std::max(worker_count, 1u));
+		std::fflush(stdout);
+		server.run();
+
+		signal_server = nullptr;
+	}
+	catch (const std::exception& e)
+	{
+		signal_server = nullptr;
+		std::fprintf(stderr, "%s\n", e.what());
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
\ No newline at end of file
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "types.hpp"
+#include "nes.hpp"
+#include "server_protocol.hpp"
+
+
+/// <summary>
+/// Daemon hosting many emulator sessions for orchestration tools, which then reuse warm
+/// consoles instead of starting a process per job. Clients talk ServerProtocol over a Unix
+/// domain socket.
+///
+/// One thread runs an epoll loop over the listening socket and all connections; it only
+/// moves bytes. Requests are handed to a fixed pool of workers. Every session is pinned to
+/// one worker for its lifetime, so its console stays in that core's caches, its requests run
+/// in order without locks, and sessions on different workers step in parallel. Workers hand
+/// responses back to the loop through a queue and an eventfd.
+///
+/// Linux only (epoll, eventfd); elsewhere run() throws.
+/// </summary>
+class EmulatorServer
+{
+public:
+	/// <param name="socket_path">Path of the socket; an old socket file there is replaced.</param>
+	/// <param name="workers">Worker threads (at least 1).</param>
+	EmulatorServer(const std::string& socket_path, unsigned workers);
+	~EmulatorServer();
+
+	EmulatorServer(const EmulatorServer&) = delete;
+	EmulatorServer& operator=(const EmulatorServer&) = delete;
+
+	/// <summary>
+	/// Serves until stop() is called. Throws std::runtime_error if the socket cannot be set up.
+	/// </summary>
+	void run();
+
+	/// <summary>
+	/// Makes run() return. Async-signal-safe, so it can be called from a signal handler.
+	/// </summary>
+	void stop();
+
+	/// <summary>
+	/// Command line tool: serve &lt;socket&gt; [--workers n]. Stops on SIGINT or SIGTERM.
+	/// </summary>
+	static int run(int argc, char* argv[]);
+
+private:
+	struct Session
+	{
+		NES nes;
+		bool loaded{ false };
+		std::unordered_map<uint32_t, std::unique_ptr<NES::Fork>> saves;
+	};
+
+	struct Job
+	{
+		uint64_t connection;
+		ServerProtocol::RequestHeader header;
+		std::vector<byte> payload;
+	};
+
+	struct Worker
+	{
+		std::thread thread;
+		std::mutex mutex;
+		std::condition_variable wake;
+		std::deque<Job> jobs;
+
+		// Only touched by the worker's thread.
+		std::unordered_map<uint32_t, std::unique_ptr<Session>> sessions;
+	};
+
+	struct Completion
+	{
+		uint64_t connection;
+		std::vector<byte> response;
+	};
+
+	struct Connection
+	{
+		int socket{ -1 };
+		std::vector<byte> input{};
+		std::vector<byte> output{};
+		size_t output_sent{ 0 };
+		bool writable_wanted{ false };
+
+		// The client shut down its side: no more requests, but the queued ones are still answered.
+		bool input_closed{ false };
+		size_t pending{ 0 };		// requests queued for workers and not answered yet
+	};
+
+	void workerLoop(Worker& worker);
+
+	/// <summary>
+	/// Runs one request on the worker that owns its session and builds the response.
+	/// </summary>
+	std::vector<byte> execute(Worker& worker, const Job& job);
+
+	/// <summary>
+	/// Queues every complete request in the connection's input for its worker.
+	/// Returns false if the input is malformed.
+	/// </summary>
+	bool dispatch(uint64_t id, Connection& connection);
+
+	void acceptConnections();
+	void readConnection(uint64_t id);
+	void flushConnection(uint64_t id);
+	void closeConnection(uint64_t id);
+	void collectCompletions();
+
+	std::string socket_path;
+	std::vector<std::unique_ptr<Worker>> workers;
+
+	int listener{ -1 };
+	int epoll{ -1 };
+	int event{ -1 };		// eventfd: completions are waiting, or stop() was called
+
+	std::atomic<bool> stopping{ false };
+	std::atomic<uint32_t> next_session{ 1 };
+
+	std::unordered_map<uint64_t, Connection> connections;
+	uint64_t next_connection{ 1 };
+
+	std::mutex completion_mutex;
+	std::vector<Completion> completions;
+};
\ No newline at end of file
@@ -0,0 +1,227 @@
+#include "frame_ring.hpp"
+#include "nes.hpp"
+
+#include <chrono>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "the ring's counters are shared between processes");
+static_assert(sizeof(FrameRingHeader) % 64 == 0 && sizeof(FrameRingSlot) % 64 == 0, "slots are cache-line aligned");
+
+
+namespace
+{
+	constexpr char ring_magic[8]{ 'E', 'M', 'U', 'N', 'E', 'S', 'F', 'R' };
+
+
+	std::string getSystemName(const std::string& name)
+	{
+#if defined(_WIN32)
+		return "Local\\" + name;
+#else
+		return "/" + name;
+#endif
+	}
+
+
+	/*
+		Maps the named shared memory; size 0 opens an existing one read-only and returns its size.
+	*/
+	void* mapShared(const std::string& name, size_t& size, void*& mapping)
+	{
+		std::string system_name{ getSystemName(name) };
+		bool create{ size != 0 };
+
+#if defined(_WIN32)
+		if (create)
+		{
+			mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+				static_cast<DWORD>(static_cast<uint64_t>(size) >> 32), static_cast<DWORD>(size), system_name.c_str());
+		}
+		else
+		{
+			mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, system_name.c_str());
+		}
+
+		if (mapping == nullptr)
+		{
+			return nullptr;
+		}
+
+		void* view{ MapViewOfFile(mapping, create ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, size) };
+		if (view != nullptr && !create)
+		{
+			MEMORY_BASIC_INFORMATION information;
+			VirtualQuery(view, &information, sizeof(information));
+			size = information.RegionSize;
+		}
+
+		if (view == nullptr)
+		{
+			CloseHandle(mapping);
+			mapping = nullptr;
+		}
+
+		return view;
+#else
+		int file{ create ? shm_open(system_name.c_str(), O_RDWR | O_CREAT, 0644) : shm_open(system_name.c_str(), O_RDONLY, 0) };
+		if (file < 0)
+		{
+			return nullptr;
+		}
+
+		struct stat status;
+		bool sized{ create ? (ftruncate(file, static_cast<off_t>(size)) == 0) : (fstat(file, &status) == 0 && status.st_size > 0) };
+		if (!create && sized)
+		{
+			size = static_cast<size_t>(status.st_size);
+		}
+
+		void* view{ sized ? mmap(nullptr, size, create ? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_SHARED, file, 0) : MAP_FAILED };
+		close(file);
+		(void)mapping;
+
+		return (view != MAP_FAILED) ? view : nullptr;
+#endif
+	}
+
+
+	void unmapShared(void* memory, size_t size, void* mapping)
+	{
+#if defined(_WIN32)
+		UnmapViewOfFile(memory);
+		CloseHandle(mapping);
+#else
+		munmap(memory, size);
+		(void)mapping;
+#endif
+	}
+}
+
+
+#pragma region Writer
+FrameRingWriter::FrameRingWriter(const std::string& name, uint32_t slot_count)
+	: name{ name }
+	, size{ sizeof(FrameRingHeader) + size_t{ slot_count } * sizeof(FrameRingSlot) }
+{
+	if (slot_count == 0)
+	{
+		throw std::runtime_error("FrameRingWriter: a ring needs at least one slot");
+	}
+
+	memory = mapShared(name, size, mapping);
+	if (memory == nullptr)
+	{
+		throw std::runtime_error("FrameRingWriter: could not create shared memory " + name);
+	}
+
+	// A ring left behind by an earlier writer is reset. Readers check the magic last.
+	header = new (memory) FrameRingHeader{};
+	header->version = version;
+	header->slot_count = slot_count;
+	header->width = PPU::screen_width;
+	header->height = PPU::screen_height;
+	header->slot_size = sizeof(FrameRingSlot);
+
+	byte* slots{ static_cast<byte*>(memory) + sizeof(FrameRingHeader) };
+	for (uint32_t i{ 0 }; i < slot_count; ++i)
+	{
+		FrameRingSlot* slot{ new (slots + i * sizeof(FrameRingSlot)) FrameRingSlot{} };
+		slot->index = ~uint64_t{ 0 };
+	}
+
+	std::atomic_thread_fence(std::memory_order_release);
+	std::memcpy(header->magic, ring_magic, sizeof(ring_magic));
+}
+
+
+FrameRingWriter::~FrameRingWriter()
+{
+	unmapShared(memory, size, mapping);
+
+#if !defined(_WIN32)
+	shm_unlink(getSystemName(name).c_str());
+#endif
+}
+
+
+/*
+	Seqlock write: the odd count tells readers the slot is changing, the release stores
+	order the data between the two counts.
+*/
+void FrameRingWriter::publish(const NES& nes, byte port_1, byte port_2)
+{
+	uint64_t index{ header->published.load(std::memory_order_relaxed) };
+	byte* slots{ static_cast<byte*>(memory) + sizeof(FrameRingHeader) };
+	FrameRingSlot& slot{ *reinterpret_cast<FrameRingSlot*>(slots + (index % header->slot_count) * sizeof(FrameRingSlot)) };
+
+	int64_t now{ std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count() };
+
+	uint64_t sequence{ slot.sequence.load(std::memory_order_relaxed) };
+	slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	slot.index = index;
+	slot.frame = nes.getFrame();
+	slot.state_hash = nes.getStateHash();
+	slot.published_ns = now;
+	slot.input[0] = port_1;
+	slot.input[1] = port_2;
+	std::memcpy(slot.pixels, nes.getFramebuffer(), sizeof(slot.pixels));
+
+	slot.sequence.store(sequence + 2, std::memory_order_release);
+	header->published.store(index + 1, std::memory_order_release);
+}
+
+
+uint64_t FrameRingWriter::getPublishedCount() const
+{
+	return header->published.load(std::memory_order_relaxed);
+}
+#pragma endregion
+
+
+#pragma region Reader
+FrameRingReader::FrameRingReader(const std::string& name)
+{
+	memory = mapShared(name, size, mapping);
+	if (memory == nullptr)
+	{
+		throw std::runtime_error("FrameRingReader: no shared memory named " + name);
+	}
+
+	header = static_cast<const FrameRingHeader*>(memory);
+
+	bool valid{ size >= sizeof(FrameRingHeader) && std::memcmp(header->magic, ring_magic, sizeof(ring_magic)) == 0 };
+	std::atomic_thread_fence(std::memory_order_acquire);
+
+	valid = valid && header->version == FrameRingWriter::version && header->slot_count > 0
+		&& header->width == PPU::screen_width && header->height == PPU::screen_height
+		&& header->slot_size == sizeof(FrameRingSlot)
+		&& sizeof(FrameRingHeader) + size_t{ header->slot_count } * header->slot_size <= size;
+
+	if (!valid)
+	{
+		unmapShared(memory, size, mapping);
+		throw std::runtime_error("FrameRingReader: " + name + " is not a frame ring of this version");
+	}
+}
+
+
+FrameRingReader::~FrameRingReader()
+{
+	unmapShared(memory, size, mapping);
+}
+#pragma endregion
\ No newline at end of file
@@ -0,0 +1,163 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+
+#include "types.hpp"
+#include "ppu.hpp"
+
+class NES;
+
+
+/// <summary>
+/// One frame in a FrameRing, as it lies in shared memory.
+/// </summary>
+struct FrameRingSlot
+{
+	// Seqlock: odd while the writer is filling the slot, bumped by 2 per frame written.
+	std::atomic<uint64_t> sequence;
+
+	uint64_t index;					// position in the stream (0, 1, 2, ...)
+	uint64_t frame;					// NES::getFrame()
+	uint64_t state_hash;			// NES::getStateHash()
+	int64_t published_ns;			// steady clock when publishing started (same clock in every process)
+	byte input[2];					// buttons held on both controllers during the frame
+
+	alignas(64) uint32_t pixels[PPU::screen_width * PPU::screen_height];
+};
+
+
+/// <summary>
+/// Start of the shared memory: the layout, then slot_count slots of slot_size bytes.
+/// </summary>
+struct FrameRingHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t slot_count;
+	uint32_t width;
+	uint32_t height;
+	uint64_t slot_size;
+
+	// Frames published so far; frame i is in slot i % slot_count until it is overwritten.
+	alignas(64) std::atomic<uint64_t> published;
+};
+
+
+/// <summary>
+/// Publishes finished frames to other processes through a named shared-memory ring.
+///
+/// The writer never waits: it overwrites the oldest slot, so a slow or stopped consumer
+/// costs emulation nothing but the copy into the ring. Consumers (FrameRingReader) read
+/// the pixels in place and then check the slot's sequence counter, so they need no locks,
+/// copies or system calls per frame, and find out if the writer overwrote a frame while
+/// they were reading it.
+/// </summary>
+class FrameRingWriter
+{
+public:
+	static constexpr uint32_t version{ 1 };
+
+	/// <summary>
+	/// Creates (or recreates) the shared memory. Throws std::runtime_error on failure.
+	/// </summary>
+	/// <param name="name">Name of the ring, without a leading '/'.</param>
+	/// <param name="slot_count">Frames kept; a consumer may fall this far behind.</param>
+	FrameRingWriter(const std::string& name, uint32_t slot_count = 8);
+
+	/// <summary>
+	/// Removes the name. Consumers that have the ring mapped keep it until they close it.
+	/// </summary>
+	~FrameRingWriter();
+
+	FrameRingWriter(const FrameRingWriter&) = delete;
+	FrameRingWriter& operator=(const FrameRingWriter&) = delete;
+
+	/// <summary>
+	/// Publishes the console's last rendered frame.
+	/// </summary>
+	void publish(const NES& nes, byte port_1 = 0, byte port_2 = 0);
+
+	uint64_t getPublishedCount() const;
+
+private:
+	std::string name;
+	void* memory{ nullptr };
+	size_t size{ 0 };
+	void* mapping{ nullptr };		// Windows file mapping handle
+
+	FrameRingHeader* header{ nullptr };
+};
+
+
+/// <summary>
+/// Consumer side of a FrameRingWriter.
+/// </summary>
+class FrameRingReader
+{
+public:
+	/// <summary>
+	/// Maps an existing ring read-only. Throws std::runtime_error if there is none by that
+	/// name (yet) or it has another layout.
+	/// </summary>
+	explicit FrameRingReader(const std::string& name);
+	~FrameRingReader();
+
+	FrameRingReader(const FrameRingReader&) = delete;
+	FrameRingReader& operator=(const FrameRingReader&) = delete;
+
+	/// <summary>
+	/// Frames published so far. The last getSlotCount() of them may still be readable.
+	/// </summary>
+	uint64_t getPublishedCount() const
+	{
+		return header->published.load(std::memory_order_acquire);
+	}
+
+	uint32_t getSlotCount() const
+	{
+		return header->slot_count;
+	}
+
+	/// <summary>
+	/// Calls visit(const FrameRingSlot&) on frame index, in place in shared memory.
+	/// The writer may overwrite the slot meanwhile; then read() returns false and whatever
+	/// the visitor computed must be thrown away (it may have seen a mix of two frames).
+	/// </summary>
+	/// <returns>True if the frame was published, still in the ring and intact.</returns>
+	template <typename Visitor>
+	bool read(uint64_t index, Visitor&& visit) const
+	{
+		if (index >= getPublishedCount())
+		{
+			return false;
+		}
+
+		const FrameRingSlot& slot{ getSlot(index) };
+
+		uint64_t sequence{ slot.sequence.load(std::memory_order_acquire) };
+		if ((sequence & 1) != 0 || slot.index != index)
+		{
+			return false;
+		}
+
+		visit(slot);
+
+		// Nothing the visitor read may be reordered past the second look at the counter.
+		std::atomic_thread_fence(std::memory_order_acquire);
+		return slot.sequence.load(std::memory_order_relaxed) == sequence;
+	}
+
+private:
+	const FrameRingSlot& getSlot(uint64_t index) const
+	{
+		const byte* slots{ reinterpret_cast<const byte*>(header) + sizeof(FrameRingHeader) };
+		return *reinterpret_cast<const FrameRingSlot*>(slots + (index % header->slot_count) * header->slot_size);
+	}
+
+	void* memory{ nullptr };
+	size_t size{ 0 };
+	void* mapping{ nullptr };		// Windows file mapping handle
+
+	const FrameRingHeader* header{ nullptr };
+};
\ No newline at end of file
@@ -0,0 +1,224 @@
+#include "frame_ring_tool.hpp"
+#include "frame_ring.hpp"
+#include "hash.hpp"
+#include "nes.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
+
+namespace
+{
+	int64_t getTimeNs()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+
+	void relax()
+	{
+#if defined(__x86_64__) || defined(_M_X64)
+		_mm_pause();
+#else
+		std::this_thread::yield();
+#endif
+	}
+
+
+	int publish(const std::string& name, const std::string& rom_path, uint64_t frames, uint32_t slots, bool throttled)
+	{
+		NES nes;
+		nes.loadCartridge(Cartridge::load(rom_path));
+		nes.power();
+
+		FrameRingWriter writer{ name, slots };
+
+		// NTSC frame rate: 1789773 Hz / 29780.5 cycles per frame.
+		const std::chrono::nanoseconds frame_time{ 16639267 };
+		auto next{ std::chrono::steady_clock::now() };
+		int64_t publish_ns{ 0 };
+
+		for (uint64_t frame{ 0 }; frame < frames; ++frame)
+		{
+			nes.runFrame(true);
+
+			int64_t start{ getTimeNs() };
+			writer.publish(nes);
+			publish_ns += getTimeNs() - start;
+
+			if (throttled)
+			{
+				next += frame_time;
+				std::this_thread::sleep_until(next);
+			}
+		}
+
+		std::printf("published %llu frames, %.2f us per publish\n", static_cast<unsigned long long>(writer.getPublishedCount()),
+			frames == 0 ? 0.0 : static_cast<double>(publish_ns) / 1000.0 / static_cast<double>(frames));
+
+		return EXIT_SUCCESS;
+	}
+
+
+	/*
+		Follows the writer: reads the next frame if it is still in the ring, else skips to the
+		oldest one that is. Stops after the given number of frames or two idle seconds.
+	*/
+	int consume(const std::string& name, uint64_t frames)
+	{
+		// The writer may not have started yet.
+		std::unique_ptr<FrameRingReader> reader;
+		for (int attempt{ 0 }; reader == nullptr; ++attempt)
+		{
+			try
+			{
+				reader = std::make_unique<FrameRingReader>(name);
+			}
+			catch (const std::runtime_error&)
+			{
+				if (attempt == 100)
+				{
+					throw;
+				}
+				std::this_thread::sleep_for(std::chrono::milliseconds{ 20 });
+			}
+		}
+
+		std::vector<int64_t> latencies;
+		uint64_t missed{ 0 };
+		uint64_t torn{ 0 };
+		uint64_t checksum{ 0 };
+
+		uint64_t next{ reader->getPublishedCount() };
+		int64_t idle_since{ getTimeNs() };
+		uint32_t spins{ 0 };
+
+		while (latencies.size() < frames)
+		{
+			uint64_t published{ reader->getPublishedCount() };
+
+			if (next >= published)
+			{
+				if (getTimeNs() - idle_since > 2'000'000'000)
+				{
+					break;
+				}
+
+				// Spin for a while, then back off so an idle consumer does not burn a core.
+				if (++spins < 4096)
+				{
+					relax();
+				}
+				else
+				{
+					std::this_thread::sleep_for(std::chrono::microseconds{ 100 });
+				}
+				continue;
+			}
+
+			spins = 0;
+			idle_since = getTimeNs();
+
+			if (published - next > reader->getSlotCount())
+			{
+				missed += published - reader->getSlotCount() - next;
+				next = published - reader->getSlotCount();
+			}
+
+			uint64_t hash{ 0 };
+			int64_t published_ns{ 0 };
+			bool intact{ reader->read(next, [&](const FrameRingSlot& slot) {
+				hash = xxHash64(slot.pixels, sizeof(slot.pixels));
+				published_ns = slot.published_ns;
+			}) };
+
+			if (intact)
+			{
+				latencies.push_back(getTimeNs() - published_ns);
+				checksum ^= hash;
+			}
+			else
+			{
+				++torn;
+			}
+
+			++next;
+		}
+
+		std::sort(latencies.begin(), latencies.end());
+		auto percentile = [&](double p) {
+			return latencies.empty() ? 0.0 : static_cast<double>(latencies[static_cast<size_t>(p * static_cast<double>(latencies.size() - 1))]) / 1000.0;
+		};
+
+		std::printf("frames read:   %zu (missed %llu, torn %llu)\n", latencies.size(),
+			static_cast<unsigned long long>(missed), static_cast<unsigned long long>(torn));
+		std::printf("latency (us):  min %.1f  median %.1f  p99 %.1f  max %.1f\n",
+			percentile(0.0), percentile(0.5), percentile(0.99), percentile(1.0));
+		std::printf("pixel checksum %016llx\n", static_cast<unsigned long long>(checksum));
+
+		return EXIT_SUCCESS;
+	}
+}
+
+
+int FrameRingTool::run(int argc, char* argv[])
+{
+	std::string command{ (argc >= 1) ? argv[0] : "" };
+
+	std::vector<std::string> arguments;
+	uint32_t slots{ 8 };
+	bool throttled{ true };
+
+	for (int i{ 1 }; i < argc; ++i)
+	{
+		std::string argument{ argv[i] };
+
+		if (argument == "--slots" && i + 1 < argc)
+		{
+			slots = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+		}
+		else if (argument == "--unthrottled")
+		{
+			throttled = false;
+		}
+		else
+		{
+			arguments.push_back(argument);
+		}
+	}
+
+	try
+	{
+		if (command == "publish" && arguments.size() >= 2)
+		{
+			uint64_t frames{ (arguments.size() >= 3) ? std::strtoull(arguments[2].c_str(), nullptr, 10) : 600 };
+			return publish(arguments[0], arguments[1], frames, slots, throttled);
+		}
+
+		if (command == "consume" && arguments.size() >= 1)
+		{
+			uint64_t frames{ (arguments.size() >= 2) ? std::strtoull(arguments[1].c_str(), nullptr, 10) : UINT64_MAX };
+			return consume(arguments[0], frames);
+		}
+	}
+	catch (const std::exception& e)
+	{
+		std::fprintf(stderr, "%s\n", e.what());
+		return EXIT_FAILURE;
+	}
+
+	std::fprintf(stderr, "usage: ring publish <name> <rom.nes> [frames] [--slots n] [--unthrottled]\n"
+		"       ring consume <name> [frames]\n");
+	return EXIT_FAILURE;
+}
\ No newline at end of file
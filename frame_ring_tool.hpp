@@ -0,0 +1,23 @@
+#pragma once
+
+/// <summary>
+/// Command line tool for shared-memory frame output (see frame_ring.hpp), and the reference
+/// consumer for it.
+///
+///		publish <name> <rom.nes> [frames] [--slots n] [--unthrottled]
+///				run the ROM and publish every frame, at 60 frames per second unless unthrottled
+///		consume <name> [frames]
+///				read frames in place as they are published (hashing their pixels), then print
+///				publish-to-read latency and how many frames were missed or torn
+/// </summary>
+class FrameRingTool
+{
+public:
+	/// <param name="argc">Number of arguments following the tool name.</param>
+	/// <param name="argv">Arguments following the tool name.</param>
+	/// <returns>Process exit code.</returns>
+	static int run(int argc, char* argv[]);
+
+private:
+	FrameRingTool() = delete;
+};
\ No newline at end of file
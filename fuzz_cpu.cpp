@@ -0,0 +1,167 @@
+/*
+	Coverage-guided fuzzing harness for the CPU core (libFuzzer entry point).
+
+	Not part of emuNES.vcxproj: libFuzzer supplies its own main(). Build with e.g.
+
+		clang++ -std=c++20 -O1 -g -pthread -fsanitize=fuzzer,address fuzz_cpu.cpp cpu.cpp bus.cpp controller.cpp \
+			nes.cpp hash.cpp opcodes.cpp ppu.cpp cartridge.cpp tile_cache.cpp paged_memory.cpp scheduler.cpp \
+			battery_ram.cpp recompiled_module.cpp rom_index.cpp thread_pool.cpp -o fuzz_cpu
+
+	or, with MSVC, add /fsanitize=fuzzer /fsanitize=address to a project containing the same files.
+
+	Input layout:
+		byte 0-1	initial program counter (little-endian)
+		byte 2		stack pointer
+		byte 3-5	A, X, Y
+		byte 6		processor status
+		byte 7-		program image, loaded at the initial program counter (wrapping at $FFFF)
+*/
+#include "nes.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+
+
+namespace
+{
+	// Enough for a few thousand instructions; keeps executions/sec high.
+	constexpr uint64_t cycle_budget{ 20'000 };
+
+	constexpr size_t header_size{ 7 };
+
+
+	[[noreturn]] void fail(const char* invariant)
+	{
+		std::fprintf(stderr, "fuzz_cpu: invariant violated: %s\n", invariant);
+		std::abort();
+	}
+
+
+	/// <summary>
+	/// Machines are created once and reset per input, so no memory is reallocated between runs.
+	/// </summary>
+	struct Harness
+	{
+		NES reference;
+		NES fast;
+		NES::Snapshot snapshot;
+
+		// Machine states at the end of the run, compared field by field.
+		CPU::State reference_state;
+		CPU::State fast_state;
+	};
+
+
+	void prepare(NES& nes, const uint8_t* data, size_t size)
+	{
+		CPU& cpu{ nes.getCPU() };
+		Bus& bus{ cpu.getBus() };
+
+		bus.clear();
+		nes.reset();
+
+		CPU::Registers registers;
+		registers.program_counter = static_cast<word>(data[0] | (data[1] << 8));
+		registers.stack_pointer = data[2];
+		registers.reg_accumulator = data[3];
+		registers.reg_x = data[4];
+		registers.reg_y = data[5];
+		registers.processor_status = data[6];
+		cpu.setRegisters(registers);
+
+		// Program image, wrapping around the end of the address space.
+		const uint8_t* image{ data + header_size };
+		size_t image_size{ std::min<size_t>(size - header_size, bus.size()) };
+		size_t first_part{ std::min<size_t>(image_size, bus.size() - registers.program_counter) };
+
+		bus.load(registers.program_counter, image, first_part);
+		bus.load(0x0000, image + first_part, image_size - first_part);
+	}
+
+
+	/// <summary>
+	/// Saves the state and checks it against what the bus keeps incrementally: the memory hash
+	/// must equal a hash recomputed from every byte of $0000-$7FFF.
+	/// </summary>
+	void checkInvariants(const NES& nes, CPU::State& state)
+	{
+		const CPU& cpu{ nes.getCPU() };
+		cpu.saveState(state);
+
+		uint64_t memory_hash{ 0 };
+		for (size_t address{ 0 }; address < state.bus.memory.size(); ++address)
+		{
+			memory_hash ^= zobristKey(static_cast<uint32_t>(address), state.bus.memory[address]);
+		}
+
+		if (memory_hash != cpu.getBus().getMemoryHash())
+		{
+			fail("incremental memory hash differs from a full rehash");
+		}
+	}
+
+
+	/// <summary>
+	/// The fast path must end in exactly the reference's state: registers, cycle count and
+	/// every byte of writable memory.
+	/// </summary>
+	void checkAgreement(const CPU::State& reference, const CPU::State& fast)
+	{
+		const CPU::Registers& a{ reference.registers };
+		const CPU::Registers& b{ fast.registers };
+
+		if (a.program_counter != b.program_counter || a.stack_pointer != b.stack_pointer || a.reg_accumulator != b.reg_accumulator
+			|| a.reg_x != b.reg_x || a.reg_y != b.reg_y || a.processor_status != b.processor_status)
+		{
+			fail("interpreter and fast path end with different registers");
+		}
+
+		if (reference.cycles != fast.cycles)
+		{
+			fail("interpreter and fast path end on different cycles");
+		}
+
+		if (std::memcmp(reference.bus.memory.data(), fast.bus.memory.data(), reference.bus.memory.size()) != 0)
+		{
+			fail("interpreter and fast path end with different memory");
+		}
+	}
+}
+
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+	static const std::unique_ptr<Harness> harness{ std::make_unique<Harness>() };
+
+	if (size < header_size)
+	{
+		return 0;
+	}
+
+	// Reference: the plain interpreter, straight through, executing every instruction.
+	harness->reference.getCPU().setIdleLoopSkipping(false);
+	prepare(harness->reference, data, size);
+	harness->reference.getCPU().runUntil(cycle_budget);
+	checkInvariants(harness->reference, harness->reference_state);
+
+	// Fast paths must agree with it. Currently: idle-loop skipping, and snapshot/restore
+	// by rewinding to the middle of the run after having run past it.
+	prepare(harness->fast, data, size);
+	harness->fast.getCPU().runUntil(cycle_budget / 2);
+	harness->fast.save(harness->snapshot);
+	harness->fast.getCPU().runUntil(cycle_budget);
+	harness->fast.restore(harness->snapshot);
+	harness->fast.getCPU().runUntil(cycle_budget);
+	checkInvariants(harness->fast, harness->fast_state);
+	checkAgreement(harness->reference_state, harness->fast_state);
+
+	if (harness->reference.getStateHash() != harness->fast.getStateHash())
+	{
+		fail("interpreter and fast path disagree");
+	}
+
+	return 0;
+}
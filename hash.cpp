@@ -0,0 +1,394 @@
+#include "hash.hpp"
+
+#include <cstring>
+
+
+/*
+	XXH64, following the reference specification:
+	https://github.com/Cyan4973/xxHash/blob/dev/doc/xxhash_spec.md
+*/
+namespace
+{
+	constexpr uint64_t prime_1{ 0x9E3779B185EBCA87ull };
+	constexpr uint64_t prime_2{ 0xC2B2AE3D27D4EB4Full };
+	constexpr uint64_t prime_3{ 0x165667B19E3779F9ull };
+	constexpr uint64_t prime_4{ 0x85EBCA77C2B2AE63ull };
+	constexpr uint64_t prime_5{ 0x27D4EB2F165667C5ull };
+
+
+	uint64_t rotateLeft(uint64_t value, int bits)
+	{
+		return (value << bits) | (value >> (64 - bits));
+	}
+
+
+	uint64_t read64(const byte* in)
+	{
+		uint64_t value;
+		std::memcpy(&value, in, sizeof(value));
+		return value;
+	}
+
+
+	uint32_t read32(const byte* in)
+	{
+		uint32_t value;
+		std::memcpy(&value, in, sizeof(value));
+		return value;
+	}
+
+
+	uint64_t round(uint64_t accumulator, uint64_t lane)
+	{
+		accumulator += lane * prime_2;
+		accumulator = rotateLeft(accumulator, 31);
+		return accumulator * prime_1;
+	}
+
+
+	uint64_t mergeAccumulator(uint64_t hash, uint64_t accumulator)
+	{
+		hash ^= round(0, accumulator);
+		return hash * prime_1 + prime_4;
+	}
+}
+
+
+uint64_t xxHash64(const void* data, size_t length, uint64_t seed)
+{
+	const byte* in{ static_cast<const byte*>(data) };
+	const byte* end{ in + length };
+	uint64_t hash;
+
+	if (length >= 32)
+	{
+		uint64_t accumulators[4]{ seed + prime_1 + prime_2, seed + prime_2, seed, seed - prime_1 };
+
+		// Stripes of 32 bytes, one 8-byte lane per accumulator.
+		const byte* limit{ end - 32 };
+		do
+		{
+			for (size_t lane{ 0 }; lane < 4; ++lane)
+			{
+				accumulators[lane] = round(accumulators[lane], read64(in + lane * 8));
+			}
+			in += 32;
+		} while (in <= limit);
+
+		hash = rotateLeft(accumulators[0], 1) + rotateLeft(accumulators[1], 7)
+			+ rotateLeft(accumulators[2], 12) + rotateLeft(accumulators[3], 18);
+
+		for (uint64_t accumulator : accumulators)
+		{
+			hash = mergeAccumulator(hash, accumulator);
+		}
+	}
+	else
+	{
+		hash = seed + prime_5;
+	}
+
+	hash += static_cast<uint64_t>(length);
+
+	// Remaining 0-31 bytes.
+	for (; in + 8 <= end; in += 8)
+	{
+		hash ^= round(0, read64(in));
+		hash = rotateLeft(hash, 27) * prime_1 + prime_4;
+	}
+
+	if (in + 4 <= end)
+	{
+		hash ^= static_cast<uint64_t>(read32(in)) * prime_1;
+		hash = rotateLeft(hash, 23) * prime_2 + prime_3;
+		in += 4;
+	}
+
+	for (; in < end; ++in)
+	{
+		hash ^= static_cast<uint64_t>(*in) * prime_5;
+		hash = rotateLeft(hash, 11) * prime_1;
+	}
+
+	// Avalanche.
+	hash ^= hash >> 33;
+	hash *= prime_2;
+	hash ^= hash >> 29;
+	hash *= prime_3;
+	hash ^= hash >> 32;
+
+	return hash;
+}
+
+
+/*
+	CRC-32, reflected, polynomial 0xEDB88320.
+
+	The table version processes 8 bytes per step (slicing-by-8). The PCLMULQDQ version folds
+	four 128-bit lanes at once and reduces with Barrett's method, as in Intel's "Fast CRC
+	Computation for Generic Polynomials Using PCLMULQDQ Instruction"; the folding constants
+	are those of zlib's x86 implementation.
+*/
+#if defined(__x86_64__) || defined(_M_X64)
+#define EMUNES_CRC32_CLMUL
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define EMUNES_TARGET_CLMUL
+#else
+#include <cpuid.h>
+#define EMUNES_TARGET_CLMUL __attribute__((target("pclmul,sse4.1")))
+#endif
+#endif
+
+
+namespace
+{
+	struct CRC32Tables
+	{
+		uint32_t table[8][256];
+
+		CRC32Tables()
+		{
+			for (uint32_t i{ 0 }; i < 256; ++i)
+			{
+				uint32_t crc{ i };
+				for (int bit{ 0 }; bit < 8; ++bit)
+				{
+					crc = (crc >> 1) ^ ((crc & 1) ? 0xEDB88320u : 0);
+				}
+				table[0][i] = crc;
+			}
+
+			for (uint32_t i{ 0 }; i < 256; ++i)
+			{
+				for (int slice{ 1 }; slice < 8; ++slice)
+				{
+					table[slice][i] = (table[slice - 1][i] >> 8) ^ table[0][table[slice - 1][i] & 0xFF];
+				}
+			}
+		}
+	};
+
+	const CRC32Tables crc32_tables;
+
+
+	// On the inverted CRC, as are the other steps.
+	uint32_t crc32Tables(const byte* in, size_t length, uint32_t crc)
+	{
+		const auto& table{ crc32_tables.table };
+
+		for (; length >= 8; in += 8, length -= 8)
+		{
+			uint32_t lo{ read32(in) ^ crc };
+			uint32_t hi{ read32(in + 4) };
+			crc = table[7][lo & 0xFF] ^ table[6][(lo >> 8) & 0xFF] ^ table[5][(lo >> 16) & 0xFF] ^ table[4][lo >> 24]
+				^ table[3][hi & 0xFF] ^ table[2][(hi >> 8) & 0xFF] ^ table[1][(hi >> 16) & 0xFF] ^ table[0][hi >> 24];
+		}
+
+		for (; length > 0; ++in, --length)
+		{
+			crc = (crc >> 8) ^ table[0][(crc ^ *in) & 0xFF];
+		}
+
+		return crc;
+	}
+
+
+#if defined(EMUNES_CRC32_CLMUL)
+	bool hasCarrylessMultiply()
+	{
+		unsigned int registers[4]{};
+#if defined(_MSC_VER)
+		__cpuid(reinterpret_cast<int*>(registers), 1);
+#else
+		__get_cpuid(1, &registers[0], &registers[1], &registers[2], &registers[3]);
+#endif
+		// ECX: PCLMULQDQ (bit 1) and SSE4.1 (bit 19).
+		return (registers[2] & (1u << 1)) != 0 && (registers[2] & (1u << 19)) != 0;
+	}
+
+	const bool has_carryless_multiply{ hasCarrylessMultiply() };
+
+
+	// Multiplies both halves of x by the folding constants and adds the next 16 bytes.
+	EMUNES_TARGET_CLMUL inline __m128i fold(__m128i x, __m128i k, __m128i data)
+	{
+		return _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x, k, 0x11), _mm_clmulepi64_si128(x, k, 0x00)), data);
+	}
+
+
+	// Length is at least 64 and a multiple of 16.
+	EMUNES_TARGET_CLMUL uint32_t crc32CarrylessMultiply(const byte* in, size_t length, uint32_t crc)
+	{
+		alignas(16) static constexpr uint64_t k1k2[2]{ 0x0154442BD4, 0x01C6E41596 };
+		alignas(16) static constexpr uint64_t k3k4[2]{ 0x01751997D0, 0x00CCAA009E };
+		alignas(16) static constexpr uint64_t k5k0[2]{ 0x0163CD6124, 0x0000000000 };
+		alignas(16) static constexpr uint64_t poly[2]{ 0x01DB710641, 0x01F7011641 };
+
+		__m128i x1{ _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 0x00)) };
+		__m128i x2{ _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 0x10)) };
+		__m128i x3{ _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 0x20)) };
+		__m128i x4{ _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 0x30)) };
+		x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128(static_cast<int>(crc)));
+
+		__m128i k{ _mm_load_si128(reinterpret_cast<const __m128i*>(k1k2)) };
+		in += 64;
+		length -= 64;
+
+		// Four lanes, 64 bytes per step.
+		for (; length >= 64; in += 64, length -= 64)
+		{
+			x1 = fold(x1, k, _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 0x00)));
+			x2 = fold(x2, k, _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 0x10)));
+			x3 = fold(x3, k, _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 0x20)));
+			x4 = fold(x4, k, _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 0x30)));
+		}
+
+		// Into one lane, then 16 bytes per step.
+		k = _mm_load_si128(reinterpret_cast<const __m128i*>(k3k4));
+		x1 = fold(x1, k, x2);
+		x1 = fold(x1, k, x3);
+		x1 = fold(x1, k, x4);
+
+		for (; length >= 16; in += 16, length -= 16)
+		{
+			x1 = fold(x1, k, _mm_loadu_si128(reinterpret_cast<const __m128i*>(in)));
+		}
+
+		// 128 to 64 bits.
+		__m128i mask{ _mm_setr_epi32(~0, 0, ~0, 0) };
+		x2 = _mm_clmulepi64_si128(x1, k, 0x10);
+		x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+
+		k = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(k5k0));
+		x2 = _mm_srli_si128(x1, 4);
+		x1 = _mm_xor_si128(_mm_clmulepi64_si128(_mm_and_si128(x1, mask), k, 0x00), x2);
+
+		// Barrett reduction to 32 bits.
+		k = _mm_load_si128(reinterpret_cast<const __m128i*>(poly));
+		x2 = _mm_and_si128(_mm_clmulepi64_si128(_mm_and_si128(x1, mask), k, 0x10), mask);
+		x2 = _mm_clmulepi64_si128(x2, k, 0x00);
+		x1 = _mm_xor_si128(x1, x2);
+
+		return static_cast<uint32_t>(_mm_extract_epi32(x1, 1));
+	}
+#endif
+}
+
+
+uint32_t crc32(const void* data, size_t length, uint32_t crc)
+{
+	const byte* in{ static_cast<const byte*>(data) };
+	crc = ~crc;
+
+#if defined(EMUNES_CRC32_CLMUL)
+	if (has_carryless_multiply && length >= 64)
+	{
+		size_t folded{ length & ~size_t{ 15 } };
+		crc = crc32CarrylessMultiply(in, folded, crc);
+		in += folded;
+		length -= folded;
+	}
+#endif
+
+	return ~crc32Tables(in, length, crc);
+}
+
+
+/*
+	SHA-1 (FIPS 180-4).
+*/
+namespace
+{
+	uint32_t rotateLeft32(uint32_t value, int bits)
+	{
+		return (value << bits) | (value >> (32 - bits));
+	}
+
+
+	void sha1Block(uint32_t state[5], const byte* block)
+	{
+		uint32_t w[80];
+		for (int i{ 0 }; i < 16; ++i)
+		{
+			w[i] = (uint32_t{ block[i * 4] } << 24) | (uint32_t{ block[i * 4 + 1] } << 16) | (uint32_t{ block[i * 4 + 2] } << 8) | block[i * 4 + 3];
+		}
+		for (int i{ 16 }; i < 80; ++i)
+		{
+			w[i] = rotateLeft32(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+		}
+
+		uint32_t a{ state[0] }, b{ state[1] }, c{ state[2] }, d{ state[3] }, e{ state[4] };
+
+		auto round = [&](uint32_t f, uint32_t k, uint32_t w) {
+			uint32_t temp{ rotateLeft32(a, 5) + f + e + k + w };
+			e = d;
+			d = c;
+			c = rotateLeft32(b, 30);
+			b = a;
+			a = temp;
+		};
+
+		for (int i{ 0 }; i < 20; ++i)
+		{
+			round((b & c) | (~b & d), 0x5A827999, w[i]);
+		}
+		for (int i{ 20 }; i < 40; ++i)
+		{
+			round(b ^ c ^ d, 0x6ED9EBA1, w[i]);
+		}
+		for (int i{ 40 }; i < 60; ++i)
+		{
+			round((b & c) | (b & d) | (c & d), 0x8F1BBCDC, w[i]);
+		}
+		for (int i{ 60 }; i < 80; ++i)
+		{
+			round(b ^ c ^ d, 0xCA62C1D6, w[i]);
+		}
+
+		state[0] += a;
+		state[1] += b;
+		state[2] += c;
+		state[3] += d;
+		state[4] += e;
+	}
+}
+
+
+std::array<byte, 20> sha1(const void* data, size_t length)
+{
+	const byte* in{ static_cast<const byte*>(data) };
+	uint32_t state[5]{ 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+
+	size_t remaining{ length };
+	for (; remaining >= 64; in += 64, remaining -= 64)
+	{
+		sha1Block(state, in);
+	}
+
+	// Padding: 0x80, zeros, and the length in bits (big-endian) at the end of the last block.
+	byte tail[128]{};
+	std::memcpy(tail, in, remaining);
+	tail[remaining] = 0x80;
+
+	size_t tail_length{ (remaining < 56) ? size_t{ 64 } : size_t{ 128 } };
+	uint64_t bits{ static_cast<uint64_t>(length) * 8 };
+	for (int i{ 0 }; i < 8; ++i)
+	{
+		tail[tail_length - 1 - i] = static_cast<byte>(bits >> (8 * i));
+	}
+
+	for (size_t offset{ 0 }; offset < tail_length; offset += 64)
+	{
+		sha1Block(state, tail + offset);
+	}
+
+	std::array<byte, 20> digest;
+	for (int i{ 0 }; i < 20; ++i)
+	{
+		digest[i] = static_cast<byte>(state[i / 4] >> (24 - 8 * (i % 4)));
+	}
+
+	return digest;
+}
\ No newline at end of file
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <array>
+
+#include "types.hpp"
+
+
+/// <summary>
+/// 64-bit xxHash (XXH64). Fast, non-cryptographic; used for per-frame state hashes.
+/// </summary>
+/// <param name="data">Bytes to hash.</param>
+/// <param name="length">Number of bytes.</param>
+/// <param name="seed">Seed; chaining hashes through the seed combines several buffers.</param>
+/// <returns>Hash value.</returns>
+uint64_t xxHash64(const void* data, size_t length, uint64_t seed = 0);
+
+
+/// <summary>
+/// CRC-32 (the IEEE polynomial of zip and of ROM databases). Folds 64 bytes at a time with
+/// carry-less multiplication (PCLMULQDQ) on x86 CPUs that have it; slicing-by-8 tables elsewhere.
+/// </summary>
+/// <param name="crc">CRC of the preceding bytes, to continue a hash over several buffers.</param>
+uint32_t crc32(const void* data, size_t length, uint32_t crc = 0);
+
+
+/// <summary>
+/// SHA-1 digest. Identifies ROM images the way ROM databases do; not for security.
+/// </summary>
+std::array<byte, 20> sha1(const void* data, size_t length);
+
+
+/// <summary>
+/// Zobrist key of a value at a position: a fixed pseudo-random number (SplitMix64 of the pair),
+/// computed rather than looked up in a table. The XOR of the keys of all positions hashes
+/// a whole state and is updated in O(1) when a single position changes.
+/// </summary>
+/// <param name="position">Address, or any other index of the hashed value.</param>
+/// <param name="value">Value at that position.</param>
+inline uint64_t zobristKey(uint32_t position, byte value)
+{
+	uint64_t z{ ((static_cast<uint64_t>(position) << 8) | value) + 0x9E3779B97F4A7C15ull };
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+	return z ^ (z >> 31);
+}
\ No newline at end of file
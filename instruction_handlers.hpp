@@ -0,0 +1,378 @@
+#pragma once
+
+#include "types.hpp"
+
+
+/*
+	Processor status flags as masks. Handlers take a set of them as their live flags.
+*/
+namespace status_flags
+{
+	enum : byte {
+		C = 1 << 0,
+		Z = 1 << 1,
+		I = 1 << 2,
+		D = 1 << 3,
+		B = 1 << 4,
+		V = 1 << 6,
+		N = 1 << 7,
+	};
+
+	constexpr byte all_flags{ 0xFF };
+}
+
+
+/// <summary>
+/// The instruction handlers' effect on registers, flags and the stack, shared by the CPU
+/// (the CPU::do* handlers) and statically recompiled code (recompiled_runtime.hpp), so both
+/// execute the same code, quirks included. Addressing, cycles and bus timing stay with the
+/// caller; see cpu.cpp for the instructions' descriptions.
+///
+/// State has the registers as members (program_counter, stack_pointer, reg_accumulator,
+/// reg_x, reg_y, processor_status) and push(byte) and pull() for page $01. Binary mode only:
+/// the CPU handles decimal mode before calling doADC() and doSBC().
+///
+/// Handlers that set flags take the set of live flags: flags outside it are overwritten
+/// before anything reads them (see Recompiler's dead-flag elimination), so they are not
+/// computed. By default all flags are live.
+///
+/// Generated code includes this header, so it sticks to C++17.
+/// </summary>
+template <typename State>
+class InstructionHandlers
+{
+public:
+	static constexpr byte C{ status_flags::C };
+	static constexpr byte Z{ status_flags::Z };
+	static constexpr byte I{ status_flags::I };
+	static constexpr byte D{ status_flags::D };
+	static constexpr byte B{ status_flags::B };
+	static constexpr byte V{ status_flags::V };
+	static constexpr byte N{ status_flags::N };
+	static constexpr byte all_flags{ status_flags::all_flags };
+
+	// B and bit 5 only exist in pushed copies of the status.
+	static constexpr byte pushed_bits{ B | 0x20 };
+
+
+	static void setFlag(State& s, byte flag, bool value)
+	{
+		s.processor_status = static_cast<byte>(value ? (s.processor_status | flag) : (s.processor_status & ~flag));
+	}
+
+
+	// Only ever sets Z and N.
+	template <byte live = all_flags>
+	static void setZeroAndNegativeFlags(State& s, byte data)
+	{
+		if constexpr ((live & Z) != 0)
+		{
+			if (data == 0)
+			{
+				s.processor_status |= Z;
+			}
+		}
+
+		if constexpr ((live & N) != 0)
+		{
+			if ((data & 0b1000'0000) != 0)
+			{
+				s.processor_status |= N;
+			}
+		}
+	}
+
+
+	// Adds with the carry flag. Overflow (tested on bit 6) sets both V and C.
+	template <byte live = all_flags>
+	static byte addBytes(State& s, byte a, byte b)
+	{
+		byte result{ static_cast<byte>(a + b + (s.processor_status & C)) };
+
+		if constexpr ((live & (V | C)) != 0)
+		{
+			if (((a ^ result) & (b ^ result) & 0b1000'000) != 0)
+			{
+				s.processor_status |= V | C;
+			}
+		}
+
+		return result;
+	}
+
+
+	// The subtrahend's two's complement, formed with the carry (0 when flags are not used).
+	static byte negate(byte subtrahend, byte carry)
+	{
+		return static_cast<byte>(~(subtrahend - 1) - static_cast<byte>(~carry));
+	}
+
+
+	// Subtracts with the carry flag. Overflow (tested on bit 6) sets V and clears C.
+	template <byte live = all_flags>
+	static byte subtractBytes(State& s, byte minuend, byte subtrahend)
+	{
+		byte negated{ negate(subtrahend, s.processor_status & C) };
+		byte result{ static_cast<byte>(minuend + negated) };
+
+		if constexpr ((live & (V | C)) != 0)
+		{
+			if (((minuend ^ result) & (negated ^ result) & 0b1000'000) != 0)
+			{
+				s.processor_status |= V;
+				s.processor_status &= ~C;
+			}
+		}
+
+		return result;
+	}
+
+
+	// CMP, CPX and CPY only ever set flags.
+	template <byte live = all_flags>
+	static void compare(State& s, byte reg, byte data)
+	{
+		if constexpr ((live & C) != 0)
+		{
+			if (reg >= data)
+			{
+				s.processor_status |= C;
+			}
+		}
+
+		if constexpr ((live & Z) != 0)
+		{
+			if (reg == data)
+			{
+				s.processor_status |= Z;
+			}
+		}
+
+		if constexpr ((live & N) != 0)
+		{
+			if ((static_cast<byte>(reg + negate(data, 0)) & 0b1000'0000) != 0)
+			{
+				s.processor_status |= N;
+			}
+		}
+	}
+
+
+	static void pushWord(State& s, word data)
+	{
+		s.push(static_cast<byte>(data >> 8));
+		s.push(static_cast<byte>(data));
+	}
+
+
+	static word pullWord(State& s)
+	{
+		byte lo{ s.pull() };
+		byte hi{ s.pull() };
+		return static_cast<word>((hi << 8) | lo);
+	}
+
+
+	// Pushes the return address and the status, and sets I. Loading the vector is up to the caller.
+	static void pushInterrupt(State& s, word return_address, byte status)
+	{
+		pushWord(s, return_address);
+		s.push(status);
+		s.processor_status |= I;
+	}
+
+
+	template <byte live = all_flags>
+	static void doADC(State& s, byte data)
+	{
+		s.reg_accumulator = addBytes<live>(s, data, s.reg_accumulator);
+		setZeroAndNegativeFlags<live>(s, s.reg_accumulator);
+	}
+
+	template <byte live = all_flags>
+	static void doAND(State& s, byte data)
+	{
+		s.reg_accumulator &= data;
+		setZeroAndNegativeFlags<live>(s, s.reg_accumulator);
+	}
+
+	template <byte live = all_flags>
+	static void doASL(State& s, byte& data)
+	{
+		if constexpr ((live & C) != 0)
+		{
+			setFlag(s, C, (data & 0b1000'0000) != 0);
+		}
+
+		data = static_cast<byte>(data << 1);
+		setZeroAndNegativeFlags<live>(s, data);
+	}
+
+	// Z is only ever set.
+	template <byte live = all_flags>
+	static void doBIT(State& s, byte data)
+	{
+		if constexpr ((live & Z) != 0)
+		{
+			if ((s.reg_accumulator & data) == 0)
+			{
+				s.processor_status |= Z;
+			}
+		}
+
+		if constexpr ((live & N) != 0)
+		{
+			setFlag(s, N, (data & 0b1000'0000) != 0);
+		}
+
+		if constexpr ((live & V) != 0)
+		{
+			setFlag(s, V, (data & 0b0100'0000) != 0);
+		}
+	}
+
+	// The clears are dropped altogether when their flag is dead.
+	template <byte live = all_flags> static void doCLC(State& s) { s.processor_status &= ~(C & live); }
+	template <byte live = all_flags> static void doCLD(State& s) { s.processor_status &= ~(D & live); }
+	template <byte live = all_flags> static void doCLI(State& s) { s.processor_status &= ~(I & live); }
+	template <byte live = all_flags> static void doCLV(State& s) { s.processor_status &= ~(V & live); }
+
+	template <byte live = all_flags> static void doCMP(State& s, byte data) { compare<live>(s, s.reg_accumulator, data); }
+	template <byte live = all_flags> static void doCMX(State& s, byte data) { compare<live>(s, s.reg_x, data); }
+	template <byte live = all_flags> static void doCMY(State& s, byte data) { compare<live>(s, s.reg_y, data); }
+
+	// Adds the two's complement of 1 as formed without flags.
+	template <byte live = all_flags>
+	static void doDEC(State& s, byte& data)
+	{
+		data = static_cast<byte>(data + negate(0b0000'0001, 0));
+		setZeroAndNegativeFlags<live>(s, data);
+	}
+
+	template <byte live = all_flags> static void doDEX(State& s) { doDEC<live>(s, s.reg_x); }
+	template <byte live = all_flags> static void doDEY(State& s) { doDEC<live>(s, s.reg_y); }
+
+	template <byte live = all_flags>
+	static void doEOR(State& s, byte data)
+	{
+		s.reg_accumulator ^= data;
+		setZeroAndNegativeFlags<live>(s, s.reg_accumulator);
+	}
+
+	template <byte live = all_flags>
+	static void doINC(State& s, byte& data)
+	{
+		++data;
+		setZeroAndNegativeFlags<live>(s, data);
+	}
+
+	template <byte live = all_flags> static void doINX(State& s) { doINC<live>(s, s.reg_x); }
+	template <byte live = all_flags> static void doINY(State& s) { doINC<live>(s, s.reg_y); }
+
+	template <byte live = all_flags>
+	static void doLDA(State& s, byte data)
+	{
+		s.reg_accumulator = data;
+		setZeroAndNegativeFlags<live>(s, data);
+	}
+
+	template <byte live = all_flags>
+	static void doLDX(State& s, byte data)
+	{
+		s.reg_x = data;
+		setZeroAndNegativeFlags<live>(s, data);
+	}
+
+	template <byte live = all_flags>
+	static void doLDY(State& s, byte data)
+	{
+		s.reg_y = data;
+		setZeroAndNegativeFlags<live>(s, data);
+	}
+
+	template <byte live = all_flags>
+	static void doLSR(State& s, byte& data)
+	{
+		if constexpr ((live & C) != 0)
+		{
+			setFlag(s, C, (data & 0b0000'0001) != 0);
+		}
+
+		data >>= 1;
+		setZeroAndNegativeFlags<live>(s, data);
+	}
+
+	// Flags come from the operand, not the result.
+	template <byte live = all_flags>
+	static void doORA(State& s, byte data)
+	{
+		s.reg_accumulator |= data;
+		setZeroAndNegativeFlags<live>(s, data);
+	}
+
+	static void doPHA(State& s) { s.push(s.reg_accumulator); }
+	static void doPHP(State& s) { s.push(static_cast<byte>(s.processor_status | pushed_bits)); }
+
+	template <byte live = all_flags>
+	static void doPLA(State& s)
+	{
+		s.reg_accumulator = s.pull();
+		setZeroAndNegativeFlags<live>(s, s.reg_accumulator);
+	}
+
+	// Overwrites every flag, so there is nothing to leave out when some are dead.
+	template <byte = all_flags>
+	static void doPLP(State& s)
+	{
+		s.processor_status = static_cast<byte>((s.pull() & ~pushed_bits) | (s.processor_status & pushed_bits));
+	}
+
+	// Bit 0 takes the inverted carry.
+	template <byte live = all_flags>
+	static void doROL(State& s, byte& data)
+	{
+		bool carry{ (data & 0b1000'0000) != 0 };
+		data = static_cast<byte>((data << 1) | ((s.processor_status & C) ? 0b0 : 0b1));
+
+		if constexpr ((live & C) != 0)
+		{
+			setFlag(s, C, carry);
+		}
+
+		setZeroAndNegativeFlags<live>(s, data);
+	}
+
+	// Bit 7 takes the inverted carry.
+	template <byte live = all_flags>
+	static void doROR(State& s, byte& data)
+	{
+		bool carry{ (data & 0b1) != 0 };
+		data = static_cast<byte>((data >> 1) | ((s.processor_status & C) ? 0b0 : 0b1000'0000));
+
+		if constexpr ((live & C) != 0)
+		{
+			setFlag(s, C, carry);
+		}
+
+		setZeroAndNegativeFlags<live>(s, data);
+	}
+
+	// Pulls the status and the return address; matching the call is up to the caller.
+	static void doRTI(State& s)
+	{
+		doPLP(s);
+		s.program_counter = pullWord(s);
+	}
+
+	static void doRTS(State& s)
+	{
+		s.program_counter = static_cast<word>(pullWord(s) + 1);
+	}
+
+	template <byte live = all_flags>
+	static void doSBC(State& s, byte data)
+	{
+		s.reg_accumulator = subtractBytes<live>(s, s.reg_accumulator, data);
+		setZeroAndNegativeFlags<live>(s, s.reg_accumulator);
+	}
+};
\ No newline at end of file
@@ -0,0 +1,1038 @@
+#include "lockstep_cpu.hpp"
+#include "opcodes.hpp"
+
+#include <algorithm>
+
+
+namespace
+{
+	/*
+		Two's complement of the subtrahend as InstructionHandlers::negate() forms it, carry included
+		(carry is 0 when flags are not used).
+	*/
+	inline byte negate(byte subtrahend, byte carry)
+	{
+		return static_cast<byte>(~(subtrahend - 1) - static_cast<byte>(~carry));
+	}
+
+
+	inline byte toMask(bool condition)
+	{
+		return condition ? 0xFF : 0x00;
+	}
+}
+
+
+LockstepCPU::LockstepCPU()
+	: memory(0x10000)
+{
+	clear();
+}
+
+
+void LockstepCPU::clear()
+{
+	std::fill(memory.begin(), memory.end(), LaneBytes{});
+
+	program_counter.fill(0);
+	stack_pointer.fill(0);
+	reg_accumulator.fill(0);
+	reg_x.fill(0);
+	reg_y.fill(0);
+	processor_status.fill(0);
+	cycles.fill(0);
+}
+
+
+void LockstepCPU::load(word address, const byte* data, size_t length)
+{
+	length = std::min(length, memory.size() - address);
+
+	for (size_t i{ 0 }; i < length; ++i)
+	{
+		memory[address + i].fill(data[i]);
+	}
+}
+
+
+void LockstepCPU::poke(size_t lane, word address, byte data)
+{
+	memory[Bus::mirror(address)][lane] = data;
+}
+
+
+byte LockstepCPU::peek(size_t lane, word address) const
+{
+	return memory[Bus::mirror(address)][lane];
+}
+
+
+void LockstepCPU::setRegisters(size_t lane, const CPU::Registers& registers)
+{
+	program_counter[lane] = registers.program_counter;
+	stack_pointer[lane] = registers.stack_pointer;
+	reg_accumulator[lane] = registers.reg_accumulator;
+	reg_x[lane] = registers.reg_x;
+	reg_y[lane] = registers.reg_y;
+	processor_status[lane] = registers.processor_status;
+}
+
+
+CPU::Registers LockstepCPU::getRegisters(size_t lane) const
+{
+	return { program_counter[lane], stack_pointer[lane], reg_accumulator[lane], reg_x[lane], reg_y[lane], processor_status[lane] };
+}
+
+
+uint64_t LockstepCPU::getCycles(size_t lane) const
+{
+	return cycles[lane];
+}
+
+
+LockstepCPU::Stats LockstepCPU::getStats() const
+{
+	return stats;
+}
+
+
+/*
+	Lanes that have not reached the cycle yet run; the one at the lowest address leads.
+	Lanes at the same address but with a different opcode there (self-modifying code)
+	wait for a later step.
+*/
+void LockstepCPU::runUntil(uint64_t cycle)
+{
+	// Sorts after every address: lanes that are done.
+	constexpr uint32_t finished{ 0x10000 };
+
+	for (;;)
+	{
+		std::array<uint32_t, lane_count> position;
+		for (size_t lane{ 0 }; lane < lane_count; ++lane)
+		{
+			position[lane] = (cycles[lane] < cycle) ? program_counter[lane] : finished;
+		}
+
+		uint32_t lowest{ finished };
+		for (size_t lane{ 0 }; lane < lane_count; ++lane)
+		{
+			lowest = std::min(lowest, position[lane]);
+		}
+
+		if (lowest == finished)
+		{
+			return;
+		}
+
+		word address{ static_cast<word>(lowest) };
+		const LaneBytes& opcodes{ memory[Bus::mirror(address)] };
+		size_t leader{ static_cast<size_t>(std::find(position.begin(), position.end(), lowest) - position.begin()) };
+		byte opcode{ opcodes[leader] };
+
+		for (size_t lane{ 0 }; lane < lane_count; ++lane)
+		{
+			mask[lane] = toMask(position[lane] == lowest && opcodes[lane] == opcode);
+		}
+
+		step(address, opcode);
+	}
+}
+
+
+void LockstepCPU::step(word address, byte opcode)
+{
+	shared_pc = address + 1;
+	page_crossed.fill(0);
+	extra_cycles.fill(0);
+	jumped.fill(0);
+
+	switch (opcode)
+	{
+		// ADC - Add with Carry
+		case 0x69: doADC(read(getAddr_Immediate()));		break;
+		case 0x65: doADC(read(getAddr_ZeroPage()));		break;
+		case 0x75: doADC(read(getAddr_ZeroPageIndexed(reg_x)));	break;
+		case 0x6d: doADC(read(getAddr_Absolute()));		break;
+		case 0x7d: doADC(read(getAddr_AbsoluteIndexed(reg_x)));	break;
+		case 0x79: doADC(read(getAddr_AbsoluteIndexed(reg_y)));	break;
+		case 0x61: doADC(read(getAddr_IndirectX()));		break;
+		case 0x71: doADC(read(getAddr_IndirectY()));		break;
+
+		// AND - Logical AND
+		case 0x29: doAND(read(getAddr_Immediate()));		break;
+		case 0x25: doAND(read(getAddr_ZeroPage()));		break;
+		case 0x35: doAND(read(getAddr_ZeroPageIndexed(reg_x)));	break;
+		case 0x2d: doAND(read(getAddr_Absolute()));		break;
+		case 0x3d: doAND(read(getAddr_AbsoluteIndexed(reg_x)));	break;
+		case 0x39: doAND(read(getAddr_AbsoluteIndexed(reg_y)));	break;
+		case 0x21: doAND(read(getAddr_IndirectX()));		break;
+		case 0x31: doAND(read(getAddr_IndirectY()));		break;
+
+		// ASL - Arithmetic Shift Left
+		case 0x0a: doASL(reg_accumulator);	break;
+		case 0x06: modify(getAddr_ZeroPage(), &LockstepCPU::doASL);	break;
+		case 0x16: modify(getAddr_ZeroPageIndexed(reg_x), &LockstepCPU::doASL);	break;
+		case 0x0e: modify(getAddr_Absolute(), &LockstepCPU::doASL);	break;
+		case 0x1e: modify(getAddr_AbsoluteIndexed(reg_x), &LockstepCPU::doASL);	break;
+
+		// (Branches) BCC, BCS, BEQ, BMI, BNE, BPL, BVC, BVS
+		case 0x90: branch(isFlagClear(C), read(getAddr_Immediate()));	break;
+		case 0xb0: branch(isFlagSet(C), read(getAddr_Immediate()));	break;
+		case 0xf0: branch(isFlagSet(Z), read(getAddr_Immediate()));	break;
+		case 0x30: branch(isFlagSet(N), read(getAddr_Immediate()));	break;
+		case 0xd0: branch(isFlagClear(Z), read(getAddr_Immediate()));	break;
+		case 0x10: branch(isFlagClear(N), read(getAddr_Immediate()));	break;
+		case 0x50: branch(isFlagClear(V), read(getAddr_Immediate()));	break;
+		case 0x70: branch(isFlagSet(V), read(getAddr_Immediate()));	break;
+
+		// BIT - Bit Test
+		case 0x24: doBIT(read(getAddr_ZeroPage()));		break;
+		case 0x2c: doBIT(read(getAddr_Absolute()));		break;
+
+		// BRK - Force Interrupt
+		case 0x00: doBRK();						break;
+
+		// (Clears) CLC, CLD, CLI, CLV
+		case 0x18: clearFlag(C);				break;
+		case 0xd8: clearFlag(D);				break;
+		case 0x58: clearFlag(I);				break;
+		case 0xb8: clearFlag(V);				break;
+
+		// CMP - Compare
+		case 0xc9: compare(reg_accumulator, read(getAddr_Immediate()));		break;
+		case 0xc5: compare(reg_accumulator, read(getAddr_ZeroPage()));		break;
+		case 0xd5: compare(reg_accumulator, read(getAddr_ZeroPageIndexed(reg_x)));	break;
+		case 0xcd: compare(reg_accumulator, read(getAddr_Absolute()));		break;
+		case 0xdd: compare(reg_accumulator, read(getAddr_AbsoluteIndexed(reg_x)));	break;
+		case 0xd9: compare(reg_accumulator, read(getAddr_AbsoluteIndexed(reg_y)));	break;
+		case 0xc1: compare(reg_accumulator, read(getAddr_IndirectX()));		break;
+		case 0xd1: compare(reg_accumulator, read(getAddr_IndirectY()));		break;
+
+		// CPX - Compare X Register
+		case 0xe0: compare(reg_x, read(getAddr_Immediate()));		break;
+		case 0xe4: compare(reg_x, read(getAddr_ZeroPage()));		break;
+		case 0xec: compare(reg_x, read(getAddr_Absolute()));		break;
+
+		// CPY - Compare Y Register
+		case 0xc0: compare(reg_y, read(getAddr_Immediate()));		break;
+		case 0xc4: compare(reg_y, read(getAddr_ZeroPage()));		break;
+		case 0xcc: compare(reg_y, read(getAddr_Absolute()));		break;
+
+		// (Decrements) DEC, DEX, DEY
+		case 0xc6: modify(getAddr_ZeroPage(), &LockstepCPU::doDEC);	break;
+		case 0xd6: modify(getAddr_ZeroPageIndexed(reg_x), &LockstepCPU::doDEC);	break;
+		case 0xce: modify(getAddr_Absolute(), &LockstepCPU::doDEC);	break;
+		case 0xde: modify(getAddr_AbsoluteIndexed(reg_x), &LockstepCPU::doDEC);	break;
+		case 0xca: doDEC(reg_x);				break;
+		case 0x88: doDEC(reg_y);				break;
+
+		// EOR - Exclusive OR
+		case 0x49: doEOR(read(getAddr_Immediate()));		break;
+		case 0x45: doEOR(read(getAddr_ZeroPage()));		break;
+		case 0x55: doEOR(read(getAddr_ZeroPageIndexed(reg_x)));	break;
+		case 0x4d: doEOR(read(getAddr_Absolute()));		break;
+		case 0x5d: doEOR(read(getAddr_AbsoluteIndexed(reg_x)));	break;
+		case 0x59: doEOR(read(getAddr_AbsoluteIndexed(reg_y)));	break;
+		case 0x41: doEOR(read(getAddr_IndirectX()));		break;
+		case 0x51: doEOR(read(getAddr_IndirectY()));		break;
+
+		// (Increments) INC, INX, INY
+		case 0xe6: modify(getAddr_ZeroPage(), &LockstepCPU::doINC);	break;
+		case 0xf6: modify(getAddr_ZeroPageIndexed(reg_x), &LockstepCPU::doINC);	break;
+		case 0xee: modify(getAddr_Absolute(), &LockstepCPU::doINC);	break;
+		case 0xfe: modify(getAddr_AbsoluteIndexed(reg_x), &LockstepCPU::doINC);	break;
+		case 0xe8: doINC(reg_x);				break;
+		case 0xc8: doINC(reg_y);				break;
+
+		// JMP - Jump
+		case 0x4c: doJMP(getAddr_Absolute());	break;
+		case 0x6c: doJMP(getAddr_Indirect());	break;
+
+		// JSR - Jump to Subroutine
+		case 0x20: doJSR(getAddr_Absolute());	break;
+
+		// LDA - Load Accumulator
+		case 0xa9: doLD(reg_accumulator, read(getAddr_Immediate()));		break;
+		case 0xa5: doLD(reg_accumulator, read(getAddr_ZeroPage()));		break;
+		case 0xb5: doLD(reg_accumulator, read(getAddr_ZeroPageIndexed(reg_x)));	break;
+		case 0xad: doLD(reg_accumulator, read(getAddr_Absolute()));		break;
+		case 0xbd: doLD(reg_accumulator, read(getAddr_AbsoluteIndexed(reg_x)));	break;
+		case 0xb9: doLD(reg_accumulator, read(getAddr_AbsoluteIndexed(reg_y)));	break;
+		case 0xa1: doLD(reg_accumulator, read(getAddr_IndirectX()));		break;
+		case 0xb1: doLD(reg_accumulator, read(getAddr_IndirectY()));		break;
+
+		// LDX - Load X Register
+		case 0xa2: doLD(reg_x, read(getAddr_Immediate()));		break;
+		case 0xa6: doLD(reg_x, read(getAddr_ZeroPage()));		break;
+		case 0xb6: doLD(reg_x, read(getAddr_ZeroPageIndexed(reg_y)));	break;
+		case 0xae: doLD(reg_x, read(getAddr_Absolute()));		break;
+		case 0xbe: doLD(reg_x, read(getAddr_AbsoluteIndexed(reg_y)));	break;
+
+		// LDY - Load Y Register
+		case 0xa0: doLD(reg_y, read(getAddr_Immediate()));		break;
+		case 0xa4: doLD(reg_y, read(getAddr_ZeroPage()));		break;
+		case 0xb4: doLD(reg_y, read(getAddr_ZeroPageIndexed(reg_x)));	break;
+		case 0xac: doLD(reg_y, read(getAddr_Absolute()));		break;
+		case 0xbc: doLD(reg_y, read(getAddr_AbsoluteIndexed(reg_x)));	break;
+
+		// LSR - Logical Shift Right
+		case 0x4a: doLSR(reg_accumulator);	break;
+		case 0x46: modify(getAddr_ZeroPage(), &LockstepCPU::doLSR);	break;
+		case 0x56: modify(getAddr_ZeroPageIndexed(reg_x), &LockstepCPU::doLSR);	break;
+		case 0x4e: modify(getAddr_Absolute(), &LockstepCPU::doLSR);	break;
+		case 0x5e: modify(getAddr_AbsoluteIndexed(reg_x), &LockstepCPU::doLSR);	break;
+
+		// ORA - Logical Inclusive OR
+		case 0x09: doORA(read(getAddr_Immediate()));		break;
+		case 0x05: doORA(read(getAddr_ZeroPage()));		break;
+		case 0x15: doORA(read(getAddr_ZeroPageIndexed(reg_x)));	break;
+		case 0x0d: doORA(read(getAddr_Absolute()));		break;
+		case 0x1d: doORA(read(getAddr_AbsoluteIndexed(reg_x)));	break;
+		case 0x19: doORA(read(getAddr_AbsoluteIndexed(reg_y)));	break;
+		case 0x01: doORA(read(getAddr_IndirectX()));		break;
+		case 0x11: doORA(read(getAddr_IndirectY()));		break;
+
+		// (Stack) PHA, PHP, PLA, PLP
+		case 0x48: push(reg_accumulator);		break;
+		case 0x08: doPHP();						break;
+		case 0x68: doPLA();						break;
+		case 0x28: doPLP();						break;
+
+		// ROL - Rotate Left
+		case 0x2a: doROL(reg_accumulator);	break;
+		case 0x26: modify(getAddr_ZeroPage(), &LockstepCPU::doROL);	break;
+		case 0x36: modify(getAddr_ZeroPageIndexed(reg_x), &LockstepCPU::doROL);	break;
+		case 0x2e: modify(getAddr_Absolute(), &LockstepCPU::doROL);	break;
+		case 0x3e: modify(getAddr_AbsoluteIndexed(reg_x), &LockstepCPU::doROL);	break;
+
+		// ROR - Rotate Right
+		case 0x6a: doROR(reg_accumulator);	break;
+		case 0x66: modify(getAddr_ZeroPage(), &LockstepCPU::doROR);	break;
+		case 0x76: modify(getAddr_ZeroPageIndexed(reg_x), &LockstepCPU::doROR);	break;
+		case 0x6e: modify(getAddr_Absolute(), &LockstepCPU::doROR);	break;
+		case 0x7e: modify(getAddr_AbsoluteIndexed(reg_x), &LockstepCPU::doROR);	break;
+
+		// (Returns) RTI, RTS
+		case 0x40: doRTI();						break;
+		case 0x60: pullProgramCounter(1);		break;
+
+		// SBC - Subtract with Carry
+		case 0xe9: doSBC(read(getAddr_Immediate()));		break;
+		case 0xe5: doSBC(read(getAddr_ZeroPage()));		break;
+		case 0xf5: doSBC(read(getAddr_ZeroPageIndexed(reg_x)));	break;
+		case 0xed: doSBC(read(getAddr_Absolute()));		break;
+		case 0xfd: doSBC(read(getAddr_AbsoluteIndexed(reg_x)));	break;
+		case 0xf9: doSBC(read(getAddr_AbsoluteIndexed(reg_y)));	break;
+		case 0xe1: doSBC(read(getAddr_IndirectX()));		break;
+		case 0xf1: doSBC(read(getAddr_IndirectY()));		break;
+
+		// STA - Store Accumulator
+		case 0x85: write(getAddr_ZeroPage(), reg_accumulator);	break;
+		case 0x95: write(getAddr_ZeroPageIndexed(reg_x), reg_accumulator);	break;
+		case 0x8d: write(getAddr_Absolute(), reg_accumulator);	break;
+		case 0x9d: write(getAddr_AbsoluteIndexed(reg_x), reg_accumulator);	break;
+		case 0x99: write(getAddr_AbsoluteIndexed(reg_y), reg_accumulator);	break;
+		case 0x81: write(getAddr_IndirectX(), reg_accumulator);	break;
+		case 0x91: write(getAddr_IndirectY(), reg_accumulator);	break;
+
+		// STX - Store X Register
+		case 0x86: write(getAddr_ZeroPage(), reg_x);	break;
+		case 0x96: write(getAddr_ZeroPageIndexed(reg_y), reg_x);	break;
+		case 0x8e: write(getAddr_Absolute(), reg_x);	break;
+
+		// STY - Store Y Register
+		case 0x84: write(getAddr_ZeroPage(), reg_y);	break;
+		case 0x94: write(getAddr_ZeroPageIndexed(reg_x), reg_y);	break;
+		case 0x8c: write(getAddr_Absolute(), reg_y);	break;
+	}
+
+	const OpcodeInfo& info{ opcode_table[opcode] };
+	byte penalty{ toMask(info.page_cross_penalty) };
+	size_t lanes{ 0 };
+
+	for (size_t lane{ 0 }; lane < lane_count; ++lane)
+	{
+		byte taken{ static_cast<byte>((info.cycles + (penalty & page_crossed[lane] & 1) + extra_cycles[lane]) & mask[lane]) };
+		cycles[lane] += taken;
+		lanes += mask[lane] & 1;
+	}
+
+	for (size_t lane{ 0 }; lane < lane_count; ++lane)
+	{
+		word next{ (jumped[lane] != 0) ? jump_target[lane] : shared_pc };
+		program_counter[lane] = (mask[lane] != 0) ? next : program_counter[lane];
+	}
+
+	++stats.steps;
+	stats.lane_instructions += lanes;
+}
+
+
+/*
+
+	INSTRUCTIONS
+
+	Same results as the CPU's handlers, lane by lane.
+
+*/
+#pragma region INSTRUCTIONS
+
+
+void LockstepCPU::doADC(const LaneBytes& data)
+{
+	assign(reg_accumulator, addBytes(data, reg_accumulator));
+	setZeroAndNegativeFlags(reg_accumulator);
+}
+
+
+void LockstepCPU::doAND(const LaneBytes& data)
+{
+	LaneBytes result;
+	for (size_t lane{ 0 }; lane < lane_count; ++lane)
+	{
+		result[lane] = reg_accumulator[lane] & data[lane];
+	}
+
+	assign(reg_accumulator, result);
+	setZeroAndNegativeFlags(reg_accumulator);
+}
+
+
+void LockstepCPU::doASL(LaneBytes& data)
+{
+	LaneBytes carry;
+	LaneBytes result;
+	for (size_t lane{ 0 }; lane < lane_count; ++lane)
+	{
+		carry[lane] = toMask((data[lane] & 0b1000'0000) != 0);
+		result[lane] = static_cast<byte>(data[lane] << 1);
+	}
+
+	setFlag(C, carry);
+	assign(data, result);
+	setZeroAndNegativeFlags(data);
+}
+
+
+void LockstepCPU::branch(const LaneBytes& condition, const LaneBytes& offset)
+{
+	for (size_t lane{ 0 }; lane < lane_count; ++lane)
+	{
+		word destination{ static_cast<word>(shared_pc + static_cast<int8_t>(offset[lane])) };
+		byte taken{ static_cast<byte>(condition[lane] & mask[lane]) };
+
+		jumped[lane] = taken;
+		jump_target[lane] = destination;
+		extra_cycles[lane] = taken & (((destination & 0xFF00) != (shared_pc & 0xFF00)) ? 2 : 1);
+	}
+}
+
+
+void LockstepCPU::doBIT(const LaneBytes& data)
+{
+	LaneBytes zero;
+	LaneBytes negative;
+	LaneBytes overflow;
+	for (size_t lane{ 0 }; lane < lane_count; ++lane)
+	{
+		zero[lane] = toMask((reg_accumulator[lane] & data[lane]) == 0);
+		negative[lane] = toMask((data[lane] & 0b1000'0000) != 0);
+		overflow[lane] = toMask((data[lane] & 0b0100'0000) != 0);
+	}
+
+	raiseFlag(Z, zero);
+	setFlag(N, negative);
+	setFlag(V, overflow);
+}
+
+
+void LockstepCPU::push(const LaneBytes& data)
+{
+	for (size_t lane{ 0 }; lane < lane_count; ++lane)
+	{
+		if (mask[lane] != 0)
+		{
+			memory[Bus::stack_page | stack_pointer[lane]][lane] = data[lane];
+			--stack_pointer[lane];
+		}
+	}
+}
+
+
+LockstepCPU::LaneBytes LockstepCPU::pull()
+{
+	LaneBytes data;
+	for (size_t lane{ 0 }; lane < lane_count; ++lane)
+	{
+		stack_pointer[lane] = static_cast<byte>(stack_pointer[lane] + (mask[lane] & 1));
+		data[lane] = memory[Bus::stack_page | stack_pointer[lane]][lane];
+	}
+
+	return data;
+}
+
+
+void LockstepCPU::pullProgramCounter(word offset)
+{
+	LaneBytes lo{ pull() };
+	LaneBytes hi{ pull() };
+
+	for (size_t lane{ 0 }; lane < lane_count; ++lane)
+	{
+		jump_target[lane] = static_cast<word>(((hi[lane] << 8) | lo[lane]) + offset);
+	}
+
+	jumped = mask;
+}
+
+
+void LockstepCPU::doBRK()
+{
+	// Returns past the byte after BRK; the pushed status has B and bit 5 set.
+	word return_address{ static_cast<word>(shared_pc + 1) };
+	LaneBytes data;
+
+	data.fill(static_cast<byte>(return_address >> 8));
+	push(data);
+	data.fill(static_cast<byte>(return_address));
+	push(data);
+	doPHP();
+
+	LaneBytes always;
+	always.fill(0xFF);
+	raiseFlag(I, always);
+
+	const LaneBytes& lo{ readRow(0xFFFE) };
+	const LaneBytes& hi{ readRow(0xFFFF) };
+	for (size_t lane{ 0 }; lane < lane_count; ++lane)
+	{
+		jump_target[lane] = static_cast<word>((hi[lane] << 8) | lo[lane]);
+	}
+
+	jumped = mask;
+}
+
+
+void LockstepCPU::compare(const LaneBytes& reg, const LaneBytes& data)
+{
+	LaneBytes carry;
+	LaneBytes zero;
+	LaneBytes negative;
+	for (size_t lane{ 0 }; lane < lane_count; ++lane)
+	{
+		byte result{ static_cast<byte>(reg[lane] + negate(data[lane], 0)) };
+
+		carry[lane] = toMask(reg[lane] >= data[lane]);
+		zero[lane] = toMask(reg[lane] == data[lane]);
+		negative[lane] = toMask((result & 0b1000'0000) != 0);
+	}
+
+	raiseFlag(C, carry);
+	raiseFlag(Z, zero);
+	raiseFlag(N, negative);
+}
+
+
+void LockstepCPU::doDEC(LaneBytes& data)
+{
+	LaneBytes result;
+	for (size_t lane{ 0 }; lane < lane_count; ++lane)
+	{
+		result[lane] = static_cast<byte>(data[lane] + negate(0b0000'0001, 0));
+	}
+
+	assign(data, result);
+	setZeroAndNegativeFlags(data);
+}
+
+
+void LockstepCPU::doEOR(const LaneBytes& data)
+{
+	LaneBytes result;
+	for (size_t lane{ 0 }; lane < lane_count; ++lane)
+	{
+		result[lane] = reg_accumulator[lane] ^ data[lane];
+	}
+
+	assign(reg_accumulator, result);
+	setZeroAndNegativeFlags(reg_accumulator);
+}
+
+
+void LockstepCPU::doINC(LaneBytes& data)
+{
+	LaneBytes result;
+	for (size_t lane{ 0 }; lane < lane_count; ++lane)
+	{
+		result[lane] = static_cast<byte>(data[lane] + 1);
+	}
+
+	assign(data, result);
+	setZeroAndNegativeFlags(data);
+}
+
+
+void LockstepCPU::doJMP(const LaneWords& address)
+{
+	jumped = mask;
+	jump_target = address;
+}
+
+
+void LockstepCPU::doJSR(const LaneWords& address)
+{
+	// Pushes the address of the operand's last byte.
+	word return_address{ static_cast<word>(shared_pc - 1) };
+	LaneBytes data;
+
+	data.fill(static_cast<byte>(return_address >> 8));
+	push(data);
+	data.fill(static_cast<byte>(return_address));
+	push(data);
+
+	doJMP(address);
+}
+
+
+void LockstepCPU::doLD(LaneBytes& reg, const LaneBytes& data)
+{
+	assign(reg, data);
+	setZeroAndNegativeFlags(data);
+}
+
+
+void LockstepCPU::doLSR(LaneBytes& data)
+{
+	LaneBytes carry;
+	LaneBytes result;
+	for (size_t lane{ 0 }; lane < lane_count; ++lane)
+	{
+		carry[lane] = toMask((data[lane] & 0b0000'0001) != 0);
+		result[lane] = data[lane] >> 1;
+	}
+
+	setFlag(C, carry);
+	assign(data, result);
+	setZeroAndNegativeFlags(data);
+}
+
+
+void LockstepCPU::doORA(const LaneBytes& data)
+{
+	LaneBytes result;
+	for (size_t lane{ 0 }; lane < lane_count; ++lane)
+	{
+		result[lane] = reg_accumulator[lane] | data[lane];
+	}
+
+	assign(reg_accumulator, result);
+
+	// Flags from the operand, like CPU::doORA().
+	setZeroAndNegativeFlags(data);
+}
+
+
+void LockstepCPU::doROL(LaneBytes& data)
+{
+	LaneBytes carry;
+	LaneBytes result;
+	for (size_t lane{ 0 }; lane < lane_count; ++lane)
+	{
+		carry[lane] = toMask((data[lane] & 0b1000'0000) != 0);
+		result[lane] = static_cast<byte>((data[lane] << 1) | ((processor_status[lane] & (1 << C)) ? 0b0 : 0b1));
+	}
+
+	setFlag(C, carry);
+	assign(data, result);
+	setZeroAndNegativeFlags(data);
+}
+
+
+void LockstepCPU::doPHP()
+{
+	LaneBytes status;
+	for (size_t lane{ 0 }; lane < lane_count; ++lane)
+	{
+		status[lane] = static_cast<byte>(processor_status[lane] | (1 << B) | 0x20);
+	}
+
+	push(status);
+}
+
+
+void LockstepCPU::doPLA()
+{
+	assign(reg_accumulator, pull());
+	setZeroAndNegativeFlags(reg_accumulator);
+}
+
+
+void LockstepCPU::doPLP()
+{
+	// B and bit 5 keep their values.
+	constexpr byte kept{ (1 << B) | 0x20 };
+	LaneBytes data{ pull() };
+
+	LaneBytes status;
+	for (size_t lane{ 0 }; lane < lane_count; ++lane)
+	{
+		status[lane] = static_cast<byte>((data[lane] & ~kept) | (processor_status[lane] & kept));
+	}
+
+	assign(processor_status, status);
+}
+
+
+void LockstepCPU::doROR(LaneBytes& data)
+{
+	LaneBytes carry;
+	LaneBytes result;
+	for (size_t lane{ 0 }; lane < lane_count; ++lane)
+	{
+		carry[lane] = toMask((data[lane] & 0b1) != 0);
+		result[lane] = static_cast<byte>((data[lane] >> 1) | ((processor_status[lane] & (1 << C)) ? 0b0 : 0b1000'0000));
+	}
+
+	setFlag(C, carry);
+	assign(data, result);
+	setZeroAndNegativeFlags(data);
+}
+
+
+void LockstepCPU::doRTI()
+{
+	doPLP();
+	pullProgramCounter(0);
+}
+
+
+void LockstepCPU::doSBC(const LaneBytes& data)
+{
+	assign(reg_accumulator, subtractBytes(reg_accumulator, data));
+	setZeroAndNegativeFlags(reg_accumulator);
+}
+
+
+void LockstepCPU::modify(const LaneWords& address, void (LockstepCPU::*instruction)(LaneBytes&))
+{
+	LaneBytes data{ read(address) };
+	(this->*instruction)(data);
+	write(address, data);
+}
+#pragma endregion
+
+
+/*
+
+	MEMORY AND ADDRESSING
+
+*/
+#pragma region ADDRESSING
+
+
+LockstepCPU::LaneBytes LockstepCPU::read(const LaneWords& address) const
+{
+	LaneBytes data;
+	for (size_t lane{ 0 }; lane < lane_count; ++lane)
+	{
+		data[lane] = memory[Bus::mirror(address[lane])][lane];
+	}
+
+	return data;
+}
+
+
+void LockstepCPU::write(const LaneWords& address, const LaneBytes& data)
+{
+	for (size_t lane{ 0 }; lane < lane_count; ++lane)
+	{
+		// ROM is read-only.
+		if (mask[lane] != 0 && address[lane] < Bus::rom_start)
+		{
+			memory[Bus::mirror(address[lane])][lane] = data[lane];
+		}
+	}
+}
+
+
+const LockstepCPU::LaneBytes& LockstepCPU::readRow(word address) const
+{
+	return memory[Bus::mirror(address)];
+}
+
+
+LockstepCPU::LaneWords LockstepCPU::getAddr_Immediate()
+{
+	LaneWords address;
+	address.fill(shared_pc++);
+
+	return address;
+}
+
+
+LockstepCPU::LaneWords LockstepCPU::getAddr_ZeroPage()
+{
+	const LaneBytes& operand{ readRow(shared_pc++) };
+
+	LaneWords address;
+	for (size_t lane{ 0 }; lane < lane_count; ++lane)
+	{
+		address[lane] = operand[lane];
+	}
+
+	return address;
+}
+
+
+LockstepCPU::LaneWords LockstepCPU::getAddr_ZeroPageIndexed(const LaneBytes& index)
+{
+	const LaneBytes& operand{ readRow(shared_pc++) };
+
+	// Indexing wraps within the zero page.
+	LaneWords address;
+	for (size_t lane{ 0 }; lane < lane_count; ++lane)
+	{
+		address[lane] = static_cast<byte>(operand[lane] + index[lane]);
+	}
+
+	return address;
+}
+
+
+LockstepCPU::LaneWords LockstepCPU::getAddr_Absolute()
+{
+	const LaneBytes& lo{ readRow(shared_pc++) };
+	const LaneBytes& hi{ readRow(shared_pc++) };
+
+	LaneWords address;
+	for (size_t lane{ 0 }; lane < lane_count; ++lane)
+	{
+		address[lane] = static_cast<word>((hi[lane] << 8) | lo[lane]);
+	}
+
+	return address;
+}
+
+
+LockstepCPU::LaneWords LockstepCPU::getAddr_AbsoluteIndexed(const LaneBytes& index)
+{
+	LaneWords address{ getAddr_Absolute() };
+
+	for (size_t lane{ 0 }; lane < lane_count; ++lane)
+	{
+		word indexed{ static_cast<word>(address[lane] + index[lane]) };
+		page_crossed[lane] = toMask((indexed & 0xFF00) != (address[lane] & 0xFF00));
+		address[lane] = indexed;
+	}
+
+	return address;
+}
+
+
+LockstepCPU::LaneWords LockstepCPU::getAddr_IndirectX()
+{
+	LaneWords table_address{ getAddr_ZeroPageIndexed(reg_x) };
+	LaneWords table_address_hi;
+	for (size_t lane{ 0 }; lane < lane_count; ++lane)
+	{
+		table_address_hi[lane] = static_cast<byte>(table_address[lane] + 1);
+	}
+
+	LaneBytes lo{ read(table_address) };
+	LaneBytes hi{ read(table_address_hi) };
+
+	LaneWords address;
+	for (size_t lane{ 0 }; lane < lane_count; ++lane)
+	{
+		address[lane] = static_cast<word>((hi[lane] << 8) | lo[lane]);
+	}
+
+	return address;
+}
+
+
+LockstepCPU::LaneWords LockstepCPU::getAddr_IndirectY()
+{
+	LaneWords lo_idx{ getAddr_ZeroPage() };
+	LaneWords hi_idx;
+	for (size_t lane{ 0 }; lane < lane_count; ++lane)
+	{
+		hi_idx[lane] = static_cast<byte>(lo_idx[lane] + 1);
+	}
+
+	LaneBytes lo{ read(lo_idx) };
+	LaneBytes hi{ read(hi_idx) };
+
+	LaneWords address;
+	for (size_t lane{ 0 }; lane < lane_count; ++lane)
+	{
+		word address_before_offset{ static_cast<word>((hi[lane] << 8) | lo[lane]) };
+		address[lane] = static_cast<word>(address_before_offset + reg_y[lane]);
+		page_crossed[lane] = toMask((address[lane] & 0xFF00) != (address_before_offset & 0xFF00));
+	}
+
+	return address;
+}
+
+
+LockstepCPU::LaneWords LockstepCPU::getAddr_Indirect()
+{
+	LaneWords indirect_address{ getAddr_Absolute() };
+
+	// JMP ($xxFF) reads the high byte from $xx00, as on the 2A03.
+	LaneWords incorrect_indirect_address;
+	for (size_t lane{ 0 }; lane < lane_count; ++lane)
+	{
+		incorrect_indirect_address[lane] = static_cast<word>((indirect_address[lane] & 0xFF00) | static_cast<byte>(indirect_address[lane] + 1));
+	}
+
+	LaneBytes i_lo{ read(indirect_address) };
+	LaneBytes i_hi{ read(incorrect_indirect_address) };
+
+	LaneWords address;
+	for (size_t lane{ 0 }; lane < lane_count; ++lane)
+	{
+		address[lane] = static_cast<word>((i_hi[lane] << 8) | i_lo[lane]);
+	}
+
+	return address;
+}
+#pragma endregion
+
+
+/*
+
+	ARITHMETIC AND FLAGS
+
+*/
+#pragma region FLAGS
+
+
+LockstepCPU::LaneBytes LockstepCPU::addBytes(const LaneBytes& a, const LaneBytes& b)
+{
+	LaneBytes result;
+	LaneBytes overflow;
+	for (size_t lane{ 0 }; lane < lane_count; ++lane)
+	{
+		result[lane] = static_cast<byte>(a[lane] + b[lane] + (processor_status[lane] & (1 << C)));
+		overflow[lane] = toMask(((a[lane] ^ result[lane]) & (b[lane] ^ result[lane]) & 0b1000'000) != 0);
+	}
+
+	// Overflow sets both V and C (see InstructionHandlers::addBytes()).
+	raiseFlag(V, overflow);
+	raiseFlag(C, overflow);
+
+	return result;
+}
+
+
+LockstepCPU::LaneBytes LockstepCPU::subtractBytes(const LaneBytes& minuend, const LaneBytes& subtrahend)
+{
+	LaneBytes result;
+	LaneBytes overflow;
+	for (size_t lane{ 0 }; lane < lane_count; ++lane)
+	{
+		byte negated{ negate(subtrahend[lane], processor_status[lane] & (1 << C)) };
+		result[lane] = static_cast<byte>(minuend[lane] + negated);
+		overflow[lane] = toMask(((minuend[lane] ^ result[lane]) & (negated ^ result[lane]) & 0b1000'000) != 0);
+	}
+
+	// Overflow sets V and clears C (see InstructionHandlers::subtractBytes()).
+	raiseFlag(V, overflow);
+	lowerFlag(C, overflow);
+
+	return result;
+}
+
+
+void LockstepCPU::assign(LaneBytes& target, const LaneBytes& value) const
+{
+	for (size_t lane{ 0 }; lane < lane_count; ++lane)
+	{
+		target[lane] = static_cast<byte>((target[lane] & ~mask[lane]) | (value[lane] & mask[lane]));
+	}
+}
+
+
+void LockstepCPU::setFlag(byte flag_idx, const LaneBytes& condition)
+{
+	byte bit{ static_cast<byte>(1 << flag_idx) };
+
+	for (size_t lane{ 0 }; lane < lane_count; ++lane)
+	{
+		byte changed{ static_cast<byte>(bit & mask[lane]) };
+		processor_status[lane] = static_cast<byte>((processor_status[lane] & ~changed) | (changed & condition[lane]));
+	}
+}
+
+
+void LockstepCPU::clearFlag(byte flag_idx)
+{
+	LaneBytes always;
+	always.fill(0xFF);
+	lowerFlag(flag_idx, always);
+}
+
+
+void LockstepCPU::raiseFlag(byte flag_idx, const LaneBytes& condition)
+{
+	byte bit{ static_cast<byte>(1 << flag_idx) };
+
+	for (size_t lane{ 0 }; lane < lane_count; ++lane)
+	{
+		processor_status[lane] |= bit & mask[lane] & condition[lane];
+	}
+}
+
+
+void LockstepCPU::lowerFlag(byte flag_idx, const LaneBytes& condition)
+{
+	byte bit{ static_cast<byte>(1 << flag_idx) };
+
+	for (size_t lane{ 0 }; lane < lane_count; ++lane)
+	{
+		processor_status[lane] &= static_cast<byte>(~(bit & mask[lane] & condition[lane]));
+	}
+}
+
+
+void LockstepCPU::setZeroAndNegativeFlags(const LaneBytes& data)
+{
+	// Only ever sets Z and N, like InstructionHandlers::setZeroAndNegativeFlags().
+	LaneBytes zero;
+	LaneBytes negative;
+	for (size_t lane{ 0 }; lane < lane_count; ++lane)
+	{
+		zero[lane] = toMask(data[lane] == 0);
+		negative[lane] = toMask((data[lane] & 0b1000'0000) != 0);
+	}
+
+	raiseFlag(Z, zero);
+	raiseFlag(N, negative);
+}
+
+
+LockstepCPU::LaneBytes LockstepCPU::isFlagSet(byte flag_idx) const
+{
+	LaneBytes set;
+	for (size_t lane{ 0 }; lane < lane_count; ++lane)
+	{
+		set[lane] = toMask((processor_status[lane] & (1 << flag_idx)) != 0);
+	}
+
+	return set;
+}
+
+
+LockstepCPU::LaneBytes LockstepCPU::isFlagClear(byte flag_idx) const
+{
+	LaneBytes clear{ isFlagSet(flag_idx) };
+	for (byte& lane : clear)
+	{
+		lane = static_cast<byte>(~lane);
+	}
+
+	return clear;
+}
+#pragma endregion
\ No newline at end of file
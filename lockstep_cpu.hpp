@@ -0,0 +1,218 @@
+#pragma once
+
+#include <array>
+#include <vector>
+
+#include "types.hpp"
+#include "cpu.hpp"
+
+
+/// <summary>
+/// Runs lane_count machines that execute the same program with different inputs
+/// (fuzzing, test vectors) in lockstep, structure-of-arrays style: every register is an
+/// array with one lane per machine, and memory is interleaved so the lanes' copies of an
+/// address are adjacent.
+///
+/// Each step executes one instruction for all lanes at the same program counter (and the
+/// same opcode there), masking out the others. The lowest program counter goes first, so
+/// lanes that took different sides of a branch meet again where the paths join.
+///
+/// Instructions behave exactly like the CPU class with the Ricoh 2A03 variant and the
+/// instruction-level accuracy tier; lanes give the same registers, memory and cycle counts
+/// as a CPU stepped through runUntil() without idle-loop skipping. Work RAM is mirrored up to $1FFF as on the bus, but the rest of memory is plain: there is no PPU, controller or DMA behind $2000-$401F.
+/// Writes to $8000-$FFFF are ignored, as on the bus.
+///
+/// The per-lane loops are branch-free over fixed-size arrays, so the compiler vectorizes
+/// them for the target's instruction set (SSE2 by default; /arch:AVX2 or /arch:AVX512 for wider registers).
+/// </summary>
+class LockstepCPU
+{
+public:
+	static constexpr size_t lane_count{ 16 };
+
+	using LaneBytes = std::array<byte, lane_count>;
+	using LaneWords = std::array<word, lane_count>;
+
+	LockstepCPU();
+
+	/// <summary>
+	/// Clears the memory, registers and cycle counters of all lanes.
+	/// </summary>
+	void clear();
+
+	/// <summary>
+	/// Copies a block into the memory of every lane (e.g. the program).
+	/// Data past the end of the address space is ignored.
+	/// </summary>
+	void load(word address, const byte* data, size_t length);
+
+	/// <summary>
+	/// Per-lane memory access without side effects, for setting up inputs and reading results.
+	/// </summary>
+	void poke(size_t lane, word address, byte data);
+	byte peek(size_t lane, word address) const;
+
+	void setRegisters(size_t lane, const CPU::Registers& registers);
+	CPU::Registers getRegisters(size_t lane) const;
+
+	uint64_t getCycles(size_t lane) const;
+
+	/// <summary>
+	/// Executes instructions until every lane's cycle counter reaches the given cycle.
+	/// As with CPU::runUntil(), a lane's last instruction may overshoot it by a few cycles.
+	/// </summary>
+	void runUntil(uint64_t cycle);
+
+	/// <summary>
+	/// Issued steps and the lane instructions they executed since construction.
+	/// lane_instructions / (steps * lane_count) is the share of lanes doing useful work.
+	/// </summary>
+	struct Stats
+	{
+		uint64_t steps;
+		uint64_t lane_instructions;
+	};
+
+	Stats getStats() const;
+
+private:
+	/// <summary>
+	/// Executes one instruction for the lanes in mask, which are all at the given address
+	/// and see the same opcode there.
+	/// </summary>
+	void step(word address, byte opcode);
+
+	// Processor status bit indices (as in CPU).
+	enum : byte {
+		C = 0,
+		Z = 1,
+		I = 2,
+		D = 3,
+		B = 4,
+		// skip
+		V = 6,
+		N = 7,
+	};
+
+	/// <summary>
+	/// Masked updates: only lanes in mask change. Conditions are 0x00 (false) or 0xFF (true) per lane.
+	/// </summary>
+	void assign(LaneBytes& target, const LaneBytes& value) const;
+	void setFlag(byte flag_idx, const LaneBytes& condition);
+	void clearFlag(byte flag_idx);
+
+	/// <summary>
+	/// Sets (raise) or clears (lower) the flag in lanes where the condition holds, and leaves
+	/// it alone elsewhere. (Several CPU instructions only ever set or only clear their flags.)
+	/// </summary>
+	void raiseFlag(byte flag_idx, const LaneBytes& condition);
+	void lowerFlag(byte flag_idx, const LaneBytes& condition);
+	void setZeroAndNegativeFlags(const LaneBytes& data);
+	LaneBytes isFlagSet(byte flag_idx) const;
+	LaneBytes isFlagClear(byte flag_idx) const;
+
+	/// <summary>
+	/// Per-lane memory access. Reads gather every lane (addresses of masked-out lanes are
+	/// harmless); writes only store for lanes in mask, and never to ROM.
+	/// </summary>
+	LaneBytes read(const LaneWords& address) const;
+	void write(const LaneWords& address, const LaneBytes& data);
+
+	/// <summary>
+	/// The same address in every lane: a plain row of memory (operand fetch).
+	/// </summary>
+	const LaneBytes& readRow(word address) const;
+
+	/// <summary>
+	/// InstructionHandlers::addBytes / subtractBytes, per lane.
+	/// </summary>
+	LaneBytes addBytes(const LaneBytes& a, const LaneBytes& b);
+	LaneBytes subtractBytes(const LaneBytes& minuend, const LaneBytes& subtrahend);
+
+	/// <summary>
+	/// CPX/CPY/CMP against the given register.
+	/// </summary>
+	void compare(const LaneBytes& reg, const LaneBytes& data);
+
+	/// <summary>
+	/// Takes the branch in lanes where the condition holds (see CPU::branch()).
+	/// </summary>
+	void branch(const LaneBytes& condition, const LaneBytes& offset);
+
+	/// <summary>
+	/// Stack access in lanes in mask (see CPU::push() and CPU::pull()). The stack is page $01
+	/// of each lane's memory.
+	/// </summary>
+	void push(const LaneBytes& data);
+	LaneBytes pull();
+
+	/// <summary>
+	/// Continues at the address pulled from the stack (RTI and RTS).
+	/// </summary>
+	/// <param name="offset">Added to the pulled address (1 for RTS).</param>
+	void pullProgramCounter(word offset);
+
+	/// <summary>
+	/// All instructions, as in CPU. Read-modify-write instructions change data in place
+	/// (see modify()); stores take the addresses to write to.
+	/// </summary>
+	void doADC(const LaneBytes& data);
+	void doAND(const LaneBytes& data);
+	void doASL(LaneBytes& data);
+	void doBIT(const LaneBytes& data);
+	void doBRK();
+	void doDEC(LaneBytes& data);
+	void doEOR(const LaneBytes& data);
+	void doINC(LaneBytes& data);
+	void doJMP(const LaneWords& address);
+	void doJSR(const LaneWords& address);
+	void doLD(LaneBytes& reg, const LaneBytes& data);
+	void doLSR(LaneBytes& data);
+	void doORA(const LaneBytes& data);
+	void doPHP();
+	void doPLA();
+	void doPLP();
+	void doROL(LaneBytes& data);
+	void doROR(LaneBytes& data);
+	void doRTI();
+	void doSBC(const LaneBytes& data);
+
+	/// <summary>
+	/// Addressing modes, as in CPU. Operand bytes are read from the shared program counter.
+	/// </summary>
+	LaneWords getAddr_Immediate();
+	LaneWords getAddr_ZeroPage();
+	LaneWords getAddr_ZeroPageIndexed(const LaneBytes& index);
+	LaneWords getAddr_Absolute();
+	LaneWords getAddr_AbsoluteIndexed(const LaneBytes& index);
+	LaneWords getAddr_IndirectX();
+	LaneWords getAddr_IndirectY();
+	LaneWords getAddr_Indirect();
+
+	/// <summary>
+	/// Read-modify-write helper (see CPU::modify()).
+	/// </summary>
+	void modify(const LaneWords& address, void (LockstepCPU::*instruction)(LaneBytes&));
+
+	// Registers, one lane per machine.
+	LaneWords program_counter{};
+	LaneBytes stack_pointer{};
+	LaneBytes reg_accumulator{};
+	LaneBytes reg_x{};
+	LaneBytes reg_y{};
+	LaneBytes processor_status{};
+	std::array<uint64_t, lane_count> cycles{};
+
+	// memory[address][lane].
+	std::vector<LaneBytes> memory;
+
+	// State of the step being executed.
+	word shared_pc{ 0 };
+	LaneBytes mask{};
+	LaneBytes page_crossed{};
+	LaneBytes extra_cycles{};
+	LaneBytes jumped{};
+	LaneWords jump_target{};
+
+	Stats stats{};
+};
\ No newline at end of file
@@ -1,11 +1,110 @@
 #include "cpu.hpp"
+#include "trace_logger.hpp"
+#include "binary_trace.hpp"
+#include "trace_tool.hpp"
+#include "recompiler.hpp"
+#include "rom_index.hpp"
+#include "frame_ring_tool.hpp"
+#include "emulator_server.hpp"
+#include "benchmark.hpp"
+#include "test.hpp"
 
+#include <memory>
+#include <string>
 
-int main()
+
+int main(int argc, char* argv[])
 {
+	// Tools: emuNES tracetool <command> ...
+	if (argc >= 2 && std::string(argv[1]) == "tracetool")
+	{
+		return TraceTool::run(argc - 2, argv + 2);
+	}
+
+	// emuNES recompile [--no-optimize] <rom.nes> <out.cpp>
+	// emuNES recompile --verify <rom.nes> <unoptimized.so> <optimized.so> [frames]
+	if (argc >= 2 && std::string(argv[1]) == "recompile")
+	{
+		return Recompiler::run(argc - 2, argv + 2);
+	}
+
+	// emuNES index <index> [--database <file>] [rom|dir]...
+	if (argc >= 2 && std::string(argv[1]) == "index")
+	{
+		return RomIndex::run(argc - 2, argv + 2);
+	}
+
+	// emuNES ring publish|consume ...
+	if (argc >= 2 && std::string(argv[1]) == "ring")
+	{
+		return FrameRingTool::run(argc - 2, argv + 2);
+	}
+
+	// emuNES serve <socket> [--workers n]
+	if (argc >= 2 && std::string(argv[1]) == "serve")
+	{
+		return EmulatorServer::run(argc - 2, argv + 2);
+	}
+
+	// emuNES bench [--filter text] [--json file] [--baseline file] ...
+	if (argc >= 2 && std::string(argv[1]) == "bench")
+	{
+		return Benchmark::run(argc - 2, argv + 2);
+	}
+
+	// emuNES test
+	if (argc >= 2 && std::string(argv[1]) == "test")
+	{
+		Test::run();
+		return 0;
+	}
+
 	// Create virtual hardware.
 	CPU cpu;	
 
+	// Options:
+	//	--cpu 2a03|6502|65c02	CPU variant (default: 2a03, the NES CPU)
+	//	--accuracy instruction|bus	accuracy tier (default: instruction; bus adds dummy accesses)
+	//	--trace <file>			text instruction trace, nestest log format
+	//	--binary-trace <file>	compressed binary instruction trace (see tracetool)
+	std::unique_ptr<TraceHook> trace_hook;
+	for (int i{ 1 }; i + 1 < argc; ++i)
+	{
+		std::string option{ argv[i] };
+
+		if (option == "--cpu")
+		{
+			std::string name{ argv[++i] };
+
+			if (name == "6502")
+			{
+				cpu.setVariant(CPUVariant::NMOS6502);
+			}
+			else if (name == "65c02")
+			{
+				cpu.setVariant(CPUVariant::WDC65C02);
+			}
+			else
+			{
+				cpu.setVariant(CPUVariant::Ricoh2A03);
+			}
+		}
+		else if (option == "--accuracy")
+		{
+			std::string name{ argv[++i] };
+			cpu.setAccuracy((name == "bus") ? CPUAccuracy::BusExact : CPUAccuracy::Instruction);
+		}
+		else if (option == "--trace")
+		{
+			trace_hook = std::make_unique<TraceLogger>(argv[++i]);
+		}
+		else if (option == "--binary-trace")
+		{
+			trace_hook = std::make_unique<BinaryTraceWriter>(argv[++i]);
+		}
+	}
+	cpu.setTraceHook(trace_hook.get());
+
 	// Load rom.
 	{
 		std::vector<byte> rom{ 0x00 };
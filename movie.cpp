@@ -0,0 +1,158 @@
+#include "movie.hpp"
+#include "nes.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+
+
+namespace
+{
+	constexpr char movie_magic[8]{ 'N', 'E', 'S', 'M', 'O', 'V', 'I', 'E' };
+	constexpr uint32_t movie_version{ 1 };
+	constexpr size_t header_size{ 8 + 4 + 4 };
+	constexpr size_t frame_size{ 1 + 1 + 4 };
+
+	using File = std::unique_ptr<std::FILE, int(*)(std::FILE*)>;
+
+
+	File openFile(const std::string& path, const char* mode)
+	{
+		File file{ std::fopen(path.c_str(), mode), &std::fclose };
+		if (file == nullptr)
+		{
+			throw std::runtime_error("Movie: could not open " + path);
+		}
+
+		return file;
+	}
+
+
+	void putLE32(byte* out, uint32_t value)
+	{
+		for (size_t i{ 0 }; i < 4; ++i)
+		{
+			out[i] = static_cast<byte>(value >> (8 * i));
+		}
+	}
+
+
+	uint32_t getLE32(const byte* in)
+	{
+		return static_cast<uint32_t>(in[0]) | (static_cast<uint32_t>(in[1]) << 8)
+			| (static_cast<uint32_t>(in[2]) << 16) | (static_cast<uint32_t>(in[3]) << 24);
+	}
+}
+
+
+void Movie::recordFrame(NES& nes, byte port_1, byte port_2)
+{
+	if (frames.empty())
+	{
+		nes.power();
+	}
+
+	nes.setInput(port_1, port_2);
+	nes.runFrame();
+
+	frames.push_back({ port_1, port_2, static_cast<uint32_t>(nes.getStateHash()) });
+}
+
+
+Movie::ReplayResult Movie::replay(NES& nes, bool stop_on_desync) const
+{
+	ReplayResult result;
+
+	nes.power();
+
+	for (const MovieFrame& frame : frames)
+	{
+		// Verification only needs the state hashes, not the pictures.
+		nes.setInput(frame.port_1, frame.port_2);
+		nes.runFrame(false);
+
+		uint32_t hash{ static_cast<uint32_t>(nes.getStateHash()) };
+		if (hash != frame.state_hash && result.in_sync)
+		{
+			result.in_sync = false;
+			result.desync_frame = result.frames_played;
+			result.expected_hash = frame.state_hash;
+			result.actual_hash = hash;
+		}
+
+		++result.frames_played;
+
+		if (!result.in_sync && stop_on_desync)
+		{
+			break;
+		}
+	}
+
+	return result;
+}
+
+
+void Movie::save(const std::string& path) const
+{
+	std::vector<byte> data(header_size + frames.size() * frame_size);
+
+	std::memcpy(data.data(), movie_magic, 8);
+	putLE32(data.data() + 8, movie_version);
+	putLE32(data.data() + 12, static_cast<uint32_t>(frames.size()));
+
+	byte* out{ data.data() + header_size };
+	for (const MovieFrame& frame : frames)
+	{
+		out[0] = frame.port_1;
+		out[1] = frame.port_2;
+		putLE32(out + 2, frame.state_hash);
+		out += frame_size;
+	}
+
+	File file{ openFile(path, "wb") };
+	if (std::fwrite(data.data(), 1, data.size(), file.get()) != data.size())
+	{
+		throw std::runtime_error("Movie: could not write " + path);
+	}
+}
+
+
+Movie Movie::load(const std::string& path)
+{
+	File file{ openFile(path, "rb") };
+
+	byte header[header_size];
+	if (std::fread(header, 1, header_size, file.get()) != header_size
+		|| std::memcmp(header, movie_magic, 8) != 0
+		|| getLE32(header + 8) != movie_version)
+	{
+		throw std::runtime_error("Movie: " + path + " is not a movie file");
+	}
+
+	std::vector<byte> data(static_cast<size_t>(getLE32(header + 12)) * frame_size);
+	if (std::fread(data.data(), 1, data.size(), file.get()) != data.size())
+	{
+		throw std::runtime_error("Movie: " + path + " is truncated");
+	}
+
+	Movie movie;
+	movie.frames.resize(data.size() / frame_size);
+
+	const byte* in{ data.data() };
+	for (MovieFrame& frame : movie.frames)
+	{
+		frame.port_1 = in[0];
+		frame.port_2 = in[1];
+		frame.state_hash = getLE32(in + 2);
+		in += frame_size;
+	}
+
+	return movie;
+}
+
+
+const std::vector<MovieFrame>& Movie::getFrames() const
+{
+	return frames;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "types.hpp"
+
+class NES;
+
+
+/// <summary>
+/// Input for one frame, plus the state hash the frame must end in.
+/// </summary>
+struct MovieFrame
+{
+	byte port_1{ 0x00 };
+	byte port_2{ 0x00 };
+
+	// Low 32 bits of NES::getStateHash() after the frame.
+	uint32_t state_hash{ 0 };
+};
+
+
+/// <summary>
+/// Controller input recorded frame by frame, for bit-exact replays.
+/// Movies always start from NES::power() with the same ROM loaded.
+/// 
+/// File layout (little-endian): "NESMOVIE", u32 version, u32 frame count,
+/// then 6 bytes per frame: port 1 buttons, port 2 buttons, u32 state hash.
+/// </summary>
+class Movie
+{
+public:
+	/// <summary>
+	/// Emulates one frame with the given input and appends it to the movie.
+	/// The first recorded frame powers the console up.
+	/// </summary>
+	void recordFrame(NES& nes, byte port_1, byte port_2);
+
+	struct ReplayResult
+	{
+		bool in_sync{ true };
+
+		// Number of frames emulated.
+		uint64_t frames_played{ 0 };
+
+		// First frame (0-based) whose state hash did not match; only valid if !in_sync.
+		uint64_t desync_frame{ 0 };
+		uint32_t expected_hash{ 0 };
+		uint32_t actual_hash{ 0 };
+	};
+
+	/// <summary>
+	/// Powers the console up and plays the movie back as fast as possible (without rendering),
+	/// checking the state hash after every frame.
+	/// </summary>
+	/// <param name="nes">Console with the movie's ROM loaded.</param>
+	/// <param name="stop_on_desync">Stop at the first mismatching frame instead of playing to the end.</param>
+	ReplayResult replay(NES& nes, bool stop_on_desync = true) const;
+
+	/// <summary>
+	/// Throws std::runtime_error on I/O errors or invalid files.
+	/// </summary>
+	void save(const std::string& path) const;
+	static Movie load(const std::string& path);
+
+	const std::vector<MovieFrame>& getFrames() const;
+
+private:
+	std::vector<MovieFrame> frames;
+};
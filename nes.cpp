@@ -0,0 +1,259 @@
+#include "nes.hpp"
+#include "hash.hpp"
+#include "battery_ram.hpp"
+
+#include <algorithm>
+
+
+void NES::loadROM(std::vector<byte>& rom)
+{
+	cpu.loadROM(rom);
+}
+
+
+void NES::loadCartridge(const Cartridge& cartridge)
+{
+	Bus& bus{ cpu.getBus() };
+	const std::vector<byte>& prg{ cartridge.getPRG() };
+
+	bus.load(Bus::rom_start, prg);
+	if (prg.size() == 0x4000)
+	{
+		bus.load(0xC000, prg);
+	}
+
+	bus.getPPU().loadCartridge(cartridge);
+
+	// Compiled for the previous ROM.
+	cpu.setRecompiledModule(nullptr);
+}
+
+
+void NES::setBatteryRAM(BatteryRAM* ram)
+{
+	if (ram != nullptr)
+	{
+		cpu.getBus().attachPRGRAM(ram->getData());
+	}
+	else
+	{
+		cpu.getBus().detachPRGRAM();
+	}
+}
+
+
+void NES::power()
+{
+	cpu.getBus().clearRAM();
+	cpu.getBus().getPPU().power();
+	reset();
+}
+
+
+void NES::reset()
+{
+	Bus& bus{ cpu.getBus() };
+
+	cpu.reset();
+	bus.getPPU().reset();
+	frame = 0;
+
+	// Like the reset sequence: three dummy stack pushes, interrupts disabled, jump through the vector.
+	CPU::Registers registers{ cpu.getRegisters() };
+	registers.program_counter = bus.peek(0xFFFC) | (bus.peek(0xFFFD) << 8);
+	registers.stack_pointer = 0xFD;
+	registers.processor_status = 0x24;
+	cpu.setRegisters(registers);
+}
+
+
+/*
+	The scheduler lives for one frame: both components start at the frame boundary, so
+	nothing but the CPU and PPU state carries over (and snapshots, forks and copies of the
+	console need no scheduler state).
+*/
+void NES::runFrame(bool render)
+{
+	uint64_t frame_start{ frame * ppu_dots_per_frame };
+
+	++frame;
+
+	Scheduler scheduler;
+	scheduler.add(runPPU(scheduler, render), frame_start);
+	scheduler.add(runCPU(scheduler), std::max(cpu.getCycles() * ppu_dots_per_cpu_cycle, frame_start));
+	scheduler.runUntil(frame_start + ppu_dots_per_frame);
+}
+
+
+Scheduler::Task NES::runPPU(Scheduler& scheduler, bool render)
+{
+	PPU& ppu{ cpu.getBus().getPPU() };
+
+	for (int scanline{ 0 }; scanline < PPU::scanlines_per_frame; ++scanline)
+	{
+		if (ppu.runScanline(scanline, render))
+		{
+			cpu.nmi();
+		}
+
+		co_await scheduler.advance(PPU::dots_per_scanline);
+	}
+}
+
+
+Scheduler::Task NES::runCPU(Scheduler& scheduler)
+{
+	for (;;)
+	{
+		// The next component's time is the next event, so idle loops are skipped up to it.
+		// It is not a whole number of CPU cycles: the CPU is caught up once its next cycle
+		// would end past it, and the remainder carries over.
+		uint64_t horizon{ scheduler.getHorizon() };
+		cpu.runUntil(horizon / ppu_dots_per_cpu_cycle);
+
+		co_await scheduler.advanceTo(std::max(cpu.getCycles() * ppu_dots_per_cpu_cycle, horizon));
+	}
+}
+
+
+uint64_t NES::getFrame() const
+{
+	return frame;
+}
+
+
+void NES::setInput(byte port_1, byte port_2)
+{
+	cpu.getBus().getController(0).setButtons(port_1);
+	cpu.getBus().getController(1).setButtons(port_2);
+}
+
+
+const uint32_t* NES::getFramebuffer() const
+{
+	return cpu.getBus().getPPU().getFramebuffer();
+}
+
+
+uint64_t NES::getStateHash() const
+{
+	CPU::Registers registers{ cpu.getRegisters() };
+	uint64_t cycles{ cpu.getCycles() };
+
+	byte state[16]{
+		static_cast<byte>(registers.program_counter & 0xFF),
+		static_cast<byte>(registers.program_counter >> 8),
+		registers.stack_pointer,
+		registers.reg_accumulator,
+		registers.reg_x,
+		registers.reg_y,
+		registers.processor_status,
+	};
+
+	for (size_t i{ 0 }; i < 8; ++i)
+	{
+		state[8 + i] = static_cast<byte>(cycles >> (8 * i));
+	}
+
+	byte ram[Bus::ram_size];
+	cpu.getBus().copyRAM(ram);
+
+	uint64_t hash{ xxHash64(ram, sizeof(ram)) };
+	hash = xxHash64(state, sizeof(state), hash);
+
+	// PPU memory, then its registers packed without padding.
+	PPU::State ppu;
+	cpu.getBus().getPPU().saveState(ppu);
+
+	hash = xxHash64(ppu.nametables.data(), ppu.nametables.size(), hash);
+	hash = xxHash64(ppu.palette.data(), ppu.palette.size(), hash);
+	hash = xxHash64(ppu.oam.data(), ppu.oam.size(), hash);
+	hash = xxHash64(ppu.chr_ram.data(), ppu.chr_ram.size(), hash);
+
+	byte ppu_registers[12]{
+		ppu.control,
+		ppu.mask,
+		ppu.status,
+		ppu.oam_address,
+		ppu.read_buffer,
+		ppu.io_latch,
+		static_cast<byte>(ppu.vram_address & 0xFF),
+		static_cast<byte>(ppu.vram_address >> 8),
+		static_cast<byte>(ppu.temp_address & 0xFF),
+		static_cast<byte>(ppu.temp_address >> 8),
+		ppu.fine_x,
+		static_cast<byte>(ppu.write_toggle),
+	};
+
+	return xxHash64(ppu_registers, sizeof(ppu_registers), hash);
+}
+
+
+uint64_t NES::getZobristHash() const
+{
+	CPU::Registers registers{ cpu.getRegisters() };
+
+	// Registers take the positions after the 64 KiB address space.
+	constexpr uint32_t registers_position{ 0x10000 };
+
+	return cpu.getBus().getMemoryHash()
+		^ zobristKey(registers_position + 0, registers.program_counter & 0xFF)
+		^ zobristKey(registers_position + 1, registers.program_counter >> 8)
+		^ zobristKey(registers_position + 2, registers.stack_pointer)
+		^ zobristKey(registers_position + 3, registers.reg_accumulator)
+		^ zobristKey(registers_position + 4, registers.reg_x)
+		^ zobristKey(registers_position + 5, registers.reg_y)
+		^ zobristKey(registers_position + 6, registers.processor_status);
+}
+
+
+void NES::save(Snapshot& snapshot) const
+{
+	cpu.saveState(snapshot.cpu);
+	snapshot.frame = frame;
+}
+
+
+void NES::restore(const Snapshot& snapshot)
+{
+	cpu.loadState(snapshot.cpu);
+	frame = snapshot.frame;
+}
+
+
+NES::Stats NES::getStats() const
+{
+	const TileCache& tile_cache{ cpu.getBus().getPPU().getTileCache() };
+
+	Stats stats;
+	stats.idle_cycles_skipped = cpu.getIdleCyclesSkipped();
+	stats.tile_cache_bytes = tile_cache.getMemoryFootprint();
+	stats.tiles_decoded = tile_cache.getTilesDecoded();
+	return stats;
+}
+
+
+void NES::fork(Fork& child) const
+{
+	cpu.fork(child.cpu);
+	child.frame = frame;
+}
+
+
+void NES::loadFork(const Fork& fork)
+{
+	cpu.loadFork(fork.cpu);
+	frame = fork.frame;
+}
+
+
+CPU& NES::getCPU()
+{
+	return cpu;
+}
+
+
+const CPU& NES::getCPU() const
+{
+	return cpu;
+}
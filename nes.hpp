@@ -0,0 +1,147 @@
+#pragma once
+
+#include <vector>
+
+#include "types.hpp"
+#include "cpu.hpp"
+#include "cartridge.hpp"
+#include "scheduler.hpp"
+
+class BatteryRAM;
+
+
+/// <summary>
+/// The console: CPU and its bus (with the PPU), driven one video frame at a time.
+/// </summary>
+class NES
+{
+public:
+	// NTSC: 341 PPU dots x 262 scanlines per frame, 3 PPU dots per CPU cycle.
+	static constexpr uint64_t ppu_dots_per_frame{ 341 * 262 };
+	static constexpr uint64_t ppu_dots_per_cpu_cycle{ 3 };
+
+	// Bump when a change makes emulation reach different states, or changes the Snapshot
+	// layout: stored states (see BootCache) of older versions are then ignored.
+	static constexpr uint32_t state_version{ 1 };
+
+	void loadROM(std::vector<byte>& rom);
+
+	/// <summary>
+	/// Maps the cartridge's PRG ROM at $8000 (16 KiB images are mirrored at $C000)
+	/// and gives its CHR memory to the PPU.
+	/// </summary>
+	void loadCartridge(const Cartridge& cartridge);
+
+	/// <summary>
+	/// Maps $6000-$7FFF onto the battery-backed save file, or unmaps it (nullptr), keeping
+	/// the contents in memory. The RAM is not owned by the console and must outlive it
+	/// being set. power() and reset() leave it alone, like the battery does.
+	/// </summary>
+	void setBatteryRAM(BatteryRAM* ram);
+
+	/// <summary>
+	/// Power-up: clears work RAM and PPU memory, and resets. Emulation from power-up is deterministic.
+	/// </summary>
+	void power();
+
+	/// <summary>
+	/// Reset button: the CPU continues at the reset vector ($FFFC). Memory is kept.
+	/// </summary>
+	void reset();
+
+	/// <summary>
+	/// Emulates one video frame, scanline by scanline. The CPU and PPU run as coroutines on a
+	/// Scheduler clocked in PPU dots.
+	/// </summary>
+	/// <param name="render">
+	/// Produce the frame's pixels. Without rendering the PPU still does everything the CPU 
+	/// can observe, so the state (and state hash) is the same either way; only the framebuffer
+	/// keeps the last rendered frame. Headless runs can render just the frames they sample.
+	/// </param>
+	void runFrame(bool render = true);
+
+	/// <summary>
+	/// Number of frames emulated since power-up/reset.
+	/// </summary>
+	uint64_t getFrame() const;
+
+	/// <summary>
+	/// Sets the buttons held on both controllers (see Controller for the bits).
+	/// </summary>
+	void setInput(byte port_1, byte port_2);
+
+	/// <summary>
+	/// The last rendered frame, PPU::screen_width x PPU::screen_height pixels as 0x00RRGGBB.
+	/// </summary>
+	const uint32_t* getFramebuffer() const;
+
+	/// <summary>
+	/// xxHash64 of work RAM, the CPU registers, the cycle counter and the PPU state.
+	/// Two runs are in sync as long as their state hashes match.
+	/// </summary>
+	uint64_t getStateHash() const;
+
+	/// <summary>
+	/// Zobrist hash of the writable memory and the CPU registers, for deduplicating visited
+	/// states in searches (see StateHashSet). O(1): the memory part is maintained by the bus on
+	/// every write. Unlike getStateHash() it leaves out the cycle counter and the PPU, so the
+	/// same game state reached at different times hashes the same.
+	/// </summary>
+	uint64_t getZobristHash() const;
+
+	/// <summary>
+	/// Machine state for save states and run-ahead. Saving or restoring is a
+	/// copy of a few dozen KiB with no allocation.
+	/// </summary>
+	struct Snapshot
+	{
+		CPU::State cpu;
+		uint64_t frame;
+	};
+
+	void save(Snapshot& snapshot) const;
+	void restore(const Snapshot& snapshot);
+
+	/// <summary>
+	/// Machine state for tree search over game states. Unlike a Snapshot, memory is shared
+	/// copy-on-write in 256-byte pages between the console and its forks, so many children
+	/// of one state cost little more than the pages each of them writes.
+	/// Forking and loading a fork allocate nothing until a shared page is written.
+	/// </summary>
+	struct Fork
+	{
+		CPU::Fork cpu;
+		uint64_t frame;
+	};
+
+	void fork(Fork& child) const;
+	void loadFork(const Fork& fork);
+
+	/// <summary>
+	/// Counters of the emulator's fast paths, for tuning and reports.
+	/// </summary>
+	struct Stats
+	{
+		uint64_t idle_cycles_skipped;
+
+		// Decoded CHR tile cache (see TileCache).
+		size_t tile_cache_bytes;
+		uint64_t tiles_decoded;
+	};
+
+	Stats getStats() const;
+
+	CPU& getCPU();
+	const CPU& getCPU() const;
+
+private:
+	/// <summary>
+	/// Components of runFrame(). The PPU renders a scanline at its start (and raises the NMI);
+	/// the CPU runs up to the next scanline in one batch.
+	/// </summary>
+	Scheduler::Task runPPU(Scheduler& scheduler, bool render);
+	Scheduler::Task runCPU(Scheduler& scheduler);
+
+	CPU cpu;
+	uint64_t frame{ 0 };
+};
@@ -0,0 +1,261 @@
+#include "opcodes.hpp"
+
+
+const std::array<OpcodeInfo, 256> opcode_table{ {
+	/* 00 */ { "BRK", AddressingMode::Implied, 7, false },
+	/* 01 */ { "ORA", AddressingMode::IndirectX, 6, false },
+	/* 02 */ { "???", AddressingMode::Implied, 2, false },
+	/* 03 */ { "???", AddressingMode::Implied, 2, false },
+	/* 04 */ { "???", AddressingMode::Implied, 2, false },
+	/* 05 */ { "ORA", AddressingMode::ZeroPage, 3, false },
+	/* 06 */ { "ASL", AddressingMode::ZeroPage, 5, false },
+	/* 07 */ { "???", AddressingMode::Implied, 2, false },
+	/* 08 */ { "PHP", AddressingMode::Implied, 3, false },
+	/* 09 */ { "ORA", AddressingMode::Immediate, 2, false },
+	/* 0A */ { "ASL", AddressingMode::Accumulator, 2, false },
+	/* 0B */ { "???", AddressingMode::Implied, 2, false },
+	/* 0C */ { "???", AddressingMode::Implied, 2, false },
+	/* 0D */ { "ORA", AddressingMode::Absolute, 4, false },
+	/* 0E */ { "ASL", AddressingMode::Absolute, 6, false },
+	/* 0F */ { "???", AddressingMode::Implied, 2, false },
+	/* 10 */ { "BPL", AddressingMode::Relative, 2, false },
+	/* 11 */ { "ORA", AddressingMode::IndirectY, 5, true },
+	/* 12 */ { "???", AddressingMode::Implied, 2, false },
+	/* 13 */ { "???", AddressingMode::Implied, 2, false },
+	/* 14 */ { "???", AddressingMode::Implied, 2, false },
+	/* 15 */ { "ORA", AddressingMode::ZeroPageX, 4, false },
+	/* 16 */ { "ASL", AddressingMode::ZeroPageX, 6, false },
+	/* 17 */ { "???", AddressingMode::Implied, 2, false },
+	/* 18 */ { "CLC", AddressingMode::Implied, 2, false },
+	/* 19 */ { "ORA", AddressingMode::AbsoluteY, 4, true },
+	/* 1A */ { "???", AddressingMode::Implied, 2, false },
+	/* 1B */ { "???", AddressingMode::Implied, 2, false },
+	/* 1C */ { "???", AddressingMode::Implied, 2, false },
+	/* 1D */ { "ORA", AddressingMode::AbsoluteX, 4, true },
+	/* 1E */ { "ASL", AddressingMode::AbsoluteX, 7, false },
+	/* 1F */ { "???", AddressingMode::Implied, 2, false },
+	/* 20 */ { "JSR", AddressingMode::Absolute, 6, false },
+	/* 21 */ { "AND", AddressingMode::IndirectX, 6, false },
+	/* 22 */ { "???", AddressingMode::Implied, 2, false },
+	/* 23 */ { "???", AddressingMode::Implied, 2, false },
+	/* 24 */ { "BIT", AddressingMode::ZeroPage, 3, false },
+	/* 25 */ { "AND", AddressingMode::ZeroPage, 3, false },
+	/* 26 */ { "ROL", AddressingMode::ZeroPage, 5, false },
+	/* 27 */ { "???", AddressingMode::Implied, 2, false },
+	/* 28 */ { "PLP", AddressingMode::Implied, 4, false },
+	/* 29 */ { "AND", AddressingMode::Immediate, 2, false },
+	/* 2A */ { "ROL", AddressingMode::Accumulator, 2, false },
+	/* 2B */ { "???", AddressingMode::Implied, 2, false },
+	/* 2C */ { "BIT", AddressingMode::Absolute, 4, false },
+	/* 2D */ { "AND", AddressingMode::Absolute, 4, false },
+	/* 2E */ { "ROL", AddressingMode::Absolute, 6, false },
+	/* 2F */ { "???", AddressingMode::Implied, 2, false },
+	/* 30 */ { "BMI", AddressingMode::Relative, 2, false },
+	/* 31 */ { "AND", AddressingMode::IndirectY, 5, true },
+	/* 32 */ { "???", AddressingMode::Implied, 2, false },
+	/* 33 */ { "???", AddressingMode::Implied, 2, false },
+	/* 34 */ { "???", AddressingMode::Implied, 2, false },
+	/* 35 */ { "AND", AddressingMode::ZeroPageX, 4, false },
+	/* 36 */ { "ROL", AddressingMode::ZeroPageX, 6, false },
+	/* 37 */ { "???", AddressingMode::Implied, 2, false },
+	/* 38 */ { "SEC", AddressingMode::Implied, 2, false },
+	/* 39 */ { "AND", AddressingMode::AbsoluteY, 4, true },
+	/* 3A */ { "???", AddressingMode::Implied, 2, false },
+	/* 3B */ { "???", AddressingMode::Implied, 2, false },
+	/* 3C */ { "???", AddressingMode::Implied, 2, false },
+	/* 3D */ { "AND", AddressingMode::AbsoluteX, 4, true },
+	/* 3E */ { "ROL", AddressingMode::AbsoluteX, 7, false },
+	/* 3F */ { "???", AddressingMode::Implied, 2, false },
+	/* 40 */ { "RTI", AddressingMode::Implied, 6, false },
+	/* 41 */ { "EOR", AddressingMode::IndirectX, 6, false },
+	/* 42 */ { "???", AddressingMode::Implied, 2, false },
+	/* 43 */ { "???", AddressingMode::Implied, 2, false },
+	/* 44 */ { "???", AddressingMode::Implied, 2, false },
+	/* 45 */ { "EOR", AddressingMode::ZeroPage, 3, false },
+	/* 46 */ { "LSR", AddressingMode::ZeroPage, 5, false },
+	/* 47 */ { "???", AddressingMode::Implied, 2, false },
+	/* 48 */ { "PHA", AddressingMode::Implied, 3, false },
+	/* 49 */ { "EOR", AddressingMode::Immediate, 2, false },
+	/* 4A */ { "LSR", AddressingMode::Accumulator, 2, false },
+	/* 4B */ { "???", AddressingMode::Implied, 2, false },
+	/* 4C */ { "JMP", AddressingMode::Absolute, 3, false },
+	/* 4D */ { "EOR", AddressingMode::Absolute, 4, false },
+	/* 4E */ { "LSR", AddressingMode::Absolute, 6, false },
+	/* 4F */ { "???", AddressingMode::Implied, 2, false },
+	/* 50 */ { "BVC", AddressingMode::Relative, 2, false },
+	/* 51 */ { "EOR", AddressingMode::IndirectY, 5, true },
+	/* 52 */ { "???", AddressingMode::Implied, 2, false },
+	/* 53 */ { "???", AddressingMode::Implied, 2, false },
+	/* 54 */ { "???", AddressingMode::Implied, 2, false },
+	/* 55 */ { "EOR", AddressingMode::ZeroPageX, 4, false },
+	/* 56 */ { "LSR", AddressingMode::ZeroPageX, 6, false },
+	/* 57 */ { "???", AddressingMode::Implied, 2, false },
+	/* 58 */ { "CLI", AddressingMode::Implied, 2, false },
+	/* 59 */ { "EOR", AddressingMode::AbsoluteY, 4, true },
+	/* 5A */ { "???", AddressingMode::Implied, 2, false },
+	/* 5B */ { "???", AddressingMode::Implied, 2, false },
+	/* 5C */ { "???", AddressingMode::Implied, 2, false },
+	/* 5D */ { "EOR", AddressingMode::AbsoluteX, 4, true },
+	/* 5E */ { "LSR", AddressingMode::AbsoluteX, 7, false },
+	/* 5F */ { "???", AddressingMode::Implied, 2, false },
+	/* 60 */ { "RTS", AddressingMode::Implied, 6, false },
+	/* 61 */ { "ADC", AddressingMode::IndirectX, 6, false },
+	/* 62 */ { "???", AddressingMode::Implied, 2, false },
+	/* 63 */ { "???", AddressingMode::Implied, 2, false },
+	/* 64 */ { "???", AddressingMode::Implied, 2, false },
+	/* 65 */ { "ADC", AddressingMode::ZeroPage, 3, false },
+	/* 66 */ { "ROR", AddressingMode::ZeroPage, 5, false },
+	/* 67 */ { "???", AddressingMode::Implied, 2, false },
+	/* 68 */ { "PLA", AddressingMode::Implied, 4, false },
+	/* 69 */ { "ADC", AddressingMode::Immediate, 2, false },
+	/* 6A */ { "ROR", AddressingMode::Accumulator, 2, false },
+	/* 6B */ { "???", AddressingMode::Implied, 2, false },
+	/* 6C */ { "JMP", AddressingMode::Indirect, 5, false },
+	/* 6D */ { "ADC", AddressingMode::Absolute, 4, false },
+	/* 6E */ { "ROR", AddressingMode::Absolute, 6, false },
+	/* 6F */ { "???", AddressingMode::Implied, 2, false },
+	/* 70 */ { "BVS", AddressingMode::Relative, 2, false },
+	/* 71 */ { "ADC", AddressingMode::IndirectY, 5, true },
+	/* 72 */ { "???", AddressingMode::Implied, 2, false },
+	/* 73 */ { "???", AddressingMode::Implied, 2, false },
+	/* 74 */ { "???", AddressingMode::Implied, 2, false },
+	/* 75 */ { "ADC", AddressingMode::ZeroPageX, 4, false },
+	/* 76 */ { "ROR", AddressingMode::ZeroPageX, 6, false },
+	/* 77 */ { "???", AddressingMode::Implied, 2, false },
+	/* 78 */ { "SEI", AddressingMode::Implied, 2, false },
+	/* 79 */ { "ADC", AddressingMode::AbsoluteY, 4, true },
+	/* 7A */ { "???", AddressingMode::Implied, 2, false },
+	/* 7B */ { "???", AddressingMode::Implied, 2, false },
+	/* 7C */ { "???", AddressingMode::Implied, 2, false },
+	/* 7D */ { "ADC", AddressingMode::AbsoluteX, 4, true },
+	/* 7E */ { "ROR", AddressingMode::AbsoluteX, 7, false },
+	/* 7F */ { "???", AddressingMode::Implied, 2, false },
+	/* 80 */ { "???", AddressingMode::Implied, 2, false },
+	/* 81 */ { "STA", AddressingMode::IndirectX, 6, false },
+	/* 82 */ { "???", AddressingMode::Implied, 2, false },
+	/* 83 */ { "???", AddressingMode::Implied, 2, false },
+	/* 84 */ { "STY", AddressingMode::ZeroPage, 3, false },
+	/* 85 */ { "STA", AddressingMode::ZeroPage, 3, false },
+	/* 86 */ { "STX", AddressingMode::ZeroPage, 3, false },
+	/* 87 */ { "???", AddressingMode::Implied, 2, false },
+	/* 88 */ { "DEY", AddressingMode::Implied, 2, false },
+	/* 89 */ { "???", AddressingMode::Implied, 2, false },
+	/* 8A */ { "TXA", AddressingMode::Implied, 2, false },
+	/* 8B */ { "???", AddressingMode::Implied, 2, false },
+	/* 8C */ { "STY", AddressingMode::Absolute, 4, false },
+	/* 8D */ { "STA", AddressingMode::Absolute, 4, false },
+	/* 8E */ { "STX", AddressingMode::Absolute, 4, false },
+	/* 8F */ { "???", AddressingMode::Implied, 2, false },
+	/* 90 */ { "BCC", AddressingMode::Relative, 2, false },
+	/* 91 */ { "STA", AddressingMode::IndirectY, 6, false },
+	/* 92 */ { "???", AddressingMode::Implied, 2, false },
+	/* 93 */ { "???", AddressingMode::Implied, 2, false },
+	/* 94 */ { "STY", AddressingMode::ZeroPageX, 4, false },
+	/* 95 */ { "STA", AddressingMode::ZeroPageX, 4, false },
+	/* 96 */ { "STX", AddressingMode::ZeroPageY, 4, false },
+	/* 97 */ { "???", AddressingMode::Implied, 2, false },
+	/* 98 */ { "TYA", AddressingMode::Implied, 2, false },
+	/* 99 */ { "STA", AddressingMode::AbsoluteY, 5, false },
+	/* 9A */ { "TXS", AddressingMode::Implied, 2, false },
+	/* 9B */ { "???", AddressingMode::Implied, 2, false },
+	/* 9C */ { "???", AddressingMode::Implied, 2, false },
+	/* 9D */ { "STA", AddressingMode::AbsoluteX, 5, false },
+	/* 9E */ { "???", AddressingMode::Implied, 2, false },
+	/* 9F */ { "???", AddressingMode::Implied, 2, false },
+	/* A0 */ { "LDY", AddressingMode::Immediate, 2, false },
+	/* A1 */ { "LDA", AddressingMode::IndirectX, 6, false },
+	/* A2 */ { "LDX", AddressingMode::Immediate, 2, false },
+	/* A3 */ { "???", AddressingMode::Implied, 2, false },
+	/* A4 */ { "LDY", AddressingMode::ZeroPage, 3, false },
+	/* A5 */ { "LDA", AddressingMode::ZeroPage, 3, false },
+	/* A6 */ { "LDX", AddressingMode::ZeroPage, 3, false },
+	/* A7 */ { "???", AddressingMode::Implied, 2, false },
+	/* A8 */ { "TAY", AddressingMode::Implied, 2, false },
+	/* A9 */ { "LDA", AddressingMode::Immediate, 2, false },
+	/* AA */ { "TAX", AddressingMode::Implied, 2, false },
+	/* AB */ { "???", AddressingMode::Implied, 2, false },
+	/* AC */ { "LDY", AddressingMode::Absolute, 4, false },
+	/* AD */ { "LDA", AddressingMode::Absolute, 4, false },
+	/* AE */ { "LDX", AddressingMode::Absolute, 4, false },
+	/* AF */ { "???", AddressingMode::Implied, 2, false },
+	/* B0 */ { "BCS", AddressingMode::Relative, 2, false },
+	/* B1 */ { "LDA", AddressingMode::IndirectY, 5, true },
+	/* B2 */ { "???", AddressingMode::Implied, 2, false },
+	/* B3 */ { "???", AddressingMode::Implied, 2, false },
+	/* B4 */ { "LDY", AddressingMode::ZeroPageX, 4, false },
+	/* B5 */ { "LDA", AddressingMode::ZeroPageX, 4, false },
+	/* B6 */ { "LDX", AddressingMode::ZeroPageY, 4, false },
+	/* B7 */ { "???", AddressingMode::Implied, 2, false },
+	/* B8 */ { "CLV", AddressingMode::Implied, 2, false },
+	/* B9 */ { "LDA", AddressingMode::AbsoluteY, 4, true },
+	/* BA */ { "TSX", AddressingMode::Implied, 2, false },
+	/* BB */ { "???", AddressingMode::Implied, 2, false },
+	/* BC */ { "LDY", AddressingMode::AbsoluteX, 4, true },
+	/* BD */ { "LDA", AddressingMode::AbsoluteX, 4, true },
+	/* BE */ { "LDX", AddressingMode::AbsoluteY, 4, true },
+	/* BF */ { "???", AddressingMode::Implied, 2, false },
+	/* C0 */ { "CPY", AddressingMode::Immediate, 2, false },
+	/* C1 */ { "CMP", AddressingMode::IndirectX, 6, false },
+	/* C2 */ { "???", AddressingMode::Implied, 2, false },
+	/* C3 */ { "???", AddressingMode::Implied, 2, false },
+	/* C4 */ { "CPY", AddressingMode::ZeroPage, 3, false },
+	/* C5 */ { "CMP", AddressingMode::ZeroPage, 3, false },
+	/* C6 */ { "DEC", AddressingMode::ZeroPage, 5, false },
+	/* C7 */ { "???", AddressingMode::Implied, 2, false },
+	/* C8 */ { "INY", AddressingMode::Implied, 2, false },
+	/* C9 */ { "CMP", AddressingMode::Immediate, 2, false },
+	/* CA */ { "DEX", AddressingMode::Implied, 2, false },
+	/* CB */ { "???", AddressingMode::Implied, 2, false },
+	/* CC */ { "CPY", AddressingMode::Absolute, 4, false },
+	/* CD */ { "CMP", AddressingMode::Absolute, 4, false },
+	/* CE */ { "DEC", AddressingMode::Absolute, 6, false },
+	/* CF */ { "???", AddressingMode::Implied, 2, false },
+	/* D0 */ { "BNE", AddressingMode::Relative, 2, false },
+	/* D1 */ { "CMP", AddressingMode::IndirectY, 5, true },
+	/* D2 */ { "???", AddressingMode::Implied, 2, false },
+	/* D3 */ { "???", AddressingMode::Implied, 2, false },
+	/* D4 */ { "???", AddressingMode::Implied, 2, false },
+	/* D5 */ { "CMP", AddressingMode::ZeroPageX, 4, false },
+	/* D6 */ { "DEC", AddressingMode::ZeroPageX, 6, false },
+	/* D7 */ { "???", AddressingMode::Implied, 2, false },
+	/* D8 */ { "CLD", AddressingMode::Implied, 2, false },
+	/* D9 */ { "CMP", AddressingMode::AbsoluteY, 4, true },
+	/* DA */ { "???", AddressingMode::Implied, 2, false },
+	/* DB */ { "???", AddressingMode::Implied, 2, false },
+	/* DC */ { "???", AddressingMode::Implied, 2, false },
+	/* DD */ { "CMP", AddressingMode::AbsoluteX, 4, true },
+	/* DE */ { "DEC", AddressingMode::AbsoluteX, 7, false },
+	/* DF */ { "???", AddressingMode::Implied, 2, false },
+	/* E0 */ { "CPX", AddressingMode::Immediate, 2, false },
+	/* E1 */ { "SBC", AddressingMode::IndirectX, 6, false },
+	/* E2 */ { "???", AddressingMode::Implied, 2, false },
+	/* E3 */ { "???", AddressingMode::Implied, 2, false },
+	/* E4 */ { "CPX", AddressingMode::ZeroPage, 3, false },
+	/* E5 */ { "SBC", AddressingMode::ZeroPage, 3, false },
+	/* E6 */ { "INC", AddressingMode::ZeroPage, 5, false },
+	/* E7 */ { "???", AddressingMode::Implied, 2, false },
+	/* E8 */ { "INX", AddressingMode::Implied, 2, false },
+	/* E9 */ { "SBC", AddressingMode::Immediate, 2, false },
+	/* EA */ { "NOP", AddressingMode::Implied, 2, false },
+	/* EB */ { "???", AddressingMode::Implied, 2, false },
+	/* EC */ { "CPX", AddressingMode::Absolute, 4, false },
+	/* ED */ { "SBC", AddressingMode::Absolute, 4, false },
+	/* EE */ { "INC", AddressingMode::Absolute, 6, false },
+	/* EF */ { "???", AddressingMode::Implied, 2, false },
+	/* F0 */ { "BEQ", AddressingMode::Relative, 2, false },
+	/* F1 */ { "SBC", AddressingMode::IndirectY, 5, true },
+	/* F2 */ { "???", AddressingMode::Implied, 2, false },
+	/* F3 */ { "???", AddressingMode::Implied, 2, false },
+	/* F4 */ { "???", AddressingMode::Implied, 2, false },
+	/* F5 */ { "SBC", AddressingMode::ZeroPageX, 4, false },
+	/* F6 */ { "INC", AddressingMode::ZeroPageX, 6, false },
+	/* F7 */ { "???", AddressingMode::Implied, 2, false },
+	/* F8 */ { "SED", AddressingMode::Implied, 2, false },
+	/* F9 */ { "SBC", AddressingMode::AbsoluteY, 4, true },
+	/* FA */ { "???", AddressingMode::Implied, 2, false },
+	/* FB */ { "???", AddressingMode::Implied, 2, false },
+	/* FC */ { "???", AddressingMode::Implied, 2, false },
+	/* FD */ { "SBC", AddressingMode::AbsoluteX, 4, true },
+	/* FE */ { "INC", AddressingMode::AbsoluteX, 7, false },
+	/* FF */ { "???", AddressingMode::Implied, 2, false },
+} };
\ No newline at end of file
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <array>
+
+#include "types.hpp"
+
+
+/// <summary>
+/// Addressing modes of the 6502. Determines the size of an instruction
+/// and how its operand is shown by the disassembler.
+/// </summary>
+enum class AddressingMode : byte
+{
+	Implied,
+	Accumulator,
+	Immediate,
+	ZeroPage,
+	ZeroPageX,
+	ZeroPageY,
+	Relative,
+	Absolute,
+	AbsoluteX,
+	AbsoluteY,
+	Indirect,
+	IndirectX,
+	IndirectY,
+};
+
+
+/// <summary>
+/// Static description of an opcode. 
+/// Shared by the dispatch loop (cycle counting) and the disassembler.
+/// </summary>
+struct OpcodeInfo
+{
+	const char* mnemonic;
+	AddressingMode mode;
+	byte cycles;
+
+	// Does crossing a page while indexing cost an extra cycle?
+	bool page_cross_penalty;
+};
+
+
+/// <summary>
+/// Metadata for all 256 opcodes. Unofficial opcodes are listed as "???".
+/// </summary>
+extern const std::array<OpcodeInfo, 256> opcode_table;
+
+
+/// <summary>
+/// Number of bytes an instruction occupies (opcode + operand).
+/// </summary>
+/// <param name="mode">Addressing mode of the instruction.</param>
+/// <returns>Instruction length in bytes (1 to 3).</returns>
+constexpr byte getInstructionLength(AddressingMode mode)
+{
+	switch (mode)
+	{
+		case AddressingMode::Implied:
+		case AddressingMode::Accumulator:
+			return 1;
+
+		case AddressingMode::Absolute:
+		case AddressingMode::AbsoluteX:
+		case AddressingMode::AbsoluteY:
+		case AddressingMode::Indirect:
+			return 3;
+
+		default:
+			return 2;
+	}
+}
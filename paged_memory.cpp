@@ -0,0 +1,156 @@
+#include "paged_memory.hpp"
+
+#include <algorithm>
+
+
+PagedMemory::Page PagedMemory::attached_page;
+
+
+PagedMemory::PagedMemory()
+{
+	for (size_t i{ 0 }; i < page_count; ++i)
+	{
+		pages[i] = new Page;
+		page_data[i] = pages[i]->data.data();
+	}
+}
+
+
+PagedMemory::~PagedMemory()
+{
+	for (Page* page : pages)
+	{
+		release(page);
+	}
+}
+
+
+PagedMemory::PagedMemory(const PagedMemory& other)
+	: pages{ other.pages }
+{
+	for (size_t i{ 0 }; i < page_count; ++i)
+	{
+		if (pages[i] == &attached_page)
+		{
+			pages[i] = new Page;
+			std::copy_n(other.page_data[i], page_size, pages[i]->data.data());
+		}
+		else
+		{
+			pages[i]->references.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		page_data[i] = pages[i]->data.data();
+	}
+}
+
+
+PagedMemory& PagedMemory::operator=(const PagedMemory& other)
+{
+	for (size_t i{ 0 }; i < page_count; ++i)
+	{
+		if (pages[i] == &attached_page || other.pages[i] == &attached_page)
+		{
+			// Attached pages keep their memory on either side; only data moves.
+			if (pages[i] != &attached_page && pages[i]->references.load(std::memory_order_acquire) != 1)
+			{
+				unshare(i);
+			}
+
+			if (page_data[i] != other.page_data[i])
+			{
+				std::copy_n(other.page_data[i], page_size, page_data[i]);
+			}
+		}
+		else if (pages[i] != other.pages[i])
+		{
+			// Pages that are already shared stay as they are.
+			other.pages[i]->references.fetch_add(1, std::memory_order_relaxed);
+			release(pages[i]);
+			pages[i] = other.pages[i];
+			page_data[i] = pages[i]->data.data();
+		}
+	}
+
+	return *this;
+}
+
+
+const byte* PagedMemory::getPage(size_t page) const
+{
+	return page_data[page];
+}
+
+
+byte* PagedMemory::getWritablePage(size_t page)
+{
+	if (pages[page]->references.load(std::memory_order_acquire) != 1)
+	{
+		unshare(page);
+	}
+
+	return page_data[page];
+}
+
+
+size_t PagedMemory::getUnsharedPageCount() const
+{
+	size_t count{ 0 };
+	for (const Page* page : pages)
+	{
+		count += (page->references.load(std::memory_order_relaxed) == 1);
+	}
+
+	return count;
+}
+
+
+void PagedMemory::attach(size_t first_page, size_t count, byte* external)
+{
+	for (size_t i{ first_page }; i < first_page + count; ++i)
+	{
+		release(pages[i]);
+		pages[i] = &attached_page;
+		page_data[i] = external + (i - first_page) * page_size;
+	}
+}
+
+
+void PagedMemory::detach(size_t first_page, size_t count)
+{
+	for (size_t i{ first_page }; i < first_page + count; ++i)
+	{
+		if (pages[i] == &attached_page)
+		{
+			pages[i] = new Page;
+			std::copy_n(page_data[i], page_size, pages[i]->data.data());
+			page_data[i] = pages[i]->data.data();
+		}
+	}
+}
+
+
+bool PagedMemory::isAttached(size_t page) const
+{
+	return pages[page] == &attached_page;
+}
+
+
+void PagedMemory::unshare(size_t page)
+{
+	Page* copy{ new Page };
+	copy->data = pages[page]->data;
+
+	release(pages[page]);
+	pages[page] = copy;
+	page_data[page] = copy->data.data();
+}
+
+
+void PagedMemory::release(Page* page)
+{
+	if (page != &attached_page && page->references.fetch_sub(1, std::memory_order_acq_rel) == 1)
+	{
+		delete page;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+
+#include "types.hpp"
+
+
+/// <summary>
+/// The 64 KiB address space as 256 pages of 256 bytes, shared copy-on-write.
+///
+/// Copying a PagedMemory shares all of its pages (each page is reference counted);
+/// the first write to a shared page gives the writer its own copy of just that page.
+/// Forked machine states therefore only cost the pages they have written since.
+/// Copies may be used on different threads.
+///
+/// Pages can also be attached to memory owned by someone else (a memory-mapped save file,
+/// see BatteryRAM). Reads and writes go straight to that memory. Attached pages are never
+/// shared: copies of the PagedMemory get private copies of them, and assigning to a
+/// PagedMemory copies data into its attached pages instead of replacing them.
+/// </summary>
+class PagedMemory
+{
+public:
+	static constexpr size_t page_size{ 0x100 };
+	static constexpr size_t page_count{ 0x100 };
+
+	/// <summary>
+	/// All pages zeroed and unshared.
+	/// </summary>
+	PagedMemory();
+	~PagedMemory();
+
+	PagedMemory(const PagedMemory& other);
+	PagedMemory& operator=(const PagedMemory& other);
+
+	byte read(word address) const;
+	void write(word address, byte data);
+
+	/// <summary>
+	/// Read-only access to a page.
+	/// </summary>
+	const byte* getPage(size_t page) const;
+
+	/// <summary>
+	/// Write access to a page; copies it first if it is shared.
+	/// </summary>
+	byte* getWritablePage(size_t page);
+
+	/// <summary>
+	/// Number of pages not shared with any other copy.
+	/// </summary>
+	size_t getUnsharedPageCount() const;
+
+	/// <summary>
+	/// Backs count pages, starting at first_page, with external memory of count * page_size
+	/// bytes. The pages then show that memory's contents. The memory must outlive the
+	/// attachment.
+	/// </summary>
+	void attach(size_t first_page, size_t count, byte* external);
+
+	/// <summary>
+	/// Gives attached pages back their own memory, with the contents they have now.
+	/// </summary>
+	void detach(size_t first_page, size_t count);
+
+	bool isAttached(size_t page) const;
+
+private:
+	struct Page
+	{
+		std::atomic<uint32_t> references{ 1 };
+		std::array<byte, page_size> data{};
+	};
+
+	void unshare(size_t page);
+	static void release(Page* page);
+
+	/// <summary>
+	/// Owner of every attached page. Its count stays at 1, so writes never unshare them.
+	/// </summary>
+	static Page attached_page;
+
+	// Where each page's bytes are (pages[i]->data, or external memory), and who owns them.
+	std::array<byte*, page_count> page_data;
+	std::array<Page*, page_count> pages;
+};
+
+
+// Every CPU access goes through these, so they are inline.
+
+inline byte PagedMemory::read(word address) const
+{
+	return page_data[address >> 8][address & 0xFF];
+}
+
+
+inline void PagedMemory::write(word address, byte data)
+{
+	// Only the owner of the last reference can see a count of 1, and nobody else can 
+	// add references to it; acquire pairs with the release in release().
+	if (pages[address >> 8]->references.load(std::memory_order_acquire) != 1)
+	{
+		unshare(address >> 8);
+	}
+
+	page_data[address >> 8][address & 0xFF] = data;
+}
\ No newline at end of file
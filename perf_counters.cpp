@@ -0,0 +1,113 @@
+#include "perf_counters.hpp"
+
+#if defined(__linux__)
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+
+PerfCounters::PerfCounters()
+{
+	files.fill(-1);
+
+#if defined(__linux__)
+	static constexpr uint64_t configs[counter_count]{
+		PERF_COUNT_HW_INSTRUCTIONS,
+		PERF_COUNT_HW_BRANCH_MISSES,
+		PERF_COUNT_HW_CACHE_MISSES,
+	};
+
+	for (size_t counter{ 0 }; counter < counter_count; ++counter)
+	{
+		perf_event_attr attributes;
+		std::memset(&attributes, 0, sizeof(attributes));
+		attributes.size = sizeof(attributes);
+		attributes.type = PERF_TYPE_HARDWARE;
+		attributes.config = configs[counter];
+		attributes.disabled = 1;
+		attributes.exclude_kernel = 1;
+		attributes.exclude_hv = 1;
+		attributes.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+		// Separate events rather than a group, so one unsupported counter does not take the others down.
+		files[counter] = static_cast<int>(syscall(SYS_perf_event_open, &attributes, 0, -1, -1, 0));
+	}
+#endif
+}
+
+
+PerfCounters::~PerfCounters()
+{
+#if defined(__linux__)
+	for (int file : files)
+	{
+		if (file >= 0)
+		{
+			close(file);
+		}
+	}
+#endif
+}
+
+
+bool PerfCounters::isAvailable(Counter counter) const
+{
+	return files[counter] >= 0;
+}
+
+
+const char* PerfCounters::getName(Counter counter)
+{
+	static constexpr const char* names[counter_count]{ "instructions", "branch_misses", "cache_misses" };
+	return names[counter];
+}
+
+
+void PerfCounters::start()
+{
+#if defined(__linux__)
+	for (int file : files)
+	{
+		if (file >= 0)
+		{
+			ioctl(file, PERF_EVENT_IOC_RESET, 0);
+			ioctl(file, PERF_EVENT_IOC_ENABLE, 0);
+		}
+	}
+#endif
+}
+
+
+PerfCounters::Values PerfCounters::stop()
+{
+	Values values{};
+
+#if defined(__linux__)
+	for (int file : files)
+	{
+		if (file >= 0)
+		{
+			ioctl(file, PERF_EVENT_IOC_DISABLE, 0);
+		}
+	}
+
+	for (size_t counter{ 0 }; counter < counter_count; ++counter)
+	{
+		// value, time enabled, time running
+		uint64_t data[3];
+		if (files[counter] < 0 || read(files[counter], data, sizeof(data)) != static_cast<ssize_t>(sizeof(data)) || data[2] == 0)
+		{
+			continue;
+		}
+
+		values.counts[counter] = (data[2] < data[1])
+			? static_cast<uint64_t>(static_cast<double>(data[0]) * static_cast<double>(data[1]) / static_cast<double>(data[2]))
+			: data[0];
+	}
+#endif
+
+	return values;
+}
\ No newline at end of file
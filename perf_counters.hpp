@@ -0,0 +1,55 @@
+#pragma once
+
+#include <array>
+
+#include "types.hpp"
+
+
+/// <summary>
+/// Hardware performance counters of the calling thread, counted in user mode only.
+/// Uses perf_event on Linux. Counters the kernel refuses (no PMU in a virtual machine,
+/// perf_event_paranoid, other platforms) are simply unavailable; the rest still count.
+/// </summary>
+class PerfCounters
+{
+public:
+	enum Counter : byte
+	{
+		Instructions,
+		BranchMisses,
+		CacheMisses,
+		counter_count,
+	};
+
+	struct Values
+	{
+		std::array<uint64_t, counter_count> counts;
+	};
+
+	PerfCounters();
+	~PerfCounters();
+
+	PerfCounters(const PerfCounters&) = delete;
+	PerfCounters& operator=(const PerfCounters&) = delete;
+
+	bool isAvailable(Counter counter) const;
+
+	/// <summary>
+	/// Name of the counter as it appears in reports (e.g. "branch_misses").
+	/// </summary>
+	static const char* getName(Counter counter);
+
+	/// <summary>
+	/// Zeroes and starts the counters.
+	/// </summary>
+	void start();
+
+	/// <summary>
+	/// Stops the counters and returns their counts since start(), scaled up if the kernel
+	/// had to multiplex them. Unavailable counters read 0.
+	/// </summary>
+	Values stop();
+
+private:
+	std::array<int, counter_count> files;
+};
\ No newline at end of file
@@ -0,0 +1,631 @@
+#include "ppu.hpp"
+
+#include <algorithm>
+
+
+namespace
+{
+	// 2C02 colours, 0x00RRGGBB.
+	constexpr uint32_t system_palette[64]{
+		0x666666, 0x002A88, 0x1412A7, 0x3B00A4, 0x5C007E, 0x6E0040, 0x6C0600, 0x561D00,
+		0x333500, 0x0B4800, 0x005200, 0x004F08, 0x00404D, 0x000000, 0x000000, 0x000000,
+		0xADADAD, 0x155FD9, 0x4240FF, 0x7527FE, 0xA01ACC, 0xB71E7B, 0xB53120, 0x994E00,
+		0x6B6D00, 0x388700, 0x0C9300, 0x008F32, 0x007C8D, 0x000000, 0x000000, 0x000000,
+		0xFFFEFF, 0x64B0FF, 0x9290FF, 0xC676FF, 0xF36AFF, 0xFE6ECC, 0xFE8170, 0xEA9E22,
+		0xBCBE00, 0x88D800, 0x5CE430, 0x45E082, 0x48CDDE, 0x4F4F4F, 0x000000, 0x000000,
+		0xFFFEFF, 0xC0DFFF, 0xD3D2FF, 0xE8C8FF, 0xFBC2FF, 0xFEC4EA, 0xFECCC5, 0xF7D8A5,
+		0xE4E594, 0xCFEF96, 0xBDF4AB, 0xB3F3CC, 0xB5EBF2, 0xB8B8B8, 0x000000, 0x000000,
+	};
+
+	// Sprite attribute byte.
+	constexpr byte sprite_palette_mask{ 0x03 };
+	constexpr byte sprite_behind_background{ 1 << 5 };
+	constexpr byte sprite_flip_horizontal{ 1 << 6 };
+	constexpr byte sprite_flip_vertical{ 1 << 7 };
+}
+
+
+PPU::PPU()
+{
+	framebuffer.resize(screen_width * screen_height);
+	chr_rom.resize(0x2000);
+	tile_cache.reset(chr_rom.size());
+}
+
+
+void PPU::power()
+{
+	state = {};
+	tile_cache.invalidateAll();
+	++change_count;
+}
+
+
+void PPU::reset()
+{
+	state.control = 0x00;
+	state.mask = 0x00;
+	state.read_buffer = 0x00;
+	state.fine_x = 0x00;
+	state.temp_address = 0x0000;
+	state.write_toggle = false;
+	++change_count;
+}
+
+
+void PPU::loadCartridge(const Cartridge& cartridge)
+{
+	mirroring = cartridge.getMirroring();
+	chr_is_ram = cartridge.hasCHRRAM();
+
+	std::fill(chr_rom.begin(), chr_rom.end(), byte{ 0x00 });
+	std::copy(cartridge.getCHR().begin(), cartridge.getCHR().end(), chr_rom.begin());
+	tile_cache.reset(chr_rom.size());
+	++change_count;
+}
+
+
+#pragma region REGISTERS
+
+byte PPU::read(word address)
+{
+	switch (address & 0x0007)
+	{
+		// PPUSTATUS: reading clears the vblank flag and the write toggle.
+		case 0x2:
+		{
+			byte data{ static_cast<byte>((state.status & 0xE0) | (state.io_latch & 0x1F)) };
+
+			if ((state.status & STATUS_VBLANK) || state.write_toggle)
+			{
+				state.status &= ~STATUS_VBLANK;
+				state.write_toggle = false;
+				++change_count;
+			}
+
+			return data;
+		}
+
+		// OAMDATA
+		case 0x4:
+			return state.oam[state.oam_address];
+
+		// PPUDATA: reads below the palette go through a one-byte buffer.
+		case 0x7:
+		{
+			word vram_address{ static_cast<word>(state.vram_address & 0x3FFF) };
+			byte data{ state.read_buffer };
+
+			state.read_buffer = readVRAM(vram_address);
+			if (vram_address >= 0x3F00)
+			{
+				data = state.read_buffer;
+
+				// The buffer gets the nametable byte "under" the palette.
+				state.read_buffer = readVRAM(vram_address - 0x1000);
+			}
+
+			incrementAddress();
+			++change_count;
+			return data;
+		}
+
+		// Write-only registers return the last value written.
+		default:
+			return state.io_latch;
+	}
+}
+
+
+void PPU::write(word address, byte data)
+{
+	state.io_latch = data;
+	++change_count;
+
+	switch (address & 0x0007)
+	{
+		// PPUCTRL: also holds the nametable select bits of the scroll.
+		case 0x0:
+			state.control = data;
+			state.temp_address = (state.temp_address & 0xF3FF) | ((data & 0x03) << 10);
+			break;
+
+		// PPUMASK
+		case 0x1:
+			state.mask = data;
+			break;
+
+		// OAMADDR
+		case 0x3:
+			state.oam_address = data;
+			break;
+
+		// OAMDATA
+		case 0x4:
+			state.oam[state.oam_address++] = data;
+			break;
+
+		// PPUSCROLL: X, then Y.
+		case 0x5:
+			if (!state.write_toggle)
+			{
+				state.temp_address = (state.temp_address & 0xFFE0) | (data >> 3);
+				state.fine_x = data & 0x07;
+			}
+			else
+			{
+				state.temp_address = (state.temp_address & 0x8C1F) | ((data & 0x07) << 12) | ((data & 0xF8) << 2);
+			}
+			state.write_toggle = !state.write_toggle;
+			break;
+
+		// PPUADDR: high byte, then low byte.
+		case 0x6:
+			if (!state.write_toggle)
+			{
+				state.temp_address = (state.temp_address & 0x00FF) | ((data & 0x3F) << 8);
+			}
+			else
+			{
+				state.temp_address = (state.temp_address & 0xFF00) | data;
+				state.vram_address = state.temp_address;
+			}
+			state.write_toggle = !state.write_toggle;
+			break;
+
+		// PPUDATA
+		case 0x7:
+			writeVRAM(state.vram_address & 0x3FFF, data);
+			incrementAddress();
+			break;
+	}
+}
+
+
+byte PPU::peek(word address) const
+{
+	switch (address & 0x0007)
+	{
+		case 0x2:	return (state.status & 0xE0) | (state.io_latch & 0x1F);
+		case 0x4:	return state.oam[state.oam_address];
+		case 0x7:	return state.read_buffer;
+		default:	return state.io_latch;
+	}
+}
+
+
+void PPU::writeOAM(const byte* data)
+{
+	size_t first_part{ state.oam.size() - state.oam_address };
+
+	std::copy_n(data, first_part, state.oam.begin() + state.oam_address);
+	std::copy_n(data + first_part, state.oam_address, state.oam.begin());
+	++change_count;
+}
+
+
+void PPU::incrementAddress()
+{
+	state.vram_address = (state.vram_address + ((state.control & CTRL_INCREMENT_32) ? 32 : 1)) & 0x7FFF;
+}
+
+#pragma endregion
+
+
+#pragma region VRAM
+
+byte PPU::readVRAM(word address) const
+{
+	if (address < 0x2000)
+	{
+		return chr_is_ram ? state.chr_ram[address] : chr_rom[address];
+	}
+
+	if (address < 0x3F00)
+	{
+		return state.nametables[getNametableIndex(address)];
+	}
+
+	// Sprite palette entry 0 of each palette mirrors the background's.
+	word index{ static_cast<word>(address & 0x1F) };
+	if ((index & 0x13) == 0x10)
+	{
+		index &= 0x0F;
+	}
+
+	return state.palette[index];
+}
+
+
+void PPU::writeVRAM(word address, byte data)
+{
+	if (address < 0x2000)
+	{
+		// CHR ROM is read-only.
+		if (chr_is_ram)
+		{
+			state.chr_ram[address] = data;
+			tile_cache.invalidate(address);
+		}
+	}
+	else if (address < 0x3F00)
+	{
+		state.nametables[getNametableIndex(address)] = data;
+	}
+	else
+	{
+		word index{ static_cast<word>(address & 0x1F) };
+		if ((index & 0x13) == 0x10)
+		{
+			index &= 0x0F;
+		}
+
+		state.palette[index] = data & 0x3F;
+	}
+}
+
+
+const byte* PPU::getCHR() const
+{
+	return chr_is_ram ? state.chr_ram.data() : chr_rom.data();
+}
+
+
+word PPU::getNametableIndex(word address) const
+{
+	// Four 1 KiB nametables ($2000-$2FFF, mirrored up to $3EFF) share 2 KiB of VRAM.
+	switch (mirroring)
+	{
+		case Mirroring::Vertical:	return address & 0x07FF;
+		default:					return ((address >> 1) & 0x0400) | (address & 0x03FF);
+	}
+}
+
+#pragma endregion
+
+
+#pragma region RENDERING
+
+bool PPU::runScanline(int scanline, bool render)
+{
+	if (scanline == vblank_scanline)
+	{
+		state.status |= STATUS_VBLANK;
+		++change_count;
+		return (state.control & CTRL_NMI) != 0;
+	}
+
+	if (scanline == prerender_scanline)
+	{
+		state.status &= ~(STATUS_VBLANK | STATUS_OVERFLOW | STATUS_SPRITE_ZERO_HIT);
+		++change_count;
+
+		if (isRenderingEnabled())
+		{
+			copyHorizontal();
+			copyVertical();
+		}
+
+		return false;
+	}
+
+	if (scanline >= screen_height)
+	{
+		return false;
+	}
+
+	if (!isRenderingEnabled())
+	{
+		// Rendering off shows the backdrop colour (or the palette entry the VRAM address points at).
+		if (render)
+		{
+			word vram_address{ static_cast<word>(state.vram_address & 0x3FFF) };
+			byte backdrop{ readVRAM(vram_address >= 0x3F00 ? vram_address : 0x3F00) };
+			std::fill_n(framebuffer.begin() + scanline * screen_width, screen_width, system_palette[backdrop & 0x3F]);
+		}
+
+		return false;
+	}
+
+	renderScanline(scanline, render);
+
+	// The scroll counters move through the line; by its end they point at the next one.
+	incrementY();
+	copyHorizontal();
+	++change_count;
+
+	return false;
+}
+
+
+void PPU::renderScanline(int scanline, bool render)
+{
+	// Sprite evaluation: the first 8 sprites on the line, and the overflow flag for a 9th.
+	int sprite_height{ (state.control & CTRL_SPRITE_8X16) ? 16 : 8 };
+
+	line_sprite_count = 0;
+	sprite_zero_on_line = false;
+
+	for (size_t sprite{ 0 }; sprite < 64; ++sprite)
+	{
+		// Sprites are drawn one line below their Y coordinate.
+		int row{ scanline - 1 - state.oam[sprite * 4] };
+		if (row < 0 || row >= sprite_height)
+		{
+			continue;
+		}
+
+		if (line_sprite_count == line_sprites.size())
+		{
+			state.status |= STATUS_OVERFLOW;
+			break;
+		}
+
+		sprite_zero_on_line |= (sprite == 0);
+		line_sprites[line_sprite_count++] = static_cast<byte>(sprite);
+	}
+
+	// Without pixels, only sprite 0 against the background matters (for the hit flag).
+	bool test_sprite_zero{
+		sprite_zero_on_line
+		&& !(state.status & STATUS_SPRITE_ZERO_HIT)
+		&& (state.mask & MASK_BACKGROUND) && (state.mask & MASK_SPRITES)
+	};
+
+	if (!render && !test_sprite_zero)
+	{
+		return;
+	}
+
+	fetchBackground();
+	fetchSprites(scanline, render ? line_sprite_count : 1);
+
+	bool background_left{ (state.mask & MASK_BACKGROUND_LEFT) != 0 };
+	bool sprites_left{ (state.mask & MASK_SPRITES_LEFT) != 0 };
+
+	if (test_sprite_zero)
+	{
+		// Never at x = 255, nor in the left 8 pixels when either layer is clipped there.
+		int first_x{ (background_left && sprites_left) ? 0 : 8 };
+		for (int x{ first_x }; x < screen_width - 1; ++x)
+		{
+			if (sprite_zero_line[x] && background_line[x] != 0)
+			{
+				state.status |= STATUS_SPRITE_ZERO_HIT;
+				break;
+			}
+		}
+	}
+
+	if (!render)
+	{
+		return;
+	}
+
+	byte gray_mask{ static_cast<byte>((state.mask & MASK_GRAYSCALE) ? 0x30 : 0x3F) };
+	uint32_t* out{ &framebuffer[scanline * screen_width] };
+
+	for (int x{ 0 }; x < screen_width; ++x)
+	{
+		byte background{ (background_left || x >= 8) ? background_line[x] : byte{ 0 } };
+		byte sprite{ (sprites_left || x >= 8) ? sprite_line[x] : byte{ 0 } };
+
+		// Palette RAM index: 0 is the backdrop, 1-15 background, 17-31 sprites.
+		byte index{ 0 };
+		if (sprite != 0 && (background == 0 || !sprite_behind[x]))
+		{
+			index = 0x10 | sprite;
+		}
+		else if (background != 0)
+		{
+			index = background;
+		}
+
+		out[x] = system_palette[readVRAM(0x3F00 | index) & gray_mask];
+	}
+}
+
+
+void PPU::fetchBackground()
+{
+	if (!(state.mask & MASK_BACKGROUND))
+	{
+		background_line.fill(0);
+		return;
+	}
+
+	word vram_address{ state.vram_address };
+	word pattern_table{ static_cast<word>((state.control & CTRL_BACKGROUND_TABLE) ? 0x1000 : 0x0000) };
+	int fine_y{ (vram_address >> 12) & 0x07 };
+	const byte* chr{ getCHR() };
+
+	// 33 tiles cover 256 pixels at any fine X scroll.
+	for (int tile{ 0 }; tile < 33; ++tile)
+	{
+		byte tile_index{ readVRAM(0x2000 | (vram_address & 0x0FFF)) };
+		byte attribute{ readVRAM(0x23C0 | (vram_address & 0x0C00) | ((vram_address >> 4) & 0x38) | ((vram_address >> 2) & 0x07)) };
+		byte palette{ static_cast<byte>((attribute >> (((vram_address >> 4) & 0x04) | (vram_address & 0x02))) & 0x03) };
+
+		const byte* row{ tile_cache.getRow(pattern_table + tile_index * 16 + fine_y, chr) };
+
+		for (int bit{ 0 }; bit < 8; ++bit)
+		{
+			int x{ tile * 8 + bit - state.fine_x };
+			if (x < 0 || x >= screen_width)
+			{
+				continue;
+			}
+
+			background_line[x] = (row[bit] != 0) ? static_cast<byte>((palette << 2) | row[bit]) : byte{ 0 };
+		}
+
+		// Coarse X, wrapping into the horizontally adjacent nametable.
+		if ((vram_address & 0x001F) == 31)
+		{
+			vram_address = (vram_address & ~0x001F) ^ 0x0400;
+		}
+		else
+		{
+			++vram_address;
+		}
+	}
+}
+
+
+void PPU::fetchSprites(int scanline, size_t count)
+{
+	sprite_line.fill(0);
+	sprite_zero_line.fill(false);
+
+	if (!(state.mask & MASK_SPRITES))
+	{
+		return;
+	}
+
+	count = std::min(count, line_sprite_count);
+	bool tall{ (state.control & CTRL_SPRITE_8X16) != 0 };
+	const byte* chr{ getCHR() };
+
+	// Lower OAM index wins, so draw in reverse.
+	for (size_t i{ count }; i-- > 0;)
+	{
+		const byte* sprite{ &state.oam[line_sprites[i] * 4] };
+		byte tile_index{ sprite[1] };
+		byte attributes{ sprite[2] };
+		int sprite_x{ sprite[3] };
+
+		int row{ scanline - 1 - sprite[0] };
+		if (attributes & sprite_flip_vertical)
+		{
+			row = (tall ? 15 : 7) - row;
+		}
+
+		word pattern;
+		if (tall)
+		{
+			// 8x16 sprites pick their pattern table with bit 0 of the tile index.
+			pattern = ((tile_index & 0x01) ? 0x1000 : 0x0000) + (tile_index & 0xFE) * 16 + (row >= 8 ? 16 : 0) + (row & 0x07);
+		}
+		else
+		{
+			pattern = ((state.control & CTRL_SPRITE_TABLE) ? 0x1000 : 0x0000) + tile_index * 16 + row;
+		}
+
+		const byte* pixels{ tile_cache.getRow(pattern, chr) };
+		bool is_sprite_zero{ line_sprites[i] == 0 };
+
+		for (int bit{ 0 }; bit < 8; ++bit)
+		{
+			int x{ sprite_x + bit };
+			if (x >= screen_width)
+			{
+				break;
+			}
+
+			byte pixel{ pixels[(attributes & sprite_flip_horizontal) ? 7 - bit : bit] };
+			if (pixel == 0)
+			{
+				continue;
+			}
+
+			sprite_line[x] = static_cast<byte>(((attributes & sprite_palette_mask) << 2) | pixel);
+			sprite_behind[x] = (attributes & sprite_behind_background) != 0;
+			sprite_zero_line[x] = is_sprite_zero;
+		}
+	}
+}
+
+
+void PPU::incrementY()
+{
+	word& v{ state.vram_address };
+
+	if ((v & 0x7000) != 0x7000)
+	{
+		v += 0x1000;
+		return;
+	}
+
+	// Fine Y wraps into coarse Y; row 29 is the last row of a nametable.
+	v &= ~0x7000;
+	int coarse_y{ (v & 0x03E0) >> 5 };
+
+	if (coarse_y == 29)
+	{
+		coarse_y = 0;
+		v ^= 0x0800;
+	}
+	else if (coarse_y == 31)
+	{
+		coarse_y = 0;
+	}
+	else
+	{
+		++coarse_y;
+	}
+
+	v = (v & ~0x03E0) | (coarse_y << 5);
+}
+
+
+void PPU::copyHorizontal()
+{
+	state.vram_address = (state.vram_address & ~0x041F) | (state.temp_address & 0x041F);
+}
+
+
+void PPU::copyVertical()
+{
+	state.vram_address = (state.vram_address & ~0x7BE0) | (state.temp_address & 0x7BE0);
+}
+
+
+bool PPU::isRenderingEnabled() const
+{
+	return (state.mask & (MASK_BACKGROUND | MASK_SPRITES)) != 0;
+}
+
+#pragma endregion
+
+
+const uint32_t* PPU::getFramebuffer() const
+{
+	return framebuffer.data();
+}
+
+
+void PPU::saveState(State& state) const
+{
+	state = this->state;
+}
+
+
+void PPU::loadState(const State& state)
+{
+	// Keep the decoded tiles that did not change (run-ahead restores every frame).
+	if (chr_is_ram)
+	{
+		for (word tile{ 0 }; tile < state.chr_ram.size(); tile += 16)
+		{
+			if (!std::equal(&state.chr_ram[tile], &state.chr_ram[tile] + 16, &this->state.chr_ram[tile]))
+			{
+				tile_cache.invalidate(tile);
+			}
+		}
+	}
+
+	this->state = state;
+	++change_count;
+}
+
+
+uint64_t PPU::getChangeCount() const
+{
+	return change_count;
+}
+
+
+const TileCache& PPU::getTileCache() const
+{
+	return tile_cache;
+}
\ No newline at end of file
@@ -0,0 +1,204 @@
+#pragma once
+
+#include <array>
+#include <vector>
+
+#include "types.hpp"
+#include "cartridge.hpp"
+#include "tile_cache.hpp"
+
+
+/// <summary>
+/// Picture processing unit (2C02), emulated one scanline at a time.
+/// The CPU sees it through eight registers mirrored over $2000-$3FFF.
+///
+/// Rendering has two parts: the work that changes state the CPU can observe
+/// (vblank, sprite-0 hit, sprite overflow, scroll counters) which always runs, and
+/// pixel composition into the framebuffer, which can be skipped per scanline.
+/// Both produce the same state; only the framebuffer differs.
+/// </summary>
+class PPU
+{
+public:
+	static constexpr int screen_width{ 256 };
+	static constexpr int screen_height{ 240 };
+
+	// NTSC timing.
+	static constexpr int dots_per_scanline{ 341 };
+	static constexpr int scanlines_per_frame{ 262 };
+	static constexpr int vblank_scanline{ 241 };
+	static constexpr int prerender_scanline{ 261 };
+
+	PPU();
+
+	/// <summary>
+	/// Power-up: clears all PPU memory and registers.
+	/// </summary>
+	void power();
+
+	/// <summary>
+	/// Reset button: clears the registers, keeps memory.
+	/// </summary>
+	void reset();
+
+	/// <summary>
+	/// Inserts the cartridge's CHR ROM (or 8 KiB of CHR RAM) and sets its mirroring.
+	/// </summary>
+	void loadCartridge(const Cartridge& cartridge);
+
+	/// <summary>
+	/// CPU read from $2000-$3FFF (mirrored every 8 bytes).
+	/// </summary>
+	byte read(word address);
+
+	/// <summary>
+	/// CPU write to $2000-$3FFF (mirrored every 8 bytes).
+	/// </summary>
+	void write(word address, byte data);
+
+	/// <summary>
+	/// Read without side effects, for tracing and debugging.
+	/// </summary>
+	byte peek(word address) const;
+
+	/// <summary>
+	/// OAM DMA: 256 bytes written as if through OAMDATA, starting at OAMADDR and wrapping around.
+	/// </summary>
+	void writeOAM(const byte* data);
+
+	/// <summary>
+	/// Emulates one scanline. Called at the start of the scanline, so register writes
+	/// made by the CPU during a scanline take effect on the next one.
+	/// </summary>
+	/// <param name="scanline">0-239 visible, 240 idle, 241-260 vblank, 261 pre-render.</param>
+	/// <param name="render">Compose pixels into the framebuffer. If false only CPU-visible state is updated.</param>
+	/// <returns>True if the PPU raises an NMI (start of vblank with NMIs enabled).</returns>
+	bool runScanline(int scanline, bool render);
+
+	/// <summary>
+	/// The last rendered picture, screen_width x screen_height pixels as 0x00RRGGBB.
+	/// Lines emulated without rendering keep the previous frame's pixels.
+	/// </summary>
+	const uint32_t* getFramebuffer() const;
+
+	/// <summary>
+	/// Everything that affects emulation (the framebuffer does not).
+	/// Fixed size, so saving and restoring is a plain copy.
+	/// </summary>
+	struct State
+	{
+		std::array<byte, 0x0800> nametables;
+		std::array<byte, 0x20> palette;
+		std::array<byte, 0x100> oam;
+		std::array<byte, 0x2000> chr_ram;
+
+		byte control;
+		byte mask;
+		byte status;
+		byte oam_address;
+		byte read_buffer;
+		byte io_latch;
+
+		// Scroll registers: current and temporary VRAM address, fine X scroll, first/second write toggle.
+		word vram_address;
+		word temp_address;
+		byte fine_x;
+		bool write_toggle;
+	};
+
+	void saveState(State& state) const;
+	void loadState(const State& state);
+
+	/// <summary>
+	/// Counts changes to CPU-visible state, like Bus::getChangeCount().
+	/// </summary>
+	uint64_t getChangeCount() const;
+
+	const TileCache& getTileCache() const;
+
+private:
+	// $2000 PPUCTRL bits.
+	enum : byte {
+		CTRL_INCREMENT_32		= 1 << 2,
+		CTRL_SPRITE_TABLE		= 1 << 3,
+		CTRL_BACKGROUND_TABLE	= 1 << 4,
+		CTRL_SPRITE_8X16		= 1 << 5,
+		CTRL_NMI				= 1 << 7,
+	};
+
+	// $2001 PPUMASK bits.
+	enum : byte {
+		MASK_GRAYSCALE			= 1 << 0,
+		MASK_BACKGROUND_LEFT	= 1 << 1,
+		MASK_SPRITES_LEFT		= 1 << 2,
+		MASK_BACKGROUND			= 1 << 3,
+		MASK_SPRITES			= 1 << 4,
+	};
+
+	// $2002 PPUSTATUS bits.
+	enum : byte {
+		STATUS_OVERFLOW			= 1 << 5,
+		STATUS_SPRITE_ZERO_HIT	= 1 << 6,
+		STATUS_VBLANK			= 1 << 7,
+	};
+
+	/// <summary>
+	/// Advances the VRAM address by 1 or 32 after a PPUDATA access.
+	/// </summary>
+	void incrementAddress();
+
+	/// <summary>
+	/// PPU address space: pattern tables, nametables and palette.
+	/// </summary>
+	byte readVRAM(word address) const;
+	void writeVRAM(word address, byte data);
+	word getNametableIndex(word address) const;
+
+	/// <summary>
+	/// The CHR memory in use: the cartridge's CHR ROM or the CHR RAM in the state.
+	/// </summary>
+	const byte* getCHR() const;
+
+	/// <summary>
+	/// CPU-visible part of a visible scanline: sprite evaluation, overflow and sprite-0 hit.
+	/// Composes the pixels too when render is set.
+	/// </summary>
+	void renderScanline(int scanline, bool render);
+
+	/// <summary>
+	/// Background palette indices (0 = transparent) for the current scanline, from the scroll registers.
+	/// </summary>
+	void fetchBackground();
+
+	/// <summary>
+	/// Sprite palette indices (0 = transparent) for the current scanline, from the sprites found by evaluation.
+	/// </summary>
+	/// <param name="count">Number of sprites to draw, starting with the first one found.</param>
+	void fetchSprites(int scanline, size_t count);
+
+	// Scroll counter updates done by the rendering hardware.
+	void incrementY();
+	void copyHorizontal();
+	void copyVertical();
+
+	bool isRenderingEnabled() const;
+
+	State state{};
+	Mirroring mirroring{ Mirroring::Horizontal };
+	std::vector<byte> chr_rom;
+	bool chr_is_ram{ true };
+	TileCache tile_cache;
+
+	uint64_t change_count{ 0 };
+
+	// Scratch buffers for the scanline being emulated.
+	std::array<byte, screen_width> background_line{};
+	std::array<byte, screen_width> sprite_line{};
+	std::array<bool, screen_width> sprite_behind{};
+	std::array<bool, screen_width> sprite_zero_line{};
+	std::array<byte, 8> line_sprites{};
+	size_t line_sprite_count{ 0 };
+	bool sprite_zero_on_line{ false };
+
+	std::vector<uint32_t> framebuffer;
+};
\ No newline at end of file
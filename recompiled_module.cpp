@@ -0,0 +1,107 @@
+#include "recompiled_module.hpp"
+#include "bus.hpp"
+#include "hash.hpp"
+
+#include <stdexcept>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#endif
+
+
+namespace
+{
+	void* openLibrary(const std::string& path)
+	{
+#if defined(_WIN32)
+		return LoadLibraryA(path.c_str());
+#else
+		return dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+#endif
+	}
+
+
+	void* findSymbol(void* library, const char* name)
+	{
+#if defined(_WIN32)
+		return reinterpret_cast<void*>(GetProcAddress(static_cast<HMODULE>(library), name));
+#else
+		return dlsym(library, name);
+#endif
+	}
+
+
+	void closeLibrary(void* library)
+	{
+#if defined(_WIN32)
+		FreeLibrary(static_cast<HMODULE>(library));
+#else
+		dlclose(library);
+#endif
+	}
+}
+
+
+RecompiledModule::RecompiledModule(const std::string& path)
+	: blocks(0x10000 - rom_start, nullptr)
+{
+	library = openLibrary(path);
+	if (library == nullptr)
+	{
+		throw std::runtime_error("RecompiledModule: could not load " + path);
+	}
+
+	using EntryPoint = const RecompiledModuleInfo* (*)();
+	EntryPoint entry_point{ reinterpret_cast<EntryPoint>(findSymbol(library, recompiled_entry_point)) };
+	const RecompiledModuleInfo* info{ (entry_point != nullptr) ? entry_point() : nullptr };
+
+	if (info == nullptr || info->abi_version != recompiled_abi_version)
+	{
+		closeLibrary(library);
+		throw std::runtime_error("RecompiledModule: " + path + " is not a recompiled module of this version");
+	}
+
+	rom_hash = info->rom_hash;
+	for (size_t i{ 0 }; i < info->block_count; ++i)
+	{
+		const RecompiledBlockEntry& entry{ info->blocks[i] };
+		if (entry.address >= rom_start)
+		{
+			blocks[entry.address - rom_start] = entry.block;
+			++block_count;
+		}
+	}
+}
+
+
+RecompiledModule::~RecompiledModule()
+{
+	closeLibrary(library);
+}
+
+
+uint64_t RecompiledModule::hashROM(const byte* rom)
+{
+	return xxHash64(rom, 0x10000 - rom_start);
+}
+
+
+bool RecompiledModule::matches(const Bus& bus) const
+{
+	std::vector<byte> rom(0x10000 - rom_start);
+	for (size_t i{ 0 }; i < rom.size(); ++i)
+	{
+		rom[i] = bus.peek(static_cast<word>(rom_start + i));
+	}
+
+	return hashROM(rom.data()) == rom_hash;
+}
+
+
+size_t RecompiledModule::getBlockCount() const
+{
+	return block_count;
+}
\ No newline at end of file
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "types.hpp"
+#include "recompiled_runtime.hpp"
+
+class Bus;
+
+
+/// <summary>
+/// A shared library of recompiled blocks (see recompiler.hpp), loaded at run time.
+/// Attach it to the CPU with CPU::setRecompiledModule(); the interpreter runs everything
+/// the library has no block for.
+/// </summary>
+class RecompiledModule
+{
+public:
+	/// <summary>
+	/// Loads the library. Throws std::runtime_error if it cannot be loaded, does not export
+	/// recompiled_entry_point or was generated for another ABI version.
+	/// </summary>
+	explicit RecompiledModule(const std::string& path);
+	~RecompiledModule();
+
+	RecompiledModule(const RecompiledModule&) = delete;
+	RecompiledModule& operator=(const RecompiledModule&) = delete;
+
+	/// <summary>
+	/// Hash identifying the 32 KiB image at $8000-$FFFF that code is compiled from.
+	/// </summary>
+	static uint64_t hashROM(const byte* rom);
+
+	/// <summary>
+	/// Was the library compiled from the ROM currently on the bus?
+	/// </summary>
+	bool matches(const Bus& bus) const;
+
+	/// <returns>The block starting at the address, or nullptr.</returns>
+	RecompiledBlock getBlock(word address) const
+	{
+		return (address >= rom_start) ? blocks[address - rom_start] : nullptr;
+	}
+
+	size_t getBlockCount() const;
+
+private:
+	static constexpr word rom_start{ 0x8000 };
+
+	void* library{ nullptr };
+	uint64_t rom_hash{ 0 };
+	size_t block_count{ 0 };
+
+	// One entry per ROM address.
+	std::vector<RecompiledBlock> blocks;
+};
\ No newline at end of file
@@ -0,0 +1,226 @@
+#pragma once
+
+#include "types.hpp"
+#include "return_stack.hpp"
+#include "instruction_handlers.hpp"
+
+
+/*
+	Interface between the emulator and statically recompiled code (see recompiler.hpp).
+
+	Generated sources include this header only, and are built into a shared library:
+
+		cl /LD /O2 /std:c++17 /I<emuNES sources> game.cpp
+		g++ -O2 -shared -fPIC -std=c++17 -I<emuNES sources> game.cpp -o game.so
+
+	The library exports recompiled_entry_point, which returns a RecompiledModuleInfo.
+	Everything crossing the boundary is plain data and function pointers, so the library
+	does not have to be built with the same compiler or settings as the emulator.
+*/
+
+
+#if defined(_WIN32)
+#define EMUNES_EXPORT __declspec(dllexport)
+#else
+#define EMUNES_EXPORT __attribute__((visibility("default")))
+#endif
+
+
+struct RecompiledState;
+
+
+/// <summary>
+/// A compiled basic block. Runs the block's instructions from program_counter, checking the cycle
+/// counter after each one like CPU::runUntil() does, and returns with program_counter at the next
+/// instruction to execute.
+/// </summary>
+using RecompiledBlock = void (*)(RecompiledState& state, uint64_t until);
+
+
+/// <summary>
+/// CPU registers as seen by a compiled block, and the bus it reads and writes through.
+/// </summary>
+struct RecompiledState
+{
+	word program_counter;
+	byte stack_pointer;
+	byte reg_accumulator;
+	byte reg_x;
+	byte reg_y;
+	byte processor_status;
+
+	// Set when the block ends with a backward branch or jump (see CPU::skipIdleLoop()).
+	bool backward_jump;
+
+	uint64_t cycles;
+
+	void* bus;
+	byte (*read)(void* bus, word address);
+	void (*write)(void* bus, word address, byte data);
+
+	// Page $01 (see Bus::readStack()).
+	byte (*read_stack)(void* bus, byte offset);
+	void (*write_stack)(void* bus, byte offset, byte data);
+
+	// The CPU's shadow return stack, kept by calls and returns.
+	ReturnStack* return_stack;
+
+	// Set by a block ending in a call, or in a return the shadow stack predicted: the block
+	// at the new program_counter, to run next without a lookup. nullptr if unknown.
+	RecompiledBlock next_block;
+
+	// For InstructionHandlers.
+	void push(byte data)
+	{
+		write_stack(bus, stack_pointer--, data);
+	}
+
+	byte pull()
+	{
+		return read_stack(bus, ++stack_pointer);
+	}
+};
+
+
+struct RecompiledBlockEntry
+{
+	word address;
+	RecompiledBlock block;
+};
+
+
+struct RecompiledModuleInfo
+{
+	uint32_t abi_version;
+
+	// RecompiledModule::hashROM() of the $8000-$FFFF image the code was compiled from.
+	uint64_t rom_hash;
+
+	size_t block_count;
+	const RecompiledBlockEntry* blocks;
+};
+
+
+constexpr uint32_t recompiled_abi_version{ 2 };
+constexpr const char* recompiled_entry_point{ "emunes_recompiled_module" };
+
+
+/*
+	Helpers for generated code. The instruction handlers are the CPU's own (Handlers, see
+	instruction_handlers.hpp), inlined; only the instructions that enter or leave a block
+	through the shadow return stack have versions of their own here.
+*/
+namespace recompiled
+{
+	using namespace status_flags;
+	using Handlers = InstructionHandlers<RecompiledState>;
+
+	constexpr word oam_dma{ 0x4014 };
+	constexpr uint64_t oam_dma_cycles{ 513 };
+
+
+	inline byte read(RecompiledState& s, word address)
+	{
+		return s.read(s.bus, address);
+	}
+
+
+	/// <returns>True if the write started OAM DMA.</returns>
+	inline bool write(RecompiledState& s, word address, byte data)
+	{
+		s.write(s.bus, address, data);
+		return address == oam_dma;
+	}
+
+
+	/// <summary>
+	/// Charges an instruction's cycles, and the CPU halt for OAM DMA if it started one.
+	/// </summary>
+	inline void addCycles(RecompiledState& s, uint64_t count, bool oam_dma_started)
+	{
+		s.cycles += count;
+
+		if (oam_dma_started)
+		{
+			s.cycles += oam_dma_cycles + (s.cycles & 1);
+		}
+	}
+
+
+	// Pointer fetches of the indexed indirect modes; the pointer wraps within the zero page.
+	inline word pointerX(RecompiledState& s, byte operand)
+	{
+		byte table_address{ static_cast<byte>(operand + s.reg_x) };
+		byte lo{ read(s, table_address) };
+		byte hi{ read(s, static_cast<byte>(table_address + 1)) };
+		return static_cast<word>((hi << 8) | lo);
+	}
+
+
+	inline word pointer(RecompiledState& s, byte operand)
+	{
+		byte lo{ read(s, operand) };
+		byte hi{ read(s, static_cast<byte>(operand + 1)) };
+		return static_cast<word>((hi << 8) | lo);
+	}
+
+
+	// JMP ($xxFF) reads the high byte from $xx00.
+	inline word indirect(RecompiledState& s, word address)
+	{
+		byte lo{ read(s, address) };
+		byte hi{ read(s, static_cast<word>((address & 0xFF00) | static_cast<byte>(address + 1))) };
+		return static_cast<word>((hi << 8) | lo);
+	}
+
+
+	// return_address is past the byte after BRK.
+	inline void doBRK(RecompiledState& s, word return_address)
+	{
+		Handlers::pushInterrupt(s, return_address, static_cast<byte>(s.processor_status | Handlers::pushed_bits));
+
+		s.program_counter = static_cast<word>(read(s, 0xFFFE) | (read(s, 0xFFFF) << 8));
+		s.return_stack->call({ s.program_counter, return_address, s.stack_pointer, true, s.cycles, nullptr });
+	}
+
+	// return_address is the instruction after JSR; return_block is the block there, if any.
+	inline void doJSR(RecompiledState& s, word return_address, word address, RecompiledBlock return_block)
+	{
+		Handlers::pushWord(s, static_cast<word>(return_address - 1));
+
+		s.return_stack->call({ address, return_address, s.stack_pointer, false, s.cycles, return_block });
+		s.program_counter = address;
+	}
+
+	// A predicted return continues in the block recorded by the call.
+	inline void doRTI(RecompiledState& s)
+	{
+		byte stack_before{ s.stack_pointer };
+		Handlers::doRTI(s);
+
+		const ReturnStack::Frame* frame{ s.return_stack->ret(stack_before, s.program_counter) };
+		s.next_block = (frame != nullptr) ? frame->return_block : nullptr;
+	}
+
+	inline void doRTS(RecompiledState& s)
+	{
+		byte stack_before{ s.stack_pointer };
+		Handlers::doRTS(s);
+
+		const ReturnStack::Frame* frame{ s.return_stack->ret(stack_before, s.program_counter) };
+		s.next_block = (frame != nullptr) ? frame->return_block : nullptr;
+	}
+
+
+	/// <summary>
+	/// Read-modify-write through the bus (see CPU::modify()).
+	/// </summary>
+	/// <returns>True if the write started OAM DMA.</returns>
+	template <void (*instruction)(RecompiledState&, byte&)>
+	inline bool modify(RecompiledState& s, word address)
+	{
+		byte data{ read(s, address) };
+		instruction(s, data);
+		return write(s, address, data);
+	}
+}
\ No newline at end of file
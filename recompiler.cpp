@@ -0,0 +1,1051 @@
+#include "recompiler.hpp"
+#include "recompiled_module.hpp"
+#include "disassembler.hpp"
+#include "nes.hpp"
+#include "opcodes.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <stdexcept>
+
+
+namespace
+{
+	std::string hex(uint64_t value, int digits)
+	{
+		char text[24];
+		std::snprintf(text, sizeof(text), "0x%0*llX", digits, static_cast<unsigned long long>(value));
+		return text;
+	}
+
+
+	std::string blockName(word address)
+	{
+		char text[16];
+		std::snprintf(text, sizeof(text), "block_%04X", address);
+		return text;
+	}
+
+
+	bool isMnemonic(const OpcodeInfo& info, const char* mnemonic)
+	{
+		return std::strcmp(info.mnemonic, mnemonic) == 0;
+	}
+
+
+	/// <summary>
+	/// Condition under which a branch is taken, as a C++ expression.
+	/// </summary>
+	std::string branchCondition(const OpcodeInfo& info)
+	{
+		struct Branch
+		{
+			const char* mnemonic;
+			const char* condition;
+		};
+
+		static constexpr Branch branches[]{
+			{ "BCC", "(s.processor_status & recompiled::C) == 0" },
+			{ "BCS", "(s.processor_status & recompiled::C) != 0" },
+			{ "BEQ", "(s.processor_status & recompiled::Z) != 0" },
+			{ "BMI", "(s.processor_status & recompiled::N) != 0" },
+			{ "BNE", "(s.processor_status & recompiled::Z) == 0" },
+			{ "BPL", "(s.processor_status & recompiled::N) == 0" },
+			{ "BVC", "(s.processor_status & recompiled::V) == 0" },
+			{ "BVS", "(s.processor_status & recompiled::V) != 0" },
+		};
+
+		for (const Branch& branch : branches)
+		{
+			if (isMnemonic(info, branch.mnemonic))
+			{
+				return branch.condition;
+			}
+		}
+
+		throw std::logic_error("Recompiler: not a branch");
+	}
+
+
+	bool isTerminator(const OpcodeInfo& info)
+	{
+		return info.mode == AddressingMode::Relative || isMnemonic(info, "JMP") || isMnemonic(info, "JSR")
+			|| isMnemonic(info, "RTS") || isMnemonic(info, "RTI") || isMnemonic(info, "BRK");
+	}
+
+
+	bool isZeroPage(const OpcodeInfo& info)
+	{
+		return info.mode == AddressingMode::ZeroPage || info.mode == AddressingMode::ZeroPageX || info.mode == AddressingMode::ZeroPageY;
+	}
+
+
+	bool isStore(const OpcodeInfo& info)
+	{
+		return isMnemonic(info, "STA") || isMnemonic(info, "STX") || isMnemonic(info, "STY");
+	}
+
+
+	bool isModify(const OpcodeInfo& info)
+	{
+		return info.mode != AddressingMode::Accumulator
+			&& (isMnemonic(info, "ASL") || isMnemonic(info, "LSR") || isMnemonic(info, "ROL") || isMnemonic(info, "ROR")
+				|| isMnemonic(info, "INC") || isMnemonic(info, "DEC"));
+	}
+
+
+	/// <summary>
+	/// Flags an instruction reads, may change, and always overwrites, as the CPU's handlers do it
+	/// (most flags are only ever set, so few instructions overwrite them).
+	/// </summary>
+	struct FlagEffects
+	{
+		byte reads;
+		byte writes;
+		byte overwrites;
+	};
+
+
+	FlagEffects getFlagEffects(const OpcodeInfo& info)
+	{
+		using namespace recompiled;
+
+		// The status as PHP and BRK push it, and PLP and RTI pull it.
+		constexpr byte status{ C | Z | I | D | V | N };
+
+		struct Entry
+		{
+			const char* mnemonic;
+			FlagEffects effects;
+		};
+
+		static constexpr Entry table[]{
+			{ "ADC", { C, V | C | Z | N, 0 } },
+			{ "AND", { 0, Z | N, 0 } },
+			{ "ASL", { 0, C | Z | N, C } },
+			{ "BCC", { C, 0, 0 } },
+			{ "BCS", { C, 0, 0 } },
+			{ "BEQ", { Z, 0, 0 } },
+			{ "BIT", { 0, Z | N | V, N | V } },
+			{ "BMI", { N, 0, 0 } },
+			{ "BNE", { Z, 0, 0 } },
+			{ "BPL", { N, 0, 0 } },
+			{ "BRK", { status, I, I } },
+			{ "BVC", { V, 0, 0 } },
+			{ "BVS", { V, 0, 0 } },
+			{ "CLC", { 0, C, C } },
+			{ "CLD", { 0, D, D } },
+			{ "CLI", { 0, I, I } },
+			{ "CLV", { 0, V, V } },
+			{ "CMP", { 0, C | Z | N, 0 } },
+			{ "CPX", { 0, C | Z | N, 0 } },
+			{ "CPY", { 0, C | Z | N, 0 } },
+			{ "DEC", { 0, Z | N, 0 } },
+			{ "DEX", { 0, Z | N, 0 } },
+			{ "DEY", { 0, Z | N, 0 } },
+			{ "EOR", { 0, Z | N, 0 } },
+			{ "INC", { 0, Z | N, 0 } },
+			{ "INX", { 0, Z | N, 0 } },
+			{ "INY", { 0, Z | N, 0 } },
+			{ "LDA", { 0, Z | N, 0 } },
+			{ "LDX", { 0, Z | N, 0 } },
+			{ "LDY", { 0, Z | N, 0 } },
+			{ "LSR", { 0, C | Z | N, C } },
+			{ "ORA", { 0, Z | N, 0 } },
+			{ "PHP", { status, 0, 0 } },
+			{ "PLA", { 0, Z | N, 0 } },
+			{ "PLP", { 0, status, status } },
+			{ "ROL", { C, C | Z | N, C } },
+			{ "ROR", { C, C | Z | N, C } },
+			{ "RTI", { 0, status, status } },
+			{ "SBC", { C, V | C | Z | N, 0 } },
+		};
+
+		for (const Entry& entry : table)
+		{
+			if (isMnemonic(info, entry.mnemonic))
+			{
+				return entry.effects;
+			}
+		}
+
+		return FlagEffects{ 0, 0, 0 };
+	}
+
+
+	std::string flagNames(byte flags)
+	{
+		static constexpr std::pair<byte, const char*> names[]{
+			{ recompiled::C, "recompiled::C" },
+			{ recompiled::Z, "recompiled::Z" },
+			{ recompiled::I, "recompiled::I" },
+			{ recompiled::D, "recompiled::D" },
+			{ recompiled::B, "recompiled::B" },
+			{ recompiled::V, "recompiled::V" },
+			{ recompiled::N, "recompiled::N" },
+		};
+
+		std::string text;
+		for (const auto& [flag, name] : names)
+		{
+			if ((flags & flag) != 0)
+			{
+				text += (text.empty() ? "" : " | ") + std::string{ name };
+			}
+		}
+
+		return text.empty() ? "0" : text;
+	}
+
+
+	/// <summary>
+	/// Name of the CPU's handler (see instruction_handlers.hpp), told which of its flags are
+	/// live when some of them are not.
+	/// </summary>
+	std::string handlerName(const OpcodeInfo& info, byte live)
+	{
+		std::string name{ std::string{ "recompiled::Handlers::do" } + info.mnemonic };
+
+		if (isMnemonic(info, "CPX"))
+		{
+			name = "recompiled::Handlers::doCMX";
+		}
+		if (isMnemonic(info, "CPY"))
+		{
+			name = "recompiled::Handlers::doCMY";
+		}
+
+		byte writes{ getFlagEffects(info).writes };
+		return ((writes & live) == writes) ? name : name + "<" + flagNames(writes & live) + ">";
+	}
+
+
+	size_t countFlags(byte flags)
+	{
+		size_t count{ 0 };
+		for (; flags != 0; flags &= flags - 1)
+		{
+			++count;
+		}
+
+		return count;
+	}
+
+
+	std::string indent(const std::string& code)
+	{
+		std::string out;
+
+		size_t line_start{ 0 };
+		while (line_start < code.size())
+		{
+			size_t line_end{ code.find('\n', line_start) };
+			std::string line{ code.substr(line_start, line_end - line_start) };
+			out += line.empty() ? "\n" : "\t" + line + "\n";
+			line_start = line_end + 1;
+		}
+
+		return out;
+	}
+
+
+	/// <summary>
+	/// Idioms counted by the report.
+	/// </summary>
+	struct Idiom
+	{
+		const char* name;
+		bool (*matches)(const OpcodeInfo& first, const OpcodeInfo& second);
+	};
+
+	const Idiom idioms[]{
+		{ "CMP #imm / BNE", [](const OpcodeInfo& a, const OpcodeInfo& b) {
+			return (isMnemonic(a, "CMP") || isMnemonic(a, "CPX") || isMnemonic(a, "CPY")) && a.mode == AddressingMode::Immediate
+				&& (isMnemonic(b, "BNE") || isMnemonic(b, "BEQ")); } },
+		{ "LDA / STA", [](const OpcodeInfo& a, const OpcodeInfo& b) { return isMnemonic(a, "LDA") && isMnemonic(b, "STA"); } },
+		{ "DEX / BNE", [](const OpcodeInfo& a, const OpcodeInfo& b) {
+			return (isMnemonic(a, "DEX") || isMnemonic(a, "DEY")) && isMnemonic(b, "BNE"); } },
+		{ "INC zp / BNE", [](const OpcodeInfo& a, const OpcodeInfo& b) {
+			return isMnemonic(a, "INC") && a.mode == AddressingMode::ZeroPage && isMnemonic(b, "BNE"); } },
+		{ "CLC / ADC", [](const OpcodeInfo& a, const OpcodeInfo& b) { return isMnemonic(a, "CLC") && isMnemonic(b, "ADC"); } },
+	};
+}
+
+
+Recompiler::Recompiler(const Cartridge& cartridge)
+	: rom(0x10000 - rom_start)
+{
+	// Mapped like NES::loadCartridge() does.
+	const std::vector<byte>& prg{ cartridge.getPRG() };
+
+	for (size_t offset{ 0 }; offset < rom.size(); offset += prg.size())
+	{
+		std::copy_n(prg.begin(), std::min(prg.size(), rom.size() - offset), rom.begin() + offset);
+	}
+}
+
+
+byte Recompiler::read(word address) const
+{
+	return rom[address - rom_start];
+}
+
+
+/*
+	The opcodes CPU::stepVariant() has cases for. Others are left to the interpreter;
+	keep the two in step.
+*/
+bool Recompiler::isCompiled(byte opcode)
+{
+	static constexpr const char* compiled[]{
+		"ADC", "AND", "ASL", "BCC", "BCS", "BEQ", "BIT", "BMI", "BNE", "BPL", "BRK", "BVC", "BVS",
+		"CLC", "CLD", "CLI", "CLV", "CMP", "CPX", "CPY", "DEC", "DEX", "DEY", "EOR", "INC", "INX",
+		"INY", "JMP", "JSR", "LDA", "LDX", "LDY", "LSR", "ORA", "PHA", "PHP", "PLA", "PLP", "ROL",
+		"ROR", "RTI", "RTS", "SBC", "STA", "STX", "STY",
+	};
+
+	const OpcodeInfo& info{ opcode_table[opcode] };
+	return std::any_of(std::begin(compiled), std::end(compiled), [&info](const char* mnemonic) { return isMnemonic(info, mnemonic); });
+}
+
+
+void Recompiler::addEntry(uint32_t address)
+{
+	if (address >= rom_start && address <= 0xFFFF && entries.insert(static_cast<word>(address)).second)
+	{
+		pending.push_back(static_cast<word>(address));
+	}
+}
+
+
+/*
+	Recursive descent. Each entry is decoded linearly until a branch, jump, call or return
+	(whose targets become entries; for a call, also the return point) or until it runs into
+	code decoded before (which becomes an entry, so the blocks do not overlap).
+*/
+void Recompiler::analyze()
+{
+	for (word vector : { word{ 0xFFFA }, word{ 0xFFFC }, word{ 0xFFFE } })
+	{
+		addEntry(read(vector) | (read(vector + 1) << 8));
+	}
+
+	while (!pending.empty())
+	{
+		word entry{ pending.back() };
+		pending.pop_back();
+
+		for (uint32_t address{ entry }; address <= 0xFFFF;)
+		{
+			if (!instructions.insert(static_cast<word>(address)).second)
+			{
+				addEntry(address);
+				break;
+			}
+
+			byte opcode{ read(static_cast<word>(address)) };
+			const OpcodeInfo& info{ opcode_table[opcode] };
+			uint32_t next{ address + getInstructionLength(info.mode) };
+			word operand{ static_cast<word>((next - address >= 3) ? (read(address + 1) | (read(address + 2) << 8)) : 0) };
+
+			if (next > 0x10000)
+			{
+				break;
+			}
+
+			if (!isCompiled(opcode))
+			{
+				// Interpreted. Guess that execution continues after it, for the blocks there.
+				addEntry(next);
+				break;
+			}
+
+			if (isMnemonic(info, "JSR"))
+			{
+				addEntry(operand);
+				addEntry(next);
+				break;
+			}
+
+			// RTI returns past the byte after BRK. Where RTS and RTI go is only known at run time.
+			if (isMnemonic(info, "BRK"))
+			{
+				addEntry(next + 1);
+				break;
+			}
+
+			if (isMnemonic(info, "RTS") || isMnemonic(info, "RTI"))
+			{
+				break;
+			}
+
+			if (info.mode == AddressingMode::Relative)
+			{
+				addEntry(static_cast<word>(next + static_cast<int8_t>(read(address + 1))));
+				addEntry(next);
+				break;
+			}
+
+			if (isMnemonic(info, "JMP"))
+			{
+				// Indirect jumps are followed only through vectors in ROM.
+				if (info.mode == AddressingMode::Absolute)
+				{
+					addEntry(operand);
+				}
+				else if (operand >= rom_start)
+				{
+					addEntry(read(operand) | (read((operand & 0xFF00) | static_cast<byte>(operand + 1)) << 8));
+				}
+				break;
+			}
+
+			address = next;
+		}
+	}
+}
+
+
+const std::set<word>& Recompiler::getBlockEntries() const
+{
+	return entries;
+}
+
+
+size_t Recompiler::getInstructionCount() const
+{
+	return instructions.size();
+}
+
+
+std::string Recompiler::generateAddress(word address, std::string& out, std::string& penalty, bool& is_constant, word& constant) const
+{
+	const OpcodeInfo& info{ opcode_table[read(address)] };
+	byte lo{ read(address + 1) };
+	word absolute{ static_cast<word>(lo | (((address + 2 <= 0xFFFF) ? read(address + 2) : 0) << 8)) };
+
+	is_constant = false;
+	penalty.clear();
+
+	switch (info.mode)
+	{
+		case AddressingMode::ZeroPage:
+			is_constant = true;
+			constant = lo;
+			return hex(lo, 4);
+
+		case AddressingMode::ZeroPageX:
+			return "static_cast<byte>(" + hex(lo, 2) + " + s.reg_x)";
+
+		case AddressingMode::ZeroPageY:
+			return "static_cast<byte>(" + hex(lo, 2) + " + s.reg_y)";
+
+		case AddressingMode::Absolute:
+			is_constant = true;
+			constant = absolute;
+			return hex(absolute, 4);
+
+		case AddressingMode::AbsoluteX:
+		case AddressingMode::AbsoluteY:
+			out += "\taddress = static_cast<word>(" + hex(absolute, 4) + ((info.mode == AddressingMode::AbsoluteX) ? " + s.reg_x);\n" : " + s.reg_y);\n");
+			penalty = "((address & 0xFF00) != " + hex(absolute & 0xFF00, 4) + ")";
+			return "address";
+
+		case AddressingMode::IndirectX:
+			return "recompiled::pointerX(s, " + hex(lo, 2) + ")";
+
+		case AddressingMode::IndirectY:
+			out += "\tbase = recompiled::pointer(s, " + hex(lo, 2) + ");\n";
+			out += "\taddress = static_cast<word>(base + s.reg_y);\n";
+			penalty = "((address & 0xFF00) != (base & 0xFF00))";
+			return "address";
+
+		default:
+			throw std::logic_error("Recompiler: addressing mode without an operand address");
+	}
+}
+
+
+bool Recompiler::generateInstruction(word address, byte live, std::string& out) const
+{
+	byte opcode{ read(address) };
+	const OpcodeInfo& info{ opcode_table[opcode] };
+	word next{ static_cast<word>(address + getInstructionLength(info.mode)) };
+
+	byte instruction[3]{ opcode, 0, 0 };
+	for (word i{ 1 }; i < getInstructionLength(info.mode); ++i)
+	{
+		instruction[i] = read(address + i);
+	}
+
+	out += "\t// $" + hex(address, 4).substr(2) + "  " + Disassembler::disassemble(address, instruction) + "\n";
+
+	const std::string cycles{ std::to_string(info.cycles) };
+
+	// Branches, jumps, calls and returns end the block.
+	if (info.mode == AddressingMode::Relative)
+	{
+		word destination{ static_cast<word>(next + static_cast<int8_t>(instruction[1])) };
+		int extra{ ((destination & 0xFF00) != (next & 0xFF00)) ? 2 : 1 };
+
+		out += "\tif (" + branchCondition(info) + ")\n\t{\n";
+		out += "\t\ts.program_counter = " + hex(destination, 4) + ";\n";
+		out += "\t\ts.cycles += " + std::to_string(extra) + ";\n";
+		if (destination < next)
+		{
+			out += "\t\ts.backward_jump = true;\n";
+		}
+		out += "\t}\n\telse\n\t{\n";
+		out += "\t\ts.program_counter = " + hex(next, 4) + ";\n";
+		out += "\t}\n";
+		out += "\ts.cycles += " + cycles + ";\n";
+		out += "\treturn;\n";
+		return false;
+	}
+
+	if (isMnemonic(info, "JMP"))
+	{
+		word operand{ static_cast<word>(instruction[1] | (instruction[2] << 8)) };
+
+		if (info.mode == AddressingMode::Absolute || operand >= rom_start)
+		{
+			// The target is known: the operand, or a vector in ROM.
+			word target{ operand };
+			if (info.mode == AddressingMode::Indirect)
+			{
+				target = static_cast<word>(read(operand) | (read((operand & 0xFF00) | static_cast<byte>(operand + 1)) << 8));
+			}
+
+			out += "\ts.program_counter = " + hex(target, 4) + ";\n";
+			if (target < next)
+			{
+				out += "\ts.backward_jump = true;\n";
+			}
+		}
+		else
+		{
+			out += "\ts.program_counter = recompiled::indirect(s, " + hex(operand, 4) + ");\n";
+			out += "\ts.backward_jump = s.program_counter < " + hex(next, 4) + ";\n";
+		}
+
+		out += "\ts.cycles += " + cycles + ";\n";
+		out += "\treturn;\n";
+		return false;
+	}
+
+	// A call continues in the subroutine's block, and records the block at the return point
+	// for the matching RTS. Returns pick their block at run time (see recompiled::doRTS()).
+	if (isMnemonic(info, "JSR"))
+	{
+		word target{ static_cast<word>(instruction[1] | (instruction[2] << 8)) };
+
+		out += "\trecompiled::doJSR(s, " + hex(next, 4) + ", " + hex(target, 4) + ", " + blockPointer(next) + ");\n";
+		out += "\ts.cycles += " + cycles + ";\n";
+		out += "\ts.next_block = " + blockPointer(target) + ";\n";
+		out += "\treturn;\n";
+		return false;
+	}
+
+	if (isMnemonic(info, "RTS") || isMnemonic(info, "RTI"))
+	{
+		out += "\trecompiled::do" + std::string{ info.mnemonic } + "(s);\n";
+		out += "\ts.cycles += " + cycles + ";\n";
+		out += "\treturn;\n";
+		return false;
+	}
+
+	if (isMnemonic(info, "BRK"))
+	{
+		out += "\trecompiled::doBRK(s, " + hex(static_cast<word>(next + 1), 4) + ");\n";
+		out += "\ts.cycles += " + cycles + ";\n";
+		out += "\treturn;\n";
+		return false;
+	}
+
+	if (info.mode == AddressingMode::Implied)
+	{
+		out += "\t" + handlerName(info, live) + "(s);\n";
+		out += "\ts.cycles += " + cycles + ";\n";
+		return true;
+	}
+
+	if (info.mode == AddressingMode::Accumulator)
+	{
+		out += "\t" + handlerName(info, live) + "(s, s.reg_accumulator);\n";
+		out += "\ts.cycles += " + cycles + ";\n";
+		return true;
+	}
+
+	if (info.mode == AddressingMode::Immediate)
+	{
+		out += "\t" + handlerName(info, live) + "(s, " + hex(instruction[1], 2) + ");\n";
+		out += "\ts.cycles += " + cycles + ";\n";
+		return true;
+	}
+
+	std::string penalty;
+	bool is_constant;
+	word constant{ 0 };
+	std::string operand{ generateAddress(address, out, penalty, is_constant, constant) };
+
+	if (info.page_cross_penalty && !penalty.empty())
+	{
+		penalty = " + " + penalty;
+	}
+	else
+	{
+		penalty.clear();
+	}
+
+	bool is_store{ isStore(info) };
+	bool is_modify{ isModify(info) };
+
+	if (is_store || is_modify)
+	{
+		std::string access;
+		if (is_store)
+		{
+			const char* reg{ isMnemonic(info, "STA") ? "s.reg_accumulator" : (isMnemonic(info, "STX") ? "s.reg_x" : "s.reg_y") };
+			access = "recompiled::write(s, " + operand + ", " + reg + ")";
+		}
+		else
+		{
+			access = "recompiled::modify<&" + handlerName(info, live) + ">(s, " + operand + ")";
+		}
+
+		// Only a write to $4014 starts OAM DMA.
+		if ((is_constant && constant != recompiled::oam_dma) || isZeroPage(info))
+		{
+			out += "\t" + access + ";\n";
+			out += "\ts.cycles += " + cycles + penalty + ";\n";
+		}
+		else
+		{
+			out += "\toam_dma = " + access + ";\n";
+			out += "\trecompiled::addCycles(s, " + cycles + penalty + ", oam_dma);\n";
+		}
+		return true;
+	}
+
+	// Reads from ROM have no side effects and are folded into constants.
+	std::string data{ (is_constant && constant >= rom_start) ? hex(read(constant), 2) : "recompiled::read(s, " + operand + ")" };
+
+	out += "\t" + handlerName(info, live) + "(s, " + data + ");\n";
+	out += "\ts.cycles += " + cycles + penalty + ";\n";
+	return true;
+}
+
+
+void Recompiler::setOptimization(bool enabled)
+{
+	optimization = enabled;
+}
+
+
+std::vector<word> Recompiler::decodeBlock(word entry) const
+{
+	std::vector<word> block;
+
+	for (uint32_t address{ entry }; isCompiled(read(static_cast<word>(address)));)
+	{
+		const OpcodeInfo& info{ opcode_table[read(static_cast<word>(address))] };
+		uint32_t next{ address + getInstructionLength(info.mode) };
+
+		// Wraps around the address space; left to the interpreter.
+		if (next > 0x10000)
+		{
+			break;
+		}
+
+		block.push_back(static_cast<word>(address));
+
+		// Ends at a branch or jump, or falls into another block.
+		if (isTerminator(info) || next > 0xFFFF || entries.count(static_cast<word>(next)) != 0)
+		{
+			break;
+		}
+
+		address = next;
+	}
+
+	return block;
+}
+
+
+bool Recompiler::hasBlock(word address) const
+{
+	return entries.count(address) != 0 && !decodeBlock(address).empty();
+}
+
+
+std::string Recompiler::blockPointer(word address) const
+{
+	return hasBlock(address) ? "&" + blockName(address) : "nullptr";
+}
+
+
+bool Recompiler::hasStaticCycles(word address) const
+{
+	const OpcodeInfo& info{ opcode_table[read(address)] };
+
+	if (isTerminator(info))
+	{
+		return false;
+	}
+
+	if (info.page_cross_penalty && (info.mode == AddressingMode::AbsoluteX || info.mode == AddressingMode::AbsoluteY
+		|| info.mode == AddressingMode::IndirectY))
+	{
+		return false;
+	}
+
+	// Stores may start OAM DMA unless the address is known not to be $4014.
+	if (isStore(info) || isModify(info))
+	{
+		return isZeroPage(info) || (info.mode == AddressingMode::Absolute && (read(address + 1) | (read(address + 2) << 8)) != recompiled::oam_dma);
+	}
+
+	return true;
+}
+
+
+std::vector<std::pair<size_t, size_t>> Recompiler::fuseBlock(const std::vector<word>& block) const
+{
+	std::vector<std::pair<size_t, size_t>> parts;
+
+	for (size_t first{ 0 }; first < block.size();)
+	{
+		size_t last{ first };
+		while (optimization && last + 1 < block.size() && hasStaticCycles(block[last]))
+		{
+			++last;
+		}
+
+		parts.emplace_back(first, last);
+		first = last + 1;
+	}
+
+	return parts;
+}
+
+
+/*
+	Backwards from the end of the superinstruction, where everything is live: a flag is live
+	before an instruction if the instruction reads it, or if it is live after it and the
+	instruction does not overwrite it.
+*/
+std::vector<byte> Recompiler::getLiveFlags(const std::vector<word>& block, size_t first, size_t last) const
+{
+	std::vector<byte> live(last - first + 1, recompiled::all_flags);
+
+	for (size_t i{ last }; i > first; --i)
+	{
+		FlagEffects effects{ getFlagEffects(opcode_table[read(block[i])]) };
+		live[i - 1 - first] = static_cast<byte>(effects.reads | (live[i - first] & ~effects.overwrites));
+	}
+
+	return live;
+}
+
+
+/*
+	A superinstruction runs in one piece when the budget cannot run out before its last
+	instruction; otherwise the plain code runs, checking after every instruction.
+*/
+std::string Recompiler::generate() const
+{
+	std::string out;
+	out += "// Generated by emuNES recompile. Do not edit.\n";
+	out += "#include \"recompiled_runtime.hpp\"\n\n\n";
+	out += "namespace\n{\n";
+
+	// Declared up front, for calls to blocks further down.
+	std::vector<word> blocks;
+
+	for (word entry : entries)
+	{
+		if (hasBlock(entry))
+		{
+			blocks.push_back(entry);
+			out += "\tvoid " + blockName(entry) + "(RecompiledState& s, uint64_t until);\n";
+		}
+	}
+
+	out += "\n\n";
+
+	for (word entry : blocks)
+	{
+		std::vector<word> block{ decodeBlock(entry) };
+		std::string body;
+
+		for (const auto& [first, last] : fuseBlock(block))
+		{
+			word end{ static_cast<word>(block[last] + getInstructionLength(opcode_table[read(block[last])].mode)) };
+
+			std::string plain;
+			bool falls_through{ true };
+
+			for (size_t i{ first }; i <= last; ++i)
+			{
+				falls_through = generateInstruction(block[i], recompiled::all_flags, plain);
+
+				if (i < last)
+				{
+					plain += "\tif (s.cycles >= until)\n\t{\n\t\ts.program_counter = " + hex(block[i + 1], 4) + ";\n\t\treturn;\n\t}\n\n";
+				}
+			}
+
+			if (first == last)
+			{
+				body += plain;
+			}
+			else
+			{
+				std::vector<byte> live{ getLiveFlags(block, first, last) };
+				std::string fused;
+				int cycles{ 0 };
+
+				for (size_t i{ first }; i <= last; ++i)
+				{
+					generateInstruction(block[i], live[i - first], fused);
+					cycles += (i < last) ? opcode_table[read(block[i])].cycles : 0;
+				}
+
+				body += "\tif (s.cycles + " + std::to_string(cycles) + " < until)\n\t{\n" + indent(fused) + "\t}\n";
+				body += "\telse\n\t{\n" + indent(plain) + "\t}\n";
+			}
+
+			if (!falls_through)
+			{
+				break;
+			}
+
+			// Falls into another block, or into code the interpreter runs.
+			if (last + 1 == block.size())
+			{
+				body += "\ts.program_counter = " + hex(end, 4) + ";\n";
+			}
+			else
+			{
+				body += "\tif (s.cycles >= until)\n\t{\n\t\ts.program_counter = " + hex(end, 4) + ";\n\t\treturn;\n\t}\n\n";
+			}
+		}
+
+		out += "\tvoid " + blockName(entry) + "(RecompiledState& s, [[maybe_unused]] uint64_t until)\n\t{\n";
+		out += "\t\t[[maybe_unused]] word address;\n\t\t[[maybe_unused]] word base;\n\t\t[[maybe_unused]] bool oam_dma;\n\n";
+		out += indent(body);
+		out += "\t}\n\n\n";
+	}
+
+	out += "\tconst RecompiledBlockEntry blocks[]{\n";
+	for (word block : blocks)
+	{
+		out += "\t\t{ " + hex(block, 4) + ", &" + blockName(block) + " },\n";
+	}
+	if (blocks.empty())
+	{
+		out += "\t\t{ 0x0000, nullptr },\n";
+	}
+	out += "\t};\n\n";
+
+	out += "\tconst RecompiledModuleInfo module_info{ recompiled_abi_version, " + hex(RecompiledModule::hashROM(rom.data()), 16) + "ull, "
+		+ std::to_string(blocks.size()) + ", blocks };\n";
+	out += "}\n\n\n";
+
+	out += "extern \"C\" EMUNES_EXPORT const RecompiledModuleInfo* " + std::string{ recompiled_entry_point } + "()\n{\n\treturn &module_info;\n}\n";
+	return out;
+}
+
+
+Recompiler::Report Recompiler::getReport() const
+{
+	Report report{};
+	for (const Idiom& idiom : idioms)
+	{
+		report.idioms.push_back(Report::Idiom{ idiom.name, 0, 0 });
+	}
+
+	for (word entry : entries)
+	{
+		std::vector<word> block{ decodeBlock(entry) };
+		if (block.empty())
+		{
+			continue;
+		}
+
+		++report.blocks;
+		report.instructions += block.size();
+
+		for (const auto& [first, last] : fuseBlock(block))
+		{
+			if (first != last)
+			{
+				++report.superinstructions;
+				report.fused_instructions += last - first + 1;
+
+				std::vector<byte> live{ getLiveFlags(block, first, last) };
+				for (size_t i{ first }; i <= last; ++i)
+				{
+					report.dead_flags += countFlags(getFlagEffects(opcode_table[read(block[i])]).writes & ~live[i - first]);
+				}
+			}
+
+			for (size_t i{ first }; i <= last; ++i)
+			{
+				if (i + 1 == block.size())
+				{
+					continue;
+				}
+
+				for (size_t k{ 0 }; k < report.idioms.size(); ++k)
+				{
+					if (idioms[k].matches(opcode_table[read(block[i])], opcode_table[read(block[i + 1])]))
+					{
+						++report.idioms[k].found;
+						report.idioms[k].fused += (i < last) ? 1 : 0;
+					}
+				}
+			}
+		}
+	}
+
+	return report;
+}
+
+
+void Recompiler::printReport(const Report& report, std::FILE* file)
+{
+	auto percent = [](size_t part, size_t whole) { return (whole == 0) ? 0.0 : 100.0 * static_cast<double>(part) / static_cast<double>(whole); };
+
+	std::fprintf(file, "%zu instructions in %zu blocks\n", report.instructions, report.blocks);
+	std::fprintf(file, "%zu instructions (%.1f%%) fused into %zu superinstructions, %zu dead flag updates\n",
+		report.fused_instructions, percent(report.fused_instructions, report.instructions), report.superinstructions, report.dead_flags);
+
+	for (const Report::Idiom& idiom : report.idioms)
+	{
+		std::fprintf(file, "\t%-16s %zu of %zu fused (%.1f%%)\n", idiom.name, idiom.fused, idiom.found, percent(idiom.fused, idiom.found));
+	}
+}
+
+
+/*
+	Runs the interpreter, the unoptimized module and the optimized module side by side (so a
+	mismatch also tells which translation is wrong), with controller input changing every
+	frame, and compares state hashes and cycle counters after each frame.
+*/
+bool Recompiler::verify(const Cartridge& cartridge, const std::string& unoptimized, const std::string& optimized, uint64_t frames)
+{
+	const char* names[]{ "interpreter", "unoptimized module", "optimized module" };
+	RecompiledModule unoptimized_module{ unoptimized };
+	RecompiledModule optimized_module{ optimized };
+	const RecompiledModule* modules[]{ nullptr, &unoptimized_module, &optimized_module };
+
+	std::vector<NES> consoles(3);
+	for (size_t i{ 0 }; i < consoles.size(); ++i)
+	{
+		consoles[i].loadCartridge(cartridge);
+		consoles[i].power();
+
+		if (!consoles[i].getCPU().setRecompiledModule(modules[i]))
+		{
+			throw std::runtime_error(std::string{ "Recompiler: the " } + names[i] + " was not compiled from this ROM");
+		}
+	}
+
+	for (uint64_t frame{ 0 }; frame < frames; ++frame)
+	{
+		for (NES& nes : consoles)
+		{
+			nes.setInput(static_cast<byte>(frame), static_cast<byte>(frame >> 8));
+			nes.runFrame(false);
+		}
+
+		for (size_t i{ 1 }; i < consoles.size(); ++i)
+		{
+			uint64_t expected_cycles{ consoles[0].getCPU().getCycles() };
+			uint64_t cycles{ consoles[i].getCPU().getCycles() };
+
+			if (consoles[i].getStateHash() != consoles[0].getStateHash() || cycles != expected_cycles)
+			{
+				std::fprintf(stderr, "frame %llu: the %s diverges from the interpreter (cycle %llu, expected %llu)\n",
+					static_cast<unsigned long long>(frame), names[i], static_cast<unsigned long long>(cycles), static_cast<unsigned long long>(expected_cycles));
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+
+int Recompiler::run(int argc, char* argv[])
+{
+	if (argc >= 1 && std::string{ argv[0] } == "--verify")
+	{
+		if (argc < 4)
+		{
+			std::fprintf(stderr, "usage: recompile --verify <rom.nes> <unoptimized.so> <optimized.so> [frames]\n");
+			return EXIT_FAILURE;
+		}
+
+		try
+		{
+			uint64_t frames{ (argc >= 5) ? std::strtoull(argv[4], nullptr, 10) : 600 };
+			if (!verify(Cartridge::load(argv[1]), argv[2], argv[3], frames))
+			{
+				return EXIT_FAILURE;
+			}
+
+			std::printf("%llu frames match\n", static_cast<unsigned long long>(frames));
+		}
+		catch (const std::exception& e)
+		{
+			std::fprintf(stderr, "%s\n", e.what());
+			return EXIT_FAILURE;
+		}
+
+		return EXIT_SUCCESS;
+	}
+
+	bool optimize{ true };
+	if (argc >= 1 && std::string{ argv[0] } == "--no-optimize")
+	{
+		optimize = false;
+		--argc;
+		++argv;
+	}
+
+	if (argc < 2)
+	{
+		std::fprintf(stderr, "usage: recompile [--no-optimize] <rom.nes> <out.cpp>\n       recompile --verify <rom.nes> <unoptimized.so> <optimized.so> [frames]\n");
+		return EXIT_FAILURE;
+	}
+
+	try
+	{
+		Recompiler recompiler{ Cartridge::load(argv[0]) };
+		recompiler.setOptimization(optimize);
+		recompiler.analyze();
+
+		std::string source{ recompiler.generate() };
+
+		std::unique_ptr<std::FILE, int(*)(std::FILE*)> file{ std::fopen(argv[1], "wb"), &std::fclose };
+		if (file == nullptr || std::fwrite(source.data(), 1, source.size(), file.get()) != source.size())
+		{
+			throw std::runtime_error(std::string{ "Recompiler: could not write " } + argv[1]);
+		}
+
+		printReport(recompiler.getReport(), stdout);
+	}
+	catch (const std::exception& e)
+	{
+		std::fprintf(stderr, "%s\n", e.what());
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
\ No newline at end of file
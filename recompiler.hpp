@@ -0,0 +1,180 @@
+#pragma once
+
+#include <cstdio>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "types.hpp"
+#include "cartridge.hpp"
+
+
+/// <summary>
+/// Static recompiler: translates a cartridge's PRG ROM into C++, one function per basic block,
+/// for a shared library the emulator loads at run time (see RecompiledModule). Code is found
+/// by recursive descent from the NMI, reset and IRQ vectors, following branches and jumps.
+///
+/// Blocks only start at instruction boundaries the descent reached. Anything else (code in RAM,
+/// computed jumps to undiscovered addresses, opcodes the CPU does not implement yet) is left to
+/// the interpreter, which hands control back to compiled code at the next block entry.
+///
+/// Optimization fuses runs of instructions whose cycle counts are known at compile time into
+/// superinstructions: one cycle-budget check up front instead of one per instruction (with a
+/// plain copy for when the budget runs out inside the run, so results stay exact). Inside a
+/// superinstruction, flag updates that a later instruction overwrites before anything reads
+/// them are not computed (dead-flag elimination).
+///
+///		emuNES recompile [--no-optimize] <rom.nes> <out.cpp>
+///		emuNES recompile --verify <rom.nes> <unoptimized.so> <optimized.so> [frames]
+/// </summary>
+class Recompiler
+{
+public:
+	explicit Recompiler(const Cartridge& cartridge);
+
+	/// <summary>
+	/// Finds the code reachable from the interrupt vectors.
+	/// </summary>
+	void analyze();
+
+	/// <summary>
+	/// Superinstruction fusion and dead-flag elimination (on by default). Unoptimized output
+	/// is the reference to verify optimized modules against.
+	/// </summary>
+	void setOptimization(bool enabled);
+
+	/// <summary>
+	/// Writes the C++ source of the shared library.
+	/// </summary>
+	std::string generate() const;
+
+	/// <summary>
+	/// What optimization does for the analyzed code.
+	/// </summary>
+	struct Report
+	{
+		size_t blocks;
+		size_t instructions;
+
+		// Instructions inside superinstructions, and the superinstructions.
+		size_t fused_instructions;
+		size_t superinstructions;
+
+		// Flag updates (one per instruction and flag) left out as dead.
+		size_t dead_flags;
+
+		// Common idioms: occurrences within a block, and those fused.
+		struct Idiom
+		{
+			const char* name;
+			size_t found;
+			size_t fused;
+		};
+
+		std::vector<Idiom> idioms;
+	};
+
+	Report getReport() const;
+
+	/// <summary>
+	/// Prints the report, one idiom per line.
+	/// </summary>
+	static void printReport(const Report& report, std::FILE* file);
+
+	/// <summary>
+	/// Addresses where blocks start, after analyze().
+	/// </summary>
+	const std::set<word>& getBlockEntries() const;
+
+	/// <summary>
+	/// Number of instructions found by analyze().
+	/// </summary>
+	size_t getInstructionCount() const;
+
+	/// <summary>
+	/// Is the opcode handled by the CPU's dispatch loop (and so compiled)?
+	/// </summary>
+	static bool isCompiled(byte opcode);
+
+	/// <summary>
+	/// Runs the cartridge for a number of frames on the interpreter and with both modules built
+	/// from it (unoptimized and optimized), and checks that state hashes and cycle counts match
+	/// after every frame. Mismatches are reported on stderr. Throws std::runtime_error if a
+	/// module cannot be loaded or was built from another ROM.
+	/// </summary>
+	/// <returns>True if all three agree on every frame.</returns>
+	static bool verify(const Cartridge& cartridge, const std::string& unoptimized, const std::string& optimized, uint64_t frames);
+
+	/// <param name="argc">Number of arguments following the tool name.</param>
+	/// <param name="argv">Arguments following the tool name.</param>
+	/// <returns>Process exit code.</returns>
+	static int run(int argc, char* argv[]);
+
+private:
+	static constexpr word rom_start{ 0x8000 };
+
+	/// <summary>
+	/// Byte at a CPU address in ROM ($8000-$FFFF).
+	/// </summary>
+	byte read(word address) const;
+
+	/// <summary>
+	/// Marks an address as a block entry and queues it for the descent.
+	/// </summary>
+	void addEntry(uint32_t address);
+
+	/// <summary>
+	/// Instructions of the block starting at the entry, in order.
+	/// Empty if the entry cannot be compiled.
+	/// </summary>
+	std::vector<word> decodeBlock(word entry) const;
+
+	/// <summary>
+	/// Does generate() write a block for the address?
+	/// </summary>
+	bool hasBlock(word address) const;
+
+	/// <returns>The generated expression for a pointer to the block at the address, or "nullptr".</returns>
+	std::string blockPointer(word address) const;
+
+	/// <summary>
+	/// Is the instruction's cycle count known at compile time? (No page-crossing penalty, no
+	/// possible OAM DMA, not a branch.)
+	/// </summary>
+	bool hasStaticCycles(word address) const;
+
+	/// <summary>
+	/// Splits a block into superinstructions: each is a run of instructions with static cycle
+	/// counts, plus the instruction after them. Single instructions are left as they are.
+	/// </summary>
+	/// <returns>Index of the first and last instruction of each part.</returns>
+	std::vector<std::pair<size_t, size_t>> fuseBlock(const std::vector<word>& block) const;
+
+	/// <summary>
+	/// Flags live after each instruction of a superinstruction. All flags are live at its end.
+	/// </summary>
+	std::vector<byte> getLiveFlags(const std::vector<word>& block, size_t first, size_t last) const;
+
+	/// <summary>
+	/// Appends the code of one instruction to out, computing only the live flags.
+	/// </summary>
+	/// <returns>False if the instruction ends the block (branch, jump, call or return).</returns>
+	bool generateInstruction(word address, byte live, std::string& out) const;
+
+	/// <summary>
+	/// C++ expression for the instruction's operand address. Statements it needs first are
+	/// appended to out. penalty gets the page-crossing condition (empty when the mode has none),
+	/// and constant the address if it is known at compile time.
+	/// </summary>
+	std::string generateAddress(word address, std::string& out, std::string& penalty, bool& is_constant, word& constant) const;
+
+	// CPU view of the ROM: $8000-$FFFF, 16 KiB images mirrored.
+	std::vector<byte> rom;
+
+	std::set<word> entries;
+	std::vector<word> pending;
+	std::set<word> instructions;
+
+	bool optimization{ true };
+};
\ No newline at end of file
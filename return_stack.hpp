@@ -0,0 +1,121 @@
+#pragma once
+
+#include <array>
+
+#include "types.hpp"
+
+struct RecompiledState;
+
+
+/// <summary>
+/// Shadow return stack: the subroutine calls (JSR) and interrupts (BRK, NMI) the CPU has
+/// entered and not yet returned from, kept beside the real stack in page $01.
+///
+/// When an RTS or RTI pulls its address, the frame pushed by the matching call predicts it,
+/// so recompiled code can continue straight into the block it returns to instead of looking
+/// the address up (see CPU::runRecompiled()). The prediction is only used once it agrees with
+/// the address actually pulled. Code that manages the stack itself (the RTS trick of pushing
+/// a jump table entry and returning to it, dropping a return address to return to the
+/// caller's caller, resetting the stack pointer) costs a misprediction and nothing else.
+///
+/// The frames are also the current call path, for profilers to sample (CPU::getReturnStack()).
+/// Plain data, so recompiled code can share it with the CPU.
+/// </summary>
+class ReturnStack
+{
+public:
+	// Deeper nesting pushes out the outermost frames, which are then no longer predicted.
+	static constexpr size_t capacity{ 64 };
+
+	struct Frame
+	{
+		word target;				// subroutine or handler entered
+		word return_address;		// where the matching RTS or RTI continues
+		byte stack_pointer;			// after the call pushed its return address (and status)
+		bool interrupt;
+		uint64_t cycles;			// CPU cycles when the call was made
+
+		// Compiled block at return_address, or nullptr if there is none (or the caller did not know).
+		void (*return_block)(RecompiledState& state, uint64_t until);
+	};
+
+	struct Stats
+	{
+		uint64_t predicted;
+		uint64_t mispredicted;
+	};
+
+	void call(const Frame& frame)
+	{
+		top = (top + 1) % capacity;
+		frames[top] = frame;
+		depth = (depth < capacity) ? depth + 1 : capacity;
+	}
+
+	/// <summary>
+	/// Matches a return with its call. Frames below the stack pointer were unwound without
+	/// a return and are dropped. The frame at the stack pointer is the one returned to; it is
+	/// popped, and the return was predicted if it goes where the frame said. A return from
+	/// above every frame (data pushed by the program itself) leaves the frames alone.
+	/// </summary>
+	/// <param name="stack_pointer">Stack pointer before the return pulled anything.</param>
+	/// <param name="return_address">Where the return actually continues.</param>
+	/// <returns>The frame returned to if it was predicted, else nullptr. Valid until the next call.</returns>
+	const Frame* ret(byte stack_pointer, word return_address)
+	{
+		while (depth > 0 && frames[top].stack_pointer < stack_pointer)
+		{
+			pop();
+		}
+
+		const Frame* frame{ nullptr };
+		if (depth > 0 && frames[top].stack_pointer == stack_pointer)
+		{
+			frame = &frames[top];
+			pop();
+		}
+
+		if (frame != nullptr && frame->return_address == return_address)
+		{
+			++stats.predicted;
+			return frame;
+		}
+
+		++stats.mispredicted;
+		return nullptr;
+	}
+
+	void clear()
+	{
+		depth = 0;
+	}
+
+	/// <returns>Number of frames (calls not yet returned from, up to capacity).</returns>
+	size_t getDepth() const
+	{
+		return depth;
+	}
+
+	/// <param name="level">0 for the innermost call, up to getDepth() - 1 for the outermost.</param>
+	const Frame& getFrame(size_t level) const
+	{
+		return frames[(top + capacity - level) % capacity];
+	}
+
+	Stats getStats() const
+	{
+		return stats;
+	}
+
+private:
+	void pop()
+	{
+		top = (top + capacity - 1) % capacity;
+		--depth;
+	}
+
+	std::array<Frame, capacity> frames{};
+	size_t top{ 0 };
+	size_t depth{ 0 };
+	Stats stats{};
+};
\ No newline at end of file
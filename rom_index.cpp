@@ -0,0 +1,642 @@
+#include "rom_index.hpp"
+#include "cartridge.hpp"
+#include "hash.hpp"
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+static_assert(sizeof(RomIndex::Entry) == 80, "RomIndex::Entry is part of the file format");
+
+
+namespace
+{
+	constexpr char index_magic[8]{ 'E', 'M', 'U', 'N', 'E', 'S', 'I', 'X' };
+
+
+	size_t alignUp(size_t value)
+	{
+		return (value + 7) & ~size_t{ 7 };
+	}
+
+
+	// Size and modification time, or false if the file does not exist.
+	bool getFileStamp(const std::string& path, uint64_t& file_size, int64_t& modified)
+	{
+		std::error_code error;
+		file_size = std::filesystem::file_size(path, error);
+		if (error)
+		{
+			return false;
+		}
+
+		modified = static_cast<int64_t>(std::filesystem::last_write_time(path, error).time_since_epoch().count());
+		return !error;
+	}
+
+
+	struct Correction
+	{
+		byte mapper;
+		byte mirroring;
+		byte battery;
+	};
+
+
+	/*
+		Database lines: "sha1-hex mapper H|V battery", e.g.
+			# Some Game (USA)
+			0123456789abcdef0123456789abcdef01234567 0 V 0
+	*/
+	std::unordered_map<std::string, Correction> readDatabase(const std::string& path)
+	{
+		std::unordered_map<std::string, Correction> corrections;
+		if (path.empty())
+		{
+			return corrections;
+		}
+
+		std::unique_ptr<std::FILE, int(*)(std::FILE*)> file{ std::fopen(path.c_str(), "r"), &std::fclose };
+		if (file == nullptr)
+		{
+			throw std::runtime_error("RomIndex: could not open " + path);
+		}
+
+		char line[512];
+		while (std::fgets(line, sizeof(line), file.get()) != nullptr)
+		{
+			char sha1_hex[41];
+			unsigned int mapper;
+			char mirroring;
+			unsigned int battery;
+
+			if (line[0] == '#' || std::sscanf(line, "%40s %u %c %u", sha1_hex, &mapper, &mirroring, &battery) != 4)
+			{
+				continue;
+			}
+
+			std::string key{ sha1_hex };
+			std::transform(key.begin(), key.end(), key.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+			Mirroring value{ (mirroring == 'V' || mirroring == 'v') ? Mirroring::Vertical : Mirroring::Horizontal };
+			corrections[key] = Correction{ static_cast<byte>(mapper), static_cast<byte>(value), static_cast<byte>(battery != 0) };
+		}
+
+		return corrections;
+	}
+
+
+	std::string toHex(const byte* data, size_t length)
+	{
+		static constexpr char digits[]{ "0123456789abcdef" };
+
+		std::string hex;
+		for (size_t i{ 0 }; i < length; ++i)
+		{
+			hex += digits[data[i] >> 4];
+			hex += digits[data[i] & 0x0F];
+		}
+
+		return hex;
+	}
+
+
+	bool hasNESExtension(const std::filesystem::path& path)
+	{
+		std::string extension{ path.extension().string() };
+		std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+		return extension == ".nes";
+	}
+
+
+	/*
+		Reads and hashes one file. Returns false if it cannot be read; a file that is not a valid
+		iNES image still gets an entry (without the valid flag), so it is not read again.
+	*/
+	bool hashFile(const std::string& path, RomIndex::Entry& entry)
+	{
+		std::vector<byte> image;
+		try
+		{
+			image = Cartridge::readImage(path);
+		}
+		catch (const std::runtime_error&)
+		{
+			return false;
+		}
+
+		entry.file_size = image.size();
+
+		INESHeader header;
+		try
+		{
+			header = INESHeader::parse(image);
+		}
+		catch (const std::runtime_error&)
+		{
+			return true;
+		}
+
+		const byte* prg{ image.data() + header.prg_offset };
+		const byte* chr{ prg + header.prg_size };
+
+		entry.prg_crc32 = crc32(prg, header.prg_size);
+		entry.chr_crc32 = crc32(chr, header.chr_size);
+		entry.crc32 = crc32(chr, header.chr_size, entry.prg_crc32);
+
+		std::array<byte, 20> digest{ sha1(prg, header.prg_size + header.chr_size) };
+		std::memcpy(entry.sha1, digest.data(), digest.size());
+
+		entry.prg_size = static_cast<uint32_t>(header.prg_size);
+		entry.chr_size = static_cast<uint32_t>(header.chr_size);
+		entry.header_mapper = header.mapper;
+		entry.header_mirroring = static_cast<byte>(header.mirroring);
+		entry.header_battery = header.battery;
+		entry.mapper = entry.header_mapper;
+		entry.mirroring = entry.header_mirroring;
+		entry.battery = entry.header_battery;
+		entry.flags = RomIndex::valid;
+
+		return true;
+	}
+}
+
+
+#pragma region Reading
+RomIndex::RomIndex(const std::string& path)
+{
+#if defined(_WIN32)
+	HANDLE file{ CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr) };
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		throw std::runtime_error("RomIndex: could not open " + path);
+	}
+
+	LARGE_INTEGER file_size;
+	GetFileSizeEx(file, &file_size);
+	size = static_cast<size_t>(file_size.QuadPart);
+
+	mapping = (size > 0) ? CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+	CloseHandle(file);
+
+	data = (mapping != nullptr) ? static_cast<const byte*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+#else
+	int file{ open(path.c_str(), O_RDONLY) };
+	if (file < 0)
+	{
+		throw std::runtime_error("RomIndex: could not open " + path);
+	}
+
+	struct stat status;
+	size = (fstat(file, &status) == 0) ? static_cast<size_t>(status.st_size) : 0;
+
+	void* view{ (size > 0) ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0) : MAP_FAILED };
+	close(file);
+
+	data = (view != MAP_FAILED) ? static_cast<const byte*>(view) : nullptr;
+#endif
+
+	// Sections must fit the file before anything points into it.
+	header = reinterpret_cast<const FileHeader*>(data);
+	bool is_index{ data != nullptr && size >= sizeof(FileHeader)
+		&& std::memcmp(header->magic, index_magic, sizeof(index_magic)) == 0 && header->version == version };
+
+	if (is_index)
+	{
+		size_t entries_offset{ sizeof(FileHeader) };
+		size_t table_offset{ entries_offset + size_t{ header->entry_count } * sizeof(Entry) };
+		size_t strings_offset{ table_offset + alignUp(size_t{ header->table_size } * sizeof(uint32_t)) };
+
+		is_index = header->table_size > 0 && (header->table_size & (header->table_size - 1)) == 0
+			&& header->table_size > header->entry_count && strings_offset + header->strings_size <= size;
+
+		if (is_index)
+		{
+			entries = reinterpret_cast<const Entry*>(data + entries_offset);
+			table = reinterpret_cast<const uint32_t*>(data + table_offset);
+			strings = reinterpret_cast<const char*>(data + strings_offset);
+		}
+	}
+
+	if (!is_index)
+	{
+		unmap();
+		throw std::runtime_error("RomIndex: " + path + " is not a ROM index of this version");
+	}
+}
+
+
+RomIndex::~RomIndex()
+{
+	unmap();
+}
+
+
+void RomIndex::unmap()
+{
+	if (data != nullptr)
+	{
+#if defined(_WIN32)
+		UnmapViewOfFile(data);
+#else
+		munmap(const_cast<byte*>(data), size);
+#endif
+		data = nullptr;
+	}
+
+#if defined(_WIN32)
+	if (mapping != nullptr)
+	{
+		CloseHandle(mapping);
+		mapping = nullptr;
+	}
+#endif
+}
+
+
+/*
+	Linear probing from the slot of the path's hash. A matching hash is confirmed against the
+	stored path, so a collision can cost a probe but never returns the wrong entry.
+*/
+const RomIndex::Entry* RomIndex::find(const std::string& rom_path) const
+{
+	if (header == nullptr || header->entry_count == 0)
+	{
+		return nullptr;
+	}
+
+	std::string key{ normalizePath(rom_path) };
+	uint64_t hash{ xxHash64(key.data(), key.size()) };
+	uint32_t mask{ header->table_size - 1 };
+
+	for (uint32_t slot{ static_cast<uint32_t>(hash) & mask }; table[slot] != 0; slot = (slot + 1) & mask)
+	{
+		uint32_t index{ table[slot] - 1 };
+		if (index >= header->entry_count)
+		{
+			return nullptr;
+		}
+
+		const Entry& entry{ entries[index] };
+		if (entry.path_hash == hash && entry.path_length == key.size()
+			&& size_t{ entry.path_offset } + entry.path_length <= header->strings_size
+			&& std::memcmp(strings + entry.path_offset, key.data(), key.size()) == 0)
+		{
+			return &entry;
+		}
+	}
+
+	return nullptr;
+}
+
+
+size_t RomIndex::getEntryCount() const
+{
+	return (header != nullptr) ? header->entry_count : 0;
+}
+
+
+const RomIndex::Entry& RomIndex::getEntry(size_t index) const
+{
+	return entries[index];
+}
+
+
+std::string RomIndex::getPath(const Entry& entry) const
+{
+	if (size_t{ entry.path_offset } + entry.path_length > header->strings_size)
+	{
+		return {};
+	}
+
+	return std::string{ strings + entry.path_offset, entry.path_length };
+}
+
+
+bool RomIndex::isCurrent(const Entry& entry, const std::string& rom_path)
+{
+	uint64_t file_size;
+	int64_t modified;
+	return getFileStamp(rom_path, file_size, modified) && file_size == entry.file_size && modified == entry.modified;
+}
+
+
+std::string RomIndex::normalizePath(const std::string& path)
+{
+	std::error_code error;
+	std::filesystem::path absolute{ std::filesystem::absolute(path, error) };
+	return (error ? std::filesystem::path{ path } : absolute).lexically_normal().generic_string();
+}
+#pragma endregion
+
+
+#pragma region Writing
+/*
+	1. Collect the paths: those of the old index that still exist, then the given files and
+	   the .nes files under the given directories.
+	2. Keep old entries whose file is unchanged; hash the rest on the thread pool.
+	3. Apply the database, if one is given, to every entry, so editing it needs no rehashing.
+	   Without one, the corrections of the old index stand in for it: they are looked up by
+	   SHA-1 like the database's, so a file that is hashed again, moved or copied keeps them.
+	4. Write the new index and rename it over the old one (after unmapping the old one, which
+	   Windows requires).
+*/
+RomIndex::UpdateReport RomIndex::update(const std::string& index_path, const std::vector<std::string>& rom_paths,
+	const std::string& database_path, unsigned threads)
+{
+	std::unordered_map<std::string, Correction> corrections{ readDatabase(database_path) };
+
+	std::vector<std::string> paths;
+	std::unordered_map<std::string, Entry> old_entries;
+
+	if (std::filesystem::exists(index_path))
+	{
+		RomIndex old_index{ index_path };
+
+		for (size_t i{ 0 }; i < old_index.getEntryCount(); ++i)
+		{
+			const Entry& entry{ old_index.getEntry(i) };
+			std::string path{ old_index.getPath(entry) };
+
+			if (database_path.empty() && (entry.flags & valid) && (entry.flags & header_corrected))
+			{
+				corrections.emplace(toHex(entry.sha1, sizeof(entry.sha1)), Correction{ entry.mapper, entry.mirroring, entry.battery });
+			}
+
+			if (!path.empty() && std::filesystem::exists(path) && old_entries.emplace(path, entry).second)
+			{
+				paths.push_back(path);
+			}
+		}
+	}
+
+	auto addPath = [&](const std::filesystem::path& path) {
+		std::string key{ normalizePath(path.string()) };
+		if (std::find(paths.begin(), paths.end(), key) == paths.end())
+		{
+			paths.push_back(key);
+		}
+	};
+
+	for (const std::string& rom_path : rom_paths)
+	{
+		if (std::filesystem::is_directory(rom_path))
+		{
+			for (const auto& item : std::filesystem::recursive_directory_iterator{ rom_path, std::filesystem::directory_options::skip_permission_denied })
+			{
+				if (item.is_regular_file() && hasNESExtension(item.path()))
+				{
+					addPath(item.path());
+				}
+			}
+		}
+		else
+		{
+			addPath(rom_path);
+		}
+	}
+
+	// Step 2.
+	UpdateReport report;
+	std::vector<Entry> entries(paths.size());
+	std::vector<byte> readable(paths.size(), 0);
+	std::vector<size_t> stale;
+
+	for (size_t i{ 0 }; i < paths.size(); ++i)
+	{
+		Entry& entry{ entries[i] };
+		entry.path_hash = xxHash64(paths[i].data(), paths[i].size());
+
+		auto old_entry{ old_entries.find(paths[i]) };
+		if (old_entry != old_entries.end() && isCurrent(old_entry->second, paths[i]))
+		{
+			entry = old_entry->second;
+			readable[i] = 1;
+			++report.reused;
+		}
+		else
+		{
+			stale.push_back(i);
+		}
+	}
+
+	{
+		ThreadPool pool{ std::max(threads, 1u) };
+		pool.run(stale.size(), [&](size_t job) {
+			size_t i{ stale[job] };
+			uint64_t file_size;
+			int64_t modified;
+
+			// Stamped before reading: a file changed while it is hashed is hashed again next time.
+			if (getFileStamp(paths[i], file_size, modified) && hashFile(paths[i], entries[i]))
+			{
+				entries[i].file_size = file_size;
+				entries[i].modified = modified;
+				readable[i] = 1;
+			}
+		});
+	}
+
+	std::vector<Entry> kept;
+	std::vector<std::string> kept_paths;
+
+	for (size_t i{ 0 }; i < paths.size(); ++i)
+	{
+		if (!readable[i])
+		{
+			++report.failed;
+			continue;
+		}
+
+		// Step 3.
+		Entry& entry{ entries[i] };
+		entry.mapper = entry.header_mapper;
+		entry.mirroring = entry.header_mirroring;
+		entry.battery = entry.header_battery;
+		entry.flags &= ~header_corrected;
+
+		auto correction{ corrections.find(toHex(entry.sha1, sizeof(entry.sha1))) };
+		if ((entry.flags & valid) && correction != corrections.end())
+		{
+			entry.mapper = correction->second.mapper;
+			entry.mirroring = correction->second.mirroring;
+			entry.battery = correction->second.battery;
+
+			if (entry.mapper != entry.header_mapper || entry.mirroring != entry.header_mirroring || entry.battery != entry.header_battery)
+			{
+				entry.flags |= header_corrected;
+			}
+		}
+
+		if (entry.flags & header_corrected)
+		{
+			++report.corrected;
+		}
+
+		kept.push_back(entry);
+		kept_paths.push_back(paths[i]);
+	}
+
+	report.hashed = stale.size() - report.failed;
+	report.entries = kept.size();
+
+	// Step 4.
+	writeIndex(index_path, kept, kept_paths);
+
+	return report;
+}
+
+
+void RomIndex::writeIndex(const std::string& path, std::vector<Entry>& entries, const std::vector<std::string>& paths)
+{
+	size_t table_size{ 16 };
+	while (table_size < entries.size() * 2)
+	{
+		table_size *= 2;
+	}
+
+	std::vector<uint32_t> table(table_size, 0);
+	std::string strings;
+
+	for (size_t i{ 0 }; i < entries.size(); ++i)
+	{
+		Entry& entry{ entries[i] };
+		entry.path_offset = static_cast<uint32_t>(strings.size());
+		entry.path_length = static_cast<uint32_t>(paths[i].size());
+		strings += paths[i];
+
+		size_t slot{ entry.path_hash & (table_size - 1) };
+		while (table[slot] != 0)
+		{
+			slot = (slot + 1) & (table_size - 1);
+		}
+		table[slot] = static_cast<uint32_t>(i + 1);
+	}
+
+	strings.resize(alignUp(strings.size()), '\0');
+
+	FileHeader header{};
+	std::memcpy(header.magic, index_magic, sizeof(index_magic));
+	header.version = version;
+	header.entry_count = static_cast<uint32_t>(entries.size());
+	header.table_size = static_cast<uint32_t>(table_size);
+	header.strings_size = static_cast<uint32_t>(strings.size());
+
+	// Written next to the index and renamed over it, so readers never see half an index.
+	std::string temporary_path{ path + ".tmp" };
+	{
+		std::unique_ptr<std::FILE, int(*)(std::FILE*)> file{ std::fopen(temporary_path.c_str(), "wb"), &std::fclose };
+		if (file == nullptr)
+		{
+			throw std::runtime_error("RomIndex: could not write " + temporary_path);
+		}
+
+		static constexpr byte padding[8]{};
+		size_t table_bytes{ table.size() * sizeof(uint32_t) };
+
+		bool written{ std::fwrite(&header, sizeof(header), 1, file.get()) == 1
+			&& std::fwrite(entries.data(), sizeof(Entry), entries.size(), file.get()) == entries.size()
+			&& std::fwrite(table.data(), 1, table_bytes, file.get()) == table_bytes
+			&& std::fwrite(padding, 1, alignUp(table_bytes) - table_bytes, file.get()) == alignUp(table_bytes) - table_bytes
+			&& std::fwrite(strings.data(), 1, strings.size(), file.get()) == strings.size() };
+
+		if (!written || std::fflush(file.get()) != 0)
+		{
+			throw std::runtime_error("RomIndex: could not write " + temporary_path);
+		}
+	}
+
+	std::filesystem::rename(temporary_path, path);
+}
+#pragma endregion
+
+
+int RomIndex::run(int argc, char* argv[])
+{
+	if (argc < 1)
+	{
+		std::fprintf(stderr, "usage: index <index> [--database <file>] [--threads <n>] [--list] [rom|dir]...\n");
+		return EXIT_FAILURE;
+	}
+
+	std::string index_path{ argv[0] };
+	std::string database_path;
+	unsigned threads{ std::max(std::thread::hardware_concurrency(), 1u) };
+	bool list{ false };
+	std::vector<std::string> rom_paths;
+
+	for (int i{ 1 }; i < argc; ++i)
+	{
+		std::string argument{ argv[i] };
+
+		if (argument == "--database" && i + 1 < argc)
+		{
+			database_path = argv[++i];
+		}
+		else if (argument == "--threads" && i + 1 < argc)
+		{
+			threads = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+		}
+		else if (argument == "--list")
+		{
+			list = true;
+		}
+		else
+		{
+			rom_paths.push_back(argument);
+		}
+	}
+
+	try
+	{
+		UpdateReport report{ update(index_path, rom_paths, database_path, threads) };
+		std::printf("%zu entries: %zu unchanged, %zu hashed, %zu unreadable, %zu corrected\n",
+			report.entries, report.reused, report.hashed, report.failed, report.corrected);
+
+		if (list)
+		{
+			RomIndex index{ index_path };
+
+			for (size_t i{ 0 }; i < index.getEntryCount(); ++i)
+			{
+				const Entry& entry{ index.getEntry(i) };
+				if (entry.flags & valid)
+				{
+					std::printf("%08X %s mapper %3u %c%s%s  %s\n", entry.crc32, toHex(entry.sha1, sizeof(entry.sha1)).c_str(), entry.mapper,
+						(entry.mirroring == static_cast<byte>(Mirroring::Vertical)) ? 'V' : 'H', entry.battery ? " battery" : "",
+						(entry.flags & header_corrected) ? " (corrected)" : "", index.getPath(entry).c_str());
+				}
+				else
+				{
+					std::printf("%-49s %s\n", "(not an iNES image)", index.getPath(entry).c_str());
+				}
+			}
+		}
+	}
+	catch (const std::exception& e)
+	{
+		std::fprintf(stderr, "%s\n", e.what());
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
\ No newline at end of file
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "types.hpp"
+
+
+/// <summary>
+/// On-disk index of a ROM library: hashes, header fields and header corrections of every
+/// .nes file, keyed by path. The file is memory-mapped read-only and looked up in place with
+/// an open-addressing hash table, so opening it costs no parsing and a lookup one or two probes.
+///
+/// Layout (native byte order, every section 8-byte aligned):
+///		FileHeader
+///		Entry[entry_count]
+///		uint32_t table[table_size]	entry index + 1, or 0 for an empty slot
+///		char strings[strings_size]	paths, not terminated
+///
+/// update() builds or refreshes an index: files whose size and modification time match their
+/// entry are kept without reading them; the others are hashed in parallel.
+/// </summary>
+class RomIndex
+{
+public:
+	/// <summary>
+	/// One ROM file. Hashes cover PRG and CHR ROM without the iNES header and trainer,
+	/// the way ROM databases (No-Intro, NesCartDB) identify dumps.
+	/// </summary>
+	struct Entry
+	{
+		uint64_t path_hash;
+		int64_t modified;			// file system clock ticks
+		uint64_t file_size;
+		uint32_t path_offset;		// into the strings section
+		uint32_t path_length;
+
+		uint32_t crc32;				// PRG + CHR
+		uint32_t prg_crc32;
+		uint32_t chr_crc32;
+		byte sha1[20];				// PRG + CHR
+		uint32_t prg_size;
+		uint32_t chr_size;
+
+		// Board, after corrections from the database.
+		byte mapper;
+		byte mirroring;				// Mirroring
+		byte battery;
+		byte flags;
+
+		// Board as the file's header has it.
+		byte header_mapper;
+		byte header_mirroring;
+		byte header_battery;
+		byte reserved;
+	};
+
+	// Entry::flags
+	static constexpr byte valid{ 0x01 };				// an iNES image; hashes and board are set
+	static constexpr byte header_corrected{ 0x02 };		// the database changed the board
+
+	static constexpr uint32_t version{ 1 };
+
+	/// <summary>
+	/// Statistics of an update().
+	/// </summary>
+	struct UpdateReport
+	{
+		size_t entries{ 0 };
+		size_t reused{ 0 };
+		size_t hashed{ 0 };
+		size_t failed{ 0 };			// unreadable files, left out of the index
+		size_t corrected{ 0 };		// entries with header_corrected
+	};
+
+	/// <summary>
+	/// An empty index.
+	/// </summary>
+	RomIndex() = default;
+
+	/// <summary>
+	/// Maps an index file. Throws std::runtime_error if it cannot be opened, is not an index
+	/// or was written by another version.
+	/// </summary>
+	explicit RomIndex(const std::string& path);
+	~RomIndex();
+
+	RomIndex(const RomIndex&) = delete;
+	RomIndex& operator=(const RomIndex&) = delete;
+
+	/// <returns>The entry of the file, or nullptr.</returns>
+	const Entry* find(const std::string& rom_path) const;
+
+	size_t getEntryCount() const;
+	const Entry& getEntry(size_t index) const;
+	std::string getPath(const Entry& entry) const;
+
+	/// <summary>
+	/// Does the file still have the size and modification time of its entry?
+	/// </summary>
+	static bool isCurrent(const Entry& entry, const std::string& rom_path);
+
+	/// <summary>
+	/// Creates or refreshes an index. Entries of files that no longer exist are dropped; the
+	/// given files, and the .nes files under the given directories, are added.
+	/// </summary>
+	/// <param name="database_path">Header corrections, or empty to keep the current ones. One line
+	/// per image: "sha1-hex mapper H|V battery(0|1)"; '#' starts a comment.</param>
+	/// <param name="threads">Threads hashing files (at least 1).</param>
+	static UpdateReport update(const std::string& index_path, const std::vector<std::string>& rom_paths,
+		const std::string& database_path, unsigned threads);
+
+	/// <summary>
+	/// Command line tool: index &lt;index&gt; [--database &lt;file&gt;] [--threads &lt;n&gt;] [--list] [rom|dir]...
+	/// </summary>
+	static int run(int argc, char* argv[]);
+
+private:
+	struct FileHeader
+	{
+		char magic[8];
+		uint32_t version;
+		uint32_t entry_count;
+		uint32_t table_size;		// power of two
+		uint32_t strings_size;
+		uint64_t reserved;
+	};
+
+	/// <summary>
+	/// Absolute, normalized path with forward slashes: the key of an entry.
+	/// </summary>
+	static std::string normalizePath(const std::string& path);
+
+	/// <summary>
+	/// Writes entries and their (normalized) paths as an index file, replacing the old one.
+	/// </summary>
+	static void writeIndex(const std::string& path, std::vector<Entry>& entries, const std::vector<std::string>& paths);
+
+	void unmap();
+
+	const byte* data{ nullptr };
+	size_t size{ 0 };
+	void* mapping{ nullptr };		// Windows file mapping handle
+
+	const FileHeader* header{ nullptr };
+	const Entry* entries{ nullptr };
+	const uint32_t* table{ nullptr };
+	const char* strings{ nullptr };
+};
\ No newline at end of file
@@ -0,0 +1,121 @@
+#include "run_ahead.hpp"
+
+
+RunAhead::RunAhead(NES& nes, unsigned frames, Mode mode, Presenter present)
+	: nes{ nes }
+	, frames{ frames }
+	, mode{ mode }
+	, present{ std::move(present) }
+	, snapshot{ std::make_unique<NES::Snapshot>() }
+{
+	if (mode == Mode::SecondInstance)
+	{
+		// The copy brings the ROM along; afterwards only snapshots are transferred.
+		ahead = std::make_unique<NES>(nes);
+		ahead->getCPU().setTraceHook(nullptr);
+
+		worker = std::thread(&RunAhead::workerLoop, this);
+	}
+}
+
+
+RunAhead::~RunAhead()
+{
+	if (worker.joinable())
+	{
+		{
+			std::lock_guard<std::mutex> lock{ mutex };
+			stopping = true;
+		}
+		job_submitted.notify_one();
+		worker.join();
+	}
+}
+
+
+void RunAhead::runFrame(byte port_1, byte port_2)
+{
+	if (mode == Mode::SecondInstance)
+	{
+		// The snapshot is shared with the worker; don't touch it while a job is running.
+		waitForWorker();
+	}
+
+	// The real frame. Its output (audio) is what the player hears; its picture
+	// is only needed when it is the one presented.
+	nes.setInput(port_1, port_2);
+	nes.runFrame(frames == 0);
+
+	if (frames == 0)
+	{
+		present(nes);
+		return;
+	}
+
+	nes.save(*snapshot);
+
+	if (mode == Mode::SingleInstance)
+	{
+		runAheadOn(nes, frames);
+		nes.restore(*snapshot);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock{ mutex };
+		job_pending = true;
+		job_frames = frames;
+	}
+	job_submitted.notify_one();
+}
+
+
+void RunAhead::setFrames(unsigned frames)
+{
+	this->frames = frames;
+}
+
+
+void RunAhead::runAheadOn(NES& instance, unsigned count)
+{
+	// Input is part of the snapshot (controller state), so it is held for the extra frames.
+	// Only the presented (last) frame is rendered.
+	for (unsigned i{ 0 }; i < count; ++i)
+	{
+		instance.runFrame(i + 1 == count);
+	}
+
+	present(instance);
+}
+
+
+void RunAhead::workerLoop()
+{
+	std::unique_lock<std::mutex> lock{ mutex };
+
+	while (true)
+	{
+		job_submitted.wait(lock, [this] { return job_pending || stopping; });
+
+		if (!job_pending)
+		{
+			return;
+		}
+
+		lock.unlock();
+
+		ahead->restore(*snapshot);
+		runAheadOn(*ahead, job_frames);
+
+		lock.lock();
+		job_pending = false;
+		job_done.notify_all();
+	}
+}
+
+
+void RunAhead::waitForWorker()
+{
+	std::unique_lock<std::mutex> lock{ mutex };
+	job_done.wait(lock, [this] { return !job_pending; });
+}
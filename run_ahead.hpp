@@ -0,0 +1,79 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "nes.hpp"
+
+
+/// <summary>
+/// Run-ahead input latency reduction.
+/// 
+/// Every host frame the console emulates one real frame, then a snapshot is taken and
+/// 'frames' more frames are emulated with the same input. The last of those is presented
+/// and the snapshot is restored, which hides the game's own input lag.
+/// 
+/// SingleInstance does all of this on the calling thread. SecondInstance runs the extra
+/// frames on a copy of the console on a worker thread: the main console never rewinds
+/// (so its audio stays continuous) and the run-ahead work overlaps with the host's own work.
+/// </summary>
+class RunAhead
+{
+public:
+	enum class Mode
+	{
+		SingleInstance,
+		SecondInstance,
+	};
+
+	/// <summary>
+	/// Receives the console state to display. With SecondInstance it is called on the worker thread.
+	/// </summary>
+	using Presenter = std::function<void(const NES& nes)>;
+
+	/// <summary>
+	/// Create after the ROM has been loaded: SecondInstance copies the console.
+	/// </summary>
+	/// <param name="nes">Console being played.</param>
+	/// <param name="frames">Number of frames to run ahead (0 disables run-ahead).</param>
+	/// <param name="mode">Where the extra frames are emulated.</param>
+	/// <param name="present">Called once per host frame with the state to display.</param>
+	RunAhead(NES& nes, unsigned frames, Mode mode, Presenter present);
+	~RunAhead();
+
+	RunAhead(const RunAhead&) = delete;
+	RunAhead& operator=(const RunAhead&) = delete;
+
+	/// <summary>
+	/// Emulates one host frame with the given input.
+	/// </summary>
+	void runFrame(byte port_1, byte port_2);
+
+	void setFrames(unsigned frames);
+
+private:
+	void runAheadOn(NES& instance, unsigned count);
+	void workerLoop();
+	void waitForWorker();
+
+	NES& nes;
+	unsigned frames;
+	Mode mode;
+	Presenter present;
+
+	// Large, so kept off the stack.
+	std::unique_ptr<NES::Snapshot> snapshot;
+
+	// SecondInstance only.
+	std::unique_ptr<NES> ahead;
+	std::thread worker;
+	std::mutex mutex;
+	std::condition_variable job_submitted;
+	std::condition_variable job_done;
+	bool job_pending{ false };
+	unsigned job_frames{ 0 };
+	bool stopping{ false };
+};
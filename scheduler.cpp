@@ -0,0 +1,217 @@
+#include "scheduler.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <new>
+#include <stdexcept>
+#include <utility>
+
+
+namespace
+{
+	/*
+		Coroutine frames of finished tasks, kept for reuse. Consoles create the same tasks
+		every frame, so after the first frame on a thread every frame is taken from here.
+	*/
+	class FrameCache
+	{
+	public:
+		~FrameCache()
+		{
+			for (size_t i{ 0 }; i < count; ++i)
+			{
+				::operator delete(frames[i].memory);
+			}
+		}
+
+		void* take(size_t size)
+		{
+			for (size_t i{ 0 }; i < count; ++i)
+			{
+				if (frames[i].size == size)
+				{
+					void* memory{ frames[i].memory };
+					frames[i] = frames[--count];
+					return memory;
+				}
+			}
+
+			return nullptr;
+		}
+
+		/// <returns>False if the cache is full.</returns>
+		bool give(void* memory, size_t size)
+		{
+			if (count == frames.size())
+			{
+				return false;
+			}
+
+			frames[count++] = { memory, size };
+			return true;
+		}
+
+	private:
+		struct Frame
+		{
+			void* memory;
+			size_t size;
+		};
+
+		std::array<Frame, 8> frames{};
+		size_t count{ 0 };
+	};
+
+
+	thread_local FrameCache frame_cache;
+}
+
+
+#pragma region Task
+void* Scheduler::Task::promise_type::operator new(size_t size)
+{
+	void* memory{ frame_cache.take(size) };
+	return (memory != nullptr) ? memory : ::operator new(size);
+}
+
+
+void Scheduler::Task::promise_type::operator delete(void* frame, size_t size) noexcept
+{
+	if (!frame_cache.give(frame, size))
+	{
+		::operator delete(frame);
+	}
+}
+
+
+
+Scheduler::Task::Task(std::coroutine_handle<promise_type> handle)
+	: handle{ handle }
+{	}
+
+
+Scheduler::Task::Task(Task&& other) noexcept
+	: handle{ std::exchange(other.handle, nullptr) }
+{	}
+
+
+Scheduler::Task& Scheduler::Task::operator=(Task&& other) noexcept
+{
+	if (this != &other)
+	{
+		if (handle)
+		{
+			handle.destroy();
+		}
+
+		handle = std::exchange(other.handle, nullptr);
+	}
+
+	return *this;
+}
+
+
+Scheduler::Task::~Task()
+{
+	if (handle)
+	{
+		handle.destroy();
+	}
+}
+#pragma endregion
+
+
+void Scheduler::add(Task task, uint64_t time)
+{
+	if (component_count == components.size())
+	{
+		throw std::runtime_error("Scheduler: too many components");
+	}
+
+	components[component_count++] = Component{ std::move(task), time };
+}
+
+
+/*
+	Resumes the component furthest behind (the first one added, on ties) until it suspends.
+	A finished component's clock is moved to the end of time, so it is never resumed again.
+*/
+void Scheduler::runUntil(uint64_t time)
+{
+	end_time = time;
+
+	for (;;)
+	{
+		auto last{ components.begin() + component_count };
+		auto next{ std::min_element(components.begin(), last,
+			[](const Component& a, const Component& b) { return a.time < b.time; }) };
+
+		if (next == last || next->time >= end_time)
+		{
+			return;
+		}
+
+		current = static_cast<size_t>(next - components.begin());
+
+		std::coroutine_handle<Task::promise_type> handle{ next->task.handle };
+		handle.resume();
+
+		if (handle.done())
+		{
+			components[current].time = std::numeric_limits<uint64_t>::max();
+
+			if (handle.promise().exception)
+			{
+				std::rethrow_exception(handle.promise().exception);
+			}
+		}
+	}
+}
+
+
+Scheduler::Await Scheduler::advance(uint64_t duration)
+{
+	components[current].time += duration;
+	return Await{ isFurthestBehind() };
+}
+
+
+Scheduler::Await Scheduler::advanceTo(uint64_t time)
+{
+	components[current].time = std::max(components[current].time, time);
+	return Await{ isFurthestBehind() };
+}
+
+
+Scheduler::Await Scheduler::sync()
+{
+	return Await{ isFurthestBehind() };
+}
+
+
+uint64_t Scheduler::getTime() const
+{
+	return components[current].time;
+}
+
+
+uint64_t Scheduler::getHorizon() const
+{
+	uint64_t horizon{ end_time };
+
+	for (size_t i{ 0 }; i < component_count; ++i)
+	{
+		if (i != current)
+		{
+			horizon = std::min(horizon, components[i].time);
+		}
+	}
+
+	return horizon;
+}
+
+
+bool Scheduler::isFurthestBehind() const
+{
+	return components[current].time < getHorizon();
+}
\ No newline at end of file
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <array>
+#include <coroutine>
+#include <exception>
+
+#include "types.hpp"
+
+
+/// <summary>
+/// Cooperative scheduler for the console's components (CPU, PPU, and later APU and mappers),
+/// each written as a C++20 coroutine on one thread. Time is counted on a shared master clock
+/// (PPU dots for the NES).
+///
+/// A component co_awaits advance() when time has elapsed for it, and sync() before a bus
+/// access another component can observe. The scheduler always resumes the component that is
+/// furthest behind; a component that is still furthest behind after an await continues
+/// without suspending. Components that run ahead in batches (like the CPU, see getHorizon())
+/// therefore cost one await per batch, and nothing is suspended until another component is due.
+///
+/// Ties go to the component added first, except that the running component yields to any
+/// other component at the same time.
+///
+/// A scheduler and its tasks are cheap to build for every frame: components are stored in
+/// place, and coroutine frames are recycled, so once warmed up this allocates nothing.
+/// </summary>
+class Scheduler
+{
+public:
+	/// <summary>
+	/// Coroutine type of a component. Owns the coroutine frame.
+	/// </summary>
+	class Task
+	{
+	public:
+		struct promise_type
+		{
+			Task get_return_object() { return Task{ std::coroutine_handle<promise_type>::from_promise(*this) }; }
+			std::suspend_always initial_suspend() noexcept { return {}; }
+			std::suspend_always final_suspend() noexcept { return {}; }
+			void return_void() {}
+			void unhandled_exception() { exception = std::current_exception(); }
+
+			// Frames of finished tasks are kept for the next task of the same size (per thread).
+			static void* operator new(size_t size);
+			static void operator delete(void* frame, size_t size) noexcept;
+
+			std::exception_ptr exception;
+		};
+
+		/// <summary>
+		/// No coroutine.
+		/// </summary>
+		Task() = default;
+
+		Task(Task&& other) noexcept;
+		Task& operator=(Task&& other) noexcept;
+		~Task();
+
+	private:
+		friend class Scheduler;
+
+		explicit Task(std::coroutine_handle<promise_type> handle);
+
+		std::coroutine_handle<promise_type> handle{ nullptr };
+	};
+
+	/// <summary>
+	/// Result of advance(), advanceTo() and sync(): suspends the component unless it may keep running.
+	/// </summary>
+	class Await
+	{
+	public:
+		bool await_ready() const noexcept { return ready; }
+		void await_suspend(std::coroutine_handle<>) const noexcept {}
+		void await_resume() const noexcept {}
+
+	private:
+		friend class Scheduler;
+
+		explicit Await(bool ready) : ready{ ready } {}
+
+		bool ready;
+	};
+
+	// Components a scheduler can hold.
+	static constexpr size_t max_components{ 4 };
+
+	/// <summary>
+	/// Adds a component. It first runs when it is the furthest behind.
+	/// Throws std::runtime_error if there are already max_components.
+	/// </summary>
+	/// <param name="time">The component's clock when it starts.</param>
+	void add(Task task, uint64_t time);
+
+	/// <summary>
+	/// Resumes components until every one of them has reached the given time.
+	/// Rethrows an exception that escapes a component.
+	/// </summary>
+	void runUntil(uint64_t time);
+
+	/// <summary>
+	/// For the running component: the given time has elapsed / its clock is now at the given time.
+	/// </summary>
+	Await advance(uint64_t duration);
+	Await advanceTo(uint64_t time);
+
+	/// <summary>
+	/// For the running component: waits until all other components have caught up with it.
+	/// </summary>
+	Await sync();
+
+	/// <summary>
+	/// Clock of the running component.
+	/// </summary>
+	uint64_t getTime() const;
+
+	/// <summary>
+	/// Time up to which the running component can run without awaiting: the clock of the next
+	/// other component, or the end of runUntil(). Nothing else happens on the bus before it.
+	/// </summary>
+	uint64_t getHorizon() const;
+
+private:
+	struct Component
+	{
+		Task task;
+		uint64_t time;
+	};
+
+	/// <summary>
+	/// May the running component continue without suspending?
+	/// </summary>
+	bool isFurthestBehind() const;
+
+	std::array<Component, max_components> components{};
+	size_t component_count{ 0 };
+	size_t current{ 0 };
+	uint64_t end_time{ 0 };
+};
\ No newline at end of file
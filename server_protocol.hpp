@@ -0,0 +1,64 @@
+#pragma once
+
+#include "types.hpp"
+
+
+/// <summary>
+/// Binary protocol of EmulatorServer. A connection carries a stream of requests, each
+/// answered by one response carrying the same tag. Clients batch by writing many requests
+/// before reading; requests for one session run in the order sent, requests for different
+/// sessions run in parallel and may be answered in any order.
+///
+/// All integers are little-endian. A message is a header followed by 'size' bytes of payload.
+/// Sessions are global to the server, so a session created on one connection can be used
+/// from any other until it is destroyed.
+/// </summary>
+namespace ServerProtocol
+{
+	enum class Command : byte
+	{
+		Create,			// -> u32 session (the request's session is ignored)
+		Destroy,
+		LoadROM,		// iNES image; loads the cartridge and powers up
+		Power,
+		Reset,
+		SetInput,		// u8 port 1 buttons, u8 port 2 buttons (see Controller)
+		StepFrames,		// u32 frames, u8 render -> u64 frame, u64 state hash
+		ReadMemory,		// u16 address, u16 length -> bytes, read without side effects
+		Save,			// u32 slot: keeps a copy-on-write snapshot in the session
+		Restore,		// u32 slot
+		GetInfo,		// -> u64 frame, u64 state hash, u64 CPU cycles
+	};
+
+	enum class Status : byte
+	{
+		Ok,
+		UnknownCommand,
+		UnknownSession,
+		BadRequest,		// payload too short, or no ROM loaded
+		Failed,			// payload: error message
+	};
+
+	struct RequestHeader
+	{
+		uint32_t size;
+		uint32_t tag;			// chosen by the client, echoed in the response
+		uint32_t session;
+		Command command;
+		byte reserved[3];
+	};
+
+	struct ResponseHeader
+	{
+		uint32_t size;
+		uint32_t tag;
+		uint32_t session;
+		Status status;
+		byte reserved[3];
+	};
+
+	static_assert(sizeof(RequestHeader) == 16 && sizeof(ResponseHeader) == 16, "part of the protocol");
+
+	// Larger requests close the connection.
+	constexpr uint32_t max_payload_size{ 1 << 20 };
+}
\ No newline at end of file
@@ -0,0 +1,103 @@
+#include "state_hash_set.hpp"
+
+#include <stdexcept>
+
+
+StateHashSet::StateHashSet(size_t capacity)
+	: max_size{ capacity }
+{
+	size_t table_size{ 2 };
+	while (table_size < 2 * capacity)
+	{
+		table_size *= 2;
+	}
+
+	slots = std::make_unique<std::atomic<uint64_t>[]>(table_size);
+	mask = table_size - 1;
+	clear();
+}
+
+
+bool StateHashSet::insert(uint64_t hash)
+{
+	uint64_t key{ toKey(hash) };
+
+	// The hash bits are uniformly distributed already, so they index the table directly.
+	for (size_t slot{ key & mask };; slot = (slot + 1) & mask)
+	{
+		uint64_t current{ slots[slot].load(std::memory_order_relaxed) };
+
+		if (current == empty)
+		{
+			// Reserve room first so the table never fills up past max_size.
+			if (count.fetch_add(1, std::memory_order_relaxed) >= max_size)
+			{
+				count.fetch_sub(1, std::memory_order_relaxed);
+				throw std::length_error("StateHashSet: full");
+			}
+
+			if (slots[slot].compare_exchange_strong(current, key, std::memory_order_relaxed))
+			{
+				return true;
+			}
+
+			// Another thread took the slot; it may have inserted the same hash.
+			count.fetch_sub(1, std::memory_order_relaxed);
+		}
+
+		if (current == key)
+		{
+			return false;
+		}
+	}
+}
+
+
+bool StateHashSet::contains(uint64_t hash) const
+{
+	uint64_t key{ toKey(hash) };
+
+	for (size_t slot{ key & mask };; slot = (slot + 1) & mask)
+	{
+		uint64_t current{ slots[slot].load(std::memory_order_relaxed) };
+
+		if (current == key)
+		{
+			return true;
+		}
+
+		if (current == empty)
+		{
+			return false;
+		}
+	}
+}
+
+
+size_t StateHashSet::size() const
+{
+	return count.load(std::memory_order_relaxed);
+}
+
+
+size_t StateHashSet::capacity() const
+{
+	return max_size;
+}
+
+
+void StateHashSet::clear()
+{
+	for (size_t slot{ 0 }; slot <= mask; ++slot)
+	{
+		slots[slot].store(empty, std::memory_order_relaxed);
+	}
+
+	count = 0;
+}
+
+
+uint64_t StateHashSet::toKey(uint64_t hash)
+{
+	return (hash == empty) ? 1 : hash;
+}
\ No newline at end of file
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+
+#include "types.hpp"
+
+
+/// <summary>
+/// Set of 64-bit state hashes (e.g. NES::getZobristHash()) shared by search worker threads
+/// to skip states that were already visited. Open addressing with linear probing in a
+/// fixed table; insertion is lock-free, nothing is ever removed.
+/// </summary>
+class StateHashSet
+{
+public:
+	/// <param name="capacity">Maximum number of hashes; rounded up to a power of two and doubled for a load factor of at most 1/2.</param>
+	explicit StateHashSet(size_t capacity);
+
+	StateHashSet(const StateHashSet&) = delete;
+	StateHashSet& operator=(const StateHashSet&) = delete;
+
+	/// <summary>
+	/// Adds a hash. Thread safe. Throws std::length_error if the set is full.
+	/// </summary>
+	/// <returns>True if the hash was not in the set yet (the caller should visit the state).</returns>
+	bool insert(uint64_t hash);
+
+	/// <summary>
+	/// Thread safe, but may miss a hash that is being inserted concurrently.
+	/// </summary>
+	bool contains(uint64_t hash) const;
+
+	size_t size() const;
+	size_t capacity() const;
+
+	/// <summary>
+	/// Empties the set. Not thread safe.
+	/// </summary>
+	void clear();
+
+private:
+	// 0 marks an empty slot, so a hash of 0 is stored as 1 instead.
+	static constexpr uint64_t empty{ 0 };
+	static uint64_t toKey(uint64_t hash);
+
+	std::unique_ptr<std::atomic<uint64_t>[]> slots;
+	size_t mask;
+	size_t max_size;
+	std::atomic<size_t> count{ 0 };
+};
\ No newline at end of file
@@ -1,7 +1,502 @@
 #include "test.hpp"
 #include "cpu.hpp"
+#include "lockstep_cpu.hpp"
+#include "nes.hpp"
+#include "battery_ram.hpp"
+#include "boot_cache.hpp"
+#include "vec_env.hpp"
 
-void Test::run()
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <filesystem>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+
+namespace
 {
+	// Heap allocations made by any thread (see operator new below).
+	std::atomic<size_t> allocations{ 0 };
+
+
+	/*
+		Blank NROM-128 image (16 KiB PRG ROM at $8000, mirrored at $C000; 8 KiB CHR ROM) with
+		the NMI and reset vectors set. Code and data go in with put().
+	*/
+	std::vector<byte> makeImage(word reset, word nmi)
+	{
+		std::vector<byte> image(16 + 0x4000 + 0x2000, 0x00);
+		const byte header[]{ 'N', 'E', 'S', 0x1A, 1, 1 };
+		std::copy(std::begin(header), std::end(header), image.begin());
+
+		image[16 + 0x3FFA] = static_cast<byte>(nmi);
+		image[16 + 0x3FFB] = static_cast<byte>(nmi >> 8);
+		image[16 + 0x3FFC] = static_cast<byte>(reset);
+		image[16 + 0x3FFD] = static_cast<byte>(reset >> 8);
+		return image;
+	}
+
+
+	void put(std::vector<byte>& image, word address, std::initializer_list<byte> bytes)
+	{
+		std::copy(bytes.begin(), bytes.end(), image.begin() + 16 + (address & 0x3FFF));
+	}
+
+
+	/*
+		Enables the vblank NMI and counts in work RAM; the NMI handler counts too.
+
+			$8000	LDA #$80
+			$8002	STA $2000
+			$8005	INC $10
+			$8007	JMP $8005
+
+			$8100	INC $11
+			$8102	RTI
+	*/
+	Cartridge makeCounterCartridge()
+	{
+		std::vector<byte> image{ makeImage(0x8000, 0x8100) };
+		put(image, 0x8000, { 0xA9, 0x80, 0x8D, 0x00, 0x20, 0xE6, 0x10, 0x4C, 0x05, 0x80 });
+		put(image, 0x8100, { 0xE6, 0x11, 0x40 });
+		return Cartridge{ image };
+	}
+
+
+	/*
+		Waits for vblank by polling the PPU status, then counts frames.
+
+			$8000	LDA $2002
+			$8003	BPL $8000
+			$8005	INC $10
+			$8007	JMP $8000
+	*/
+	Cartridge makeVblankWaitCartridge()
+	{
+		std::vector<byte> image{ makeImage(0x8000, 0x8000) };
+		put(image, 0x8000, { 0xAD, 0x02, 0x20, 0x10, 0xFB, 0xE6, 0x10, 0x4C, 0x00, 0x80 });
+		return Cartridge{ image };
+	}
+
+
+	/*
+		Enables the vblank NMI and spins on a jump to itself; the NMI handler counts frames.
+
+			$8000	LDA #$80
+			$8002	STA $2000
+			$8005	JMP $8005
+
+			$8100	INC $11
+			$8102	RTI
+	*/
+	Cartridge makeSpinCartridge()
+	{
+		std::vector<byte> image{ makeImage(0x8000, 0x8100) };
+		put(image, 0x8000, { 0xA9, 0x80, 0x8D, 0x00, 0x20, 0x4C, 0x05, 0x80 });
+		put(image, 0x8100, { 0xE6, 0x11, 0x40 });
+		return Cartridge{ image };
+	}
+
+
+	/*
+		Renders an opaque background (every CHR tile 0 row set, nametables all tile 0) with
+		sprite 0 at (128, 96) over it and the other 63 sprites stacked at the top, more than
+		8 to a line. The main loop ORs the $2002 sprite-0 hit and overflow bits it sees into $10;
+		the NMI handler moves them to $11 and copies OAM from page $02.
+
+			$8000	LDA #$60
+			$8002	STA $0200
+			$8005	LDA #$80
+			$8007	STA $0203
+			$800A	LDA #$80
+			$800C	STA $2000
+			$800F	LDA #$1E
+			$8011	STA $2001
+			$8014	LDA $2002
+			$8017	AND #$60
+			$8019	ORA $10
+			$801B	STA $10
+			$801D	JMP $8014
+
+			$8100	PHA
+			$8101	LDA $10
+			$8103	STA $11
+			$8105	LDA #$00
+			$8107	STA $10
+			$8109	LDA #$02
+			$810B	STA $4014
+			$810E	PLA
+			$810F	RTI
+	*/
+	Cartridge makeSpriteZeroCartridge()
+	{
+		std::vector<byte> image{ makeImage(0x8000, 0x8100) };
+		put(image, 0x8000, { 0xA9, 0x60, 0x8D, 0x00, 0x02, 0xA9, 0x80, 0x8D, 0x03, 0x02, 0xA9, 0x80, 0x8D, 0x00, 0x20, 0xA9, 0x1E, 0x8D, 0x01, 0x20,
+			0xAD, 0x02, 0x20, 0x29, 0x60, 0x05, 0x10, 0x85, 0x10, 0x4C, 0x14, 0x80 });
+		put(image, 0x8100, { 0x48, 0xA5, 0x10, 0x85, 0x11, 0xA9, 0x00, 0x85, 0x10, 0xA9, 0x02, 0x8D, 0x14, 0x40, 0x68, 0x40 });
+		std::fill_n(image.begin() + 16 + 0x4000, 8, 0xFF);
+		return Cartridge{ image };
+	}
+
+
+	/*
+		Battery-backed; the boot copies the first byte of the save ($6000) to $6001, then waits.
+
+			$8000	LDA $6000
+			$8003	STA $6001
+			$8006	JMP $8006
+	*/
+	Cartridge makeSaveCopyCartridge()
+	{
+		std::vector<byte> image{ makeImage(0x8000, 0x8000) };
+		image[6] = 0b0000'0010;
+		put(image, 0x8000, { 0xAD, 0x00, 0x60, 0x8D, 0x01, 0x60, 0x4C, 0x06, 0x80 });
+		return Cartridge{ image };
+	}
+
+
+	/*
+		A boot cache hit restores PRG RAM, which writes through to an attached save file. The
+		snapshot taken when booting one save must not be restored over a different one.
+	*/
+	void testBootCacheKeepsSave()
+	{
+		std::filesystem::path directory{ std::filesystem::temp_directory_path() / "emuNES_test" };
+		std::filesystem::remove_all(directory);
+		std::filesystem::create_directories(directory);
+
+		Cartridge cartridge{ makeSaveCopyCartridge() };
+		BootCache::Trigger trigger;
+		trigger.frames = 2;
+
+		const byte saves[]{ 0xAA, 0x55, 0x55, 0xAA };
+		const bool hits[]{ false, false, true, true };
+
+		for (size_t i{ 0 }; i < std::size(saves); ++i)
+		{
+			BatteryRAM ram{ (directory / "save.sav").string() };
+			std::fill(ram.getData(), ram.getData() + Bus::prg_ram_size, 0x00);
+			ram.getData()[0] = saves[i];
+
+			NES nes;
+			nes.setBatteryRAM(&ram);
+
+			BootCache cache{ (directory / "boot").string(), trigger };
+			bool hit{ cache.boot(nes, cartridge) };
+			nes.setBatteryRAM(nullptr);
+
+			if (ram.getData()[0] != saves[i] || ram.getData()[1] != saves[i])
+			{
+				throw std::runtime_error("Test: boot cache changed the save file (boot " + std::to_string(i) + ")");
+			}
+
+			if (hit != hits[i])
+			{
+				throw std::runtime_error("Test: unexpected boot cache " + std::string{ hit ? "hit" : "miss" } + " (boot " + std::to_string(i) + ")");
+			}
+		}
+
+		std::filesystem::remove_all(directory);
+	}
+
+
+	/*
+		Idle-loop skipping jumps the clock ahead instead of running the loop, and must land on
+		the cycle (and state) running it would have reached, frame after frame.
+	*/
+	void testIdleLoopSkippingIsExact()
+	{
+		const Cartridge cartridges[]{ makeVblankWaitCartridge(), makeSpinCartridge() };
+		const char* names[]{ "vblank wait", "JMP *" };
+
+		for (size_t i{ 0 }; i < std::size(cartridges); ++i)
+		{
+			auto skipping{ std::make_unique<NES>() };
+			auto running{ std::make_unique<NES>() };
+
+			for (NES* nes : { skipping.get(), running.get() })
+			{
+				nes->loadCartridge(cartridges[i]);
+				nes->power();
+			}
+
+			skipping->getCPU().setIdleLoopSkipping(true);
+			running->getCPU().setIdleLoopSkipping(false);
+
+			for (int frame{ 0 }; frame < 60; ++frame)
+			{
+				skipping->runFrame();
+				running->runFrame();
+
+				if (skipping->getStateHash() != running->getStateHash() || skipping->getCPU().getCycles() != running->getCPU().getCycles())
+				{
+					throw std::runtime_error("Test: idle-loop skipping changed frame " + std::to_string(frame) + " of the " + names[i] + " ROM");
+				}
+			}
+
+			if (skipping->getCPU().getIdleCyclesSkipped() == 0)
+			{
+				throw std::runtime_error(std::string{ "Test: no idle loop skipped in the " } + names[i] + " ROM");
+			}
+		}
+	}
+
+
+	/*
+		Frames emulated without rendering still evaluate sprites and test sprite 0 against the
+		background, so the CPU sees the same sprite-0 hit and overflow flags either way.
+	*/
+	void testSkippedRenderingKeepsSpriteFlags()
+	{
+		Cartridge cartridge{ makeSpriteZeroCartridge() };
+		auto rendered{ std::make_unique<NES>() };
+		auto skipped{ std::make_unique<NES>() };
+
+		for (NES* nes : { rendered.get(), skipped.get() })
+		{
+			nes->loadCartridge(cartridge);
+			nes->power();
+		}
+
+		for (int frame{ 0 }; frame < 30; ++frame)
+		{
+			rendered->runFrame(true);
+			skipped->runFrame(false);
 
+			const Bus& rendered_bus{ rendered->getCPU().getBus() };
+			const Bus& skipped_bus{ skipped->getCPU().getBus() };
+
+			if (rendered->getStateHash() != skipped->getStateHash()
+				|| (rendered_bus.peek(0x2002) & 0x60) != (skipped_bus.peek(0x2002) & 0x60)
+				|| rendered_bus.peek(0x11) != skipped_bus.peek(0x11))
+			{
+				throw std::runtime_error("Test: skipping rendering changed frame " + std::to_string(frame));
+			}
+		}
+
+		// Both flags were raised during the frames compared, so the comparison covered them.
+		if (rendered->getCPU().getBus().peek(0x11) != 0x60)
+		{
+			throw std::runtime_error("Test: the sprite-0 hit and overflow flags were never raised");
+		}
+	}
+
+
+	/*
+		Random program at $8000: instructions over work RAM and forward and backward branches,
+		looping back to the start. Operands stay below $2000, where LockstepCPU's plain memory
+		and the bus agree:
+		- reads use any page up to $1E (mirrors included), indexed reads end below $2000;
+		- writes use pages $02-$06, so indexing cannot reach the zero page or the stack;
+		- (zp),Y goes through the pointers at $F0-$F7, which point into pages $02-$06 and are
+		  never written (zero page writes stay below $F0).
+	*/
+	std::vector<byte> makeRandomProgram(std::mt19937& random)
+	{
+		auto pick = [&](std::initializer_list<byte> values) { return *(values.begin() + random() % values.size()); };
+		auto any = [&]() { return static_cast<byte>(random()); };
+
+		std::vector<byte> program;
+		std::vector<word> starts;		// instruction addresses
+		std::vector<size_t> branches;	// offsets of the branches in program
+
+		for (size_t count{ 40 + random() % 40 }; starts.size() < count; )
+		{
+			starts.push_back(static_cast<word>(Bus::rom_start + program.size()));
+
+			switch (random() % 9)
+			{
+				case 0:		program.insert(program.end(), { pick({ 0x69, 0x29, 0xC9, 0xE0, 0xC0, 0x49, 0xA9, 0xA2, 0xA0, 0x09, 0xE9 }), any() });	break;
+				case 1:		program.insert(program.end(), { pick({ 0x65, 0x25, 0x24, 0xC5, 0xE4, 0xC4, 0x45, 0xA5, 0xA6, 0xA4, 0x05, 0xE5 }), any() });	break;
+				case 2:		program.insert(program.end(), { pick({ 0x06, 0xC6, 0xE6, 0x46, 0x26, 0x66, 0x85, 0x86, 0x84 }), static_cast<byte>(random() % 0xF0) });	break;
+				case 3:		program.insert(program.end(), { pick({ 0x75, 0x35, 0xD5, 0x55, 0xB5, 0xB6, 0xB4, 0x15, 0xF5 }), any() });	break;
+				case 4:		program.insert(program.end(), { pick({ 0x6D, 0x2D, 0x2C, 0xCD, 0xEC, 0xCC, 0x4D, 0xAD, 0xAE, 0xAC, 0x0D, 0xED,
+								0x7D, 0x79, 0x3D, 0x39, 0xDD, 0xD9, 0x5D, 0x59, 0xBD, 0xB9, 0xBE, 0xBC, 0x1D, 0x19, 0xFD, 0xF9 }),
+								any(), static_cast<byte>(random() % 0x1F) });	break;
+				case 5:		program.insert(program.end(), { pick({ 0x0E, 0xCE, 0xEE, 0x4E, 0x2E, 0x6E, 0x8D, 0x8E, 0x8C,
+								0x1E, 0xDE, 0xFE, 0x5E, 0x3E, 0x7E, 0x9D, 0x99 }), any(), static_cast<byte>(2 + random() % 5) });	break;
+				case 6:		program.insert(program.end(), { pick({ 0x71, 0x31, 0xD1, 0x51, 0xB1, 0x11, 0xF1, 0x91 }), static_cast<byte>(0xF0 + 2 * (random() % 4)) });	break;
+				case 7:		program.push_back(pick({ 0x0A, 0x4A, 0x2A, 0x6A, 0x18, 0xD8, 0x58, 0xB8, 0xCA, 0x88, 0xE8, 0xC8, 0xEA,
+								0xAA, 0xA8, 0x8A, 0x98, 0xBA, 0x9A, 0x38, 0xF8, 0x78, 0x48, 0x08, 0x68, 0x28 }));	break;
+				default:	branches.push_back(program.size());
+							program.insert(program.end(), { pick({ 0x90, 0xB0, 0xF0, 0x30, 0xD0, 0x10, 0x50, 0x70 }), 0x00 });	break;
+			}
+		}
+
+		// Branch to an instruction in range; the branch falls through if none is found.
+		for (size_t branch : branches)
+		{
+			for (int attempt{ 0 }; attempt < 16; ++attempt)
+			{
+				int offset{ starts[random() % starts.size()] - static_cast<int>(Bus::rom_start + branch + 2) };
+				if (offset >= -128 && offset <= 127)
+				{
+					program[branch + 1] = static_cast<byte>(offset);
+					break;
+				}
+			}
+		}
+
+		program.insert(program.end(), { 0x4C, 0x00, 0x80 });
+		return program;
+	}
+
+
+	/*
+		LockstepCPU promises its lanes match CPUs stepped without idle-loop skipping: the same
+		random programs run on both, each lane with its own registers and work RAM.
+	*/
+	void testLockstepMatchesCPU()
+	{
+		constexpr uint64_t cycles{ 3000 };
+
+		std::mt19937 random{ 1 };
+		auto lockstep{ std::make_unique<LockstepCPU>() };
+
+		for (int program_index{ 0 }; program_index < 50; ++program_index)
+		{
+			std::vector<byte> program{ makeRandomProgram(random) };
+			lockstep->clear();
+			lockstep->load(Bus::rom_start, program.data(), program.size());
+
+			std::vector<std::vector<byte>> rams(LockstepCPU::lane_count, std::vector<byte>(Bus::ram_size));
+			std::vector<CPU::Registers> registers(LockstepCPU::lane_count);
+
+			for (size_t lane{ 0 }; lane < LockstepCPU::lane_count; ++lane)
+			{
+				std::vector<byte>& ram{ rams[lane] };
+				std::generate(ram.begin(), ram.end(), [&]() { return static_cast<byte>(random()); });
+
+				for (word pointer{ 0xF0 }; pointer < 0xF8; pointer += 2)
+				{
+					ram[pointer + 1] = static_cast<byte>(2 + random() % 5);
+				}
+
+				for (word address{ 0 }; address < Bus::ram_size; ++address)
+				{
+					lockstep->poke(lane, address, ram[address]);
+				}
+
+				registers[lane] = { Bus::rom_start, static_cast<byte>(random()), static_cast<byte>(random()),
+					static_cast<byte>(random()), static_cast<byte>(random()), static_cast<byte>(random()) };
+				lockstep->setRegisters(lane, registers[lane]);
+			}
+
+			lockstep->runUntil(cycles);
+
+			for (size_t lane{ 0 }; lane < LockstepCPU::lane_count; ++lane)
+			{
+				auto cpu{ std::make_unique<CPU>() };
+				cpu->setIdleLoopSkipping(false);
+
+				Bus& bus{ cpu->getBus() };
+				bus.clear();
+				bus.load(Bus::rom_start, program);
+				bus.load(0x0000, rams[lane]);
+				cpu->setRegisters(registers[lane]);
+				cpu->runUntil(cycles);
+
+				CPU::Registers expected{ cpu->getRegisters() };
+				CPU::Registers actual{ lockstep->getRegisters(lane) };
+
+				bool same{ expected.program_counter == actual.program_counter && expected.stack_pointer == actual.stack_pointer
+					&& expected.reg_accumulator == actual.reg_accumulator && expected.reg_x == actual.reg_x
+					&& expected.reg_y == actual.reg_y && expected.processor_status == actual.processor_status
+					&& cpu->getCycles() == lockstep->getCycles(lane) };
+
+				for (word address{ 0 }; same && address < Bus::ram_size; ++address)
+				{
+					same = bus.peek(address) == lockstep->peek(lane, address);
+				}
+
+				if (!same)
+				{
+					throw std::runtime_error("Test: LockstepCPU lane " + std::to_string(lane) + " differs from CPU (program " + std::to_string(program_index) + ")");
+				}
+			}
+		}
+	}
+
+
+	/*
+		VecEnv promises that stepping allocates nothing, which every frame's Scheduler and its
+		coroutines depend on. Warmed up first: copy-on-write pages shared by the copied consoles
+		are unshared by their first writes.
+	*/
+	void testVecEnvStepDoesNotAllocate()
+	{
+		Cartridge cartridge{ makeCounterCartridge() };
+
+		for (VecEnv::Observation observation : { VecEnv::Observation::RAM, VecEnv::Observation::Grayscale })
+		{
+			VecEnv env{ cartridge, 4, observation, [](size_t, const NES& nes) { return static_cast<float>(nes.getCPU().getBus().peek(0x10)); }, 2, 1 };
+
+			std::vector<byte> actions(env.getCount(), 0);
+			std::vector<byte> observations(env.getCount() * env.getObservationSize());
+			std::vector<float> rewards(env.getCount());
+
+			for (int step{ 0 }; step < 3; ++step)
+			{
+				env.step(actions.data(), observations.data(), rewards.data());
+			}
+
+			size_t before{ allocations.load() };
+			for (int step{ 0 }; step < 10; ++step)
+			{
+				env.step(actions.data(), observations.data(), rewards.data());
+			}
+
+			if (allocations.load() != before)
+			{
+				throw std::runtime_error("Test: VecEnv::step allocated " + std::to_string(allocations.load() - before) + " times");
+			}
+		}
+	}
+}
+
+
+/*
+	Counting replacements of the global allocation functions (the array and nothrow forms
+	call these).
+*/
+void* operator new(size_t size)
+{
+	allocations.fetch_add(1, std::memory_order_relaxed);
+
+	void* memory{ std::malloc((size != 0) ? size : 1) };
+	if (memory == nullptr)
+	{
+		throw std::bad_alloc{};
+	}
+
+	return memory;
+}
+
+
+void operator delete(void* memory) noexcept
+{
+	std::free(memory);
+}
+
+
+void operator delete(void* memory, size_t) noexcept
+{
+	std::free(memory);
+}
+
+
+void Test::run()
+{
+	testBootCacheKeepsSave();
+	testVecEnvStepDoesNotAllocate();
+	testLockstepMatchesCPU();
+	testIdleLoopSkippingIsExact();
+	testSkippedRenderingKeepsSpriteFlags();
 }
\ No newline at end of file
@@ -3,6 +3,9 @@
 class Test
 {
 public:
+	/// <summary>
+	/// Runs the regression checks. Throws std::runtime_error naming the first that fails.
+	/// </summary>
 	static void run();
 
 private:
@@ -0,0 +1,88 @@
+#include "thread_pool.hpp"
+
+
+ThreadPool::ThreadPool(unsigned threads)
+{
+	for (unsigned i{ 1 }; i < threads; ++i)
+	{
+		workers.emplace_back(&ThreadPool::workerLoop, this);
+	}
+}
+
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock{ mutex };
+		stopping = true;
+	}
+	job_submitted.notify_all();
+
+	for (std::thread& worker : workers)
+	{
+		worker.join();
+	}
+}
+
+
+void ThreadPool::run(size_t count, const std::function<void(size_t)>& job)
+{
+	{
+		std::lock_guard<std::mutex> lock{ mutex };
+		this->job = &job;
+		job_count = count;
+		next_index = 0;
+		busy_workers = workers.size();
+		++generation;
+	}
+	job_submitted.notify_all();
+
+	work();
+
+	std::unique_lock<std::mutex> lock{ mutex };
+	job_done.wait(lock, [this] { return busy_workers == 0; });
+	this->job = nullptr;
+}
+
+
+unsigned ThreadPool::getThreadCount() const
+{
+	return static_cast<unsigned>(workers.size()) + 1;
+}
+
+
+void ThreadPool::workerLoop()
+{
+	uint64_t seen_generation{ 0 };
+	std::unique_lock<std::mutex> lock{ mutex };
+
+	while (true)
+	{
+		job_submitted.wait(lock, [&] { return generation != seen_generation || stopping; });
+
+		if (stopping)
+		{
+			return;
+		}
+
+		seen_generation = generation;
+		lock.unlock();
+
+		work();
+
+		lock.lock();
+		if (--busy_workers == 0)
+		{
+			job_done.notify_one();
+		}
+	}
+}
+
+
+void ThreadPool::work()
+{
+	for (size_t i{ next_index++ }; i < job_count; i = next_index++)
+	{
+		(*job)(i);
+	}
+}
\ No newline at end of file
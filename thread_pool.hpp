@@ -0,0 +1,53 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+/// <summary>
+/// Fixed set of worker threads running parallel loops.
+/// Workers sleep between loops; a loop allocates nothing.
+/// </summary>
+class ThreadPool
+{
+public:
+	/// <param name="threads">Total threads working on a loop, the caller's included (at least 1).</param>
+	explicit ThreadPool(unsigned threads);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	/// <summary>
+	/// Calls job(i) for every i in [0, count), spread over the workers and the calling thread.
+	/// Returns when all calls have returned. Not reentrant.
+	/// </summary>
+	void run(size_t count, const std::function<void(size_t)>& job);
+
+	unsigned getThreadCount() const;
+
+private:
+	void workerLoop();
+
+	/// <summary>
+	/// Takes indices of the current loop until none are left.
+	/// </summary>
+	void work();
+
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable job_submitted;
+	std::condition_variable job_done;
+
+	// Current loop.
+	const std::function<void(size_t)>* job{ nullptr };
+	size_t job_count{ 0 };
+	std::atomic<size_t> next_index{ 0 };
+	size_t busy_workers{ 0 };
+	uint64_t generation{ 0 };
+	bool stopping{ false };
+};
\ No newline at end of file
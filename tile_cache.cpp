@@ -0,0 +1,83 @@
+#include "tile_cache.hpp"
+
+#include <algorithm>
+
+
+void TileCache::reset(size_t chr_size)
+{
+	size_t banks{ std::max<size_t>(chr_size / bank_size, 1) };
+
+	pixels.assign(banks * tiles_per_bank * tile_pixels, 0);
+	valid.assign(banks * tiles_per_bank, false);
+
+	for (size_t slot{ 0 }; slot < slot_count; ++slot)
+	{
+		mapBank(slot, slot);
+	}
+}
+
+
+void TileCache::mapBank(size_t slot, size_t bank)
+{
+	// Smaller CHR memories are mirrored across the slots.
+	slot_banks[slot] = bank % (valid.size() / tiles_per_bank);
+}
+
+
+const byte* TileCache::getRow(word address, const byte* chr)
+{
+	size_t tile{ slot_banks[address / bank_size] * tiles_per_bank + ((address % bank_size) >> 4) };
+
+	if (!valid[tile])
+	{
+		decode(tile, chr);
+	}
+
+	return &pixels[tile * tile_pixels + (address & 0x07) * 8];
+}
+
+
+void TileCache::invalidate(word address)
+{
+	valid[slot_banks[address / bank_size] * tiles_per_bank + ((address % bank_size) >> 4)] = false;
+}
+
+
+void TileCache::invalidateAll()
+{
+	std::fill(valid.begin(), valid.end(), byte{ false });
+}
+
+
+size_t TileCache::getMemoryFootprint() const
+{
+	return pixels.capacity() + valid.capacity();
+}
+
+
+uint64_t TileCache::getTilesDecoded() const
+{
+	return tiles_decoded;
+}
+
+
+void TileCache::decode(size_t tile, const byte* chr)
+{
+	// 16 bytes per tile: 8 rows of the low bitplane, then 8 rows of the high one.
+	const byte* planes{ chr + tile * 16 };
+	byte* out{ &pixels[tile * tile_pixels] };
+
+	for (size_t row{ 0 }; row < 8; ++row)
+	{
+		byte low{ planes[row] };
+		byte high{ planes[row + 8] };
+
+		for (size_t x{ 0 }; x < 8; ++x)
+		{
+			*out++ = static_cast<byte>(((low >> (7 - x)) & 0x01) | (((high >> (7 - x)) & 0x01) << 1));
+		}
+	}
+
+	valid[tile] = true;
+	++tiles_decoded;
+}
\ No newline at end of file
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <array>
+#include <vector>
+
+#include "types.hpp"
+
+
+/// <summary>
+/// Pre-decoded pattern table tiles, so the PPU does not recombine the two bitplanes of
+/// a tile on every fetch. Each 16-byte tile of CHR memory becomes 8x8 pixels of one
+/// byte each (0-3), decoded lazily on first use.
+///
+/// CHR memory is cached per 1 KiB bank (the smallest unit mappers switch). The PPU's
+/// eight 1 KiB pattern table slots each refer to a bank, so a bank switch only remaps
+/// a slot and keeps the decoded tiles of both banks.
+/// </summary>
+class TileCache
+{
+public:
+	static constexpr size_t bank_size{ 0x0400 };
+	static constexpr size_t slot_count{ 8 };
+	static constexpr size_t tiles_per_bank{ bank_size / 16 };
+	static constexpr size_t tile_pixels{ 8 * 8 };
+
+	/// <summary>
+	/// Sets up the cache for CHR memory of the given size and maps the banks to the slots in order.
+	/// All tiles are decoded again on first use.
+	/// </summary>
+	/// <param name="chr_size">Size of the CHR ROM/RAM in bytes, a multiple of bank_size.</param>
+	void reset(size_t chr_size);
+
+	/// <summary>
+	/// Points a pattern table slot at a bank of CHR memory.
+	/// </summary>
+	/// <param name="slot">$0000-$03FF is slot 0, ..., $1C00-$1FFF is slot 7.</param>
+	void mapBank(size_t slot, size_t bank);
+
+	/// <summary>
+	/// Decoded pixels of one tile row.
+	/// </summary>
+	/// <param name="address">PPU address of the row's low bitplane byte ($0000-$1FFF; bit 3 clear).</param>
+	/// <param name="chr">CHR memory the tile is decoded from if it is not cached.</param>
+	/// <returns>8 pixel values (0-3), left to right.</returns>
+	const byte* getRow(word address, const byte* chr);
+
+	/// <summary>
+	/// Drops the tile holding the given address, after a write to CHR RAM.
+	/// </summary>
+	void invalidate(word address);
+
+	/// <summary>
+	/// Drops all tiles, after CHR RAM was replaced as a whole (e.g. a restored state).
+	/// </summary>
+	void invalidateAll();
+
+	/// <summary>
+	/// Bytes allocated for decoded tiles and their valid flags.
+	/// </summary>
+	size_t getMemoryFootprint() const;
+
+	/// <summary>
+	/// Number of tiles decoded since construction.
+	/// </summary>
+	uint64_t getTilesDecoded() const;
+
+private:
+	void decode(size_t tile, const byte* chr);
+
+	std::vector<byte> pixels;
+	std::vector<byte> valid;
+	std::array<size_t, slot_count> slot_banks{};
+
+	uint64_t tiles_decoded{ 0 };
+};
\ No newline at end of file
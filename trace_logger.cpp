@@ -0,0 +1,175 @@
+#include "trace_logger.hpp"
+#include "disassembler.hpp"
+#include "opcodes.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+
+TraceLogger::TraceLogger(const std::string& path, size_t buffer_size)
+{
+	file = std::fopen(path.c_str(), "wb");
+	if (file == nullptr)
+	{
+		throw std::runtime_error("TraceLogger: could not open " + path);
+	}
+
+	// A buffer must at least hold a single line.
+	buffer_size = std::max(buffer_size, max_line_length);
+	buffers[0].resize(buffer_size);
+	buffers[1].resize(buffer_size);
+
+	flusher = std::thread(&TraceLogger::flushLoop, this);
+}
+
+
+TraceLogger::~TraceLogger()
+{
+	flush();
+
+	{
+		std::lock_guard<std::mutex> lock{ mutex };
+		stopping = true;
+	}
+	buffer_submitted.notify_one();
+	flusher.join();
+
+	std::fclose(file);
+}
+
+
+void TraceLogger::onInstruction(const CPU::Registers& registers, const byte* instruction, uint64_t cycles)
+{
+	if (buffers[active_buffer].size() - active_length < max_line_length)
+	{
+		submitActiveBuffer();
+	}
+
+	char* line{ buffers[active_buffer].data() + active_length };
+	char* cursor{ line };
+
+	// Address and raw bytes. "C000  4C F5 C5  "
+	cursor = Disassembler::writeHex16(cursor, registers.program_counter);
+	*cursor++ = ' ';
+
+	byte length{ getInstructionLength(opcode_table[instruction[0]].mode) };
+	for (byte i{ 0 }; i < 3; ++i)
+	{
+		*cursor++ = ' ';
+		if (i < length)
+		{
+			cursor = Disassembler::writeHex8(cursor, instruction[i]);
+		}
+		else
+		{
+			*cursor++ = ' ';
+			*cursor++ = ' ';
+		}
+	}
+	*cursor++ = ' ';
+	*cursor++ = ' ';
+
+	// Mnemonic and operand, padded so the registers always start at column 48.
+	char* disassembly{ cursor };
+	cursor += Disassembler::format(cursor, registers.program_counter, instruction);
+	while (cursor - disassembly < 32)
+	{
+		*cursor++ = ' ';
+	}
+
+	// Registers. "A:00 X:00 Y:00 P:24 SP:FD "
+	std::memcpy(cursor, "A:", 2);
+	cursor = Disassembler::writeHex8(cursor + 2, registers.reg_accumulator);
+	std::memcpy(cursor, " X:", 3);
+	cursor = Disassembler::writeHex8(cursor + 3, registers.reg_x);
+	std::memcpy(cursor, " Y:", 3);
+	cursor = Disassembler::writeHex8(cursor + 3, registers.reg_y);
+	std::memcpy(cursor, " P:", 3);
+	cursor = Disassembler::writeHex8(cursor + 3, registers.processor_status);
+	std::memcpy(cursor, " SP:", 4);
+	cursor = Disassembler::writeHex8(cursor + 4, registers.stack_pointer);
+
+	// Cycle count in decimal. Digits are produced backwards and then copied in order.
+	std::memcpy(cursor, " CYC:", 5);
+	cursor += 5;
+
+	char digits[20];
+	size_t digit_count{ 0 };
+	do
+	{
+		digits[digit_count++] = static_cast<char>('0' + (cycles % 10));
+		cycles /= 10;
+	} while (cycles != 0);
+
+	while (digit_count > 0)
+	{
+		*cursor++ = digits[--digit_count];
+	}
+
+	*cursor++ = '\n';
+
+	active_length += static_cast<size_t>(cursor - line);
+}
+
+
+void TraceLogger::flush()
+{
+	submitActiveBuffer();
+
+	// Wait for the flushing thread to finish the buffer just submitted.
+	std::unique_lock<std::mutex> lock{ mutex };
+	buffer_written.wait(lock, [this] { return !has_pending_buffer; });
+	std::fflush(file);
+}
+
+
+void TraceLogger::submitActiveBuffer()
+{
+	if (active_length == 0)
+	{
+		return;
+	}
+
+	std::unique_lock<std::mutex> lock{ mutex };
+
+	// Only one buffer can be in flight. If the disk is slower than the emulator, we wait here.
+	buffer_written.wait(lock, [this] { return !has_pending_buffer; });
+
+	has_pending_buffer = true;
+	pending_buffer = active_buffer;
+	pending_length = active_length;
+
+	lock.unlock();
+	buffer_submitted.notify_one();
+
+	active_buffer ^= 1;
+	active_length = 0;
+}
+
+
+void TraceLogger::flushLoop()
+{
+	std::unique_lock<std::mutex> lock{ mutex };
+
+	while (true)
+	{
+		buffer_submitted.wait(lock, [this] { return has_pending_buffer || stopping; });
+
+		if (!has_pending_buffer)
+		{
+			return;
+		}
+
+		// The emulator never touches the pending buffer, so it can be written without the lock.
+		const char* data{ buffers[pending_buffer].data() };
+		size_t length{ pending_length };
+
+		lock.unlock();
+		std::fwrite(data, 1, length, file);
+		lock.lock();
+
+		has_pending_buffer = false;
+		buffer_written.notify_all();
+	}
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "cpu.hpp"
+
+
+/// <summary>
+/// Writes one line per executed instruction in the nestest log format:
+/// 
+///		C000  4C F5 C5  JMP $C5F5                       A:00 X:00 Y:00 P:24 SP:FD CYC:7
+/// 
+/// Lines are formatted by hand into a large preallocated buffer. 
+/// Full buffers are handed to a background thread which writes them to disk
+/// while the emulator keeps filling the other buffer.
+/// </summary>
+class TraceLogger : public TraceHook
+{
+public:
+	/// <summary>
+	/// Opens the log file and starts the flushing thread.
+	/// Throws std::runtime_error if the file cannot be opened.
+	/// </summary>
+	/// <param name="path">File to write the trace to.</param>
+	/// <param name="buffer_size">Size in bytes of each of the two buffers.</param>
+	explicit TraceLogger(const std::string& path, size_t buffer_size = 16 * 1024 * 1024);
+	~TraceLogger();
+
+	TraceLogger(const TraceLogger&) = delete;
+	TraceLogger& operator=(const TraceLogger&) = delete;
+
+	/// <summary>
+	/// Appends a line for the instruction about to be executed.
+	/// </summary>
+	void onInstruction(const CPU::Registers& registers, const byte* instruction, uint64_t cycles) override;
+
+	/// <summary>
+	/// Hands whatever has been buffered to the flushing thread and waits until it is on disk.
+	/// </summary>
+	void flush();
+
+private:
+	// Longest line onInstruction() can produce, including the newline.
+	static constexpr size_t max_line_length{ 128 };
+
+	void submitActiveBuffer();
+	void flushLoop();
+
+	std::FILE* file{ nullptr };
+
+	// Double buffering: the emulator fills one buffer while the other is written out.
+	std::vector<char> buffers[2];
+	size_t active_buffer{ 0 };
+	size_t active_length{ 0 };
+
+	std::thread flusher;
+	std::mutex mutex;
+	std::condition_variable buffer_submitted;
+	std::condition_variable buffer_written;
+	bool has_pending_buffer{ false };
+	size_t pending_buffer{ 0 };
+	size_t pending_length{ 0 };
+	bool stopping{ false };
+};
@@ -0,0 +1,290 @@
+#include "trace_tool.hpp"
+#include "binary_trace.hpp"
+#include "opcodes.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+namespace
+{
+	void printRecord(const TraceRecord& record, uint64_t cycle)
+	{
+		std::printf("%04X  %02X  %s  A:%02X X:%02X Y:%02X P:%02X SP:%02X CYC:%llu\n",
+			record.program_counter, record.opcode, opcode_table[record.opcode].mnemonic,
+			record.reg_accumulator, record.reg_x, record.reg_y, record.processor_status, record.stack_pointer,
+			static_cast<unsigned long long>(cycle));
+	}
+
+
+	/// <summary>
+	/// Prints up to 'count' records starting at record 'first' of chunk 'chunk'.
+	/// </summary>
+	void printFrom(BinaryTraceReader& reader, size_t chunk, size_t first, uint64_t count)
+	{
+		std::vector<TraceRecord> records;
+
+		while (count > 0 && chunk < reader.getChunks().size())
+		{
+			reader.readChunk(chunk, records);
+
+			uint64_t cycle{ reader.getChunks()[chunk].first_cycle };
+			for (size_t i{ 0 }; i < records.size() && count > 0; ++i)
+			{
+				cycle += records[i].cycle_delta;
+				if (i >= first)
+				{
+					printRecord(records[i], cycle);
+					--count;
+				}
+			}
+
+			++chunk;
+			first = 0;
+		}
+	}
+
+
+	int info(const std::string& path)
+	{
+		BinaryTraceReader reader{ path };
+
+		uint64_t compressed{ 0 };
+		for (const TraceChunkInfo& chunk : reader.getChunks())
+		{
+			compressed += chunk.compressed_size;
+		}
+
+		uint64_t raw{ reader.getRecordCount() * TraceRecord::record_size };
+		std::printf("records:           %llu\n", static_cast<unsigned long long>(reader.getRecordCount()));
+		std::printf("chunks:            %zu (%u records each)\n", reader.getChunks().size(), reader.getRecordsPerChunk());
+		std::printf("compressed bytes:  %llu (%.1f%% of %llu)\n", static_cast<unsigned long long>(compressed),
+			raw == 0 ? 0.0 : 100.0 * static_cast<double>(compressed) / static_cast<double>(raw),
+			static_cast<unsigned long long>(raw));
+
+		return EXIT_SUCCESS;
+	}
+
+
+	int decode(const std::string& path, uint64_t first, uint64_t count)
+	{
+		BinaryTraceReader reader{ path };
+
+		const std::vector<TraceChunkInfo>& chunks{ reader.getChunks() };
+		auto it = std::upper_bound(chunks.begin(), chunks.end(), first,
+			[](uint64_t value, const TraceChunkInfo& chunk) { return value < chunk.first_record; });
+
+		if (it == chunks.begin())
+		{
+			return EXIT_SUCCESS;
+		}
+
+		size_t chunk{ static_cast<size_t>(it - chunks.begin() - 1) };
+		printFrom(reader, chunk, static_cast<size_t>(first - chunks[chunk].first_record), count);
+
+		return EXIT_SUCCESS;
+	}
+
+
+	int seek(const std::string& path, uint64_t target_cycle, uint64_t count)
+	{
+		BinaryTraceReader reader{ path };
+
+		if (reader.getChunks().empty())
+		{
+			return EXIT_SUCCESS;
+		}
+
+		size_t chunk{ reader.findChunk(target_cycle) };
+
+		std::vector<TraceRecord> records;
+		reader.readChunk(chunk, records);
+
+		// Last instruction starting at or before the target cycle.
+		uint64_t cycle{ reader.getChunks()[chunk].first_cycle };
+		size_t first{ 0 };
+		for (size_t i{ 1 }; i < records.size(); ++i)
+		{
+			if (cycle + records[i].cycle_delta > target_cycle)
+			{
+				break;
+			}
+
+			cycle += records[i].cycle_delta;
+			first = i;
+		}
+
+		printFrom(reader, chunk, first, count);
+
+		return EXIT_SUCCESS;
+	}
+
+
+	int diff(const std::string& path_a, const std::string& path_b)
+	{
+		BinaryTraceReader reader_a{ path_a };
+		BinaryTraceReader reader_b{ path_b };
+
+		if (reader_a.getRecordsPerChunk() != reader_b.getRecordsPerChunk())
+		{
+			std::fprintf(stderr, "diff: traces use different chunk sizes (%u vs %u)\n",
+				reader_a.getRecordsPerChunk(), reader_b.getRecordsPerChunk());
+			return EXIT_FAILURE;
+		}
+
+		const size_t chunk_count{ std::min(reader_a.getChunks().size(), reader_b.getChunks().size()) };
+
+		// Workers claim chunks in order; chunks after the earliest known difference are skipped.
+		std::atomic<size_t> next_chunk{ 0 };
+		std::atomic<uint64_t> first_difference{ UINT64_MAX };
+
+		auto worker = [&]()
+		{
+			BinaryTraceReader a{ path_a };
+			BinaryTraceReader b{ path_b };
+			std::vector<TraceRecord> records_a;
+			std::vector<TraceRecord> records_b;
+
+			for (size_t chunk{ next_chunk++ }; chunk < chunk_count; chunk = next_chunk++)
+			{
+				uint64_t chunk_start{ a.getChunks()[chunk].first_record };
+				if (chunk_start >= first_difference.load())
+				{
+					return;
+				}
+
+				a.readChunk(chunk, records_a);
+				b.readChunk(chunk, records_b);
+
+				// Chunks start at absolute cycles, so compare those too.
+				bool same_start{ a.getChunks()[chunk].first_cycle == b.getChunks()[chunk].first_cycle };
+
+				size_t length{ std::min(records_a.size(), records_b.size()) };
+				for (size_t i{ 0 }; i < length; ++i)
+				{
+					if (records_a[i] != records_b[i] || (i == 0 && !same_start))
+					{
+						uint64_t found{ chunk_start + i };
+						uint64_t current{ first_difference.load() };
+						while (found < current && !first_difference.compare_exchange_weak(current, found))
+						{
+						}
+						break;
+					}
+				}
+			}
+		};
+
+		// An exception escaping a thread terminates the process: the first one a worker throws
+		// (e.g. a corrupt chunk) stops the others and is rethrown once they have all finished.
+		std::exception_ptr failure;
+		std::mutex failure_mutex;
+
+		auto guarded_worker = [&]()
+		{
+			try
+			{
+				worker();
+			}
+			catch (...)
+			{
+				next_chunk = chunk_count;
+
+				std::lock_guard<std::mutex> lock{ failure_mutex };
+				if (failure == nullptr)
+				{
+					failure = std::current_exception();
+				}
+			}
+		};
+
+		size_t thread_count{ std::max<size_t>(1, std::min<size_t>(std::thread::hardware_concurrency(), chunk_count)) };
+		std::vector<std::thread> threads;
+		for (size_t i{ 0 }; i < thread_count; ++i)
+		{
+			threads.emplace_back(guarded_worker);
+		}
+		for (std::thread& thread : threads)
+		{
+			thread.join();
+		}
+
+		if (failure != nullptr)
+		{
+			std::rethrow_exception(failure);
+		}
+
+		uint64_t difference{ first_difference.load() };
+		if (difference == UINT64_MAX)
+		{
+			if (reader_a.getRecordCount() == reader_b.getRecordCount())
+			{
+				std::printf("traces are identical (%llu records)\n", static_cast<unsigned long long>(reader_a.getRecordCount()));
+				return EXIT_SUCCESS;
+			}
+
+			// One trace is a prefix of the other.
+			difference = std::min(reader_a.getRecordCount(), reader_b.getRecordCount());
+		}
+
+		std::printf("first difference at instruction %llu\n", static_cast<unsigned long long>(difference));
+		std::printf("--- %s\n", path_a.c_str());
+		decode(path_a, difference, 1);
+		std::printf("+++ %s\n", path_b.c_str());
+		decode(path_b, difference, 1);
+
+		return 1;
+	}
+
+
+	uint64_t parseNumber(int argc, char* argv[], int index, uint64_t fallback)
+	{
+		return (index < argc) ? std::strtoull(argv[index], nullptr, 0) : fallback;
+	}
+}
+
+
+int TraceTool::run(int argc, char* argv[])
+{
+	const std::string command{ argc >= 1 ? argv[0] : "" };
+
+	try
+	{
+		if (command == "info" && argc >= 2)
+		{
+			return info(argv[1]);
+		}
+		if (command == "decode" && argc >= 2)
+		{
+			return decode(argv[1], parseNumber(argc, argv, 2, 0), parseNumber(argc, argv, 3, 20));
+		}
+		if (command == "seek" && argc >= 3)
+		{
+			return seek(argv[1], parseNumber(argc, argv, 2, 0), parseNumber(argc, argv, 3, 20));
+		}
+		if (command == "diff" && argc >= 3)
+		{
+			return diff(argv[1], argv[2]);
+		}
+	}
+	catch (const std::exception& e)
+	{
+		std::fprintf(stderr, "%s\n", e.what());
+		return EXIT_FAILURE;
+	}
+
+	std::fprintf(stderr,
+		"usage: tracetool info   <trace>\n"
+		"       tracetool decode <trace> [first] [count]\n"
+		"       tracetool seek   <trace> <cycle> [count]\n"
+		"       tracetool diff   <trace_a> <trace_b>\n");
+
+	return EXIT_FAILURE;
+}
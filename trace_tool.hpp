@@ -0,0 +1,21 @@
+#pragma once
+
+/// <summary>
+/// Command line tool for binary traces (see binary_trace.hpp).
+/// 
+///		info   <trace>							chunk and record counts
+///		decode <trace> [first] [count]			print records starting at instruction number 'first'
+///		seek   <trace> <cycle> [count]			print records starting at the instruction executing at 'cycle'
+///		diff   <trace_a> <trace_b>				report the first differing instruction (chunks compared in parallel)
+/// </summary>
+class TraceTool
+{
+public:
+	/// <param name="argc">Number of arguments following the tool name.</param>
+	/// <param name="argv">Arguments following the tool name.</param>
+	/// <returns>Process exit code (for diff: 0 if identical, 1 if different).</returns>
+	static int run(int argc, char* argv[]);
+
+private:
+	TraceTool() = delete;
+};
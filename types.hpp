@@ -0,0 +1,7 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+using byte = uint8_t;
+using word = uint16_t;
@@ -0,0 +1,131 @@
+#include "vec_env.hpp"
+
+#include <algorithm>
+
+
+VecEnv::VecEnv(const Cartridge& cartridge, size_t count, Observation observation, RewardFunction reward,
+	unsigned boot_frames, unsigned threads)
+	: observation{ observation }
+	, reward{ std::move(reward) }
+	, boot_snapshot{ std::make_unique<NES::Snapshot>() }
+	, pool{ std::max(threads, 1u) }
+{
+	NES booted;
+	booted.loadCartridge(cartridge);
+	booted.power();
+
+	for (unsigned frame{ 0 }; frame < boot_frames; ++frame)
+	{
+		booted.runFrame(observation == Observation::Grayscale && frame + 1 == boot_frames);
+	}
+
+	booted.save(*boot_snapshot);
+	consoles.assign(count, booted);
+
+	boot_observation.resize(getObservationSize());
+	observe(booted, boot_observation.data());
+
+	step_job = [this](size_t env) { stepEnvironment(env); };
+	reset_job = [this](size_t env) { resetEnvironment(env); };
+}
+
+
+void VecEnv::step(const byte* actions, byte* observations, float* rewards)
+{
+	step_actions = actions;
+	step_observations = observations;
+	step_rewards = rewards;
+
+	pool.run(consoles.size(), step_job);
+}
+
+
+void VecEnv::reset(const bool* mask, byte* observations)
+{
+	reset_mask = mask;
+	step_observations = observations;
+
+	pool.run(consoles.size(), reset_job);
+}
+
+
+size_t VecEnv::getCount() const
+{
+	return consoles.size();
+}
+
+
+size_t VecEnv::getObservationSize() const
+{
+	switch (observation)
+	{
+		case Observation::Grayscale:	return grayscale_width * grayscale_height;
+		default:						return Bus::ram_size;
+	}
+}
+
+
+NES& VecEnv::getNES(size_t env)
+{
+	return consoles[env];
+}
+
+
+const NES& VecEnv::getNES(size_t env) const
+{
+	return consoles[env];
+}
+
+
+void VecEnv::stepEnvironment(size_t env)
+{
+	NES& nes{ consoles[env] };
+
+	// RAM observations don't need the picture.
+	nes.setInput(step_actions[env], 0x00);
+	nes.runFrame(observation == Observation::Grayscale);
+
+	observe(nes, step_observations + env * getObservationSize());
+	step_rewards[env] = reward ? reward(env, nes) : 0.0f;
+}
+
+
+void VecEnv::resetEnvironment(size_t env)
+{
+	if (reset_mask != nullptr && !reset_mask[env])
+	{
+		return;
+	}
+
+	consoles[env].restore(*boot_snapshot);
+	std::copy(boot_observation.begin(), boot_observation.end(), step_observations + env * getObservationSize());
+}
+
+
+void VecEnv::observe(const NES& nes, byte* out) const
+{
+	if (observation == Observation::RAM)
+	{
+		nes.getCPU().getBus().copyRAM(out);
+		return;
+	}
+
+	const uint32_t* pixels{ nes.getFramebuffer() };
+
+	for (size_t y{ 0 }; y < grayscale_height; ++y)
+	{
+		const uint32_t* row{ pixels + 2 * y * PPU::screen_width };
+
+		for (size_t x{ 0 }; x < grayscale_width; ++x)
+		{
+			uint32_t sum{ 0 };
+			for (uint32_t pixel : { row[2 * x], row[2 * x + 1], row[PPU::screen_width + 2 * x], row[PPU::screen_width + 2 * x + 1] })
+			{
+				// Luma, BT.601 weights in 8-bit fixed point.
+				sum += (((pixel >> 16) & 0xFF) * 77 + ((pixel >> 8) & 0xFF) * 150 + (pixel & 0xFF) * 29) >> 8;
+			}
+
+			*out++ = static_cast<byte>(sum / 4);
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "nes.hpp"
+#include "thread_pool.hpp"
+
+
+/// <summary>
+/// Batch of independent consoles running the same game, for reinforcement learning.
+/// step() advances every console one frame with its own input, in parallel over a thread pool.
+///
+/// Observations and rewards are written into caller-provided contiguous buffers:
+/// environment i uses observations[i * getObservationSize()] onwards and rewards[i].
+/// Stepping and resetting allocate nothing.
+/// </summary>
+class VecEnv
+{
+public:
+	enum class Observation
+	{
+		Grayscale,	// 128x120 pixels, each the average luma of a 2x2 block of the picture
+		RAM,		// the 2 KiB of work RAM (frames are emulated without rendering)
+	};
+
+	static constexpr size_t grayscale_width{ PPU::screen_width / 2 };
+	static constexpr size_t grayscale_height{ PPU::screen_height / 2 };
+
+	/// <summary>
+	/// Reward for the frame environment env just emulated, usually computed from work RAM
+	/// (see Bus::peek()). Called on worker threads, concurrently for different environments.
+	/// </summary>
+	using RewardFunction = std::function<float(size_t env, const NES& nes)>;
+
+	/// <summary>
+	/// Boots one console, caches a snapshot of it and copies it count times.
+	/// </summary>
+	/// <param name="cartridge">Game to run.</param>
+	/// <param name="count">Number of environments.</param>
+	/// <param name="observation">What step() and reset() write to the observation buffer.</param>
+	/// <param name="reward">Reward function.</param>
+	/// <param name="boot_frames">Frames emulated (without input) after power-up before the snapshot is taken.</param>
+	/// <param name="threads">Threads used by step() and reset(), the caller's included.</param>
+	VecEnv(const Cartridge& cartridge, size_t count, Observation observation, RewardFunction reward,
+		unsigned boot_frames = 0, unsigned threads = std::thread::hardware_concurrency());
+
+	VecEnv(const VecEnv&) = delete;
+	VecEnv& operator=(const VecEnv&) = delete;
+
+	/// <summary>
+	/// Emulates one frame on every environment.
+	/// </summary>
+	/// <param name="actions">Controller 1 buttons per environment (see Controller).</param>
+	/// <param name="observations">Receives getCount() observations.</param>
+	/// <param name="rewards">Receives getCount() rewards.</param>
+	void step(const byte* actions, byte* observations, float* rewards);
+
+	/// <summary>
+	/// Restores environments to the cached post-boot snapshot and writes their observations.
+	/// Observations of the other environments are left untouched.
+	/// </summary>
+	/// <param name="mask">Environments to reset (nullptr resets all of them).</param>
+	/// <param name="observations">Buffer for getCount() observations.</param>
+	void reset(const bool* mask, byte* observations);
+
+	size_t getCount() const;
+
+	/// <summary>
+	/// Bytes per observation.
+	/// </summary>
+	size_t getObservationSize() const;
+
+	NES& getNES(size_t env);
+	const NES& getNES(size_t env) const;
+
+private:
+	void stepEnvironment(size_t env);
+	void resetEnvironment(size_t env);
+	void observe(const NES& nes, byte* out) const;
+
+	std::vector<NES> consoles;
+	Observation observation;
+	RewardFunction reward;
+
+	// Post-boot state and its observation; large, so kept off the stack.
+	std::unique_ptr<NES::Snapshot> boot_snapshot;
+	std::vector<byte> boot_observation;
+
+	ThreadPool pool;
+
+	// Arguments of the current step()/reset(), read by the jobs. The jobs only capture
+	// 'this', so they are built once and running them allocates nothing.
+	const byte* step_actions{ nullptr };
+	byte* step_observations{ nullptr };
+	float* step_rewards{ nullptr };
+	const bool* reset_mask{ nullptr };
+
+	std::function<void(size_t)> step_job;
+	std::function<void(size_t)> reset_job;
+};
\ No newline at end of file